@@ -98,128 +98,123 @@ void AudioEncoder::set_voip_bitrate(int bitrate)
     opus_encoder_ctl(_enc_voip, OPUS_SET_BITRATE(bitrate));
 }
 
-unsigned char* AudioEncoder::encode_opus(short *audiobuffer, int audiobuffersize, int &encoded_size)
+void AudioEncoder::set_voip_dtx(bool value)
 {
-    unsigned char *encoded_audio = new unsigned char[47];
-    encoded_size = opus_encode(_enc, audiobuffer, audiobuffersize/sizeof(short), encoded_audio, 47);
-    return encoded_audio;
+    opus_encoder_ctl(_enc_voip, OPUS_SET_DTX((int)value));
 }
 
-unsigned char* AudioEncoder::encode_opus_voip(short *audiobuffer, int audiobuffersize, int &encoded_size)
+int AudioEncoder::encode_opus(const short *pcm, int samples, unsigned char *out, int max_bytes)
 {
-    unsigned char *encoded_audio = new unsigned char[4096];
-    encoded_size = opus_encode(_enc_voip, audiobuffer, audiobuffersize/sizeof(short), encoded_audio, 4096);
-    return encoded_audio;
+    return opus_encode(_enc, pcm, samples, out, max_bytes);
 }
 
-short* AudioEncoder::decode_opus(unsigned char *audiobuffer, int audiobuffersize, int &samples)
+int AudioEncoder::encode_opus_voip(const short *pcm, int samples, unsigned char *out, int max_bytes)
 {
-    if(audiobuffersize > 47)
+    return opus_encode(_enc_voip, pcm, samples, out, max_bytes);
+}
+
+int AudioEncoder::decode_opus(const unsigned char *data, int size, short *pcm, int max_samples)
+{
+    if(size > 47)
     {
-        samples = 0;
-        delete[] audiobuffer;
-        return nullptr;
+        return 0;
     }
-    int fs = 320;
-    short *pcm = new short[fs];
-    //memset(pcm,0,(fs)*sizeof(short));
-    samples = opus_decode(_dec,audiobuffer,audiobuffersize, pcm, fs, 0);
+    int samples = opus_decode(_dec, data, size, pcm, max_samples, 0);
     if(samples <= 0)
     {
-        delete[] pcm;
-        return nullptr;
+        return 0;
     }
-    return pcm;
+    return samples;
 }
 
-short* AudioEncoder::decode_opus_voip(unsigned char *audiobuffer, int audiobuffersize, int &samples)
+int AudioEncoder::decode_opus_voip(const unsigned char *data, int size, short *pcm, int max_samples)
 {
-    if(audiobuffersize > 512)
+    if(size > 512)
     {
-        samples = 0;
-        delete[] audiobuffer;
-        return nullptr;
+        return 0;
     }
-    int fs = 4096;
-    short *pcm = new short[fs];
-    //memset(pcm,0,(fs)*sizeof(short));
-    samples = opus_decode(_dec_voip,audiobuffer,audiobuffersize, pcm, fs, 0);
+    int samples = opus_decode(_dec_voip, data, size, pcm, max_samples, 0);
     if(samples <= 0)
     {
-        delete[] pcm;
-        return nullptr;
+        return 0;
     }
-    return pcm;
+    return samples;
 }
 
+int AudioEncoder::encode_codec2(struct CODEC2 *codec, int frame_bytes, short *pcm, int samples,
+                                unsigned char *out, int max_bytes)
+{
+    int frame_samples = codec2_samples_per_frame(codec);
+    int frames = samples / frame_samples;
+    if(frames * frame_bytes > max_bytes)
+    {
+        return -1;
+    }
+    for(int i=0;i<frames;i++)
+    {
+        codec2_encode(codec, out + i * frame_bytes, pcm + i * frame_samples);
+    }
+    return frames * frame_bytes;
+}
 
+int AudioEncoder::decode_codec2(struct CODEC2 *codec, int frame_bytes, const unsigned char *data,
+                                int size, short *pcm, int max_samples)
+{
+    int frame_samples = codec2_samples_per_frame(codec);
+    int frames = size / frame_bytes;
+    if(frames * frame_samples > max_samples)
+    {
+        return -1;
+    }
+    for(int i=0;i<frames;i++)
+    {
+        codec2_decode(codec, pcm + i * frame_samples, data + i * frame_bytes);
+    }
+    return frames * frame_samples;
+}
 
-unsigned char* AudioEncoder::encode_codec2_1400(short *audiobuffer, int audiobuffersize, int &length)
+int AudioEncoder::encode_codec2_1400(short *pcm, int samples, unsigned char *out, int max_bytes)
 {
-    _processor->filter_audio(audiobuffer, audiobuffersize,true,false);
-    int bits = codec2_bits_per_frame(_codec2_1400);
+    _processor->filter_audio(pcm, samples*sizeof(short), true, false);
     //int bytes = (bits + 7) / 8;
-    int bytes = bits / 8;
-    unsigned char *encoded = new unsigned char[bytes];
-    codec2_encode(_codec2_1400, encoded, audiobuffer);
-    length = bytes;
-    return encoded;
+    int bytes = codec2_bits_per_frame(_codec2_1400) / 8;
+    return encode_codec2(_codec2_1400, bytes, pcm, samples, out, max_bytes);
 }
 
-unsigned char* AudioEncoder::encode_codec2_700(short *audiobuffer, int audiobuffersize, int &length)
+int AudioEncoder::encode_codec2_700(short *pcm, int samples, unsigned char *out, int max_bytes)
 {
-    _processor->filter_audio(audiobuffer, audiobuffersize, true, false);
-    int bits = codec2_bits_per_frame(_codec2_700);
-    int bytes = (bits + 4) / 8;
-    unsigned char *encoded = new unsigned char[bytes];
-    codec2_encode(_codec2_700, encoded, audiobuffer);
-    length = bytes;
-    return encoded;
+    _processor->filter_audio(pcm, samples*sizeof(short), true, false);
+    int bytes = (codec2_bits_per_frame(_codec2_700) + 4) / 8;
+    return encode_codec2(_codec2_700, bytes, pcm, samples, out, max_bytes);
 }
 
-unsigned char* AudioEncoder::encode_codec2_2400(short *audiobuffer, int audiobuffersize, int &length)
+int AudioEncoder::encode_codec2_2400(short *pcm, int samples, unsigned char *out, int max_bytes)
 {
-    _processor->filter_audio(audiobuffer, audiobuffersize);
-    int bits = codec2_bits_per_frame(_codec2_2400);
-    int bytes = (bits + 4) / 8;
-    unsigned char *encoded = new unsigned char[bytes];
-    codec2_encode(_codec2_2400, encoded, audiobuffer);
-    length = bytes;
-    return encoded;
+    _processor->filter_audio(pcm, samples*sizeof(short));
+    int bytes = (codec2_bits_per_frame(_codec2_2400) + 4) / 8;
+    return encode_codec2(_codec2_2400, bytes, pcm, samples, out, max_bytes);
 }
 
-short* AudioEncoder::decode_codec2_1400(unsigned char *audiobuffer, int audiobuffersize, int &samples)
+int AudioEncoder::decode_codec2_1400(const unsigned char *data, int size, short *pcm, int max_samples)
 {
-    Q_UNUSED(audiobuffersize);
-    samples = codec2_samples_per_frame(_codec2_1400);
-    short* decoded = new short[samples];
-    memset(decoded,0,(samples)*sizeof(short));
-    codec2_decode(_codec2_1400, decoded, audiobuffer);
-    _processor->filter_audio(decoded, samples*sizeof(short),false,true);
-    return decoded;
+    int bytes = codec2_bits_per_frame(_codec2_1400) / 8;
+    int samples = decode_codec2(_codec2_1400, bytes, data, size, pcm, max_samples);
+    if(samples > 0)
+        _processor->filter_audio(pcm, samples*sizeof(short), false, true);
+    return samples;
 }
 
-short* AudioEncoder::decode_codec2_700(unsigned char *audiobuffer, int audiobuffersize, int &samples)
+int AudioEncoder::decode_codec2_700(const unsigned char *data, int size, short *pcm, int max_samples)
 {
-    Q_UNUSED(audiobuffersize);
-    samples = codec2_samples_per_frame(_codec2_700);
-    short* decoded = new short[samples];
-    memset(decoded,0,(samples)*sizeof(short));
-    codec2_decode(_codec2_700, decoded, audiobuffer);
-    _processor->filter_audio(decoded, samples*sizeof(short), false, true);
-    return decoded;
+    int bytes = (codec2_bits_per_frame(_codec2_700) + 4) / 8;
+    int samples = decode_codec2(_codec2_700, bytes, data, size, pcm, max_samples);
+    if(samples > 0)
+        _processor->filter_audio(pcm, samples*sizeof(short), false, true);
+    return samples;
 }
 
-short* AudioEncoder::decode_codec2_2400(unsigned char *audiobuffer, int audiobuffersize, int &samples)
+int AudioEncoder::decode_codec2_2400(const unsigned char *data, int size, short *pcm, int max_samples)
 {
-    Q_UNUSED(audiobuffersize);
-    samples = codec2_samples_per_frame(_codec2_2400);
-    short* decoded = new short[samples];
-    memset(decoded,0,(samples)*sizeof(short));
-    codec2_decode(_codec2_2400, decoded, audiobuffer);
-    return decoded;
+    int bytes = (codec2_bits_per_frame(_codec2_2400) + 4) / 8;
+    return decode_codec2(_codec2_2400, bytes, data, size, pcm, max_samples);
 }
-
-
-
-
@@ -31,19 +31,30 @@ public:
     AudioEncoder(const Settings *settings);
     ~AudioEncoder();
     void set_voip_bitrate(int bitrate);
-    unsigned char *encode_opus(short *audiobuffer, int audiobuffersize, int &encoded_size);
-    short *decode_opus(unsigned char *audiobuffer, int data_length, int &samples);
-    unsigned char *encode_opus_voip(short *audiobuffer, int audiobuffersize, int &encoded_size);
-    short *decode_opus_voip(unsigned char *audiobuffer, int data_length, int &samples);
-    unsigned char* encode_codec2_1400(short *audiobuffer, int audiobuffersize, int &length);
-    unsigned char* encode_codec2_700(short *audiobuffer, int audiobuffersize, int &length);
-    unsigned char* encode_codec2_2400(short *audiobuffer, int audiobuffersize, int &length);
-    short* decode_codec2_1400(unsigned char *audiobuffer, int audiobuffersize, int &samples);
-    short* decode_codec2_700(unsigned char *audiobuffer, int audiobuffersize, int &samples);
-    short* decode_codec2_2400(unsigned char *audiobuffer, int audiobuffersize, int &samples);
+    void set_voip_dtx(bool value);
+    /// All codec calls write into caller owned buffers and never allocate.
+    /// Encoders return the number of bytes written, decoders the number of
+    /// samples, or a negative value if the output buffer is too small.
+    /// The codec2 variants take a whole number of frames and run them as a batch.
+    /// Buffers handed to another thread must be owned by the receiver, not lent.
+    int encode_opus(const short *pcm, int samples, unsigned char *out, int max_bytes);
+    int decode_opus(const unsigned char *data, int size, short *pcm, int max_samples);
+    int encode_opus_voip(const short *pcm, int samples, unsigned char *out, int max_bytes);
+    int decode_opus_voip(const unsigned char *data, int size, short *pcm, int max_samples);
+    int encode_codec2_1400(short *pcm, int samples, unsigned char *out, int max_bytes);
+    int encode_codec2_700(short *pcm, int samples, unsigned char *out, int max_bytes);
+    int encode_codec2_2400(short *pcm, int samples, unsigned char *out, int max_bytes);
+    int decode_codec2_1400(const unsigned char *data, int size, short *pcm, int max_samples);
+    int decode_codec2_700(const unsigned char *data, int size, short *pcm, int max_samples);
+    int decode_codec2_2400(const unsigned char *data, int size, short *pcm, int max_samples);
 
 
 private:
+    int encode_codec2(struct CODEC2 *codec, int frame_bytes, short *pcm, int samples,
+                      unsigned char *out, int max_bytes);
+    int decode_codec2(struct CODEC2 *codec, int frame_bytes, const unsigned char *data,
+                      int size, short *pcm, int max_samples);
+
     const Settings *_settings;
     OpusEncoder *_enc;
     OpusDecoder *_dec;
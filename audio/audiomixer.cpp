@@ -30,7 +30,7 @@ void AudioMixer::empty()
 {
     if(_sample_buffers.size() > 0)
     {
-        QMap<int, QVector<short>*>::const_iterator iter = _sample_buffers.constBegin();
+        QMap<qint64, QVector<short>*>::const_iterator iter = _sample_buffers.constBegin();
         while (iter != _sample_buffers.constEnd())
         {
             QVector<short> *samples_for_sid = iter.value();
@@ -48,7 +48,7 @@ bool AudioMixer::buffers_available()
 }
 
 
-void AudioMixer::addSamples(short *pcm, int samples, int sid)
+void AudioMixer::addSamples(short *pcm, int samples, qint64 sid)
 {
     _mutex.lock();
     QVector<short> *samples_for_sid;
@@ -66,7 +66,6 @@ void AudioMixer::addSamples(short *pcm, int samples, int sid)
         samples_for_sid->push_back(pcm[i]);
     }
     _mutex.unlock();
-    delete[] pcm;
 }
 
 
@@ -76,14 +75,14 @@ short* AudioMixer::mix_samples(float rx_volume)
     const int max_frame_size = 960; // to voip can reach 120 msec
     short *pcm = nullptr;
     int max_samples = 0;
-    QMap<int, int> sizes_map;
+    QMap<qint64, int> sizes_map;
 
     _mutex.lock();
     /// get buffers with available samples
-    QMap<int, QVector<short>*>::const_iterator iter = _sample_buffers.constBegin();
+    QMap<qint64, QVector<short>*>::const_iterator iter = _sample_buffers.constBegin();
     while (iter != _sample_buffers.constEnd())
     {
-        int sid = iter.key();
+        qint64 sid = iter.key();
         QVector<short> *samples_for_sid = iter.value();
         if(samples_for_sid->size() > max_samples)
         {
@@ -98,7 +97,7 @@ short* AudioMixer::mix_samples(float rx_volume)
         int num_channels = sizes_map.size();
         pcm = new short[frame_size];
         memset(pcm, 0, frame_size*sizeof(short));
-        QMap<int, int>::const_iterator it = sizes_map.constBegin();
+        QMap<qint64, int>::const_iterator it = sizes_map.constBegin();
         for(int i = 0;i<frame_size;i++)
         {
             while (it != sizes_map.constEnd())
@@ -33,13 +33,14 @@ public:
 signals:
 
 public slots:
-    void addSamples(short *pcm, int samples, int sid);
+    /// samples are copied, the caller keeps ownership of pcm
+    void addSamples(short *pcm, int samples, qint64 sid);
     short *mix_samples(float rx_volume);
     bool buffers_available();
     void empty();
 
 private:
-    QMap<int, QVector<short>*> _sample_buffers;
+    QMap<qint64, QVector<short>*> _sample_buffers;
     QMutex _mutex;
 
 };
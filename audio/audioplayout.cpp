@@ -0,0 +1,248 @@
+// Written by Adrian Musceac YO8RZZ , started October 2013.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+#include "audioplayout.h"
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+
+/// 8 ksps mono
+static const int SAMPLES_PER_MS = 8;
+/// how much the playout delay moves on each adjustment
+static const int PLAYOUT_STEP_MS = 20;
+static const int PLAYOUT_MAX_TARGET_MS = 200;
+/// audio resuming sooner than this after the buffer ran dry counts as an underrun,
+/// a longer pause is the end of a talk spurt
+static const int PLAYOUT_UNDERRUN_GAP_MS = 100;
+/// backlog is measured as the lowest fill seen over this window
+static const int PLAYOUT_WINDOW_MS = 1000;
+static const int PLAYOUT_TRIM_MARGIN_MS = 20;
+/// time without underruns before the delay is lowered again
+static const int PLAYOUT_DECAY_MS = 30000;
+
+AudioPlayout::AudioPlayout(Logger *logger, int capacity_ms, int target_ms, QObject *parent) :
+    QIODevice(parent)
+{
+    _logger = logger;
+    unsigned int slots = 1;
+    while(slots * PLAYOUT_FRAME_SAMPLES < (unsigned int)(capacity_ms * SAMPLES_PER_MS))
+        slots <<= 1;
+    _slots = slots;
+    _mask = slots - 1;
+    _samples.resize(slots * PLAYOUT_FRAME_SAMPLES, 0);
+    _lengths.resize(slots, 0);
+    _write_slot.store(0);
+    _read_slot.store(0);
+    _fill.store(0);
+    _dropped.store(0);
+    _read_offset = 0;
+    _min_target = target_ms * SAMPLES_PER_MS;
+    _max_target = std::max(_min_target, PLAYOUT_MAX_TARGET_MS * SAMPLES_PER_MS);
+    _target = _min_target;
+    _buffering = true;
+    _waited = 0;
+    _silence_run = -1;
+    _window_samples = 0;
+    _window_min_fill = INT_MAX;
+    _stable_samples = 0;
+    _underruns = 0;
+}
+
+short* AudioPlayout::beginWrite()
+{
+    unsigned int write_slot = _write_slot.load(std::memory_order_relaxed);
+    unsigned int read_slot = _read_slot.load(std::memory_order_acquire);
+    if(write_slot - read_slot >= _slots)
+        return nullptr;
+    return &_samples[(write_slot & _mask) * PLAYOUT_FRAME_SAMPLES];
+}
+
+void AudioPlayout::commitWrite(int samples)
+{
+    if(samples < 1)
+        return;
+    unsigned int write_slot = _write_slot.load(std::memory_order_relaxed);
+    _lengths[write_slot & _mask] = std::min(samples, PLAYOUT_FRAME_SAMPLES);
+    _write_slot.store(write_slot + 1, std::memory_order_release);
+    _fill.fetch_add(std::min(samples, PLAYOUT_FRAME_SAMPLES));
+}
+
+void AudioPlayout::countDropped(int samples)
+{
+    _dropped.fetch_add(samples);
+}
+
+int AudioPlayout::pop(short *out, int count)
+{
+    int copied = 0;
+    while(copied < count)
+    {
+        unsigned int read_slot = _read_slot.load(std::memory_order_relaxed);
+        if(read_slot == _write_slot.load(std::memory_order_acquire))
+            break;
+        unsigned int index = read_slot & _mask;
+        int n = std::min(_lengths[index] - _read_offset, count - copied);
+        if(out != nullptr)
+            memcpy(out + copied, &_samples[index * PLAYOUT_FRAME_SAMPLES + _read_offset],
+                   n * sizeof(short));
+        copied += n;
+        _read_offset += n;
+        if(_read_offset >= _lengths[index])
+        {
+            _read_offset = 0;
+            _read_slot.store(read_slot + 1, std::memory_order_release);
+        }
+    }
+    _fill.fetch_sub(copied);
+    return copied;
+}
+
+void AudioPlayout::flush()
+{
+    pop(nullptr, INT_MAX);
+    _buffering = true;
+    _waited = 0;
+    _silence_run = -1;
+}
+
+int AudioPlayout::queuedMs()
+{
+    return std::max(0, _fill.load()) / SAMPLES_PER_MS;
+}
+
+int AudioPlayout::targetMs()
+{
+    return _target / SAMPLES_PER_MS;
+}
+
+quint64 AudioPlayout::underruns()
+{
+    return _underruns;
+}
+
+quint64 AudioPlayout::dropped()
+{
+    return _dropped.load();
+}
+
+bool AudioPlayout::isSequential() const
+{
+    return true;
+}
+
+qint64 AudioPlayout::bytesAvailable() const
+{
+    /// never runs dry, silence is played when there is no audio
+    return PLAYOUT_FRAME_SAMPLES * sizeof(short) + QIODevice::bytesAvailable();
+}
+
+qint64 AudioPlayout::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+    return -1;
+}
+
+qint64 AudioPlayout::readData(char *data, qint64 maxlen)
+{
+    short *out = (short*)data;
+    int requested = (int)(maxlen / sizeof(short));
+    if(requested < 1)
+        return 0;
+    int fill = std::max(0, _fill.load());
+    if(_buffering)
+    {
+        if(fill > 0)
+        {
+            if((_silence_run >= 0) && (_silence_run < PLAYOUT_UNDERRUN_GAP_MS * SAMPLES_PER_MS))
+            {
+                /// audio came back right after running dry, the delay is too short
+                _underruns++;
+                _stable_samples = 0;
+                if(_target < _max_target)
+                {
+                    _target = std::min(_max_target, _target + PLAYOUT_STEP_MS * SAMPLES_PER_MS);
+                    _logger->log(Logger::LogLevelDebug, QString(
+                            "Audio output underrun, playout delay raised to %1 msec").arg(
+                                     _target / SAMPLES_PER_MS), Logger::LogSubsystemAudio);
+                }
+            }
+            _silence_run = -1;
+            _waited += requested;
+        }
+        else if(_silence_run >= 0)
+        {
+            _silence_run += requested;
+            if(_silence_run >= PLAYOUT_UNDERRUN_GAP_MS * SAMPLES_PER_MS)
+                _silence_run = -1;
+        }
+        /// short clips don't wait for the buffer to fill up to the target
+        if((fill > 0) && ((fill >= _target) || (_waited >= _target)))
+        {
+            _buffering = false;
+            _waited = 0;
+            _window_samples = 0;
+            _window_min_fill = INT_MAX;
+        }
+        else
+        {
+            memset(out, 0, requested * sizeof(short));
+            return requested * sizeof(short);
+        }
+    }
+
+    int n = pop(out, requested);
+    if(n < requested)
+    {
+        memset(out + n, 0, (requested - n) * sizeof(short));
+        _buffering = true;
+        _waited = 0;
+        _silence_run = requested - n;
+    }
+    else
+    {
+        adapt(requested);
+    }
+    return requested * sizeof(short);
+}
+
+void AudioPlayout::adapt(int requested)
+{
+    int fill = std::max(0, _fill.load());
+    _window_min_fill = std::min(_window_min_fill, fill);
+    _window_samples += requested;
+    if(_window_samples >= PLAYOUT_WINDOW_MS * SAMPLES_PER_MS)
+    {
+        if(_window_min_fill > _target + PLAYOUT_TRIM_MARGIN_MS * SAMPLES_PER_MS)
+        {
+            /// audio never drained below this level, it is just added delay
+            pop(nullptr, _window_min_fill - _target);
+        }
+        _window_samples = 0;
+        _window_min_fill = INT_MAX;
+    }
+    _stable_samples += requested;
+    if((_stable_samples >= PLAYOUT_DECAY_MS * SAMPLES_PER_MS) && (_target > _min_target))
+    {
+        _target = std::max(_min_target, _target - PLAYOUT_STEP_MS * SAMPLES_PER_MS);
+        _stable_samples = 0;
+        _logger->log(Logger::LogLevelDebug, QString(
+                "Audio playout delay lowered to %1 msec").arg(
+                         _target / SAMPLES_PER_MS), Logger::LogSubsystemAudio);
+    }
+}
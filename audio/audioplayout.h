@@ -0,0 +1,91 @@
+// Written by Adrian Musceac YO8RZZ , started October 2013.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+#ifndef AUDIOPLAYOUT_H
+#define AUDIOPLAYOUT_H
+
+#include <QIODevice>
+#include <atomic>
+#include <vector>
+#include "src/logger.h"
+
+/// Samples per ring slot, one 40 msec frame at 8 ksps
+#define PLAYOUT_FRAME_SAMPLES 320
+
+/// Lock-free playout buffer between the radio thread and the audio device.
+/// The producer fills whole 40 msec slots in place and publishes them,
+/// the audio device pulls through readData() and always gets a full period,
+/// padded with silence when nothing is queued.
+/// A playout controller keeps the queued audio close to a target delay:
+/// an underrun inside a talk spurt raises the target, a standing backlog
+/// above it is trimmed, and the target decays back after a quiet period.
+class AudioPlayout : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit AudioPlayout(Logger *logger, int capacity_ms=2560, int target_ms=60,
+                          QObject *parent = nullptr);
+
+    /// producer side, a free slot of PLAYOUT_FRAME_SAMPLES or nullptr when full
+    short *beginWrite();
+    void commitWrite(int samples);
+
+    /// consumer side
+    void flush();
+    int queuedMs();
+    int targetMs();
+    quint64 underruns();
+    quint64 dropped();
+    void countDropped(int samples);
+
+    bool isSequential() const;
+    qint64 bytesAvailable() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen);
+    qint64 writeData(const char *data, qint64 len);
+
+private:
+    int pop(short *out, int count);
+    void adapt(int requested);
+
+    Logger *_logger;
+    std::vector<short> _samples;
+    std::vector<int> _lengths;
+    unsigned int _slots;
+    unsigned int _mask;
+    std::atomic<unsigned int> _write_slot;
+    std::atomic<unsigned int> _read_slot;
+    std::atomic<int> _fill;
+    std::atomic<quint64> _dropped;
+    int _read_offset;
+
+    /// playout controller state, only touched by the consumer
+    int _min_target;
+    int _max_target;
+    int _target;
+    bool _buffering;
+    int _waited;
+    int _silence_run;
+    int _window_samples;
+    int _window_min_fill;
+    int _stable_samples;
+    quint64 _underruns;
+};
+
+#endif // AUDIOPLAYOUT_H
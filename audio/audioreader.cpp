@@ -22,6 +22,11 @@ AudioReader::AudioReader(const Settings *settings, Logger *logger, QObject *pare
 {
     _settings = settings;
     _logger = logger;
+    _processor = nullptr;
+    _audio_dev = nullptr;
+    _frame_filled = 0;
+    _frame_samples = CAPTURE_MAX_FRAME_SAMPLES;
+    _next_frame_samples = CAPTURE_MAX_FRAME_SAMPLES;
     _working = true;
     _restart = false;
     _capture_audio = false;
@@ -29,6 +34,9 @@ AudioReader::AudioReader(const Settings *settings, Logger *logger, QObject *pare
     _read_preprocess = false;
 }
 
+AudioReader::~AudioReader()
+{
+}
 
 void AudioReader::stop()
 {
@@ -41,23 +49,64 @@ void AudioReader::restart()
     _restart = true;
 }
 
-void AudioReader::setReadMode(bool capture, bool preprocess, int audio_mode)
+void AudioReader::setReadMode(bool capture, bool preprocess, int audio_mode, int frame_msec)
 {
+    if((frame_msec != 10) && (frame_msec != 20))
+        frame_msec = 40;
+    /// the compressor works in blocks of 32 samples, 10 msec frames would leave gaps
+    if(preprocess && (frame_msec == 10))
+        frame_msec = 20;
     _mutex.lock();
     _capture_audio = capture;
     _read_audio_mode = audio_mode;
     _read_preprocess = preprocess;
+    _next_frame_samples = frame_msec * 8;
     _mutex.unlock();
 }
 
+void AudioReader::readAudio()
+{
+    _mutex.lock();
+    bool capture = _capture_audio;
+    bool preprocess = _read_preprocess;
+    int audio_mode = _read_audio_mode;
+    int next_frame_samples = _next_frame_samples;
+    _mutex.unlock();
+    if(!capture)
+    {
+        /// keep the device drained so capture starts with fresh audio
+        char discard[1024];
+        while(_audio_dev->read(discard, sizeof(discard)) > 0);
+        _frame_filled = 0;
+        _frame_samples = next_frame_samples;
+        return;
+    }
+    while(true)
+    {
+        int frame_bytes = _frame_samples * sizeof(short);
+        if(_frame_filled == 0)
+            _frame = QByteArray(frame_bytes, Qt::Uninitialized);
+        qint64 bytes = _audio_dev->read(_frame.data() + _frame_filled, frame_bytes - _frame_filled);
+        if(bytes <= 0)
+            break;
+        _frame_filled += bytes;
+        if(_frame_filled < frame_bytes)
+            break;
+        int vad = _processor->read_preprocess((short*)_frame.data(), frame_bytes, preprocess, audio_mode);
+        emit audioPCM(_frame, vad, false);
+        /// the receiver keeps the only reference, the next frame gets a new buffer
+        _frame = QByteArray();
+        _frame_filled = 0;
+        _frame_samples = next_frame_samples;
+    }
+}
+
 void AudioReader::run()
 {
+    ThreadScheduler::applyProfile(_settings, _logger, "audioreader");
     start:
     _working = true;
-    AudioProcessor *processor = new AudioProcessor(_settings);
-    _buffer = new QByteArray;
-    // FIXME: support different frame durations
-    int audiobuffer_size = 640; //40 ms @ 8k
+    _processor = new AudioProcessor(_settings);
     QAudioFormat format;
     format.setSampleRate(8000);
     format.setChannelCount(1);
@@ -78,48 +127,30 @@ void AudioReader::run()
     if (!device.isFormatSupported(format))
     {
        _logger->log(Logger::LogLevelCritical, "Raw audio format not supported by backend, cannot capture audio.");
+       delete _processor;
        struct timespec time_to_sleep = {1, 40000000L };
        nanosleep(&time_to_sleep, NULL);
        goto start;
     }
     _logger->log(Logger::LogLevelInfo, QString("Using audio input device %1").arg(device.deviceName()));
     QAudioInput *audio_reader = new QAudioInput(device,format, this);
-    audio_reader->setBufferSize(4096);
-    QIODevice *audio_dev = audio_reader->start();
+    /// two of the longest frames, short enough for the device to signal every period
+    audio_reader->setBufferSize(2 * CAPTURE_MAX_FRAME_SAMPLES * sizeof(short));
+    _frame_filled = 0;
+    _audio_dev = audio_reader->start();
+    QObject::connect(_audio_dev, SIGNAL(readyRead()), this, SLOT(readAudio()));
     while(_working)
     {
-        QCoreApplication::processEvents();
-        bool capture = _capture_audio;
-        bool preprocess = _read_preprocess;
-        int audio_mode = _read_audio_mode;
-        QByteArray data = audio_dev->readAll();
-        if(capture)
-        {
-            _buffer->append(data);
-            if(_buffer->size() >= audiobuffer_size)
-            {
-                short *audiobuffer = new short[audiobuffer_size/sizeof(short)];
-                memcpy(audiobuffer, (short*)_buffer->data(), audiobuffer_size);
-                int vad = processor->read_preprocess(audiobuffer, audiobuffer_size, preprocess, audio_mode);
-                emit audioPCM(audiobuffer, audiobuffer_size, vad, false);
-                _buffer->remove(0, audiobuffer_size);
-                struct timespec time_to_sleep = {0, 39000000L };
-                nanosleep(&time_to_sleep, NULL);
-            }
-        }
-        else
-        {
-            struct timespec time_to_sleep = {0, 40000000L };
-            nanosleep(&time_to_sleep, NULL);
-        }
-
+        /// device notifications and control slots both arrive as events
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
     }
-    audio_dev->close();
+    QObject::disconnect(_audio_dev, SIGNAL(readyRead()), this, SLOT(readAudio()));
+    _audio_dev->close();
     audio_reader->stop();
-    _buffer->clear();
+    _audio_dev = nullptr;
     delete audio_reader;
-    delete processor;
-    delete _buffer;
+    delete _processor;
+    _processor = nullptr;
     if(_restart)
     {
         _restart = false;
@@ -19,32 +19,47 @@
 
 #include <QCoreApplication>
 #include <QMutex>
+#include <QByteArray>
 #include <QAudioInput>
 #include <QDebug>
 #include "audio/audioprocessor.h"
 #include "src/settings.h"
 #include "src/logger.h"
+#include "src/threadscheduler.h"
 
+/// Samples in the longest capture frame, 40 msec at 8 ksps
+#define CAPTURE_MAX_FRAME_SAMPLES 320
+/// Audio capture. The device readyRead() drives reading straight into
+/// the frame buffer, each frame is handed over as soon as it is complete
 class AudioReader : public QObject
 {
     Q_OBJECT
 public:
     explicit AudioReader(const Settings *settings, Logger *logger, QObject *parent = 0);
+    ~AudioReader();
 
 signals:
     void finished();
-    void audioPCM(short *pcm, int bytes, int vad, bool radio_only);
+    void audioPCM(QByteArray pcm, int vad, bool radio_only);
 
 public slots:
     void run();
-    void setReadMode(bool capture, bool preprocess, int audio_mode);
+    void setReadMode(bool capture, bool preprocess, int audio_mode, int frame_msec=40);
     void stop();
     void restart();
 
+private slots:
+    void readAudio();
+
 private:
     const Settings *_settings;
     Logger *_logger;
-    QByteArray *_buffer;
+    AudioProcessor *_processor;
+    QIODevice *_audio_dev;
+    QByteArray _frame;
+    int _frame_filled; // bytes
+    int _frame_samples;
+    int _next_frame_samples;
     bool _working;
     bool _restart;
     bool _capture_audio;
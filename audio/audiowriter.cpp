@@ -16,24 +16,26 @@
 
 
 #include "audiowriter.h"
+#include <string.h>
+#include <algorithm>
 
 AudioWriter::AudioWriter(const Settings *settings, Logger *logger, QObject *parent) :
     QObject(parent)
 {
     _settings = settings;
     _logger = logger;
-    _rx_sample_queue = new QVector<audio_samples*>;
     _recorder = new AudioRecorder(settings, logger);
+    _processor = new AudioProcessor(settings);
+    _playout = new AudioPlayout(logger, 2560, 60, this);
     _working = true;
     _restart = false;
     _record_audio = false;
+    _recording = false;
 }
 
 AudioWriter::~AudioWriter()
 {
-
-    _rx_sample_queue->clear();
-    delete _rx_sample_queue;
+    delete _processor;
     delete _recorder;
 }
 
@@ -57,25 +59,39 @@ void AudioWriter::recordAudio(bool value)
 
 void AudioWriter::writePCM(short *pcm, int bytes, bool preprocess, int audio_mode)
 {
-
-    audio_samples *samp = new audio_samples;
-    samp->pcm = pcm;
-    samp->bytes = bytes;
-    samp->preprocess = preprocess;
-    samp->audio_mode = audio_mode;
-    _mutex.lock();
-    _rx_sample_queue->push_back(samp);
-    _mutex.unlock();
+    /// producer side of the playout ring, runs in the radio thread
+    int samples = bytes / sizeof(short);
+    int written = 0;
+    while(written < samples)
+    {
+        short *slot = _playout->beginWrite();
+        if(slot == nullptr)
+        {
+            /// more than the ring can hold is waiting to be played
+            _playout->countDropped(samples - written);
+            break;
+        }
+        /// processing works on whole 40 msec frames
+        int len = std::min(samples - written, PLAYOUT_FRAME_SAMPLES);
+        memcpy(slot, pcm + written, len * sizeof(short));
+        _processor->write_preprocess(slot, len * sizeof(short), preprocess, audio_mode);
+        /// the writer thread opens and closes the recorder under the same lock
+        _mutex.lock();
+        if(_recording)
+        {
+            _recorder->writeSamples(slot, len);
+        }
+        _mutex.unlock();
+        _playout->commitWrite(len);
+        written += len;
+    }
 }
 
 void AudioWriter::run()
 {
+    ThreadScheduler::applyProfile(_settings, _logger, "audiowriter");
     start:
     _working = true;
-    bool recording = false;
-    int frame_counter = 0;
-    // FIXME: support different frame durations
-    AudioProcessor *processor = new AudioProcessor(_settings);
     QAudioFormat format;
     format.setSampleRate(8000);
     format.setChannelCount(1);
@@ -108,115 +124,37 @@ void AudioWriter::run()
     QObject::connect(audio_writer, SIGNAL(stateChanged(QAudio::State)),
                      this, SLOT(processStateChange(QAudio::State)), Qt::DirectConnection);
     */
-    audio_writer->setBufferSize(4096);
-    QIODevice *audio_dev = audio_writer->start();
+    /// the playout ring does the buffering, keep the device buffer to one frame
+    audio_writer->setBufferSize(PLAYOUT_FRAME_SAMPLES * sizeof(short));
+    _playout->flush();
+    _playout->open(QIODevice::ReadOnly);
+    /// pull mode, the device reads from the ring whenever it needs audio
+    audio_writer->start(_playout);
 
     while(_working)
     {
-        QCoreApplication::processEvents();
+        /// device pulls and control slots both arrive as events
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
         _mutex.lock();
-        int size = _rx_sample_queue->size();
-        if(_record_audio && !recording)
+        if(_record_audio && !_recording)
         {
             _recorder->startRecording();
-            recording = true;
+            _recording = true;
         }
-        if(recording && !_record_audio)
+        if(_recording && !_record_audio)
         {
+            _recording = false;
             _recorder->stopRecording();
-            recording = false;
         }
         _mutex.unlock();
-        if(size > 0)
-        {
-            frame_counter = 50;
-            for(int i=0;i< size;i++)
-            {
-                audio_samples *samp = _rx_sample_queue->at(i);
-                int bytes = samp->bytes;
-                bool preprocess = samp->preprocess;
-                int audio_mode = samp->audio_mode;
-                if(bytes <= 640)
-                {
-                    short *pcm = new short[bytes/sizeof(short)];
-                    memcpy(pcm, samp->pcm, bytes);
-                    processor->write_preprocess(pcm, bytes, preprocess, audio_mode);
-                    audio_dev->write((char*)pcm, bytes);
-                    if(recording)
-                    {
-                        _recorder->writeSamples(pcm, bytes/sizeof(short));
-                    }
-                    /// time it takes for the packet to be played without overflow
-                    long play_time = 1000/(8000/(bytes/sizeof(short))) * 1000000L;
-                    if(play_time > 2000000L)
-                        play_time -= 2000000L;
-                    struct timespec time_to_sleep = {0, play_time };
-                    nanosleep(&time_to_sleep, NULL);
-                }
-                else
-                {
-                    int frames = bytes / 640;
-                    int leftover = bytes % 640;
-                    for(int i=0;i<frames;i++)
-                    {
-                        short *pcm = new short[320];
-                        memcpy(pcm, samp->pcm+(320*i), 640);
-                        processor->write_preprocess(pcm, 640, preprocess, audio_mode);
-                        audio_dev->write((char*)pcm, 640);
-                        if(recording)
-                        {
-                            _recorder->writeSamples(pcm, 640/sizeof(short));
-                        }
-                        /// time it takes for the packet to be played without overflow
-                        struct timespec time_to_sleep = {0, 39000000L };
-                        nanosleep(&time_to_sleep, NULL);
-                    }
-                    if(leftover > 1)
-                    {
-                        short *pcm = new short[leftover/sizeof(short)];
-                        memcpy(pcm, samp->pcm+(320*frames), leftover);
-                        processor->write_preprocess(pcm, leftover, preprocess, audio_mode);
-                        audio_dev->write((char*)pcm, leftover);
-                        if(recording)
-                        {
-                            _recorder->writeSamples(pcm, leftover/sizeof(short));
-                        }
-                        /// time it takes for the packet to be played without overflow
-                        long play_time = 1000/(8000/(leftover/sizeof(short))) * 1000000L;
-                        struct timespec time_to_sleep = {0, play_time };
-                        nanosleep(&time_to_sleep, NULL);
-                    }
-                }
-                delete[] samp->pcm;
-                delete samp;
-            }
-            _mutex.lock();
-            _rx_sample_queue->remove(0, size);
-            _mutex.unlock();
-
-        }
-        else
-        {
-            if(frame_counter > 0)
-            {
-                /// recent audio packet
-                frame_counter--;
-                struct timespec time_to_sleep = {0, 1000000L };
-                nanosleep(&time_to_sleep, NULL);
-            }
-            else if(frame_counter == 0)
-            {
-                /// Idle time
-                struct timespec time_to_sleep = {0, 40000000L };
-                nanosleep(&time_to_sleep, NULL);
-            }
-        }
     }
-    _rx_sample_queue->clear();
-    audio_dev->close();
     audio_writer->stop();
+    _playout->close();
     delete audio_writer;
-    delete processor;
+    _logger->log(Logger::LogLevelDebug, QString(
+            "Audio output stopped, %1 underruns, %2 samples dropped, playout delay %3 msec").arg(
+                     _playout->underruns()).arg(_playout->dropped()).arg(_playout->targetMs()),
+                 Logger::LogSubsystemAudio);
     if(_restart)
     {
         _restart = false;
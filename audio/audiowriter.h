@@ -24,10 +24,15 @@
 #include <QAudioOutput>
 #include <QAudio>
 #include "audio/audioprocessor.h"
+#include "audio/audioplayout.h"
 #include "src/settings.h"
 #include "src/logger.h"
+#include "src/threadscheduler.h"
 #include "audio/audiorecorder.h"
 
+/// Audio output. writePCM() is called directly from the radio thread and
+/// processes audio straight into the playout ring, the audio device pulls
+/// it from there at its own pace. The pcm buffer is only borrowed for the call
 class AudioWriter : public QObject
 {
     Q_OBJECT
@@ -47,21 +52,15 @@ public slots:
     void processStateChange(QAudio::State state);
 
 private:
-    struct audio_samples
-    {
-        audio_samples() : pcm(0), bytes(0), preprocess(false), audio_mode(0) {}
-        short *pcm;
-        int bytes;
-        bool preprocess;
-        int audio_mode;
-    };
     const Settings *_settings;
     Logger *_logger;
     AudioRecorder *_recorder;
-    QVector<audio_samples*> *_rx_sample_queue;
+    AudioProcessor *_processor;
+    AudioPlayout *_playout;
     bool _working;
     bool _restart;
     bool _record_audio;
+    bool _recording;
     QMutex _mutex;
 
 };
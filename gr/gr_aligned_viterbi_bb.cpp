@@ -0,0 +1,198 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "gr_aligned_viterbi_bb.h"
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
+gr_aligned_viterbi_bb_sptr make_gr_aligned_viterbi_bb(int frame_type)
+{
+    return gnuradio::get_initial_sptr(new gr_aligned_viterbi_bb(frame_type));
+}
+
+gr_aligned_viterbi_bb::gr_aligned_viterbi_bb(int frame_type) :
+    gr::block("gr_aligned_viterbi_bb",
+              gr::io_signature::make (1, 1, sizeof (unsigned char)),
+              gr::io_signature::make (1, 1, sizeof (unsigned char)))
+{
+    _frame_type = frame_type;
+    for(int i=0;i<2;i++)
+    {
+        _lfsr.push_back(gr::digital::lfsr(0x8A, 0x7F ,7));
+        _score[i] = 0;
+        _shift_reg[i] = 0;
+    }
+    /// same 80 bit frames the cc_decoder used
+    _frame_out = 80;
+    _frame_in = 2 * _frame_out;
+    for(int i=0;i<2;i++)
+    {
+        _decoded[i].resize(_frame_out, 0);
+        _pending[i].resize(_frame_out, 0);
+    }
+
+    /// an 8 bit sync word also matches random data every 256 bits or so
+    if(frame_type == 2)
+    {
+        _lock_margin = 3;
+        _unlock_bits = 4 * 5 * 8;
+    }
+    else if(frame_type == 3)
+    {
+        _lock_margin = 1;
+        _unlock_bits = 4 * 50 * 8;
+    }
+    else
+    {
+        _lock_margin = 1;
+        _unlock_bits = 4 * 10 * 8;
+    }
+    _locked = false;
+    _branch = 0;
+    _bits_since_sync = 0;
+
+    set_output_multiple(_frame_out);
+    set_relative_rate((double)_frame_out / (double)_frame_in);
+}
+
+bool gr_aligned_viterbi_bb::is_locked()
+{
+    return _locked;
+}
+
+void gr_aligned_viterbi_bb::forecast(int noutput_items, gr_vector_int &ninput_items_required)
+{
+    int frames = std::max(1, noutput_items / _frame_out);
+    /// one extra item for the odd pairing
+    ninput_items_required[0] = frames * _frame_in + 1;
+}
+
+bool gr_aligned_viterbi_bb::find_sync(int branch, unsigned char bit)
+{
+    _shift_reg[branch] = (_shift_reg[branch] << 1) | (bit & 0x1);
+    if(_frame_type == 2)
+        return ((_shift_reg[branch] & 0xFF) == 0xB5);
+    u_int32_t temp = _shift_reg[branch] & 0xFFFF;
+    if((temp == 0x89ED) || (temp == 0xED89) || (temp == 0x98DE)
+            || (temp == 0xED77) || (temp == 0x8CC8))
+        return true;
+    temp = _shift_reg[branch] & 0xFFFFFF;
+    return (temp == 0x4C8A2B);
+}
+
+int gr_aligned_viterbi_bb::decode_branch(int branch, const unsigned char *in)
+{
+    unsigned char *bits = _decoded[branch].data();
+    _decoder[branch].decode(in, _frame_out, bits);
+    int hits = 0;
+    for(int i=0;i<_frame_out;i++)
+    {
+        bits[i] = _lfsr[branch].next_bit_descramble(bits[i]);
+        if(find_sync(branch, bits[i]))
+            hits++;
+    }
+    return hits;
+}
+
+void gr_aligned_viterbi_bb::update_lock(int hits1, int hits2)
+{
+    if(_locked)
+    {
+        int hits = (_branch == 0) ? hits1 : hits2;
+        if(hits > 0)
+        {
+            _bits_since_sync = 0;
+            return;
+        }
+        _bits_since_sync += _frame_out;
+        if(_bits_since_sync > _unlock_bits)
+        {
+            /// symbol slip or end of transmission, go back to decoding both
+            _locked = false;
+            _bits_since_sync = 0;
+            _score[0] = 0;
+            _score[1] = 0;
+            /// not decoded while locked, don't let stale bits through
+            memset(_pending[1 - _branch].data(), 0, _frame_out);
+            _decoder[1 - _branch].reset();
+        }
+        return;
+    }
+    _score[0] += hits1;
+    _score[1] += hits2;
+    if(_score[0] > _score[1])
+        _branch = 0;
+    else if(_score[1] > _score[0])
+        _branch = 1;
+    if(abs(_score[0] - _score[1]) >= _lock_margin)
+    {
+        _locked = true;
+        _bits_since_sync = 0;
+        return;
+    }
+    if(hits1 + hits2 > 0)
+    {
+        _bits_since_sync = 0;
+        return;
+    }
+    /// forget random sync hits from noise
+    _bits_since_sync += _frame_out;
+    if(_bits_since_sync > _unlock_bits)
+    {
+        _bits_since_sync = 0;
+        _score[0] = 0;
+        _score[1] = 0;
+    }
+}
+
+int gr_aligned_viterbi_bb::general_work(int noutput_items,
+       gr_vector_int &ninput_items,
+       gr_vector_const_void_star &input_items,
+       gr_vector_void_star &output_items)
+{
+    const unsigned char *in = (const unsigned char*)(input_items[0]);
+    unsigned char *out = (unsigned char*)(output_items[0]);
+    int frames = std::min(noutput_items / _frame_out,
+                          (ninput_items[0] - 1) / _frame_in);
+    if(frames < 1)
+    {
+        consume_each(0);
+        return 0;
+    }
+    for(int i=0;i<frames;i++)
+    {
+        const unsigned char *frame = in + i * _frame_in;
+        int hits1 = 0;
+        int hits2 = 0;
+        bool decode1 = !_locked || (_branch == 0);
+        bool decode2 = !_locked || (_branch == 1);
+        if(decode1)
+            hits1 = decode_branch(0, frame);
+        if(decode2)
+            hits2 = decode_branch(1, frame + 1);
+        update_lock(hits1, hits2);
+
+        memcpy(out + i * _frame_out, _pending[_branch].data(), _frame_out);
+        if(decode1)
+            _pending[0].swap(_decoded[0]);
+        if(decode2)
+            _pending[1].swap(_decoded[1]);
+    }
+    consume_each(frames * _frame_in);
+    return frames * _frame_out;
+}
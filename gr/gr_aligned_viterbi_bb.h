@@ -0,0 +1,71 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef GR_ALIGNED_VITERBI_BB_H
+#define GR_ALIGNED_VITERBI_BB_H
+
+#include <gnuradio/block.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/digital/lfsr.h>
+#include <vector>
+#include "viterbi_k7.h"
+
+class gr_aligned_viterbi_bb;
+typedef boost::shared_ptr<gr_aligned_viterbi_bb> gr_aligned_viterbi_bb_sptr;
+
+gr_aligned_viterbi_bb_sptr make_gr_aligned_viterbi_bb(int frame_type);
+
+/// K=7 rate 1/2 Viterbi decoder and descrambler for the 2-level modems
+/// The coded bit pairing is unknown after clock recovery, so both pairings
+/// are decoded until one of them produces sync words, then only that one is
+/// decoded until the sync words stop coming. Output lags one decoder frame
+/// so the bits preceding the first sync word come from the right branch.
+/// frame_type is the same as for gr_deframer_bb
+class gr_aligned_viterbi_bb : public gr::block
+{
+public:
+    gr_aligned_viterbi_bb(int frame_type);
+
+    void forecast(int noutput_items, gr_vector_int &ninput_items_required);
+    int general_work(int noutput_items,
+           gr_vector_int &ninput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    bool is_locked();
+
+private:
+    int decode_branch(int branch, const unsigned char *in);
+    bool find_sync(int branch, unsigned char bit);
+    void update_lock(int hits1, int hits2);
+
+    int _frame_type;
+    int _frame_in;
+    int _frame_out;
+    int _lock_margin;
+    int _unlock_bits;
+    bool _locked;
+    int _branch;
+    int _bits_since_sync;
+    int _score[2];
+    unsigned long long _shift_reg[2];
+    viterbi_k7_decoder _decoder[2];
+    std::vector<gr::digital::lfsr> _lfsr;
+    std::vector<unsigned char> _decoded[2];
+    std::vector<unsigned char> _pending[2];
+};
+
+#endif // GR_ALIGNED_VITERBI_BB_H
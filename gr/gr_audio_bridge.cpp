@@ -0,0 +1,208 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "gr_audio_bridge.h"
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+/// 5 msec at 8 ksps, the most audio queued ahead of the modulator
+static const int BRIDGE_LEAD_SAMPLES = 40;
+
+gr_audio_bridge_sptr
+make_gr_audio_bridge (int max_latency, int hang_time)
+{
+    return gr_audio_bridge_sptr(new gr_audio_bridge(max_latency, hang_time));
+}
+
+gr_audio_bridge_sink_sptr
+make_gr_audio_bridge_sink ()
+{
+    return gnuradio::get_initial_sptr(new gr_audio_bridge_sink);
+}
+
+gr_audio_bridge_source_sptr
+make_gr_audio_bridge_source (int samp_rate)
+{
+    return gnuradio::get_initial_sptr(new gr_audio_bridge_source(samp_rate));
+}
+
+gr_audio_bridge::gr_audio_bridge(int max_latency, int hang_time)
+{
+    unsigned int size = 1;
+    while(size < (unsigned int)max_latency * 2)
+        size <<= 1;
+    _buffer.resize(size, 0.0f);
+    _mask = size - 1;
+    _max_latency = max_latency;
+    _hang_time = std::chrono::milliseconds(hang_time);
+    _enabled.store(false);
+    _write_index.store(0);
+    _read_index.store(0);
+    _dropped.store(0);
+    _last_push.store(0);
+}
+
+void gr_audio_bridge::set_enabled(bool value)
+{
+    _enabled.store(value);
+}
+
+bool gr_audio_bridge::is_enabled()
+{
+    return _enabled.load();
+}
+
+bool gr_audio_bridge::is_active()
+{
+    if(!_enabled.load())
+        return false;
+    std::chrono::steady_clock::duration since_push =
+            std::chrono::steady_clock::now().time_since_epoch() -
+            std::chrono::steady_clock::duration(_last_push.load());
+    return since_push < _hang_time;
+}
+
+void gr_audio_bridge::push(const float *samples, int count)
+{
+    if(!_enabled.load() || (count < 1))
+        return;
+    unsigned int write_index = _write_index.load(std::memory_order_relaxed);
+    unsigned int read_index = _read_index.load(std::memory_order_acquire);
+    /// never write over what the reader may still be copying out
+    int space = (int)_buffer.size() - (int)(write_index - read_index);
+    if(count > space)
+    {
+        _dropped.fetch_add(count - space);
+        count = space;
+    }
+    for(int i=0;i<count;i++)
+    {
+        _buffer[(write_index + i) & _mask] = samples[i];
+    }
+    _write_index.store(write_index + count, std::memory_order_release);
+    _last_push.store(std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+int gr_audio_bridge::pop(float *samples, int count)
+{
+    unsigned int write_index = _write_index.load(std::memory_order_acquire);
+    unsigned int read_index = _read_index.load(std::memory_order_relaxed);
+    int available = (int)(write_index - read_index);
+    if(available > _max_latency)
+    {
+        /// receiver is ahead of the transmitter, skip to the newest audio
+        _dropped.fetch_add(available - _max_latency);
+        read_index = write_index - _max_latency;
+        available = _max_latency;
+    }
+    int n = std::min(available, count);
+    for(int i=0;i<n;i++)
+    {
+        samples[i] = _buffer[(read_index + i) & _mask];
+    }
+    _read_index.store(read_index + n, std::memory_order_release);
+    return n;
+}
+
+int gr_audio_bridge::fill()
+{
+    return (int)(_write_index.load() - _read_index.load());
+}
+
+uint64_t gr_audio_bridge::get_dropped()
+{
+    return _dropped.load();
+}
+
+gr_audio_bridge_sink::gr_audio_bridge_sink() :
+        gr::sync_block("gr_audio_bridge_sink",
+                       gr::io_signature::make (1, 1, sizeof (float)),
+                       gr::io_signature::make (0, 0, 0))
+{
+}
+
+void gr_audio_bridge_sink::set_bridge(gr_audio_bridge_sptr bridge)
+{
+    gr::thread::scoped_lock guard(_mutex);
+    _bridge = bridge;
+}
+
+int gr_audio_bridge_sink::work(int noutput_items,
+       gr_vector_const_void_star &input_items,
+       gr_vector_void_star &output_items)
+{
+    (void) output_items;
+    const float *in = (const float*)(input_items[0]);
+    gr::thread::scoped_lock guard(_mutex);
+    if(_bridge)
+        _bridge->push(in, noutput_items);
+    return noutput_items;
+}
+
+gr_audio_bridge_source::gr_audio_bridge_source(int samp_rate) :
+        gr::sync_block("gr_audio_bridge_source",
+                       gr::io_signature::make (0, 0, 0),
+                       gr::io_signature::make (1, 1, sizeof (float)))
+{
+    _samp_rate = samp_rate;
+    _lead = BRIDGE_LEAD_SAMPLES;
+    _was_active = false;
+    _produced = 0;
+    _start_time = std::chrono::steady_clock::now();
+}
+
+void gr_audio_bridge_source::set_bridge(gr_audio_bridge_sptr bridge)
+{
+    gr::thread::scoped_lock guard(_mutex);
+    _bridge = bridge;
+}
+
+int gr_audio_bridge_source::work(int noutput_items,
+       gr_vector_const_void_star &input_items,
+       gr_vector_void_star &output_items)
+{
+    (void) input_items;
+    float *out = (float*)(output_items[0]);
+    gr::thread::scoped_lock guard(_mutex);
+    bool active = _bridge && _bridge->is_active();
+    if(active && !_was_active)
+    {
+        /// new transmission, restart the pacing clock
+        _start_time = std::chrono::steady_clock::now();
+        _produced = 0;
+    }
+    _was_active = active;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _start_time;
+    int64_t budget = (int64_t)(elapsed.count() * _samp_rate) + _lead - (int64_t)_produced;
+    if(budget <= 0)
+    {
+        guard.unlock();
+        struct timespec time_to_sleep = {0, 2000000L };
+        nanosleep(&time_to_sleep, NULL);
+        return 0;
+    }
+    int n = (int)std::min((int64_t)noutput_items, budget);
+    int got = 0;
+    if(_bridge)
+        got = _bridge->pop(out, n);
+    if(got < n)
+        memset(out + got, 0, (n - got) * sizeof(float));
+    _produced += n;
+    return n;
+}
@@ -0,0 +1,109 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef GR_AUDIO_BRIDGE_H
+#define GR_AUDIO_BRIDGE_H
+
+#include <gnuradio/sync_block.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/thread/thread.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+class gr_audio_bridge;
+class gr_audio_bridge_sink;
+class gr_audio_bridge_source;
+typedef boost::shared_ptr<gr_audio_bridge> gr_audio_bridge_sptr;
+typedef boost::shared_ptr<gr_audio_bridge_sink> gr_audio_bridge_sink_sptr;
+typedef boost::shared_ptr<gr_audio_bridge_source> gr_audio_bridge_source_sptr;
+
+gr_audio_bridge_sptr make_gr_audio_bridge(int max_latency=320, int hang_time=100);
+gr_audio_bridge_sink_sptr make_gr_audio_bridge_sink();
+gr_audio_bridge_source_sptr make_gr_audio_bridge_source(int samp_rate=8000);
+
+/// Bounded single producer / single consumer FIFO carrying demodulated
+/// audio from the receive flowgraph straight into the transmit flowgraph.
+/// The oldest samples are dropped when more than max_latency samples pile up,
+/// so clock differences between the two devices can't add delay. When the
+/// reader falls so far behind that the ring is full, new samples are dropped.
+/// Audio stops arriving when the demodulator squelch closes, which is what
+/// is_active() reports after hang_time msec
+class gr_audio_bridge
+{
+public:
+    gr_audio_bridge(int max_latency, int hang_time);
+
+    void set_enabled(bool value);
+    bool is_enabled();
+    bool is_active();
+    void push(const float *samples, int count);
+    int pop(float *samples, int count);
+    /// Samples waiting in the FIFO
+    int fill();
+    /// Samples dropped because the FIFO was full or too far ahead
+    uint64_t get_dropped();
+
+private:
+    std::vector<float> _buffer;
+    unsigned int _mask;
+    int _max_latency;
+    std::chrono::steady_clock::duration _hang_time;
+    std::atomic<bool> _enabled;
+    std::atomic<unsigned int> _write_index;
+    std::atomic<unsigned int> _read_index;
+    std::atomic<uint64_t> _dropped;
+    std::atomic<int64_t> _last_push;
+};
+
+/// Receive side of the bridge, fed from the demodulator audio output
+class gr_audio_bridge_sink : public gr::sync_block
+{
+public:
+    gr_audio_bridge_sink();
+    int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    void set_bridge(gr_audio_bridge_sptr bridge);
+
+private:
+    gr_audio_bridge_sptr _bridge;
+    gr::thread::mutex _mutex;
+};
+
+/// Transmit side of the bridge. Output is paced to real time and padded with
+/// silence, so only a few msec of audio are ever queued towards the modulator
+class gr_audio_bridge_source : public gr::sync_block
+{
+public:
+    gr_audio_bridge_source(int samp_rate);
+    int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    void set_bridge(gr_audio_bridge_sptr bridge);
+
+private:
+    gr_audio_bridge_sptr _bridge;
+    int _samp_rate;
+    int _lead;
+    bool _was_active;
+    uint64_t _produced;
+    std::chrono::steady_clock::time_point _start_time;
+    gr::thread::mutex _mutex;
+};
+
+#endif // GR_AUDIO_BRIDGE_H
@@ -0,0 +1,61 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "gr_block_profiler.h"
+
+gr_block_profiler::gr_block_profiler()
+{
+    _last_sample = gr::high_res_timer_now();
+}
+
+void gr_block_profiler::enable_counters(bool value)
+{
+    /// work time is measured with the thread CPU clock by default
+    gr::prefs::singleton()->set_bool("PerfCounters", "on", value);
+}
+
+void gr_block_profiler::sample(const block_list &blocks, std::vector<stats> &result)
+{
+    result.clear();
+    gr::high_res_timer_type now = gr::high_res_timer_now();
+    float elapsed = (float)(now - _last_sample);
+    _last_sample = now;
+    float ticks_per_usec = (float)gr::high_res_timer_tps() / 1000000.0f;
+    for(unsigned int i=0;i<blocks.size();i++)
+    {
+        gr::block_sptr block = blocks.at(i).second;
+        if(!block)
+            continue;
+        gr::block_detail_sptr detail = block->detail();
+        if(!detail)
+            continue;
+        float work_time = block->pc_work_time_total();
+        float last_work_time = _last_work_time[block->unique_id()];
+        _last_work_time[block->unique_id()] = work_time;
+        /// wired but idle paths don't make it into the report
+        if(work_time <= last_work_time)
+            continue;
+        stats s;
+        s.name = blocks.at(i).first;
+        s.cpu_percent = (elapsed > 0) ? 100.0f * (work_time - last_work_time) / elapsed : 0.0f;
+        s.work_usec = block->pc_work_time_avg() / ticks_per_usec;
+        s.items_per_sec = block->pc_throughput_avg();
+        s.input_full = (detail->ninputs() > 0) ? block->pc_input_buffers_full_avg(0) : 0.0f;
+        s.output_full = (detail->noutputs() > 0) ? block->pc_output_buffers_full_avg(0) : 0.0f;
+        result.push_back(s);
+    }
+}
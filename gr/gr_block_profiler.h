@@ -0,0 +1,57 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef GR_BLOCK_PROFILER_H
+#define GR_BLOCK_PROFILER_H
+
+#include <gnuradio/block.h>
+#include <gnuradio/block_detail.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/prefs.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <map>
+
+/// Reads the GNU Radio performance counters of a list of blocks.
+/// The counters are only kept when enabled before the flowgraph starts
+class gr_block_profiler
+{
+public:
+    struct stats
+    {
+        std::string name;
+        float cpu_percent; // of one core, since the previous sample
+        float work_usec; // average per work() call
+        float items_per_sec;
+        float input_full; // 0 to 1, first input
+        float output_full; // 0 to 1, first output
+    };
+    typedef std::vector<std::pair<std::string, gr::block_sptr>> block_list;
+
+    gr_block_profiler();
+    /// Must be called before any flowgraph is started
+    static void enable_counters(bool value);
+    /// Blocks outside a running flowgraph are skipped
+    void sample(const block_list &blocks, std::vector<stats> &result);
+
+private:
+    std::map<long, float> _last_work_time;
+    gr::high_res_timer_type _last_sample;
+};
+
+#endif // GR_BLOCK_PROFILER_H
@@ -32,14 +32,11 @@
 #include <gnuradio/blocks/complex_to_real.h>
 #include <gnuradio/filter/fft_filter_ccf.h>
 #include <gnuradio/filter/fft_filter_ccc.h>
-#include <gnuradio/digital/descrambler_bb.h>
-#include <gnuradio/fec/decoder.h>
-#include <gnuradio/fec/cc_decoder.h>
 #include <gnuradio/blocks/complex_to_mag.h>
 #include <gnuradio/blocks/multiply_const_ff.h>
 #include <gnuradio/blocks/add_const_ff.h>
-#include <gnuradio/blocks/delay.h>
 #include <gnuradio/blocks/float_to_uchar.h>
+#include "gr_aligned_viterbi_bb.h"
 #include <gnuradio/analog/quadrature_demod_cf.h>
 
 
@@ -54,6 +51,12 @@ class gr_demod_2fsk_sdr : public gr::hier_block2
 public:
     explicit gr_demod_2fsk_sdr(std::vector<int> signature, int sps=4, int samp_rate=8000, int carrier_freq=1600,
                                int filter_width=1800, bool fm=false);
+    /// Sample rate after the first decimation, where most blocks run
+    int get_target_samp_rate();
+
+    /// Blocks belonging to the "demod" and "fec" scheduling groups
+    std::vector<gr::block_sptr> demod_blocks();
+    std::vector<gr::block_sptr> fec_blocks();
 
 private:
     gr::blocks::multiply_const_cc::sptr _multiply_symbols;
@@ -71,15 +74,11 @@ private:
     gr::analog::rail_ff::sptr _rail;
     gr::digital::binary_slicer_fb::sptr _binary_slicer;
     gr::blocks::complex_to_real::sptr _complex_to_real;
-    gr::digital::descrambler_bb::sptr _descrambler;
-    gr::digital::descrambler_bb::sptr _descrambler2;
-    gr::blocks::delay::sptr _delay;
     gr::blocks::multiply_const_ff::sptr _multiply_const_fec;
     gr::blocks::add_const_ff::sptr _add;
     gr::blocks::float_to_uchar::sptr _float_to_uchar;
+    gr_aligned_viterbi_bb_sptr _viterbi;
     gr::blocks::add_const_ff::sptr _add_const_fec;
-    gr::fec::decoder::sptr _cc_decoder;
-    gr::fec::decoder::sptr _cc_decoder2;
     gr::analog::quadrature_demod_cf::sptr _freq_demod;
     gr::filter::fft_filter_ccf::sptr _shaping_filter;
 
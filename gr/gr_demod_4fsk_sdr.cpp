@@ -81,9 +81,6 @@ gr_demod_4fsk_sdr::gr_demod_4fsk_sdr(std::vector<int>signature, int sps, int sam
     if((nfilts % 2) == 0)
         nfilts += 1;
 
-    std::vector<int> polys;
-    polys.push_back(109);
-    polys.push_back(79);
 
     int spacing = 1;
 
@@ -93,7 +90,6 @@ gr_demod_4fsk_sdr::gr_demod_4fsk_sdr(std::vector<int>signature, int sps, int sam
                                  _target_samp_rate, _target_samp_rate/_samples_per_symbol, _target_samp_rate/_samples_per_symbol/20,
                                                                          gr::filter::firdes::WIN_BLACKMAN_HARRIS);
     _resampler = gr::filter::rational_resampler_base_ccf::make(interpolation, decimation, taps);
-    _resampler->set_thread_priority(99);
     _fll = gr::digital::fll_band_edge_cc::make(_samples_per_symbol/4, 0.01, 16, 48*M_PI/100);
     _filter = gr::filter::fft_filter_ccf::make(1, gr::filter::firdes::low_pass(
                                 1, _target_samp_rate, _filter_width,_filter_width/2,gr::filter::firdes::WIN_BLACKMAN_HARRIS) );
@@ -135,8 +131,7 @@ gr_demod_4fsk_sdr::gr_demod_4fsk_sdr(std::vector<int>signature, int sps, int sam
     _multiply_const_fec = gr::blocks::multiply_const_ff::make(128);
     _float_to_uchar = gr::blocks::float_to_uchar::make();
     _add_const_fec = gr::blocks::add_const_ff::make(128.0);
-    gr::fec::code::cc_decoder::sptr decoder = gr::fec::code::cc_decoder::make(80, 7, 2, polys);
-    _decode_ccsds = gr::fec::decoder::make(decoder, 1, 1);
+    _decode_ccsds = make_gr_viterbi_k7_bb();
 
 
     connect(self(),0,_resampler,0);
@@ -211,3 +206,24 @@ gr_demod_4fsk_sdr::gr_demod_4fsk_sdr(std::vector<int>signature, int sps, int sam
 
 }
 
+std::vector<gr::block_sptr> gr_demod_4fsk_sdr::demod_blocks()
+{
+    std::vector<gr::block_sptr> blocks;
+    blocks.push_back(_resampler);
+    blocks.push_back(_fll);
+    blocks.push_back(_clock_recovery);
+    blocks.push_back(_clock_recovery_f);
+    return blocks;
+}
+
+std::vector<gr::block_sptr> gr_demod_4fsk_sdr::fec_blocks()
+{
+    std::vector<gr::block_sptr> blocks;
+    blocks.push_back(_decode_ccsds);
+    return blocks;
+}
+
+int gr_demod_4fsk_sdr::get_target_samp_rate()
+{
+    return _target_samp_rate;
+}
@@ -44,8 +44,7 @@
 #include <gnuradio/blocks/multiply_const_ff.h>
 #include <gnuradio/blocks/complex_to_float.h>
 #include <gnuradio/blocks/interleave.h>
-#include <gnuradio/fec/decoder.h>
-#include <gnuradio/fec/cc_decoder.h>
+#include "gr_viterbi_k7_bb.h"
 #include "gr_4fsk_discriminator.h"
 
 class gr_demod_4fsk_sdr;
@@ -59,7 +58,12 @@ class gr_demod_4fsk_sdr : public gr::hier_block2
 public:
     explicit gr_demod_4fsk_sdr(std::vector<int> signature, int sps=4, int samp_rate=8000, int carrier_freq=1600,
                                int filter_width=1800, bool fm=true);
+    /// Sample rate after the first decimation, where most blocks run
+    int get_target_samp_rate();
 
+    /// Blocks belonging to the "demod" and "fec" scheduling groups
+    std::vector<gr::block_sptr> demod_blocks();
+    std::vector<gr::block_sptr> fec_blocks();
 
 private:
     gr::blocks::unpack_k_bits_bb::sptr _unpack;
@@ -91,7 +95,7 @@ private:
     gr::blocks::interleave::sptr _interleave;
     gr::blocks::float_to_uchar::sptr _float_to_uchar;
     gr::blocks::add_const_ff::sptr _add_const_fec;
-    gr::fec::decoder::sptr _decode_ccsds;
+    gr_viterbi_k7_bb_sptr _decode_ccsds;
     gr::filter::fft_filter_fff::sptr _shaping_filter;
     gr::analog::phase_modulator_fc::sptr _phase_mod;
     gr::analog::rail_ff::sptr _rail;
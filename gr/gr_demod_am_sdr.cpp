@@ -89,3 +89,8 @@ void gr_demod_am_sdr::set_squelch(int value)
 {
     _squelch->set_threshold(value);
 }
+
+int gr_demod_am_sdr::get_target_samp_rate()
+{
+    return _target_samp_rate;
+}
@@ -15,6 +15,78 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "gr_demod_base.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <gnuradio/buffer.h>
+#include <chrono>
+#include <cmath>
+
+/// Queueing each buffer may add, voice paths want it short while the
+/// wideband data paths need deeper buffers to not starve
+static const float VOICE_EDGE_LATENCY_MSEC = 4.0f;
+static const float DATA_EDGE_LATENCY_MSEC = 20.0f;
+/// the demodulators always see 1 Msps, whatever the device rate
+static const int DEMOD_INPUT_RATE = 1000000;
+/// lowest fraction of the latency target auto-tuning goes down to
+static const float MIN_BUFFER_SCALE = 0.125f;
+
+static int edge_items(int rate, float latency_msec)
+{
+    /// GNU Radio rounds this up to whole pages and to what the block needs
+    return std::max(1, (int)(rate * latency_msec / 1000.0f));
+}
+
+/// GNU Radio rounds a max buffer down to the output multiple of the block
+/// and refuses to start below one, so leave room for two
+static void pin_buffer(gr::block_sptr block, int items)
+{
+    if(!block)
+        return;
+    items = std::max(items, 2 * block->output_multiple());
+    block->set_min_output_buffer(items);
+    block->set_max_output_buffer(items);
+}
+
+/// the multiples of the blocks inside a hier block are not visible from
+/// here, so it only gets a lower bound its inner blocks inherit
+static void size_hier(gr::hier_block2_sptr hier, int items)
+{
+    if(!hier)
+        return;
+    hier->set_min_output_buffer(items);
+}
+
+static void add_buffer(gr::block_sptr block, int rate, int &bytes, float &latency_msec)
+{
+    if(!block || !block->detail() || (block->detail()->noutputs() < 1))
+        return;
+    gr::buffer_sptr buffer = block->detail()->output(0);
+    bytes += buffer->bufsize() * buffer->get_sizeof_item();
+    latency_msec += 1000.0f * buffer->bufsize() / rate;
+}
+
+static float sample_ratio(gr::block_sptr block, double rate, uint64_t &last_items,
+                          std::chrono::steady_clock::time_point &last_time)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - last_time;
+    last_time = now;
+    if(!block || !block->detail() || (block->detail()->noutputs() < 1))
+    {
+        last_items = 0;
+        return 1.0f;
+    }
+    uint64_t items = block->nitems_written(0);
+    /// the counter starts from zero again with a new flowgraph run
+    bool restarted = items < last_items;
+    uint64_t produced = items - last_items;
+    last_items = items;
+    if(restarted || (elapsed.count() <= 0) || (rate <= 0))
+        return 1.0f;
+    return (float)(produced / (elapsed.count() * rate));
+}
 
 
 
@@ -24,6 +96,10 @@ gr_demod_base::gr_demod_base(QObject *parent, float device_frequency,
     QObject(parent)
 {
     _locked = false;
+    _center_freq = -1;
+    _squelch = -9999;
+    _ctcss = -1;
+    _fft_size = 0;
     _msg_nr = 0;
     _demod_running = false;
     _device_frequency = device_frequency;
@@ -32,26 +108,36 @@ gr_demod_base::gr_demod_base(QObject *parent, float device_frequency,
     _carrier_offset = 0;
     _samp_rate = 1000000;
     _freq_correction = freq_corr;
+    _frontend_priority = 0;
 
     _audio_sink = make_gr_audio_sink();
+    _bridge_sink = make_gr_audio_bridge_sink();
     _vector_sink = make_gr_vector_sink();
 
     _message_sink = gr::blocks::message_debug::make();
 
     _rssi_valve = gr::blocks::copy::make(8);
     _rssi_valve->set_enabled(false);
-    _rssi = gr::blocks::probe_signal_f::make();
+    /// ~1 kHz updates at the 20 ksps most demodulators run at
+    _rssi = make_gr_rssi_sink(20, 2000, -80);
     _constellation = make_gr_const_sink();
     _const_valve = gr::blocks::copy::make(8);
     _const_valve->set_enabled(false);
     _demod_valve = gr::blocks::copy::make(8);
     _demod_valve->set_enabled(true);
-    _mag_squared = gr::blocks::complex_to_mag_squared::make();
-    _single_pole_filter = gr::filter::single_pole_iir_filter_ff::make(0.04);
-    _log10 = gr::blocks::nlog10_ff::make();
-    _multiply_const_ff = gr::blocks::multiply_const_ff::make(10);
-    _moving_average = gr::blocks::moving_average_ff::make(2000,1,2000);
-    _add_const = gr::blocks::add_const_ff::make(-80);
+    _mode_switch_time = 0;
+    _rssi_select = make_gr_mode_selector(sizeof(gr_complex));
+    _const_select = make_gr_mode_selector(sizeof(gr_complex));
+    _audio_select = make_gr_mode_selector(sizeof(float));
+    _vector_select = make_gr_mode_selector(sizeof(unsigned char));
+    _frame_select = make_gr_mode_selector(sizeof(unsigned char));
+    _frame_700_select = make_gr_mode_selector(sizeof(unsigned char));
+    _frame_10k_select = make_gr_mode_selector(sizeof(unsigned char));
+    _data_selectors.push_back(_audio_select);
+    _data_selectors.push_back(_vector_select);
+    _data_selectors.push_back(_frame_select);
+    _data_selectors.push_back(_frame_700_select);
+    _data_selectors.push_back(_frame_10k_select);
     _rotator = gr::blocks::rotator_cc::make(2*M_PI/1000000);
     std::vector<float> taps;
     int tw = std::min(_samp_rate/4, 1500000);
@@ -60,65 +146,99 @@ gr_demod_base::gr_demod_base(QObject *parent, float device_frequency,
 
     // FIXME: LimeSDR bandwidth set to higher value for lower freq
     _lime_specific = false;
+    _replay_samp_rate = 0;
+    _ratio_items = 0;
+    _ratio_time = std::chrono::steady_clock::now();
+    _rx_gain = rf_gain;
     QString device(device_args.c_str());
     if(device.contains("driver=lime", Qt::CaseInsensitive))
     {
         _lime_specific = true;
     }
-    _osmosdr_source = osmosdr::source::make(device_args);
-    _osmosdr_source->set_center_freq(_device_frequency);
-    set_bandwidth_specific();
-    _osmosdr_source->set_sample_rate(1000000);
-    //_osmosdr_source->set_freq_corr(freq_corr);
-    _osmosdr_source->set_gain_mode(true);
-    _osmosdr_source->set_dc_offset_mode(2);
-    _osmosdr_source->set_iq_balance_mode(0);
-    _osmosdr_source->set_antenna(device_antenna);
-    _gain_range = _osmosdr_source->get_gain_range();
-    _gain_names = _osmosdr_source->get_gain_names();
-    if (!_gain_range.empty())
-    {
-        double gain =  (double)_gain_range.start() + rf_gain*(
-                    (double)_gain_range.stop()- (double)_gain_range.start());
-        _osmosdr_source->set_gain_mode(false);
-        if(_gain_names.size() == 1)
+    _fft_sink = make_rx_fft_c(32768, gr::filter::firdes::WIN_BLACKMAN_HARRIS);
+    _sigmf_sink = make_gr_sigmf_sink();
+    if(device.startsWith("sigmf=", Qt::CaseInsensitive))
+    {
+        /// Replay a recording instead of using a device:
+        /// sigmf=/path/to/file.sigmf-data,throttle=1,repeat=0
+        QStringList params = device.split(",");
+        QString data_path = params.at(0).mid(6);
+        bool throttle = true;
+        bool repeat = false;
+        for(int i=1;i<params.size();i++)
         {
-            _osmosdr_source->set_gain(gain, _gain_names.at(0));
+            if(params.at(i).trimmed() == "throttle=0")
+                throttle = false;
+            else if(params.at(i).trimmed() == "repeat=1")
+                repeat = true;
         }
-        else
+        QString meta_path = data_path;
+        meta_path.replace(".sigmf-data", ".sigmf-meta");
+        QFile meta_file(meta_path);
+        if(meta_file.open(QIODevice::ReadOnly))
         {
-            _osmosdr_source->set_gain(gain);
+            QJsonObject meta = QJsonDocument::fromJson(meta_file.readAll()).object();
+            _replay_samp_rate = (int)meta.value("global").toObject().value(
+                        "core:sample_rate").toDouble();
+            QJsonArray captures = meta.value("captures").toArray();
+            if(captures.size() > 0)
+                _device_frequency = captures.at(0).toObject().value("core:frequency").toDouble();
         }
+        if(_replay_samp_rate < 1000000)
+            _replay_samp_rate = 1000000;
+        _sigmf_source = make_gr_sigmf_source(data_path.toStdString(), _replay_samp_rate,
+                                             throttle, repeat);
+        _top_block->connect(_sigmf_source,0,_rotator,0);
+        _top_block->connect(_sigmf_source,0,_fft_sink,0);
+        _top_block->connect(_sigmf_source,0,_sigmf_sink,0);
     }
     else
     {
+        _osmosdr_source = osmosdr::source::make(device_args);
+        _osmosdr_source->set_center_freq(_device_frequency);
+        set_bandwidth_specific();
+        _osmosdr_source->set_sample_rate(1000000);
+        //_osmosdr_source->set_freq_corr(freq_corr);
         _osmosdr_source->set_gain_mode(true);
+        _osmosdr_source->set_dc_offset_mode(2);
+        _osmosdr_source->set_iq_balance_mode(0);
+        _osmosdr_source->set_antenna(device_antenna);
+        _gain_range = _osmosdr_source->get_gain_range();
+        _gain_names = _osmosdr_source->get_gain_names();
+        if (!_gain_range.empty())
+        {
+            double gain =  (double)_gain_range.start() + rf_gain*(
+                        (double)_gain_range.stop()- (double)_gain_range.start());
+            _osmosdr_source->set_gain_mode(false);
+            if(_gain_names.size() == 1)
+            {
+                _osmosdr_source->set_gain(gain, _gain_names.at(0));
+            }
+            else
+            {
+                _osmosdr_source->set_gain(gain);
+            }
+        }
+        else
+        {
+            _osmosdr_source->set_gain_mode(true);
+        }
+        _top_block->connect(_osmosdr_source,0,_rotator,0);
+        _top_block->connect(_osmosdr_source,0,_fft_sink,0);
+        _top_block->connect(_osmosdr_source,0,_sigmf_sink,0);
     }
 
-    _fft_sink = make_rx_fft_c(32768, gr::filter::firdes::WIN_BLACKMAN_HARRIS);
-
-    _deframer1 = make_gr_deframer_bb(1);
-    _deframer2 = make_gr_deframer_bb(1);
+    _deframer = make_gr_deframer_bb(1);
 
-    _deframer_700_1 = make_gr_deframer_bb(2);
-    _deframer_700_2 = make_gr_deframer_bb(2);
+    _deframer_700 = make_gr_deframer_bb(2);
 
-    _deframer1_10k = make_gr_deframer_bb(3);
-    _deframer2_10k = make_gr_deframer_bb(3);
+    _deframer_10k = make_gr_deframer_bb(3);
 
 
-    _top_block->connect(_osmosdr_source,0,_rotator,0);
     _top_block->connect(_rotator,0,_demod_valve,0);
-    _top_block->connect(_osmosdr_source,0,_fft_sink,0);
 
 
-    _top_block->connect(_rssi_valve,0,_mag_squared,0);
-    _top_block->connect(_mag_squared,0,_moving_average,0);
-    _top_block->connect(_moving_average,0,_single_pole_filter,0);
-    _top_block->connect(_single_pole_filter,0,_log10,0);
-    _top_block->connect(_log10,0,_multiply_const_ff,0);
-    _top_block->connect(_multiply_const_ff,0,_add_const,0);
-    _top_block->connect(_add_const,0,_rssi,0);
+    _top_block->connect(_rssi_valve,0,_rssi,0);
 
 
 
@@ -174,7 +294,30 @@ gr_demod_base::gr_demod_base(QObject *parent, float device_frequency,
 
 gr_demod_base::~gr_demod_base()
 {
+    _sigmf_sink->stop_recording();
     _osmosdr_source.reset();
+    _sigmf_source.reset();
+}
+
+bool gr_demod_base::start_iq_recording(std::string base_path, std::string mode_name)
+{
+    return _sigmf_sink->start_recording(base_path, (double)_samp_rate,
+                                        (double)_device_frequency, _rx_gain, mode_name);
+}
+
+void gr_demod_base::stop_iq_recording()
+{
+    _sigmf_sink->stop_recording();
+}
+
+bool gr_demod_base::is_replay()
+{
+    return (bool)_sigmf_source;
+}
+
+void gr_demod_base::set_audio_bridge(gr_audio_bridge_sptr bridge)
+{
+    _bridge_sink->set_bridge(bridge);
 }
 
 const QMap<std::string,QVector<int>> gr_demod_base::get_gain_names() const
@@ -193,410 +336,231 @@ const QMap<std::string,QVector<int>> gr_demod_base::get_gain_names() const
     return gain_names;
 }
 
-void gr_demod_base::set_mode(int mode, bool disconnect, bool connect)
+void gr_demod_base::set_mode(int mode)
 {
+    std::chrono::steady_clock::time_point switch_start = std::chrono::steady_clock::now();
     _demod_running = false;
-    if(!_locked)
-        _top_block->lock();
-
-    _deframer_700_1->flush();
-    _deframer_700_2->flush();
-    _deframer1->flush();
-    _deframer2->flush();
+    if(!_mode_paths.contains(mode))
+    {
+        /// first use of this mode, the only time the flowgraph gets locked for it
+        if(!_locked)
+            _top_block->lock();
+        wire_mode(mode);
+        if(!_locked)
+            _top_block->unlock();
+    }
+    select_path(mode);
+    _mode = mode;
+    /// the shared front end follows the current mode from the next start
+    size_buffers(mode);
+    _deframer_700->flush();
+    _deframer->flush();
+    _deframer_10k->flush();
     _audio_sink->flush();
     _vector_sink->flush();
-    if(disconnect)
+    _demod_running = true;
+    std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - switch_start;
+    _mode_switch_time = elapsed.count();
+}
+
+void gr_demod_base::apply_config(const RadioConfig &config)
+{
+    bool mode_change = config.has(RadioConfig::RxMode) && (config.rx_mode != _mode);
+    bool rate_change = config.has(RadioConfig::SampleRate) && (config.samp_rate != _samp_rate);
+    bool fft_change = config.has(RadioConfig::FFTSize) && (config.fft_size != _fft_size);
+    /// only rewiring needs the flowgraph stopped, and then just once for all of it
+    bool needs_lock = rate_change || fft_change ||
+            (mode_change && !_mode_paths.contains(config.rx_mode));
+    if(needs_lock)
     {
-        switch(_mode)
-        {
-        case gr_modem_types::ModemType2FSK2000FM:
-            _top_block->disconnect(_demod_valve,0,_2fsk_2k_fm,0);
-            _top_block->disconnect(_2fsk_2k_fm,0,_rssi_valve,0);
-            _top_block->disconnect(_2fsk_2k_fm,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_2fsk_2k_fm,2,_deframer1,0);
-            _top_block->disconnect(_2fsk_2k_fm,3,_deframer2,0);
-            break;
-        case gr_modem_types::ModemType2FSK1000FM:
-            _top_block->disconnect(_demod_valve,0,_2fsk_1k_fm,0);
-            _top_block->disconnect(_2fsk_1k_fm,0,_rssi_valve,0);
-            _top_block->disconnect(_2fsk_1k_fm,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_2fsk_1k_fm,2,_deframer_700_1,0);
-            _top_block->disconnect(_2fsk_1k_fm,3,_deframer_700_2,0);
-            break;
-        case gr_modem_types::ModemType2FSK2000:
-            _top_block->disconnect(_demod_valve,0,_2fsk_2k,0);
-            _top_block->disconnect(_2fsk_2k,0,_rssi_valve,0);
-            _top_block->disconnect(_2fsk_2k,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_2fsk_2k,2,_deframer1,0);
-            _top_block->disconnect(_2fsk_2k,3,_deframer2,0);
-            break;
-        case gr_modem_types::ModemType2FSK1000:
-            _top_block->disconnect(_demod_valve,0,_2fsk_1k,0);
-            _top_block->disconnect(_2fsk_1k,0,_rssi_valve,0);
-            _top_block->disconnect(_2fsk_1k,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_2fsk_1k,2,_deframer_700_1,0);
-            _top_block->disconnect(_2fsk_1k,3,_deframer_700_2,0);
-            break;
-        case gr_modem_types::ModemType2FSK20000:
-            _top_block->disconnect(_demod_valve,0,_2fsk_10k,0);
-            _top_block->disconnect(_2fsk_10k,0,_rssi_valve,0);
-            _top_block->disconnect(_2fsk_10k,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_2fsk_10k,2,_deframer1_10k,0);
-            _top_block->disconnect(_2fsk_10k,3,_deframer2_10k,0);
-            break;
-        case gr_modem_types::ModemType4FSK2000:
-            _top_block->disconnect(_demod_valve,0,_4fsk_2k,0);
-            _top_block->disconnect(_4fsk_2k,0,_rssi_valve,0);
-            _top_block->disconnect(_4fsk_2k,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_4fsk_2k,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemType4FSK20000:
-            _top_block->disconnect(_demod_valve,0,_4fsk_10k,0);
-            _top_block->disconnect(_4fsk_10k,0,_rssi_valve,0);
-            _top_block->disconnect(_4fsk_10k,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_4fsk_10k,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemType4FSK2000FM:
-            _top_block->disconnect(_demod_valve,0,_4fsk_2k_fm,0);
-            _top_block->disconnect(_4fsk_2k_fm,0,_rssi_valve,0);
-            _top_block->disconnect(_4fsk_2k_fm,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_4fsk_2k_fm,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemType4FSK1000FM:
-            _top_block->disconnect(_demod_valve,0,_4fsk_1k_fm,0);
-            _top_block->disconnect(_4fsk_1k_fm,0,_rssi_valve,0);
-            _top_block->disconnect(_4fsk_1k_fm,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_4fsk_1k_fm,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemType4FSK20000FM:
-            _top_block->disconnect(_demod_valve,0,_4fsk_10k_fm,0);
-            _top_block->disconnect(_4fsk_10k_fm,0,_rssi_valve,0);
-            _top_block->disconnect(_4fsk_10k_fm,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_4fsk_10k_fm,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemTypeAM5000:
-            _top_block->disconnect(_demod_valve,0,_am,0);
-            _top_block->disconnect(_am,0,_rssi_valve,0);
-            _top_block->disconnect(_am,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeBPSK1000:
-            _top_block->disconnect(_demod_valve,0,_bpsk_1k,0);
-            _top_block->disconnect(_bpsk_1k,0,_rssi_valve,0);
-            _top_block->disconnect(_bpsk_1k,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_bpsk_1k,2,_deframer_700_1,0);
-            _top_block->disconnect(_bpsk_1k,3,_deframer_700_2,0);
-            break;
-        case gr_modem_types::ModemTypeBPSK2000:
-            _top_block->disconnect(_demod_valve,0,_bpsk_2k,0);
-            _top_block->disconnect(_bpsk_2k,0,_rssi_valve,0);
-            _top_block->disconnect(_bpsk_2k,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_bpsk_2k,2,_deframer1,0);
-            _top_block->disconnect(_bpsk_2k,3,_deframer2,0);
-            break;
-        case gr_modem_types::ModemTypeNBFM2500:
-            _top_block->disconnect(_demod_valve,0,_fm_2500,0);
-            _top_block->disconnect(_fm_2500,0,_rssi_valve,0);
-            _top_block->disconnect(_fm_2500,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeNBFM5000:
-            _top_block->disconnect(_demod_valve,0,_fm_5000,0);
-            _top_block->disconnect(_fm_5000,0,_rssi_valve,0);
-            _top_block->disconnect(_fm_5000,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeQPSK2000:
-            _top_block->disconnect(_demod_valve,0,_qpsk_2k,0);
-            _top_block->disconnect(_qpsk_2k,0,_rssi_valve,0);
-            _top_block->disconnect(_qpsk_2k,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_qpsk_2k,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemTypeQPSK20000:
-            _top_block->disconnect(_demod_valve,0,_qpsk_10k,0);
-            _top_block->disconnect(_qpsk_10k,0,_rssi_valve,0);
-            _top_block->disconnect(_qpsk_10k,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_qpsk_10k,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemTypeQPSK250000:
-            _top_block->disconnect(_demod_valve,0,_qpsk_250k,0);
-            _top_block->disconnect(_qpsk_250k,0,_rssi_valve,0);
-            _top_block->disconnect(_qpsk_250k,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_qpsk_250k,2,_vector_sink,0);
-            //_carrier_offset = 25000;
-            //_osmosdr_source->set_center_freq(_device_frequency - _carrier_offset);
-            break;
-        case gr_modem_types::ModemTypeQPSKVideo:
-            _top_block->disconnect(_demod_valve,0,_qpsk_video,0);
-            _top_block->disconnect(_qpsk_video,0,_rssi_valve,0);
-            _top_block->disconnect(_qpsk_video,1,_const_valve,0);
-            _top_block->disconnect(_const_valve,0,_constellation,0);
-            _top_block->disconnect(_qpsk_video,2,_vector_sink,0);
-            //_carrier_offset = 25000;
-            //_osmosdr_source->set_center_freq(_device_frequency - _carrier_offset);
-            break;
-        case gr_modem_types::ModemTypeUSB2500:
-            _top_block->disconnect(_demod_valve,0,_usb,0);
-            _top_block->disconnect(_usb,0,_rssi_valve,0);
-            _top_block->disconnect(_usb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeLSB2500:
-            _top_block->disconnect(_demod_valve,0,_lsb,0);
-            _top_block->disconnect(_lsb,0,_rssi_valve,0);
-            _top_block->disconnect(_lsb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV1600USB:
-            _top_block->disconnect(_demod_valve,0,_freedv_rx1600_usb,0);
-            _top_block->disconnect(_freedv_rx1600_usb,0,_rssi_valve,0);
-            _top_block->disconnect(_freedv_rx1600_usb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV700DUSB:
-            _top_block->disconnect(_demod_valve,0,_freedv_rx700C_usb,0);
-            _top_block->disconnect(_freedv_rx700C_usb,0,_rssi_valve,0);
-            _top_block->disconnect(_freedv_rx700C_usb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV800XAUSB:
-            _top_block->disconnect(_demod_valve,0,_freedv_rx800XA_usb,0);
-            _top_block->disconnect(_freedv_rx800XA_usb,0,_rssi_valve,0);
-            _top_block->disconnect(_freedv_rx800XA_usb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV1600LSB:
-            _top_block->disconnect(_demod_valve,0,_freedv_rx1600_lsb,0);
-            _top_block->disconnect(_freedv_rx1600_lsb,0,_rssi_valve,0);
-            _top_block->disconnect(_freedv_rx1600_lsb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV700DLSB:
-            _top_block->disconnect(_demod_valve,0,_freedv_rx700C_lsb,0);
-            _top_block->disconnect(_freedv_rx700C_lsb,0,_rssi_valve,0);
-            _top_block->disconnect(_freedv_rx700C_lsb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV800XALSB:
-            _top_block->disconnect(_demod_valve,0,_freedv_rx800XA_lsb,0);
-            _top_block->disconnect(_freedv_rx800XA_lsb,0,_rssi_valve,0);
-            _top_block->disconnect(_freedv_rx800XA_lsb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeWBFM:
-            _top_block->disconnect(_demod_valve,0,_wfm,0);
-            _top_block->disconnect(_wfm,0,_rssi_valve,0);
-            _top_block->disconnect(_wfm,1,_audio_sink,0);
-            //_carrier_offset = 25000;
-            //_osmosdr_source->set_center_freq(_device_frequency - _carrier_offset);
-            break;
-        default:
-            break;
-        }
+        _top_block->lock();
+        _locked = true;
+    }
+    if(config.has(RadioConfig::RxFrequency) && (config.rx_frequency != _center_freq))
+        tune(config.rx_frequency);
+    if(rate_change)
+        set_samp_rate(config.samp_rate);
+    if(mode_change)
+        set_mode(config.rx_mode);
+    if(config.has(RadioConfig::Squelch) && (config.squelch != _squelch))
+        set_squelch(config.squelch);
+    if(config.has(RadioConfig::RxCTCSS) && (std::abs(config.rx_ctcss - _ctcss) > 0.001f))
+        set_ctcss(config.rx_ctcss);
+    if(fft_change)
+        set_fft_size(config.fft_size);
+    if(needs_lock)
+    {
+        _top_block->unlock();
+        _locked = false;
     }
+}
 
-    if(connect)
+double gr_demod_base::get_mode_switch_time()
+{
+    return _mode_switch_time;
+}
+
+void gr_demod_base::wire_mode(int mode)
+{
+    switch(mode)
     {
-        switch(mode)
-        {
-        case gr_modem_types::ModemType2FSK2000FM:
-            _top_block->connect(_demod_valve,0,_2fsk_2k_fm,0);
-            _top_block->connect(_2fsk_2k_fm,0,_rssi_valve,0);
-            _top_block->connect(_2fsk_2k_fm,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_2fsk_2k_fm,2,_deframer1,0);
-            _top_block->connect(_2fsk_2k_fm,3,_deframer2,0);
-            break;
-        case gr_modem_types::ModemType2FSK1000FM:
-            _top_block->connect(_demod_valve,0,_2fsk_1k_fm,0);
-            _top_block->connect(_2fsk_1k_fm,0,_rssi_valve,0);
-            _top_block->connect(_2fsk_1k_fm,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_2fsk_1k_fm,2,_deframer_700_1,0);
-            _top_block->connect(_2fsk_1k_fm,3,_deframer_700_2,0);
-            break;
-        case gr_modem_types::ModemType2FSK2000:
-            _top_block->connect(_demod_valve,0,_2fsk_2k,0);
-            _top_block->connect(_2fsk_2k,0,_rssi_valve,0);
-            _top_block->connect(_2fsk_2k,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_2fsk_2k,2,_deframer1,0);
-            _top_block->connect(_2fsk_2k,3,_deframer2,0);
-            break;
-        case gr_modem_types::ModemType2FSK1000:
-            _top_block->connect(_demod_valve,0,_2fsk_1k,0);
-            _top_block->connect(_2fsk_1k,0,_rssi_valve,0);
-            _top_block->connect(_2fsk_1k,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_2fsk_1k,2,_deframer_700_1,0);
-            _top_block->connect(_2fsk_1k,3,_deframer_700_2,0);
-            break;
-        case gr_modem_types::ModemType2FSK20000:
-            _top_block->connect(_demod_valve,0,_2fsk_10k,0);
-            _top_block->connect(_2fsk_10k,0,_rssi_valve,0);
-            _top_block->connect(_2fsk_10k,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_2fsk_10k,2,_deframer1_10k,0);
-            _top_block->connect(_2fsk_10k,3,_deframer2_10k,0);
-            break;
-        case gr_modem_types::ModemType4FSK2000:
-            _top_block->connect(_demod_valve,0,_4fsk_2k,0);
-            _top_block->connect(_4fsk_2k,0,_rssi_valve,0);
-            _top_block->connect(_4fsk_2k,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_4fsk_2k,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemType4FSK20000:
-            _top_block->connect(_demod_valve,0,_4fsk_10k,0);
-            _top_block->connect(_4fsk_10k,0,_rssi_valve,0);
-            _top_block->connect(_4fsk_10k,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_4fsk_10k,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemType4FSK2000FM:
-            _top_block->connect(_demod_valve,0,_4fsk_2k_fm,0);
-            _top_block->connect(_4fsk_2k_fm,0,_rssi_valve,0);
-            _top_block->connect(_4fsk_2k_fm,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_4fsk_2k_fm,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemType4FSK1000FM:
-            _top_block->connect(_demod_valve,0,_4fsk_1k_fm,0);
-            _top_block->connect(_4fsk_1k_fm,0,_rssi_valve,0);
-            _top_block->connect(_4fsk_1k_fm,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_4fsk_1k_fm,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemType4FSK20000FM:
-            _top_block->connect(_demod_valve,0,_4fsk_10k_fm,0);
-            _top_block->connect(_4fsk_10k_fm,0,_rssi_valve,0);
-            _top_block->connect(_4fsk_10k_fm,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_4fsk_10k_fm,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemTypeAM5000:
-            _top_block->connect(_demod_valve,0,_am,0);
-            _top_block->connect(_am,0,_rssi_valve,0);
-            _top_block->connect(_am,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeBPSK1000:
-            _top_block->connect(_demod_valve,0,_bpsk_1k,0);
-            _top_block->connect(_bpsk_1k,0,_rssi_valve,0);
-            _top_block->connect(_bpsk_1k,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_bpsk_1k,2,_deframer_700_1,0);
-            _top_block->connect(_bpsk_1k,3,_deframer_700_2,0);
-            break;
-        case gr_modem_types::ModemTypeBPSK2000:
-            _top_block->connect(_demod_valve,0,_bpsk_2k,0);
-            _top_block->connect(_bpsk_2k,0,_rssi_valve,0);
-            _top_block->connect(_bpsk_2k,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_bpsk_2k,2,_deframer1,0);
-            _top_block->connect(_bpsk_2k,3,_deframer2,0);
-            break;
-        case gr_modem_types::ModemTypeNBFM2500:
-            _top_block->connect(_demod_valve,0,_fm_2500,0);
-            _top_block->connect(_fm_2500,0,_rssi_valve,0);
-            _top_block->connect(_fm_2500,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeNBFM5000:
-            _top_block->connect(_demod_valve,0,_fm_5000,0);
-            _top_block->connect(_fm_5000,0,_rssi_valve,0);
-            _top_block->connect(_fm_5000,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeQPSK2000:
-            _top_block->connect(_demod_valve,0,_qpsk_2k,0);
-            _top_block->connect(_qpsk_2k,0,_rssi_valve,0);
-            _top_block->connect(_qpsk_2k,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_qpsk_2k,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemTypeQPSK20000:
-            _top_block->connect(_demod_valve,0,_qpsk_10k,0);
-            _top_block->connect(_qpsk_10k,0,_rssi_valve,0);
-            _top_block->connect(_qpsk_10k,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_qpsk_10k,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemTypeQPSK250000:
-            //_carrier_offset = 250000;
-            //_osmosdr_source->set_center_freq(_device_frequency - _carrier_offset);
-            _top_block->connect(_demod_valve,0,_qpsk_250k,0);
-            _top_block->connect(_qpsk_250k,0,_rssi_valve,0);
-            _top_block->connect(_qpsk_250k,1,_const_valve,0);
-            _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_qpsk_250k,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemTypeQPSKVideo:
-            //_carrier_offset = 250000;
-            //_osmosdr_source->set_center_freq(_device_frequency - _carrier_offset);
-            _top_block->connect(_demod_valve,0,_qpsk_video,0);
-            _top_block->connect(_qpsk_video,0,_rssi_valve,0);
-            _top_block->connect(_qpsk_video,1,_const_valve,0);
+    case gr_modem_types::ModemType2FSK2000FM:
+        wire_path(mode, _2fsk_2k_fm, _2fsk_2k_fm->get_target_samp_rate(), true, _frame_select, _deframer);
+        break;
+    case gr_modem_types::ModemType2FSK1000FM:
+        wire_path(mode, _2fsk_1k_fm, _2fsk_1k_fm->get_target_samp_rate(), true, _frame_700_select, _deframer_700);
+        break;
+    case gr_modem_types::ModemType2FSK2000:
+        wire_path(mode, _2fsk_2k, _2fsk_2k->get_target_samp_rate(), true, _frame_select, _deframer);
+        break;
+    case gr_modem_types::ModemType2FSK1000:
+        wire_path(mode, _2fsk_1k, _2fsk_1k->get_target_samp_rate(), true, _frame_700_select, _deframer_700);
+        break;
+    case gr_modem_types::ModemType2FSK20000:
+        wire_path(mode, _2fsk_10k, _2fsk_10k->get_target_samp_rate(), true, _frame_10k_select, _deframer_10k);
+        break;
+    case gr_modem_types::ModemType4FSK2000:
+        wire_path(mode, _4fsk_2k, _4fsk_2k->get_target_samp_rate(), true, _vector_select, _vector_sink);
+        break;
+    case gr_modem_types::ModemType4FSK20000:
+        wire_path(mode, _4fsk_10k, _4fsk_10k->get_target_samp_rate(), true, _vector_select, _vector_sink);
+        break;
+    case gr_modem_types::ModemType4FSK2000FM:
+        wire_path(mode, _4fsk_2k_fm, _4fsk_2k_fm->get_target_samp_rate(), true, _vector_select, _vector_sink);
+        break;
+    case gr_modem_types::ModemType4FSK1000FM:
+        wire_path(mode, _4fsk_1k_fm, _4fsk_1k_fm->get_target_samp_rate(), true, _vector_select, _vector_sink);
+        break;
+    case gr_modem_types::ModemType4FSK20000FM:
+        wire_path(mode, _4fsk_10k_fm, _4fsk_10k_fm->get_target_samp_rate(), true, _vector_select, _vector_sink);
+        break;
+    case gr_modem_types::ModemTypeAM5000:
+        wire_path(mode, _am, _am->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeBPSK1000:
+        wire_path(mode, _bpsk_1k, _bpsk_1k->get_target_samp_rate(), true, _frame_700_select, _deframer_700);
+        break;
+    case gr_modem_types::ModemTypeBPSK2000:
+        wire_path(mode, _bpsk_2k, _bpsk_2k->get_target_samp_rate(), true, _frame_select, _deframer);
+        break;
+    case gr_modem_types::ModemTypeNBFM2500:
+        wire_path(mode, _fm_2500, _fm_2500->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeNBFM5000:
+        wire_path(mode, _fm_5000, _fm_5000->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeQPSK2000:
+        wire_path(mode, _qpsk_2k, _qpsk_2k->get_target_samp_rate(), true, _vector_select, _vector_sink);
+        break;
+    case gr_modem_types::ModemTypeQPSK20000:
+        wire_path(mode, _qpsk_10k, _qpsk_10k->get_target_samp_rate(), true, _vector_select, _vector_sink);
+        break;
+    case gr_modem_types::ModemTypeQPSK250000:
+        wire_path(mode, _qpsk_250k, _qpsk_250k->get_target_samp_rate(), true, _vector_select, _vector_sink);
+        break;
+    case gr_modem_types::ModemTypeQPSKVideo:
+        wire_path(mode, _qpsk_video, _qpsk_video->get_target_samp_rate(), true, _vector_select, _vector_sink);
+        break;
+    case gr_modem_types::ModemTypeUSB2500:
+        wire_path(mode, _usb, _usb->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeLSB2500:
+        wire_path(mode, _lsb, _lsb->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeFREEDV1600USB:
+        wire_path(mode, _freedv_rx1600_usb, _freedv_rx1600_usb->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeFREEDV700DUSB:
+        wire_path(mode, _freedv_rx700C_usb, _freedv_rx700C_usb->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeFREEDV800XAUSB:
+        wire_path(mode, _freedv_rx800XA_usb, _freedv_rx800XA_usb->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeFREEDV1600LSB:
+        wire_path(mode, _freedv_rx1600_lsb, _freedv_rx1600_lsb->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeFREEDV700DLSB:
+        wire_path(mode, _freedv_rx700C_lsb, _freedv_rx700C_lsb->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeFREEDV800XALSB:
+        wire_path(mode, _freedv_rx800XA_lsb, _freedv_rx800XA_lsb->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    case gr_modem_types::ModemTypeWBFM:
+        wire_path(mode, _wfm, _wfm->get_target_samp_rate(), false, _audio_select, _audio_sink);
+        break;
+    default:
+        break;
+    }
+}
+
+void gr_demod_base::wire_path(int mode, gr::hier_block2_sptr demod, int demod_rate, bool digital,
+                              gr_mode_selector_sptr data_select, gr::basic_block_sptr data_sink)
+{
+    /// demodulators: output 0 is the RSSI stream, digital ones have the
+    /// constellation on 1 and data on 2, analog ones have audio on 1
+    mode_path path;
+    path.valve = gr::blocks::copy::make(sizeof(gr_complex));
+    path.valve->set_enabled(false);
+    path.demod = demod;
+    path.demod_rate = demod_rate;
+    path.buffer_scale = 1.0f;
+    path.buffer_tuned = false;
+    _top_block->connect(_demod_valve,0,path.valve,0);
+    _top_block->connect(path.valve,0,demod,0);
+    path.rssi_input = attach_selector(demod, 0, _rssi_select, _rssi_valve);
+    path.const_input = -1;
+    if(digital)
+    {
+        path.const_input = attach_selector(demod, 1, _const_select, _const_valve);
+        if(path.const_input == 0)
             _top_block->connect(_const_valve,0,_constellation,0);
-            _top_block->connect(_qpsk_video,2,_vector_sink,0);
-            break;
-        case gr_modem_types::ModemTypeUSB2500:
-            _top_block->connect(_demod_valve,0,_usb,0);
-            _top_block->connect(_usb,0,_rssi_valve,0);
-            _top_block->connect(_usb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeLSB2500:
-            _top_block->connect(_demod_valve,0,_lsb,0);
-            _top_block->connect(_lsb,0,_rssi_valve,0);
-            _top_block->connect(_lsb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV1600USB:
-            _top_block->connect(_demod_valve,0,_freedv_rx1600_usb,0);
-            _top_block->connect(_freedv_rx1600_usb,0,_rssi_valve,0);
-            _top_block->connect(_freedv_rx1600_usb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV700DUSB:
-            _top_block->connect(_demod_valve,0,_freedv_rx700C_usb,0);
-            _top_block->connect(_freedv_rx700C_usb,0,_rssi_valve,0);
-            _top_block->connect(_freedv_rx700C_usb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV800XAUSB:
-            _top_block->connect(_demod_valve,0,_freedv_rx800XA_usb,0);
-            _top_block->connect(_freedv_rx800XA_usb,0,_rssi_valve,0);
-            _top_block->connect(_freedv_rx800XA_usb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV1600LSB:
-            _top_block->connect(_demod_valve,0,_freedv_rx1600_lsb,0);
-            _top_block->connect(_freedv_rx1600_lsb,0,_rssi_valve,0);
-            _top_block->connect(_freedv_rx1600_lsb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV700DLSB:
-            _top_block->connect(_demod_valve,0,_freedv_rx700C_lsb,0);
-            _top_block->connect(_freedv_rx700C_lsb,0,_rssi_valve,0);
-            _top_block->connect(_freedv_rx700C_lsb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeFREEDV800XALSB:
-            _top_block->connect(_demod_valve,0,_freedv_rx800XA_lsb,0);
-            _top_block->connect(_freedv_rx800XA_lsb,0,_rssi_valve,0);
-            _top_block->connect(_freedv_rx800XA_lsb,1,_audio_sink,0);
-            break;
-        case gr_modem_types::ModemTypeWBFM:
-            //_carrier_offset = 250000;
-            //_osmosdr_source->set_center_freq(_device_frequency - _carrier_offset);
-            _top_block->connect(_demod_valve,0,_wfm,0);
-            _top_block->connect(_wfm,0,_rssi_valve,0);
-            _top_block->connect(_wfm,1,_audio_sink,0);
-        break;
-        default:
-            break;
-        }
-        _mode = mode;
     }
+    path.data_select = data_select;
+    path.data_input = attach_selector(demod, digital ? 2 : 1, data_select, data_sink);
+    /// analog audio is also tapped for the repeater bridge to the TX flowgraph
+    if((data_select == _audio_select) && (path.data_input == 0))
+        _top_block->connect(_audio_select,0,_bridge_sink,0);
+    _mode_paths[mode] = path;
+    /// new blocks get their buffers when the flowgraph is unlocked
+    size_buffers(mode);
+}
 
-    if(!_locked)
-        _top_block->unlock();
-    _demod_running = true;
+int gr_demod_base::attach_selector(gr::basic_block_sptr block, int port,
+                                   gr_mode_selector_sptr selector, gr::basic_block_sptr sink)
+{
+    int input = selector->add_input();
+    if(input == 0)
+        _top_block->connect(selector,0,sink,0);
+    _top_block->connect(block,port,selector,input);
+    return input;
+}
+
+void gr_demod_base::select_path(int mode)
+{
+    mode_path path;
+    path.rssi_input = -1;
+    path.const_input = -1;
+    path.data_input = -1;
+    if(_mode_paths.contains(mode))
+        path = _mode_paths[mode];
+
+    /// close the old chain before opening the new one so the streams never mix
+    QMap<int, mode_path>::iterator it;
+    for(it = _mode_paths.begin(); it != _mode_paths.end(); ++it)
+    {
+        if(it.key() != mode)
+            it.value().valve->set_enabled(false);
+    }
+    _rssi_select->set_input(path.rssi_input);
+    _const_select->set_input(path.const_input);
+    for(unsigned int i=0;i<_data_selectors.size();i++)
+    {
+        gr_mode_selector_sptr selector = _data_selectors.at(i);
+        selector->set_input((selector == path.data_select) ? path.data_input : -1);
+    }
+    if(path.valve)
+        path.valve->set_enabled(true);
 }
 
 void gr_demod_base::start(int buffer_size)
@@ -607,6 +571,8 @@ void gr_demod_base::start(int buffer_size)
         _top_block->start(buffer_size);
     else // automatic
         _top_block->start();
+    _ratio_items = 0;
+    _ratio_time = std::chrono::steady_clock::now();
 }
 
 void gr_demod_base::stop()
@@ -617,66 +583,36 @@ void gr_demod_base::stop()
     _top_block->wait();
 }
 
-std::vector<unsigned char>* gr_demod_base::getData(int nr)
+std::vector<unsigned char>* gr_demod_base::getFrameData()
 {
     if(!_demod_running)
     {
         return nullptr;
     }
     std::vector<unsigned char> *data = nullptr;
-    if(nr == 1)
+    switch(_mode)
     {
-        switch(_mode)
-        {
-        case gr_modem_types::ModemType2FSK2000FM:
-            data = _deframer1->get_data();
-            break;
-        case gr_modem_types::ModemType2FSK1000FM:
-            data = _deframer_700_1->get_data();
-            break;
-        case gr_modem_types::ModemType2FSK2000:
-            data = _deframer1->get_data();
-            break;
-        case gr_modem_types::ModemType2FSK1000:
-            data = _deframer_700_1->get_data();
-            break;
-        case gr_modem_types::ModemType2FSK20000:
-            data = _deframer1_10k->get_data();
-            break;
-        case gr_modem_types::ModemTypeBPSK1000:
-            data = _deframer_700_1->get_data();
-            break;
-        case gr_modem_types::ModemTypeBPSK2000:
-            data = _deframer1->get_data();
-            break;
-        }
-    }
-    else if(nr == 2)
-    {
-        switch(_mode)
-        {
-        case gr_modem_types::ModemType2FSK2000FM:
-            data = _deframer2->get_data();
-            break;
-        case gr_modem_types::ModemType2FSK1000FM:
-            data = _deframer_700_2->get_data();
-            break;
-        case gr_modem_types::ModemType2FSK2000:
-            data = _deframer2->get_data();
-            break;
-        case gr_modem_types::ModemType2FSK1000:
-            data = _deframer_700_2->get_data();
-            break;
-        case gr_modem_types::ModemType2FSK20000:
-            data = _deframer2_10k->get_data();
-            break;
-        case gr_modem_types::ModemTypeBPSK1000:
-            data = _deframer_700_2->get_data();
-            break;
-        case gr_modem_types::ModemTypeBPSK2000:
-            data = _deframer2->get_data();
-            break;
-        }
+    case gr_modem_types::ModemType2FSK2000FM:
+        data = _deframer->get_data();
+        break;
+    case gr_modem_types::ModemType2FSK1000FM:
+        data = _deframer_700->get_data();
+        break;
+    case gr_modem_types::ModemType2FSK2000:
+        data = _deframer->get_data();
+        break;
+    case gr_modem_types::ModemType2FSK1000:
+        data = _deframer_700->get_data();
+        break;
+    case gr_modem_types::ModemType2FSK20000:
+        data = _deframer_10k->get_data();
+        break;
+    case gr_modem_types::ModemTypeBPSK1000:
+        data = _deframer_700->get_data();
+        break;
+    case gr_modem_types::ModemTypeBPSK2000:
+        data = _deframer->get_data();
+        break;
     }
     return data;
 }
@@ -715,8 +651,12 @@ void gr_demod_base::get_FFT_data(float *fft_data,  unsigned int &fftSize)
 
 void gr_demod_base::tune(long long center_freq)
 {
+    _center_freq = center_freq;
     long long steps = center_freq / 1000000;
     _device_frequency = center_freq + steps * _freq_correction;
+    _sigmf_sink->set_center_freq(_device_frequency);
+    if(!_osmosdr_source)
+        return;
     _osmosdr_source->set_center_freq(_device_frequency);
     set_bandwidth_specific();
 }
@@ -738,6 +678,9 @@ double gr_demod_base::get_freq()
 
 void gr_demod_base::set_rx_sensitivity(double value, std::string gain_stage)
 {
+    _rx_gain = value;
+    if(!_osmosdr_source)
+        return;
     if (!_gain_range.empty() && (gain_stage.size() < 1))
     {
 
@@ -812,6 +755,7 @@ void gr_demod_base::set_filter_width(int filter_width, int mode)
 
 void gr_demod_base::set_squelch(int value)
 {
+    _squelch = value;
     _fm_2500->set_squelch(value);
     _fm_5000->set_squelch(value);
     _am->set_squelch(value);
@@ -829,10 +773,25 @@ void gr_demod_base::set_gain(float value)
 
 void gr_demod_base::set_ctcss(float value)
 {
-    _top_block->lock();
+    _ctcss = value;
     _fm_2500->set_ctcss(value);
     _fm_5000->set_ctcss(value);
-    _top_block->unlock();
+}
+
+void gr_demod_base::get_detected_tone(float &tone, int &dcs_code)
+{
+    tone = 0;
+    dcs_code = 0;
+    if(_mode == gr_modem_types::ModemTypeNBFM2500)
+    {
+        tone = _fm_2500->get_ctcss_tone();
+        dcs_code = _fm_2500->get_dcs_code();
+    }
+    else if(_mode == gr_modem_types::ModemTypeNBFM5000)
+    {
+        tone = _fm_5000->get_ctcss_tone();
+        dcs_code = _fm_5000->get_dcs_code();
+    }
 }
 
 void gr_demod_base::set_carrier_offset(long long carrier_offset)
@@ -844,9 +803,12 @@ void gr_demod_base::set_carrier_offset(long long carrier_offset)
 
 void gr_demod_base::set_fft_size(int size)
 {
-    _top_block->lock();
+    if(!_locked)
+        _top_block->lock();
     _fft_sink->set_fft_size((unsigned int)size);
-    _top_block->unlock();
+    _fft_size = size;
+    if(!_locked)
+        _top_block->unlock();
 }
 
 float gr_demod_base::get_rssi()
@@ -854,6 +816,11 @@ float gr_demod_base::get_rssi()
     return _rssi->level();
 }
 
+void gr_demod_base::get_rssi_history(std::vector<float> &history)
+{
+    _rssi->get_history(history);
+}
+
 std::vector<gr_complex>* gr_demod_base::get_constellation_data()
 {
     if(!_demod_running)
@@ -867,8 +834,13 @@ std::vector<gr_complex>* gr_demod_base::get_constellation_data()
 
 void gr_demod_base::set_samp_rate(int samp_rate)
 {
-    _top_block->lock();
+    bool locked = _locked;
+    if(!locked)
+        _top_block->lock();
     _locked = true;
+    /// a recording can only be replayed at the rate it was made with
+    if(_sigmf_source)
+        samp_rate = _replay_samp_rate;
     _samp_rate = samp_rate;
 
     int decimation = (int) _samp_rate / 1000000;
@@ -900,7 +872,7 @@ void gr_demod_base::set_samp_rate(int samp_rate)
                                             gr::filter::firdes::WIN_BLACKMAN_HARRIS);
 
         _resampler = gr::filter::rational_resampler_base_ccf::make(1, decimation, taps);
-        _resampler->set_thread_priority(75);
+        sched_blocks(std::vector<gr::block_sptr>(1, _resampler), _frontend_cpus, _frontend_priority);
         _top_block->connect(_rotator,0, _resampler,0);
         _top_block->connect(_resampler,0, _demod_valve,0);
     }
@@ -926,17 +898,26 @@ void gr_demod_base::set_samp_rate(int samp_rate)
 
 
     _rotator->set_phase_inc(2*M_PI*-_carrier_offset/_samp_rate);
-    _osmosdr_source->set_center_freq(_device_frequency);
-    _osmosdr_source->set_sample_rate(_samp_rate);
-    set_bandwidth_specific();
-    _top_block->unlock();
-    _locked = false;
+    if(_osmosdr_source)
+    {
+        _osmosdr_source->set_center_freq(_device_frequency);
+        _osmosdr_source->set_sample_rate(_samp_rate);
+        set_bandwidth_specific();
+    }
+    size_buffers(_mode);
+    if(!locked)
+    {
+        _top_block->unlock();
+        _locked = false;
+    }
 
 
 }
 
 void gr_demod_base::set_bandwidth_specific()
 {
+    if(!_osmosdr_source)
+        return;
     _osmo_filter_bw = (double)_samp_rate;
     if((_device_frequency < 30 * 1000 * 1000) && _lime_specific)
     {
@@ -951,7 +932,7 @@ void gr_demod_base::set_bandwidth_specific()
 
 void gr_demod_base::calibrate_rssi(float value)
 {
-    _add_const->set_k(value);
+    _rssi->set_calibration(value);
 }
 
 void gr_demod_base::set_agc_attack(float value)
@@ -965,3 +946,213 @@ void gr_demod_base::set_agc_decay(float value)
     _usb->set_agc_decay(value);
     _lsb->set_agc_decay(value);
 }
+
+void gr_demod_base::set_sched_group(int group, const std::vector<int> &cpus, int priority)
+{
+    std::vector<gr::block_sptr> blocks;
+    switch(group)
+    {
+    case SchedFrontEnd:
+        _frontend_cpus = cpus;
+        _frontend_priority = priority;
+        blocks.push_back(_rotator);
+        blocks.push_back(_resampler);
+        blocks.push_back(_demod_valve);
+        if(_sigmf_source)
+            blocks.push_back(_sigmf_source);
+        /// the osmosdr source is a hier block, threads can only be pinned
+        if(_osmosdr_source && !cpus.empty())
+            _osmosdr_source->set_processor_affinity(cpus);
+        break;
+    case SchedDemod:
+    {
+        std::vector<gr::hier_block2_sptr> demods = {_2fsk_2k_fm, _2fsk_1k_fm, _2fsk_2k,
+                _2fsk_1k, _2fsk_10k, _4fsk_2k, _4fsk_10k, _4fsk_2k_fm, _4fsk_1k_fm, _4fsk_10k_fm,
+                _am, _bpsk_1k, _bpsk_2k, _fm_2500, _fm_5000, _qpsk_2k, _qpsk_10k, _qpsk_250k,
+                _qpsk_video, _usb, _lsb, _wfm, _freedv_rx1600_usb, _freedv_rx700C_usb,
+                _freedv_rx800XA_usb, _freedv_rx1600_lsb, _freedv_rx700C_lsb, _freedv_rx800XA_lsb};
+        if(!cpus.empty())
+        {
+            for(unsigned int i=0;i<demods.size();i++)
+                demods.at(i)->set_processor_affinity(cpus);
+        }
+        /// hier blocks don't have a thread priority, only the costly inner blocks get one
+        std::vector<std::vector<gr::block_sptr>> inner = {
+                _2fsk_2k_fm->demod_blocks(), _2fsk_1k_fm->demod_blocks(), _2fsk_2k->demod_blocks(),
+                _2fsk_1k->demod_blocks(), _2fsk_10k->demod_blocks(), _4fsk_2k->demod_blocks(),
+                _4fsk_10k->demod_blocks(), _4fsk_2k_fm->demod_blocks(), _4fsk_1k_fm->demod_blocks(),
+                _4fsk_10k_fm->demod_blocks(), _bpsk_1k->demod_blocks(), _bpsk_2k->demod_blocks(),
+                _qpsk_2k->demod_blocks(), _qpsk_10k->demod_blocks(), _qpsk_250k->demod_blocks(),
+                _qpsk_video->demod_blocks()};
+        for(unsigned int i=0;i<inner.size();i++)
+            blocks.insert(blocks.end(), inner.at(i).begin(), inner.at(i).end());
+        break;
+    }
+    case SchedFec:
+    {
+        std::vector<std::vector<gr::block_sptr>> inner = {
+                _2fsk_2k_fm->fec_blocks(), _2fsk_1k_fm->fec_blocks(), _2fsk_2k->fec_blocks(),
+                _2fsk_1k->fec_blocks(), _2fsk_10k->fec_blocks(), _4fsk_2k->fec_blocks(),
+                _4fsk_10k->fec_blocks(), _4fsk_2k_fm->fec_blocks(), _4fsk_1k_fm->fec_blocks(),
+                _4fsk_10k_fm->fec_blocks(), _bpsk_1k->fec_blocks(), _bpsk_2k->fec_blocks(),
+                _qpsk_2k->fec_blocks(), _qpsk_10k->fec_blocks(), _qpsk_250k->fec_blocks(),
+                _qpsk_video->fec_blocks()};
+        for(unsigned int i=0;i<inner.size();i++)
+            blocks.insert(blocks.end(), inner.at(i).begin(), inner.at(i).end());
+        blocks.push_back(_deframer);
+        blocks.push_back(_deframer_700);
+        blocks.push_back(_deframer_10k);
+        break;
+    }
+    default:
+        return;
+    }
+    sched_blocks(blocks, cpus, priority);
+}
+
+void gr_demod_base::sched_blocks(const std::vector<gr::block_sptr> &blocks,
+                                 const std::vector<int> &cpus, int priority)
+{
+    for(unsigned int i=0;i<blocks.size();i++)
+    {
+        gr::block_sptr block = blocks.at(i);
+        if(!block)
+            continue;
+        if(!cpus.empty())
+            block->set_processor_affinity(cpus);
+        /// block threads keep the policy of the thread starting the flowgraph
+        if(priority > 0)
+            block->set_thread_priority(priority);
+    }
+}
+
+void gr_demod_base::get_block_stats(std::vector<gr_block_profiler::stats> &stats)
+{
+    gr_block_profiler::block_list list;
+    list.push_back(std::make_pair("source", _sigmf_source));
+    list.push_back(std::make_pair("rotator", _rotator));
+    list.push_back(std::make_pair("resampler", _resampler));
+    list.push_back(std::make_pair("demod_valve", _demod_valve));
+    list.push_back(std::make_pair("rssi", _rssi));
+    list.push_back(std::make_pair("constellation", _constellation));
+    list.push_back(std::make_pair("fft", _fft_sink));
+    list.push_back(std::make_pair("audio_sink", _audio_sink));
+    list.push_back(std::make_pair("vector_sink", _vector_sink));
+    list.push_back(std::make_pair("deframer", _deframer));
+    list.push_back(std::make_pair("deframer_700", _deframer_700));
+    list.push_back(std::make_pair("deframer_10k", _deframer_10k));
+    add_profiled(list, "2fsk_2k_fm", _2fsk_2k_fm->demod_blocks());
+    add_profiled(list, "2fsk_2k_fm", _2fsk_2k_fm->fec_blocks());
+    add_profiled(list, "2fsk_1k_fm", _2fsk_1k_fm->demod_blocks());
+    add_profiled(list, "2fsk_1k_fm", _2fsk_1k_fm->fec_blocks());
+    add_profiled(list, "2fsk_2k", _2fsk_2k->demod_blocks());
+    add_profiled(list, "2fsk_2k", _2fsk_2k->fec_blocks());
+    add_profiled(list, "2fsk_1k", _2fsk_1k->demod_blocks());
+    add_profiled(list, "2fsk_1k", _2fsk_1k->fec_blocks());
+    add_profiled(list, "2fsk_10k", _2fsk_10k->demod_blocks());
+    add_profiled(list, "2fsk_10k", _2fsk_10k->fec_blocks());
+    add_profiled(list, "4fsk_2k", _4fsk_2k->demod_blocks());
+    add_profiled(list, "4fsk_2k", _4fsk_2k->fec_blocks());
+    add_profiled(list, "4fsk_10k", _4fsk_10k->demod_blocks());
+    add_profiled(list, "4fsk_10k", _4fsk_10k->fec_blocks());
+    add_profiled(list, "4fsk_2k_fm", _4fsk_2k_fm->demod_blocks());
+    add_profiled(list, "4fsk_2k_fm", _4fsk_2k_fm->fec_blocks());
+    add_profiled(list, "4fsk_1k_fm", _4fsk_1k_fm->demod_blocks());
+    add_profiled(list, "4fsk_1k_fm", _4fsk_1k_fm->fec_blocks());
+    add_profiled(list, "4fsk_10k_fm", _4fsk_10k_fm->demod_blocks());
+    add_profiled(list, "4fsk_10k_fm", _4fsk_10k_fm->fec_blocks());
+    add_profiled(list, "bpsk_1k", _bpsk_1k->demod_blocks());
+    add_profiled(list, "bpsk_1k", _bpsk_1k->fec_blocks());
+    add_profiled(list, "bpsk_2k", _bpsk_2k->demod_blocks());
+    add_profiled(list, "bpsk_2k", _bpsk_2k->fec_blocks());
+    add_profiled(list, "qpsk_2k", _qpsk_2k->demod_blocks());
+    add_profiled(list, "qpsk_2k", _qpsk_2k->fec_blocks());
+    add_profiled(list, "qpsk_10k", _qpsk_10k->demod_blocks());
+    add_profiled(list, "qpsk_10k", _qpsk_10k->fec_blocks());
+    add_profiled(list, "qpsk_250k", _qpsk_250k->demod_blocks());
+    add_profiled(list, "qpsk_250k", _qpsk_250k->fec_blocks());
+    add_profiled(list, "qpsk_video", _qpsk_video->demod_blocks());
+    add_profiled(list, "qpsk_video", _qpsk_video->fec_blocks());
+    _profiler.sample(list, stats);
+}
+
+void gr_demod_base::add_profiled(gr_block_profiler::block_list &list, const std::string &prefix,
+                                 const std::vector<gr::block_sptr> &blocks)
+{
+    for(unsigned int i=0;i<blocks.size();i++)
+    {
+        if(blocks.at(i))
+            list.push_back(std::make_pair(prefix + "/" + blocks.at(i)->name(), blocks.at(i)));
+    }
+}
+
+void gr_demod_base::size_buffers(int mode)
+{
+    if(!_mode_paths.contains(mode))
+        return;
+    const mode_path &path = _mode_paths[mode];
+    float latency = ((mode == gr_modem_types::ModemTypeQPSK250000) ||
+                     (mode == gr_modem_types::ModemTypeQPSKVideo)) ?
+                DATA_EDGE_LATENCY_MSEC : VOICE_EDGE_LATENCY_MSEC;
+    latency *= path.buffer_scale;
+    int device_items = edge_items(_samp_rate, latency);
+    int demod_items = edge_items(DEMOD_INPUT_RATE, latency);
+    size_hier(_osmosdr_source, device_items);
+    pin_buffer(_sigmf_source, device_items);
+    pin_buffer(_rotator, device_items);
+    pin_buffer(_resampler, demod_items);
+    pin_buffer(_demod_valve, demod_items);
+    pin_buffer(path.valve, demod_items);
+    size_hier(path.demod, edge_items(path.demod_rate, latency));
+}
+
+bool gr_demod_base::tune_buffers(bool overflow)
+{
+    if(!_mode_paths.contains(_mode))
+        return false;
+    mode_path &path = _mode_paths[_mode];
+    if(path.buffer_tuned)
+        return false;
+    float scale = path.buffer_scale;
+    if(overflow)
+    {
+        path.buffer_scale = std::min(1.0f, path.buffer_scale * 2);
+        path.buffer_tuned = true;
+    }
+    else if(path.buffer_scale > MIN_BUFFER_SCALE)
+    {
+        path.buffer_scale = path.buffer_scale / 2;
+    }
+    else
+    {
+        path.buffer_tuned = true;
+    }
+    if(path.buffer_scale == scale)
+        return false;
+    size_buffers(_mode);
+    return true;
+}
+
+float gr_demod_base::get_sample_ratio()
+{
+    return sample_ratio(_rotator, _samp_rate, _ratio_items, _ratio_time);
+}
+
+void gr_demod_base::get_buffer_stats(int &bytes, float &latency_msec, float &scale, bool &tuned)
+{
+    bytes = 0;
+    latency_msec = 0;
+    scale = 1.0f;
+    tuned = false;
+    add_buffer(_sigmf_source, _samp_rate, bytes, latency_msec);
+    add_buffer(_rotator, _samp_rate, bytes, latency_msec);
+    if(_samp_rate != DEMOD_INPUT_RATE)
+        add_buffer(_resampler, DEMOD_INPUT_RATE, bytes, latency_msec);
+    add_buffer(_demod_valve, DEMOD_INPUT_RATE, bytes, latency_msec);
+    if(!_mode_paths.contains(_mode))
+        return;
+    const mode_path &path = _mode_paths[_mode];
+    add_buffer(path.valve, DEMOD_INPUT_RATE, bytes, latency_msec);
+    scale = path.buffer_scale;
+    tuned = path.buffer_tuned;
+}
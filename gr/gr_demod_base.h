@@ -27,23 +27,25 @@
 #include <gnuradio/filter/freq_xlating_fir_filter_ccf.h>
 #include <gnuradio/blocks/multiply_cc.h>
 #include <gnuradio/analog/agc2_ff.h>
-#include <gnuradio/blocks/complex_to_mag_squared.h>
-#include <gnuradio/blocks/nlog10_ff.h>
 #include <gnuradio/blocks/multiply_const_ff.h>
-#include <gnuradio/filter/single_pole_iir_filter_ff.h>
-#include <gnuradio/blocks/moving_average_ff.h>
 #include <gnuradio/blocks/add_const_ff.h>
 #include <gnuradio/blocks/delay.h>
 #include <gnuradio/blocks/copy.h>
 #include <gnuradio/blocks/rotator_cc.h>
 #include <gnuradio/blocks/message_debug.h>
-#include <gnuradio/blocks/probe_signal_f.h>
 #include <gnuradio/constants.h>
 #include <osmosdr/source.h>
 #include <vector>
+#include <chrono>
 #include "gr_audio_sink.h"
+#include "gr_audio_bridge.h"
 #include "gr_vector_sink.h"
 #include "gr_const_sink.h"
+#include "gr_sigmf_sink.h"
+#include "gr_sigmf_source.h"
+#include "gr_block_profiler.h"
+#include "gr_rssi_sink.h"
+#include "gr_mode_selector.h"
 #include "rx_fft.h"
 #include "gr_deframer_bb.h"
 #include "gr_demod_2fsk_sdr.h"
@@ -56,17 +58,41 @@
 #include "gr_demod_wbfm_sdr.h"
 #include "gr_demod_freedv.h"
 #include "src/modem_types.h"
+#include "src/radioconfig.h"
 
 class gr_demod_base : public QObject
 {
     Q_OBJECT
 public:
+    /// Block groups which can be given their own CPUs and RT priority
+    enum
+    {
+        SchedFrontEnd,
+        SchedDemod,
+        SchedFec
+    };
+
     explicit gr_demod_base(QObject *parent = 0, float device_frequency=434000000,
                                float rf_gain=50, std::string device_args="rtl=0", std::string device_antenna="RX2",
                                 int freq_corr=0);
     ~gr_demod_base();
 
     void set_bandwidth_specific();
+    /// Pins a block group to cpus and sets the priority of its block threads,
+    /// takes effect when the flowgraph is started. Apply the groups in enum order,
+    /// each group overrides the affinity set by the previous one
+    void set_sched_group(int group, const std::vector<int> &cpus, int priority);
+    /// Performance counters of the busy blocks since the previous call
+    void get_block_stats(std::vector<gr_block_profiler::stats> &stats);
+    /// One auto-tune step for the buffers of the current mode: shrink them,
+    /// or grow them back once and stop after an overflow. Returns true when
+    /// the sizes changed, they apply after the flowgraph is restarted
+    bool tune_buffers(bool overflow);
+    /// Samples the front end delivered since the previous call against the
+    /// sample rate, below 1 the source dropped samples
+    float get_sample_ratio();
+    /// Memory and worst case queueing latency of the current mode buffers
+    void get_buffer_stats(int &bytes, float &latency_msec, float &scale, bool &tuned);
 
 signals:
 
@@ -74,7 +100,7 @@ public slots:
     void start(int buffer_size=0);
     void stop();
     std::vector<unsigned char> *getData();
-    std::vector<unsigned char> *getData(int nr);
+    std::vector<unsigned char> *getFrameData();
     std::vector<float> *getAudio();
     void get_FFT_data(float *fft_data,  unsigned int &fftSize);
     void tune(long long center_freq);
@@ -85,46 +111,86 @@ public slots:
     void set_agc_attack(float value);
     void set_agc_decay(float value);
     void set_ctcss(float value);
+    void get_detected_tone(float &tone, int &dcs_code);
     void enable_gui_const(bool value);
     void enable_gui_fft(bool value);
     void enable_rssi(bool value);
     void enable_demodulator(bool value);
     double get_freq();
-    void set_mode(int mode, bool disconnect=true, bool connect=true);
+    /// Each demodulator chain is wired on first use and then stays in the
+    /// flowgraph behind its own valve, later switches don't lock the flowgraph
+    void set_mode(int mode);
+    /// Applies every changed field of the set with at most one flowgraph lock
+    void apply_config(const RadioConfig &config);
+    /// Duration of the last set_mode() call in microseconds
+    double get_mode_switch_time();
     void set_fft_size(int size);
     float get_rssi();
+    void get_rssi_history(std::vector<float> &history);
     std::vector<gr_complex> *get_constellation_data();
     void set_samp_rate(int samp_rate);
     void set_filter_width(int filter_width, int mode);
     void calibrate_rssi(float value);
     const QMap<std::string,QVector<int>> get_gain_names() const;
+    bool start_iq_recording(std::string base_path, std::string mode_name);
+    void stop_iq_recording();
+    bool is_replay();
+    void set_audio_bridge(gr_audio_bridge_sptr bridge);
 
 private:
+    struct mode_path
+    {
+        gr::blocks::copy::sptr valve;
+        gr::hier_block2_sptr demod;
+        int demod_rate;
+        float buffer_scale; // fraction of the latency target, lowered by tune_buffers()
+        bool buffer_tuned;
+        int rssi_input;
+        int const_input;
+        int data_input;
+        gr_mode_selector_sptr data_select;
+    };
+
+    void wire_mode(int mode);
+    void wire_path(int mode, gr::hier_block2_sptr demod, int demod_rate, bool digital,
+                   gr_mode_selector_sptr data_select, gr::basic_block_sptr data_sink);
+    int attach_selector(gr::basic_block_sptr block, int port,
+                        gr_mode_selector_sptr selector, gr::basic_block_sptr sink);
+    void select_path(int mode);
+    void sched_blocks(const std::vector<gr::block_sptr> &blocks,
+                      const std::vector<int> &cpus, int priority);
+    void size_buffers(int mode);
+    void add_profiled(gr_block_profiler::block_list &list, const std::string &prefix,
+                      const std::vector<gr::block_sptr> &blocks);
+
     gr::top_block_sptr _top_block;
     gr_audio_sink_sptr _audio_sink;
+    gr_audio_bridge_sink_sptr _bridge_sink;
     gr_vector_sink_sptr _vector_sink;
     rx_fft_c_sptr _fft_sink;
     gr::blocks::message_debug::sptr _message_sink;
     gr::blocks::copy::sptr _rssi_valve;
     gr::blocks::copy::sptr _const_valve;
     gr::blocks::copy::sptr _demod_valve;
-    gr::blocks::probe_signal_f::sptr _rssi;
+    gr_rssi_sink_sptr _rssi;
     gr_const_sink_sptr _constellation;
-    gr::blocks::complex_to_mag_squared::sptr _mag_squared;
-    gr::blocks::nlog10_ff::sptr _log10;
-    gr::filter::single_pole_iir_filter_ff::sptr _single_pole_filter;
-    gr::blocks::multiply_const_ff::sptr _multiply_const_ff;
-    gr::blocks::moving_average_ff::sptr _moving_average;
-    gr::blocks::add_const_ff::sptr _add_const;
     gr::blocks::rotator_cc::sptr _rotator;
     gr::filter::rational_resampler_base_ccf::sptr _resampler;
 
-    gr_deframer_bb_sptr _deframer1;
-    gr_deframer_bb_sptr _deframer2;
-    gr_deframer_bb_sptr _deframer_700_1;
-    gr_deframer_bb_sptr _deframer_700_2;
-    gr_deframer_bb_sptr _deframer1_10k;
-    gr_deframer_bb_sptr _deframer2_10k;
+    gr_mode_selector_sptr _rssi_select;
+    gr_mode_selector_sptr _const_select;
+    gr_mode_selector_sptr _audio_select;
+    gr_mode_selector_sptr _vector_select;
+    gr_mode_selector_sptr _frame_select;
+    gr_mode_selector_sptr _frame_700_select;
+    gr_mode_selector_sptr _frame_10k_select;
+    std::vector<gr_mode_selector_sptr> _data_selectors;
+    QMap<int, mode_path> _mode_paths;
+    double _mode_switch_time;
+
+    gr_deframer_bb_sptr _deframer;
+    gr_deframer_bb_sptr _deframer_700;
+    gr_deframer_bb_sptr _deframer_10k;
 
     gr_demod_2fsk_sdr_sptr _2fsk_2k_fm;
     gr_demod_2fsk_sdr_sptr _2fsk_1k_fm;
@@ -156,19 +222,32 @@ private:
     gr_demod_freedv_sptr _freedv_rx800XA_lsb;
 
     osmosdr::source::sptr _osmosdr_source;
+    gr_sigmf_source_sptr _sigmf_source;
+    gr_sigmf_sink_sptr _sigmf_sink;
 
     float _device_frequency;
+    long long _center_freq;
+    int _squelch;
+    float _ctcss;
+    int _fft_size;
     int _freq_correction;
     int _msg_nr;
     int _mode;
     int _carrier_offset;
     bool _demod_running;
     int _samp_rate;
+    int _replay_samp_rate;
+    uint64_t _ratio_items;
+    std::chrono::steady_clock::time_point _ratio_time;
+    double _rx_gain;
     bool _locked;
     bool _lime_specific; // LimeSDR specific
     double _osmo_filter_bw;
     osmosdr::gain_range_t _gain_range;
     std::vector<std::string> _gain_names;
+    std::vector<int> _frontend_cpus;
+    int _frontend_priority;
+    gr_block_profiler _profiler;
 };
 
 #endif // GR_DEMOD_BASE_H
@@ -23,7 +23,6 @@ gr_demod_bpsk_sdr_sptr make_gr_demod_bpsk_sdr(int sps, int samp_rate, int carrie
     signature.push_back(sizeof (gr_complex));
     signature.push_back(sizeof (gr_complex));
     signature.push_back(sizeof (char));
-    signature.push_back(sizeof (char));
     return gnuradio::get_initial_sptr(new gr_demod_bpsk_sdr(signature, sps, samp_rate, carrier_freq,
                                                       filter_width));
 }
@@ -34,7 +33,7 @@ gr_demod_bpsk_sdr::gr_demod_bpsk_sdr(std::vector<int>signature, int sps, int sam
                                  int filter_width) :
     gr::hier_block2 ("gr_demod_bpsk_sdr",
                       gr::io_signature::make (1, 1, sizeof (gr_complex)),
-                      gr::io_signature::makev (4, 4, signature))
+                      gr::io_signature::makev (3, 3, signature))
 {
 
     _target_samp_rate = 20000;
@@ -42,16 +41,13 @@ gr_demod_bpsk_sdr::gr_demod_bpsk_sdr(std::vector<int>signature, int sps, int sam
     _samp_rate =samp_rate;
     _carrier_freq = carrier_freq;
     _filter_width = filter_width;
-
-    std::vector<int> polys;
-    polys.push_back(109);
-    polys.push_back(79);
+    /// frame layout matches the deframer used for this symbol rate
+    int frame_type = (sps >= 10) ? 2 : 1;
 
 
     std::vector<float> taps = gr::filter::firdes::low_pass(1, _samp_rate, _target_samp_rate/2, _target_samp_rate/2,
                                                            gr::filter::firdes::WIN_BLACKMAN_HARRIS);
     _resampler = gr::filter::rational_resampler_base_ccf::make(1, 50, taps);
-    _resampler->set_thread_priority(99);
     _agc = gr::analog::agc2_cc::make(1e-1, 1e-1, 1, 10);
     _filter = gr::filter::fft_filter_ccf::make(1, gr::filter::firdes::low_pass(
                             1, _target_samp_rate, _filter_width,1200,gr::filter::firdes::WIN_BLACKMAN_HARRIS) );
@@ -69,14 +65,9 @@ gr_demod_bpsk_sdr::gr_demod_bpsk_sdr(std::vector<int>signature, int sps, int sam
     _float_to_uchar = gr::blocks::float_to_uchar::make();
     _add_const_fec = gr::blocks::add_const_ff::make(128.0);
 
-    gr::fec::code::cc_decoder::sptr decoder = gr::fec::code::cc_decoder::make(80, 7, 2, polys);
-    gr::fec::code::cc_decoder::sptr decoder2 = gr::fec::code::cc_decoder::make(80, 7, 2, polys);
-    _cc_decoder = gr::fec::decoder::make(decoder, 1, 1);
-    _cc_decoder2 = gr::fec::decoder::make(decoder2, 1, 1);
+    /// bit pairing of the coded stream is found by the decoder itself
+    _viterbi = make_gr_aligned_viterbi_bb(frame_type);
 
-    _descrambler = gr::digital::descrambler_bb::make(0x8A, 0x7F ,7);
-    _delay = gr::blocks::delay::make(1,1);
-    _descrambler2 = gr::digital::descrambler_bb::make(0x8A, 0x7F ,7);
 
 
 
@@ -93,14 +84,28 @@ gr_demod_bpsk_sdr::gr_demod_bpsk_sdr(std::vector<int>signature, int sps, int sam
     connect(_complex_to_real,0,_multiply_const_fec,0);
     connect(_multiply_const_fec,0,_add_const_fec,0);
     connect(_add_const_fec,0,_float_to_uchar,0);
-    connect(_float_to_uchar,0,_cc_decoder,0);
-    connect(_cc_decoder,0,_descrambler,0);
-    connect(_descrambler,0,self(),2);
-    connect(_float_to_uchar,0,_delay,0);
-    connect(_delay,0,_cc_decoder2,0);
-    connect(_cc_decoder2,0,_descrambler2,0);
-    connect(_descrambler2,0,self(),3);
+    connect(_float_to_uchar,0,_viterbi,0);
+    connect(_viterbi,0,self(),2);
 
 }
 
+std::vector<gr::block_sptr> gr_demod_bpsk_sdr::demod_blocks()
+{
+    std::vector<gr::block_sptr> blocks;
+    blocks.push_back(_resampler);
+    blocks.push_back(_fll);
+    blocks.push_back(_clock_recovery);
+    return blocks;
+}
 
+std::vector<gr::block_sptr> gr_demod_bpsk_sdr::fec_blocks()
+{
+    std::vector<gr::block_sptr> blocks;
+    blocks.push_back(_viterbi);
+    return blocks;
+}
+
+int gr_demod_bpsk_sdr::get_target_samp_rate()
+{
+    return _target_samp_rate;
+}
@@ -31,13 +31,10 @@
 #include <gnuradio/digital/fll_band_edge_cc.h>
 #include <gnuradio/filter/rational_resampler_base_ccf.h>
 #include <gnuradio/filter/fft_filter_ccf.h>
-#include <gnuradio/digital/descrambler_bb.h>
 #include <gnuradio/blocks/add_const_ff.h>
-#include <gnuradio/fec/decoder.h>
-#include <gnuradio/fec/cc_decoder.h>
-#include <gnuradio/blocks/delay.h>
 #include <gnuradio/blocks/multiply_const_ff.h>
 #include <gnuradio/blocks/float_to_uchar.h>
+#include "gr_aligned_viterbi_bb.h"
 
 
 class gr_demod_bpsk_sdr;
@@ -51,6 +48,12 @@ class gr_demod_bpsk_sdr : public gr::hier_block2
 public:
     explicit gr_demod_bpsk_sdr(std::vector<int> signature, int sps=4, int samp_rate=8000, int carrier_freq=1600,
                                int filter_width=1800);
+    /// Sample rate after the first decimation, where most blocks run
+    int get_target_samp_rate();
+
+    /// Blocks belonging to the "demod" and "fec" scheduling groups
+    std::vector<gr::block_sptr> demod_blocks();
+    std::vector<gr::block_sptr> fec_blocks();
 
 private:
 
@@ -62,16 +65,12 @@ private:
     gr::digital::clock_recovery_mm_cc::sptr _clock_recovery;
     gr::digital::costas_loop_cc::sptr _costas_loop;
     gr::blocks::float_to_uchar::sptr _float_to_uchar;
+    gr_aligned_viterbi_bb_sptr _viterbi;
     gr::blocks::add_const_ff::sptr _add_const_fec;
 
     gr::filter::rational_resampler_base_ccf::sptr _resampler;
     gr::filter::fft_filter_ccf::sptr _filter;
-    gr::digital::descrambler_bb::sptr _descrambler;
-    gr::digital::descrambler_bb::sptr _descrambler2;
-    gr::blocks::delay::sptr _delay;
     gr::blocks::multiply_const_ff::sptr _multiply_const_fec;
-    gr::fec::decoder::sptr _cc_decoder;
-    gr::fec::decoder::sptr _cc_decoder2;
 
 
 
@@ -88,3 +88,8 @@ void gr_demod_freedv::set_squelch(int value)
 {
     _freedv->set_squelch_thresh((float)value);
 }
+
+int gr_demod_freedv::get_target_samp_rate()
+{
+    return _target_samp_rate;
+}
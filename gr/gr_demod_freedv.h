@@ -45,6 +45,8 @@ class gr_demod_freedv : public gr::hier_block2
 public:
     explicit gr_demod_freedv(std::vector<int> signature, int sps=125, int samp_rate=8000, int carrier_freq=1600,
                                int filter_width=2000, int low_cutoff=200, int mode=gr::vocoder::freedv_api::MODE_1600, int sb=0);
+    /// Sample rate after the first decimation, where most blocks run
+    int get_target_samp_rate();
 
     void set_squelch(int value);
 
@@ -58,7 +58,7 @@ gr_demod_nbfm_sdr::gr_demod_nbfm_sdr(std::vector<int>signature, int sps, int sam
 
     _fm_demod = gr::analog::quadrature_demod_cf::make(_target_samp_rate/(4*M_PI* _filter_width));
     _squelch = gr::analog::pwr_squelch_cc::make(-140,0.01,0,true);
-    _ctcss = gr::analog::ctcss_squelch_ff::make(8000,88.5,0.02,4000,0,true);
+    _ctcss = make_gr_tone_detector_ff(8000);
     _amplify = gr::blocks::multiply_const_ff::make(0.99);
     _float_to_short = gr::blocks::float_to_short::make();
 
@@ -71,7 +71,8 @@ gr_demod_nbfm_sdr::gr_demod_nbfm_sdr(std::vector<int>signature, int sps, int sam
     connect(_squelch,0,_fm_demod,0);
     connect(_fm_demod,0,_audio_resampler,0);
     connect(_audio_resampler,0,_deemphasis_filter,0);
-    connect(_deemphasis_filter,0,_amplify,0);
+    connect(_deemphasis_filter,0,_ctcss,0);
+    connect(_ctcss,0,_amplify,0);
     connect(_amplify,0,self(),1);
 
 }
@@ -94,29 +95,20 @@ void gr_demod_nbfm_sdr::set_squelch(int value)
 
 void gr_demod_nbfm_sdr::set_ctcss(float value)
 {
-    if(value == 0)
-    {
-        try {
-            disconnect(_deemphasis_filter,0,_ctcss,0);
-            disconnect(_ctcss,0,_amplify,0);
-            connect(_deemphasis_filter,0,_amplify,0);
-        }
-        catch(std::invalid_argument &e)
-        {
-
-        }
-    }
-    else
-    {
-        _ctcss->set_frequency(value);
-        try {
-            disconnect(_deemphasis_filter,0,_amplify,0);
-            connect(_deemphasis_filter,0,_ctcss,0);
-            connect(_ctcss,0,_amplify,0);
-        }
-        catch(std::invalid_argument &e)
-        {
-
-        }
-    }
+    _ctcss->set_required_tone(value);
+}
+
+float gr_demod_nbfm_sdr::get_ctcss_tone()
+{
+    return _ctcss->get_tone();
+}
+
+int gr_demod_nbfm_sdr::get_dcs_code()
+{
+    return _ctcss->get_dcs_code();
+}
+
+int gr_demod_nbfm_sdr::get_target_samp_rate()
+{
+    return _target_samp_rate;
 }
@@ -24,11 +24,11 @@
 #include <gnuradio/filter/rational_resampler_base_fff.h>
 #include <gnuradio/analog/quadrature_demod_cf.h>
 #include <gnuradio/analog/pwr_squelch_cc.h>
-#include <gnuradio/analog/ctcss_squelch_ff.h>
 #include <gnuradio/filter/fft_filter_ccf.h>
 #include <gnuradio/filter/fft_filter_fff.h>
 #include <gnuradio/blocks/float_to_short.h>
 #include <gnuradio/blocks/multiply_const_ff.h>
+#include "gr_tone_detector_ff.h"
 
 
 class gr_demod_nbfm_sdr;
@@ -42,9 +42,13 @@ class gr_demod_nbfm_sdr : public gr::hier_block2
 public:
     explicit gr_demod_nbfm_sdr(std::vector<int> signature, int sps=4, int samp_rate=8000, int carrier_freq=1600,
                                int filter_width=1800);
+    /// Sample rate after the first decimation, where most blocks run
+    int get_target_samp_rate();
 
     void set_squelch(int value);
     void set_ctcss(float value);
+    float get_ctcss_tone();
+    int get_dcs_code();
     void set_filter_width(int filter_width);
 
 
@@ -54,7 +58,7 @@ private:
     gr::analog::quadrature_demod_cf::sptr _fm_demod;
     gr::analog::pwr_squelch_cc::sptr _squelch;
     gr::blocks::multiply_const_ff::sptr _amplify;
-    gr::analog::ctcss_squelch_ff::sptr _ctcss;
+    gr_tone_detector_ff_sptr _ctcss;
     gr::filter::rational_resampler_base_ccf::sptr _resampler;
     gr::filter::rational_resampler_base_fff::sptr _audio_resampler;
     gr::filter::fft_filter_ccf::sptr _filter;
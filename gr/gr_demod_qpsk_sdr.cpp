@@ -73,9 +73,6 @@ gr_demod_qpsk_sdr::gr_demod_qpsk_sdr(std::vector<int>signature, int sps, int sam
     map.push_back(3);
     map.push_back(2);
 
-    std::vector<int> polys;
-    polys.push_back(109);
-    polys.push_back(79);
 
 
     unsigned int flt_size = 32;
@@ -88,7 +85,6 @@ gr_demod_qpsk_sdr::gr_demod_qpsk_sdr(std::vector<int>signature, int sps, int sam
                             _target_samp_rate/2, gr::filter::firdes::WIN_BLACKMAN_HARRIS);
 
     _resampler = gr::filter::rational_resampler_base_ccf::make(interpolation, decimation, taps);
-    _resampler->set_thread_priority(99);
     _agc = gr::analog::agc2_cc::make(1e-1, 1e-1, 1, 10);
     _filter = gr::filter::fft_filter_ccf::make(1, gr::filter::firdes::low_pass(
             1, _target_samp_rate, _filter_width, filter_slope,gr::filter::firdes::WIN_BLACKMAN_HARRIS) );
@@ -138,8 +134,7 @@ gr_demod_qpsk_sdr::gr_demod_qpsk_sdr(std::vector<int>signature, int sps, int sam
     _multiply_const_fec = gr::blocks::multiply_const_ff::make(48);
     _float_to_uchar = gr::blocks::float_to_uchar::make();
     _add_const_fec = gr::blocks::add_const_ff::make(128.0);
-    gr::fec::code::cc_decoder::sptr decoder = gr::fec::code::cc_decoder::make(80, 7, 2, polys);
-    _decode_ccsds = gr::fec::decoder::make(decoder, 1, 1);
+    _decode_ccsds = make_gr_viterbi_k7_bb();
     _descrambler = gr::digital::descrambler_bb::make(0x8A, 0x7F ,7);
 
 
@@ -165,3 +160,24 @@ gr_demod_qpsk_sdr::gr_demod_qpsk_sdr(std::vector<int>signature, int sps, int sam
     connect(_descrambler,0,self(),2);
 
 }
+
+std::vector<gr::block_sptr> gr_demod_qpsk_sdr::demod_blocks()
+{
+    std::vector<gr::block_sptr> blocks;
+    blocks.push_back(_resampler);
+    blocks.push_back(_fll);
+    blocks.push_back(_clock_recovery);
+    return blocks;
+}
+
+std::vector<gr::block_sptr> gr_demod_qpsk_sdr::fec_blocks()
+{
+    std::vector<gr::block_sptr> blocks;
+    blocks.push_back(_decode_ccsds);
+    return blocks;
+}
+
+int gr_demod_qpsk_sdr::get_target_samp_rate()
+{
+    return _target_samp_rate;
+}
@@ -27,8 +27,7 @@
 #include <gnuradio/blocks/multiply_const_ff.h>
 #include <gnuradio/digital/diff_phasor_cc.h>
 #include <gnuradio/blocks/interleave.h>
-#include <gnuradio/fec/decoder.h>
-#include <gnuradio/fec/cc_decoder.h>
+#include "gr_viterbi_k7_bb.h"
 #include <gnuradio/digital/costas_loop_cc.h>
 #include <gnuradio/digital/cma_equalizer_cc.h>
 #include <gnuradio/analog/agc2_cc.h>
@@ -54,7 +53,12 @@ class gr_demod_qpsk_sdr : public gr::hier_block2
 public:
     explicit gr_demod_qpsk_sdr(std::vector<int> signature, int sps=4, int samp_rate=8000, int carrier_freq=1600,
                                int filter_width=1800);
+    /// Sample rate after the first decimation, where most blocks run
+    int get_target_samp_rate();
 
+    /// Blocks belonging to the "demod" and "fec" scheduling groups
+    std::vector<gr::block_sptr> demod_blocks();
+    std::vector<gr::block_sptr> fec_blocks();
 
 private:
     gr::digital::cma_equalizer_cc::sptr _equalizer;
@@ -67,7 +71,7 @@ private:
     gr::filter::fft_filter_ccf::sptr _shaping_filter;
     gr::filter::fft_filter_ccf::sptr _filter;
     gr::digital::descrambler_bb::sptr _descrambler;
-    gr::fec::decoder::sptr _decode_ccsds;
+    gr_viterbi_k7_bb_sptr _decode_ccsds;
     gr::digital::diff_phasor_cc::sptr _diff_phasor;
     gr::blocks::multiply_const_cc::sptr _rotate_const;
     gr::blocks::multiply_const_ff::sptr _multiply_const_fec;
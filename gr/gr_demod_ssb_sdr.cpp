@@ -116,3 +116,8 @@ void gr_demod_ssb_sdr::set_gain(float value)
 {
     _if_gain->set_k(value);
 }
+
+int gr_demod_ssb_sdr::get_target_samp_rate()
+{
+    return _target_samp_rate;
+}
@@ -40,6 +40,8 @@ class gr_demod_wbfm_sdr : public gr::hier_block2
 public:
     explicit gr_demod_wbfm_sdr(std::vector<int> signature, int sps=4, int samp_rate=8000, int carrier_freq=1600,
                                int filter_width=1800);
+    /// Sample rate after the first decimation, where most blocks run
+    int get_target_samp_rate();
 
 
     void set_squelch(int value);
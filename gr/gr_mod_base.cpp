@@ -15,6 +15,46 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "gr_mod_base.h"
+#include <gnuradio/buffer.h>
+#include <chrono>
+#include <cmath>
+
+/// Same per edge latency targets as the receiver
+static const float VOICE_EDGE_LATENCY_MSEC = 4.0f;
+static const float DATA_EDGE_LATENCY_MSEC = 20.0f;
+static const int AUDIO_RATE = 8000;
+static const int DEVICE_RATE = 1000000;
+static const float MIN_BUFFER_SCALE = 0.125f;
+
+static int edge_items(int rate, float latency_msec)
+{
+    return std::max(1, (int)(rate * latency_msec / 1000.0f));
+}
+
+/// GNU Radio rounds a max buffer down to the output multiple of the block
+/// and refuses to start below one, so leave room for two
+static void pin_buffer(gr::block_sptr block, int items)
+{
+    items = std::max(items, 2 * block->output_multiple());
+    block->set_min_output_buffer(items);
+    block->set_max_output_buffer(items);
+}
+
+/// the multiples of the blocks inside a hier block are not visible from
+/// here, so it only gets a lower bound its inner blocks inherit
+static void size_hier(gr::hier_block2_sptr hier, int items)
+{
+    hier->set_min_output_buffer(items);
+}
+
+static void add_buffer(gr::block_sptr block, int rate, int &bytes, float &latency_msec)
+{
+    if(!block->detail() || (block->detail()->noutputs() < 1))
+        return;
+    gr::buffer_sptr buffer = block->detail()->output(0);
+    bytes += buffer->bufsize() * buffer->get_sizeof_item();
+    latency_msec += 1000.0f * buffer->bufsize() / rate;
+}
 
 gr_mod_base::gr_mod_base(QObject *parent, float device_frequency, float rf_gain,
                            std::string device_args, std::string device_antenna, int freq_corr) :
@@ -24,10 +64,18 @@ gr_mod_base::gr_mod_base(QObject *parent, float device_frequency, float rf_gain,
     _top_block = gr::make_top_block("modulator");
     _freq_correction = freq_corr;
     _mode = 9999;
+    _center_freq = -1;
+    _ctcss = -1;
+    _locked = false;
     _vector_source = make_gr_vector_source();
     _audio_source = make_gr_audio_source();
+    _bridge_source = make_gr_audio_bridge_source(8000);
+    _audio_input_select = make_gr_mode_selector(sizeof(float));
+    _audio_input_wired = false;
 
     _carrier_offset = 0;
+    _ratio_items = 0;
+    _ratio_time = std::chrono::steady_clock::now();
 
     _rotator = gr::blocks::rotator_cc::make(2*M_PI*_carrier_offset/1000000);
     _osmosdr_sink = osmosdr::sink::make(device_args);
@@ -54,6 +102,8 @@ gr_mod_base::gr_mod_base(QObject *parent, float device_frequency, float rf_gain,
     }
 
     _signal_source = gr::analog::sig_source_f::make(8000, gr::analog::GR_SIN_WAVE, 600, 0.001, 1);
+    _tx_select = make_gr_mode_selector(sizeof(gr_complex));
+    _mode_switch_time = 0;
 
     _2fsk_2k_fm = make_gr_mod_2fsk_sdr(25, 1000000, 1700, 2700, true); // 4000 for non FM, 2700 for FM
     _2fsk_1k_fm = make_gr_mod_2fsk_sdr(50, 1000000, 1700, 1350, true);
@@ -122,419 +172,216 @@ const QMap<std::string,QVector<int>> gr_mod_base::get_gain_names() const
 
 void gr_mod_base::set_mode(int mode)
 {
-    _top_block->lock();
+    std::chrono::steady_clock::time_point switch_start = std::chrono::steady_clock::now();
+    if(!_mode_paths.contains(mode))
+    {
+        /// first use of this mode, the only time the flowgraph gets locked for it
+        if(!_locked)
+            _top_block->lock();
+        wire_mode(mode);
+        if(!_locked)
+            _top_block->unlock();
+    }
     _audio_source->flush();
     _vector_source->flush();
+    select_path(mode);
 
-    switch(_mode)
+    if(_mode_paths.contains(mode))
     {
-    case gr_modem_types::ModemType2FSK2000FM:
-        _top_block->disconnect(_vector_source,0,_2fsk_2k_fm,0);
-        _top_block->disconnect(_2fsk_2k_fm,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemType2FSK1000FM:
-        _top_block->disconnect(_vector_source,0,_2fsk_1k_fm,0);
-        _top_block->disconnect(_2fsk_1k_fm,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemType2FSK2000:
-        _top_block->disconnect(_vector_source,0,_2fsk_2k,0);
-        _top_block->disconnect(_2fsk_2k,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemType2FSK1000:
-        _top_block->disconnect(_vector_source,0,_2fsk_1k,0);
-        _top_block->disconnect(_2fsk_1k,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemType2FSK20000:
-        _top_block->disconnect(_vector_source,0,_2fsk_10k,0);
-        _top_block->disconnect(_2fsk_10k,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemType4FSK2000:
-        _top_block->disconnect(_vector_source,0,_4fsk_2k,0);
-        _top_block->disconnect(_4fsk_2k,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemType4FSK20000:
-        _top_block->disconnect(_vector_source,0,_4fsk_10k,0);
-        _top_block->disconnect(_4fsk_10k,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemType4FSK2000FM:
-        _top_block->disconnect(_vector_source,0,_4fsk_2k_fm,0);
-        _top_block->disconnect(_4fsk_2k_fm,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemType4FSK1000FM:
-        _top_block->disconnect(_vector_source,0,_4fsk_1k_fm,0);
-        _top_block->disconnect(_4fsk_1k_fm,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemType4FSK20000FM:
-        _top_block->disconnect(_vector_source,0,_4fsk_10k_fm,0);
-        _top_block->disconnect(_4fsk_10k_fm,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeAM5000:
-        _top_block->disconnect(_audio_source,0,_am,0);
-        _top_block->disconnect(_am,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeBPSK1000:
-        _top_block->disconnect(_vector_source,0,_bpsk_1k,0);
-        _top_block->disconnect(_bpsk_1k,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeBPSK2000:
-        _top_block->disconnect(_vector_source,0,_bpsk_2k,0);
-        _top_block->disconnect(_bpsk_2k,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeNBFM2500:
-        _top_block->disconnect(_audio_source,0,_fm_2500,0);
-        _top_block->disconnect(_fm_2500,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeNBFM5000:
-        _top_block->disconnect(_audio_source,0,_fm_5000,0);
-        _top_block->disconnect(_fm_5000,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeQPSK2000:
-        _top_block->disconnect(_vector_source,0,_qpsk_2k,0);
-        _top_block->disconnect(_qpsk_2k,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeQPSK20000:
-        _top_block->disconnect(_vector_source,0,_qpsk_10k,0);
-        _top_block->disconnect(_qpsk_10k,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeQPSK250000:
-        _carrier_offset = 0;
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _top_block->disconnect(_vector_source,0,_qpsk_250k,0);
-        _top_block->disconnect(_qpsk_250k,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeQPSKVideo:
-        _top_block->disconnect(_vector_source,0,_qpsk_video,0);
-        _top_block->disconnect(_qpsk_video,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeUSB2500:
-        _top_block->disconnect(_audio_source,0,_usb,0);
-        _top_block->disconnect(_usb,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeLSB2500:
-        _top_block->disconnect(_audio_source,0,_lsb,0);
-        _top_block->disconnect(_lsb,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeCW600USB:
-        _top_block->disconnect(_signal_source,0,_usb_cw,0);
-        _top_block->disconnect(_usb_cw,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeFREEDV1600USB:
-        _top_block->disconnect(_audio_source,0,_freedv_tx1600_usb,0);
-        _top_block->disconnect(_freedv_tx1600_usb,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeFREEDV700DUSB:
-        _top_block->disconnect(_audio_source,0,_freedv_tx700C_usb,0);
-        _top_block->disconnect(_freedv_tx700C_usb,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeFREEDV800XAUSB:
-        _top_block->disconnect(_audio_source,0,_freedv_tx800XA_usb,0);
-        _top_block->disconnect(_freedv_tx800XA_usb,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeFREEDV1600LSB:
-        _top_block->disconnect(_audio_source,0,_freedv_tx1600_lsb,0);
-        _top_block->disconnect(_freedv_tx1600_lsb,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeFREEDV700DLSB:
-        _top_block->disconnect(_audio_source,0,_freedv_tx700C_lsb,0);
-        _top_block->disconnect(_freedv_tx700C_lsb,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    case gr_modem_types::ModemTypeFREEDV800XALSB:
-        _top_block->disconnect(_audio_source,0,_freedv_tx800XA_lsb,0);
-        _top_block->disconnect(_freedv_tx800XA_lsb,0,_rotator,0);
-        _top_block->disconnect(_rotator,0,_osmosdr_sink,0);
-        break;
-    default:
-        break;
+        int carrier_offset = 50000;
+        if((mode == gr_modem_types::ModemTypeQPSK250000) ||
+                (mode == gr_modem_types::ModemTypeQPSKVideo))
+            carrier_offset = 250000;
+        if(carrier_offset != _carrier_offset)
+        {
+            _carrier_offset = carrier_offset;
+            _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
+            _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
+        }
+    }
+
+    _mode = mode;
+    size_buffers(mode);
+    std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - switch_start;
+    _mode_switch_time = elapsed.count();
+}
+
+void gr_mod_base::apply_config(const RadioConfig &config)
+{
+    bool mode_change = config.has(RadioConfig::TxMode) && (config.tx_mode != _mode);
+    bool ctcss_change = config.has(RadioConfig::TxCTCSS) &&
+            (std::abs(config.tx_ctcss - _ctcss) > 0.001f);
+    bool needs_lock = ctcss_change || (mode_change && !_mode_paths.contains(config.tx_mode));
+    if(needs_lock)
+    {
+        _top_block->lock();
+        _locked = true;
     }
+    if(config.has(RadioConfig::TxFrequency) && (config.tx_frequency != _center_freq))
+        tune(config.tx_frequency);
+    if(mode_change)
+        set_mode(config.tx_mode);
+    if(ctcss_change)
+        set_ctcss(config.tx_ctcss);
+    if(needs_lock)
+    {
+        _top_block->unlock();
+        _locked = false;
+    }
+}
+
+double gr_mod_base::get_mode_switch_time()
+{
+    return _mode_switch_time;
+}
 
+void gr_mod_base::wire_mode(int mode)
+{
     switch(mode)
     {
     case gr_modem_types::ModemType2FSK2000FM:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_2fsk_2k_fm,0);
-        _top_block->connect(_2fsk_2k_fm,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _2fsk_2k_fm);
         break;
     case gr_modem_types::ModemType2FSK1000FM:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_2fsk_1k_fm,0);
-        _top_block->connect(_2fsk_1k_fm,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _2fsk_1k_fm);
         break;
     case gr_modem_types::ModemType2FSK2000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_2fsk_2k,0);
-        _top_block->connect(_2fsk_2k,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _2fsk_2k);
         break;
     case gr_modem_types::ModemType2FSK1000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_2fsk_1k,0);
-        _top_block->connect(_2fsk_1k,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _2fsk_1k);
         break;
     case gr_modem_types::ModemType2FSK20000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_2fsk_10k,0);
-        _top_block->connect(_2fsk_10k,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _2fsk_10k);
         break;
     case gr_modem_types::ModemType4FSK2000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_4fsk_2k,0);
-        _top_block->connect(_4fsk_2k,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _4fsk_2k);
         break;
     case gr_modem_types::ModemType4FSK20000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_4fsk_10k,0);
-        _top_block->connect(_4fsk_10k,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _4fsk_10k);
         break;
     case gr_modem_types::ModemType4FSK2000FM:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_4fsk_2k_fm,0);
-        _top_block->connect(_4fsk_2k_fm,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _4fsk_2k_fm);
         break;
     case gr_modem_types::ModemType4FSK1000FM:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_4fsk_1k_fm,0);
-        _top_block->connect(_4fsk_1k_fm,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _4fsk_1k_fm);
         break;
     case gr_modem_types::ModemType4FSK20000FM:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_4fsk_10k_fm,0);
-        _top_block->connect(_4fsk_10k_fm,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _4fsk_10k_fm);
         break;
     case gr_modem_types::ModemTypeAM5000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_am,0);
-        _top_block->connect(_am,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _am);
         break;
     case gr_modem_types::ModemTypeBPSK1000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_bpsk_1k,0);
-        _top_block->connect(_bpsk_1k,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _bpsk_1k);
         break;
     case gr_modem_types::ModemTypeBPSK2000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_bpsk_2k,0);
-        _top_block->connect(_bpsk_2k,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _bpsk_2k);
         break;
     case gr_modem_types::ModemTypeNBFM2500:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_fm_2500,0);
-        _top_block->connect(_fm_2500,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _fm_2500);
         break;
     case gr_modem_types::ModemTypeNBFM5000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_fm_5000,0);
-        _top_block->connect(_fm_5000,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _fm_5000);
         break;
     case gr_modem_types::ModemTypeQPSK2000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_qpsk_2k,0);
-        _top_block->connect(_qpsk_2k,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _qpsk_2k);
         break;
     case gr_modem_types::ModemTypeQPSK20000:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_qpsk_10k,0);
-        _top_block->connect(_qpsk_10k,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _qpsk_10k);
         break;
     case gr_modem_types::ModemTypeQPSK250000:
-        _carrier_offset = 250000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_qpsk_250k,0);
-        _top_block->connect(_qpsk_250k,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _qpsk_250k);
         break;
     case gr_modem_types::ModemTypeQPSKVideo:
-        _carrier_offset = 250000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_vector_source,0,_qpsk_video,0);
-        _top_block->connect(_qpsk_video,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _vector_source, sizeof(char), _qpsk_video);
         break;
     case gr_modem_types::ModemTypeUSB2500:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_usb,0);
-        _top_block->connect(_usb,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _usb);
         break;
     case gr_modem_types::ModemTypeLSB2500:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_lsb,0);
-        _top_block->connect(_lsb,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _lsb);
         break;
     case gr_modem_types::ModemTypeCW600USB:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_signal_source,0,_usb_cw,0);
-        _top_block->connect(_usb_cw,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _signal_source, sizeof(float), _usb_cw);
         break;
     case gr_modem_types::ModemTypeFREEDV1600USB:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_freedv_tx1600_usb,0);
-        _top_block->connect(_freedv_tx1600_usb,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _freedv_tx1600_usb);
         break;
     case gr_modem_types::ModemTypeFREEDV700DUSB:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_freedv_tx700C_usb,0);
-        _top_block->connect(_freedv_tx700C_usb,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _freedv_tx700C_usb);
         break;
     case gr_modem_types::ModemTypeFREEDV800XAUSB:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_freedv_tx800XA_usb,0);
-        _top_block->connect(_freedv_tx800XA_usb,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _freedv_tx800XA_usb);
         break;
     case gr_modem_types::ModemTypeFREEDV1600LSB:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_freedv_tx1600_lsb,0);
-        _top_block->connect(_freedv_tx1600_lsb,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _freedv_tx1600_lsb);
         break;
     case gr_modem_types::ModemTypeFREEDV700DLSB:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_freedv_tx700C_lsb,0);
-        _top_block->connect(_freedv_tx700C_lsb,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _freedv_tx700C_lsb);
         break;
     case gr_modem_types::ModemTypeFREEDV800XALSB:
-        _carrier_offset = 50000;
-        _rotator->set_phase_inc(2*M_PI*_carrier_offset/1000000);
-        _osmosdr_sink->set_center_freq(_device_frequency - _carrier_offset);
-        _osmosdr_sink->set_sample_rate(1000000);
-        _top_block->connect(_audio_source,0,_freedv_tx800XA_lsb,0);
-        _top_block->connect(_freedv_tx800XA_lsb,0,_rotator,0);
-        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+        wire_path(mode, _audio_source, sizeof(float), _freedv_tx800XA_lsb);
         break;
     default:
         break;
     }
+}
 
-    _mode = mode;
+void gr_mod_base::wire_path(int mode, gr::basic_block_sptr source, size_t itemsize,
+                            gr::hier_block2_sptr mod)
+{
+    /// analog modulators take audio either from the local audio source or
+    /// from the repeater bridge, chosen without touching the flowgraph
+    if(source == _audio_source)
+    {
+        if(!_audio_input_wired)
+        {
+            _top_block->connect(_audio_source,0,_audio_input_select,_audio_input_select->add_input());
+            _top_block->connect(_bridge_source,0,_audio_input_select,_audio_input_select->add_input());
+            _audio_input_select->set_input(0);
+            _audio_input_wired = true;
+        }
+        source = _audio_input_select;
+    }
+    mode_path path;
+    path.mod = mod;
+    /// data modulators interpolate early, only audio chains run at 8 kHz
+    path.mod_rate = (itemsize == sizeof(float)) ? AUDIO_RATE : DEVICE_RATE;
+    path.buffer_scale = 1.0f;
+    path.buffer_tuned = false;
+    path.valve = gr::blocks::copy::make(itemsize);
+    path.valve->set_enabled(false);
+    _top_block->connect(source,0,path.valve,0);
+    _top_block->connect(path.valve,0,mod,0);
+    path.input = _tx_select->add_input();
+    if(path.input == 0)
+    {
+        _top_block->connect(_tx_select,0,_rotator,0);
+        _top_block->connect(_rotator,0,_osmosdr_sink,0);
+    }
+    _top_block->connect(mod,0,_tx_select,path.input);
+    _mode_paths[mode] = path;
+    size_buffers(mode);
+}
 
-    _top_block->unlock();
+void gr_mod_base::select_path(int mode)
+{
+    /// close the old chain before opening the new one so the streams never mix
+    QMap<int, mode_path>::iterator it;
+    for(it = _mode_paths.begin(); it != _mode_paths.end(); ++it)
+    {
+        if(it.key() != mode)
+            it.value().valve->set_enabled(false);
+    }
+    if(!_mode_paths.contains(mode))
+    {
+        _tx_select->set_input(-1);
+        return;
+    }
+    _tx_select->set_input(_mode_paths[mode].input);
+    _mode_paths[mode].valve->set_enabled(true);
 }
 
 void gr_mod_base::start(int buffer_size)
@@ -545,6 +392,8 @@ void gr_mod_base::start(int buffer_size)
         _top_block->start(buffer_size);
     else // automatic
         _top_block->start();
+    _ratio_items = 0;
+    _ratio_time = std::chrono::steady_clock::now();
 }
 
 void gr_mod_base::stop()
@@ -560,14 +409,36 @@ int gr_mod_base::set_data(std::vector<u_int8_t> *data)
     return _vector_source->set_data(data);
 }
 
+void gr_mod_base::append_data(const unsigned char *data, unsigned int size)
+{
+    _vector_source->append_data(data, size);
+}
+
+unsigned int gr_mod_base::get_queued_data()
+{
+    return _vector_source->get_queued();
+}
+
 int gr_mod_base::set_audio(std::vector<float> *data)
 {
     return _audio_source->set_data(data);
 
 }
 
+void gr_mod_base::set_audio_bridge(gr_audio_bridge_sptr bridge)
+{
+    _bridge_source->set_bridge(bridge);
+}
+
+void gr_mod_base::enable_audio_bridge(bool value)
+{
+    _audio_input_select->set_input(value ? 1 : 0);
+    _audio_source->flush();
+}
+
 void gr_mod_base::tune(long long center_freq)
 {
+    _center_freq = center_freq;
     long long steps = center_freq / 1000000;
     _device_frequency = double(center_freq) + double(steps * _freq_correction);
     double tx_freq = _device_frequency - _carrier_offset;
@@ -593,10 +464,25 @@ void gr_mod_base::set_power(float value, std::string gain_stage)
 
 void gr_mod_base::set_ctcss(float value)
 {
-    _top_block->lock();
+    /// called on every mode change, don't stop the flowgraph for nothing
+    if(std::abs(value - _ctcss) < 0.001f)
+        return;
+    /// a repeater passes on a different access tone on each key-up, going from
+    /// one tone to another only retunes the tone source
+    if((value > 0) && (_ctcss > 0))
+    {
+        _fm_2500->set_ctcss_frequency(value);
+        _fm_5000->set_ctcss_frequency(value);
+        _ctcss = value;
+        return;
+    }
+    if(!_locked)
+        _top_block->lock();
     _fm_2500->set_ctcss(value);
     _fm_5000->set_ctcss(value);
-    _top_block->unlock();
+    _ctcss = value;
+    if(!_locked)
+        _top_block->unlock();
 }
 
 void gr_mod_base::set_filter_width(int filter_width, int mode)
@@ -697,4 +583,137 @@ void gr_mod_base::set_bandwidth_specific()
     _osmosdr_sink->set_bandwidth(_osmo_filter_bw);
 }
 
+void gr_mod_base::set_sched_group(const std::vector<int> &cpus, int priority)
+{
+    if(!cpus.empty())
+    {
+        std::vector<gr::hier_block2_sptr> mods = {_2fsk_2k_fm, _2fsk_1k_fm, _2fsk_2k,
+                _2fsk_1k, _2fsk_10k, _4fsk_2k, _4fsk_10k, _4fsk_2k_fm, _4fsk_1k_fm,
+                _4fsk_10k_fm, _am, _bpsk_1k, _bpsk_2k, _fm_2500, _fm_5000, _qpsk_2k, _qpsk_10k,
+                _qpsk_250k, _qpsk_video, _usb, _lsb, _usb_cw, _freedv_tx1600_usb,
+                _freedv_tx700C_usb, _freedv_tx1600_lsb, _freedv_tx700C_lsb,
+                _freedv_tx800XA_usb, _freedv_tx800XA_lsb};
+        for(unsigned int i=0;i<mods.size();i++)
+            mods.at(i)->set_processor_affinity(cpus);
+        _osmosdr_sink->set_processor_affinity(cpus);
+        _rotator->set_processor_affinity(cpus);
+    }
+    if(priority > 0)
+    {
+        /// block threads keep the policy of the thread starting the flowgraph
+        std::vector<gr::block_sptr> blocks = _bpsk_1k->mod_blocks();
+        std::vector<gr::block_sptr> bpsk_2k = _bpsk_2k->mod_blocks();
+        blocks.insert(blocks.end(), bpsk_2k.begin(), bpsk_2k.end());
+        blocks.push_back(_rotator);
+        for(unsigned int i=0;i<blocks.size();i++)
+            blocks.at(i)->set_thread_priority(priority);
+    }
+}
+
+void gr_mod_base::get_block_stats(std::vector<gr_block_profiler::stats> &stats)
+{
+    gr_block_profiler::block_list list;
+    list.push_back(std::make_pair("vector_source", _vector_source));
+    list.push_back(std::make_pair("audio_source", _audio_source));
+    list.push_back(std::make_pair("bridge_source", _bridge_source));
+    list.push_back(std::make_pair("rotator", _rotator));
+    std::vector<gr::block_sptr> bpsk_1k = _bpsk_1k->mod_blocks();
+    for(unsigned int i=0;i<bpsk_1k.size();i++)
+        list.push_back(std::make_pair("bpsk_1k/" + bpsk_1k.at(i)->name(), bpsk_1k.at(i)));
+    std::vector<gr::block_sptr> bpsk_2k = _bpsk_2k->mod_blocks();
+    for(unsigned int i=0;i<bpsk_2k.size();i++)
+        list.push_back(std::make_pair("bpsk_2k/" + bpsk_2k.at(i)->name(), bpsk_2k.at(i)));
+    _profiler.sample(list, stats);
+}
+
+void gr_mod_base::size_buffers(int mode)
+{
+    if(!_mode_paths.contains(mode))
+        return;
+    const mode_path &path = _mode_paths[mode];
+    float latency = ((mode == gr_modem_types::ModemTypeQPSK250000) ||
+                     (mode == gr_modem_types::ModemTypeQPSKVideo)) ?
+                DATA_EDGE_LATENCY_MSEC : VOICE_EDGE_LATENCY_MSEC;
+    latency *= path.buffer_scale;
+    int audio_items = edge_items(AUDIO_RATE, latency);
+    int device_items = edge_items(DEVICE_RATE, latency);
+    if(path.mod_rate == AUDIO_RATE)
+    {
+        /// vector source bursts are small, only the audio edges are worth sizing
+        pin_buffer(_audio_source, audio_items);
+        pin_buffer(_bridge_source, audio_items);
+        pin_buffer(_audio_input_select, audio_items);
+        pin_buffer(_signal_source, audio_items);
+        pin_buffer(path.valve, audio_items);
+    }
+    size_hier(path.mod, edge_items(path.mod_rate, latency));
+    pin_buffer(_tx_select, device_items);
+    pin_buffer(_rotator, device_items);
+}
+
+bool gr_mod_base::tune_buffers(bool underflow)
+{
+    if(!_mode_paths.contains(_mode))
+        return false;
+    mode_path &path = _mode_paths[_mode];
+    if(path.buffer_tuned)
+        return false;
+    float scale = path.buffer_scale;
+    if(underflow)
+    {
+        path.buffer_scale = std::min(1.0f, path.buffer_scale * 2);
+        path.buffer_tuned = true;
+    }
+    else if(path.buffer_scale > MIN_BUFFER_SCALE)
+    {
+        path.buffer_scale = path.buffer_scale / 2;
+    }
+    else
+    {
+        path.buffer_tuned = true;
+    }
+    if(path.buffer_scale == scale)
+        return false;
+    size_buffers(_mode);
+    return true;
+}
+
+float gr_mod_base::get_sample_ratio()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - _ratio_time;
+    _ratio_time = now;
+    if(!_rotator->detail() || (_rotator->detail()->noutputs() < 1))
+    {
+        _ratio_items = 0;
+        return 1.0f;
+    }
+    uint64_t items = _rotator->nitems_written(0);
+    /// the counter starts from zero again with a new flowgraph run
+    bool restarted = items < _ratio_items;
+    uint64_t produced = items - _ratio_items;
+    _ratio_items = items;
+    if(restarted || (elapsed.count() <= 0))
+        return 1.0f;
+    return (float)(produced / (elapsed.count() * DEVICE_RATE));
+}
 
+void gr_mod_base::get_buffer_stats(int &bytes, float &latency_msec, float &scale, bool &tuned)
+{
+    bytes = 0;
+    latency_msec = 0;
+    scale = 1.0f;
+    tuned = false;
+    if(!_mode_paths.contains(_mode))
+        return;
+    const mode_path &path = _mode_paths[_mode];
+    if(path.mod_rate == AUDIO_RATE)
+    {
+        add_buffer(_audio_input_select, AUDIO_RATE, bytes, latency_msec);
+        add_buffer(path.valve, AUDIO_RATE, bytes, latency_msec);
+    }
+    add_buffer(_tx_select, DEVICE_RATE, bytes, latency_msec);
+    add_buffer(_rotator, DEVICE_RATE, bytes, latency_msec);
+    scale = path.buffer_scale;
+    tuned = path.buffer_tuned;
+}
@@ -23,6 +23,7 @@
 #include <QDebug>
 #include <string>
 #include <vector>
+#include <chrono>
 #include <gnuradio/top_block.h>
 #include <gnuradio/blocks/rotator_cc.h>
 #include <gnuradio/vocoder/freedv_api.h>
@@ -31,8 +32,12 @@
 #include <gnuradio/blocks/copy.h>
 #include <osmosdr/sink.h>
 #include "src/modem_types.h"
+#include "src/radioconfig.h"
 #include "gr_vector_source.h"
 #include "gr_audio_source.h"
+#include "gr_audio_bridge.h"
+#include "gr_mode_selector.h"
+#include "gr_block_profiler.h"
 #include "gr_mod_2fsk_sdr.h"
 #include "gr_mod_4fsk_sdr.h"
 #include "gr_mod_am_sdr.h"
@@ -53,25 +58,70 @@ public slots:
     void start(int buffer_size=0);
     void stop();
     int set_data(std::vector<u_int8_t> *data);
+    void append_data(const unsigned char *data, unsigned int size);
+    unsigned int get_queued_data();
     void tune(long long center_freq);
     void set_power(float value, std::string gain_stage="");
     void set_filter_width(int filter_width, int mode);
     void set_ctcss(float value);
+    /// Modulator chains are wired on first use, later switches only flip valves
     void set_mode(int mode);
+    /// Applies every changed field of the set with at most one flowgraph lock
+    void apply_config(const RadioConfig &config);
+    /// Duration of the last set_mode() call in microseconds
+    double get_mode_switch_time();
     int set_audio(std::vector<float> *data);
+    void set_audio_bridge(gr_audio_bridge_sptr bridge);
+    /// Feed analog modulators from the repeater bridge instead of the audio source
+    void enable_audio_bridge(bool value);
     void set_bb_gain(float value);
     void set_cw_k(bool value);
     void set_carrier_offset(long carrier_offset);
     void flush_sources();
     const QMap<std::string,QVector<int>> get_gain_names() const;
+    /// Pins the modulator blocks to cpus and sets the priority of their
+    /// threads, takes effect when the flowgraph is started
+    void set_sched_group(const std::vector<int> &cpus, int priority);
+    /// Performance counters of the busy blocks since the previous call
+    void get_block_stats(std::vector<gr_block_profiler::stats> &stats);
+    /// One auto-tune step for the buffers of the current mode, returns true
+    /// when the sizes changed, they apply after the flowgraph is restarted
+    bool tune_buffers(bool underflow);
+    /// Samples handed to the device since the previous call against the
+    /// device rate, below 1 the device ran out of samples
+    float get_sample_ratio();
+    /// Memory and worst case queueing latency of the current mode buffers
+    void get_buffer_stats(int &bytes, float &latency_msec, float &scale, bool &tuned);
 
 private:
+    struct mode_path
+    {
+        gr::blocks::copy::sptr valve;
+        gr::hier_block2_sptr mod;
+        int mod_rate; // rate of the edges inside the modulator the latency is sized for
+        float buffer_scale; // fraction of the latency target, lowered by tune_buffers()
+        bool buffer_tuned;
+        int input;
+    };
+
+    void wire_mode(int mode);
+    void wire_path(int mode, gr::basic_block_sptr source, size_t itemsize,
+                   gr::hier_block2_sptr mod);
+    void size_buffers(int mode);
+    void select_path(int mode);
+
     gr::top_block_sptr _top_block;
     gr_vector_source_sptr _vector_source;
     gr_audio_source_sptr _audio_source;
+    gr_audio_bridge_source_sptr _bridge_source;
+    gr_mode_selector_sptr _audio_input_select;
+    bool _audio_input_wired;
     osmosdr::sink::sptr _osmosdr_sink;
     gr::blocks::rotator_cc::sptr _rotator;
     gr::analog::sig_source_f::sptr _signal_source;
+    gr_mode_selector_sptr _tx_select;
+    QMap<int, mode_path> _mode_paths;
+    double _mode_switch_time;
 
     gr_mod_2fsk_sdr_sptr _2fsk_2k_fm;
     gr_mod_2fsk_sdr_sptr _2fsk_1k_fm;
@@ -105,9 +155,14 @@ private:
 
     int _samples_per_symbol;
     int _samp_rate;
+    uint64_t _ratio_items;
+    std::chrono::steady_clock::time_point _ratio_time;
     int _carrier_freq;
     int _filter_width;
     double _device_frequency;
+    long long _center_freq;
+    float _ctcss;
+    bool _locked;
     int _freq_correction;
     int _carrier_offset;
     int _mode;
@@ -116,6 +171,7 @@ private:
     void set_bandwidth_specific();
     osmosdr::gain_range_t _gain_range;
     std::vector<std::string> _gain_names;
+    gr_block_profiler _profiler;
 
 };
 
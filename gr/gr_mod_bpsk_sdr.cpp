@@ -57,7 +57,6 @@ gr_mod_bpsk_sdr::gr_mod_bpsk_sdr(int sps, int samp_rate, int carrier_freq,
     _resampler = gr::filter::rational_resampler_base_ccf::make(_samples_per_symbol, 1,
                                   gr::filter::firdes::root_raised_cosine(_samples_per_symbol,
                                         _samples_per_symbol,1,0.35,11 * _samples_per_symbol));
-    _resampler->set_thread_priority(99);
     _shaping_filter = gr::filter::fft_filter_ccf::make(
                 1, gr::filter::firdes::root_raised_cosine(1,_samp_rate,_samp_rate/_samples_per_symbol,
                                                           0.35,nfilts * _samples_per_symbol));
@@ -91,6 +90,10 @@ void gr_mod_bpsk_sdr::set_bb_gain(float value)
     _bb_gain->set_k(value);
 }
 
-
-
-
+std::vector<gr::block_sptr> gr_mod_bpsk_sdr::mod_blocks()
+{
+    std::vector<gr::block_sptr> blocks;
+    blocks.push_back(_resampler);
+    blocks.push_back(_resampler2);
+    return blocks;
+}
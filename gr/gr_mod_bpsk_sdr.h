@@ -52,6 +52,8 @@ public:
     explicit gr_mod_bpsk_sdr(int sps=125, int samp_rate=250000, int carrier_freq=1700,
                              int filter_width=8000);
     void set_bb_gain(float value);
+    /// Blocks belonging to the "modulator" scheduling group
+    std::vector<gr::block_sptr> mod_blocks();
 
 private:
     gr::blocks::packed_to_unpacked_bb::sptr _packed_to_unpacked;
@@ -131,3 +131,8 @@ void gr_mod_nbfm_sdr::set_ctcss(float value)
         }
     }
 }
+
+void gr_mod_nbfm_sdr::set_ctcss_frequency(float value)
+{
+    _tone_source->set_frequency(value);
+}
@@ -47,6 +47,8 @@ public:
                              int filter_width=8000);
     void set_filter_width(int filter_width);
     void set_ctcss(float value);
+    /// Retunes the tone while it is wired in, needs no flowgraph lock
+    void set_ctcss_frequency(float value);
     void set_bb_gain(float value);
 
 private:
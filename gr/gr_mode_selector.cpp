@@ -0,0 +1,95 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "gr_mode_selector.h"
+#include <string.h>
+#include <algorithm>
+
+gr_mode_selector_sptr
+make_gr_mode_selector (size_t itemsize)
+{
+    return gnuradio::get_initial_sptr(new gr_mode_selector(itemsize));
+}
+
+gr_mode_selector::gr_mode_selector(size_t itemsize) :
+        gr::block("gr_mode_selector",
+                  gr::io_signature::make (1, -1, itemsize),
+                  gr::io_signature::make (1, 1, itemsize))
+{
+    _itemsize = itemsize;
+    _ninputs = 0;
+    _input.store(-1);
+    _selected.store(false);
+    /// tags from the inactive chains would land at meaningless offsets
+    set_tag_propagation_policy(TPP_DONT);
+}
+
+int gr_mode_selector::add_input()
+{
+    return _ninputs++;
+}
+
+void gr_mode_selector::set_input(int input)
+{
+    _input.store(input);
+    _selected.store(true);
+}
+
+int gr_mode_selector::get_input()
+{
+    return _input.load();
+}
+
+void gr_mode_selector::forecast(int noutput_items, gr_vector_int &ninput_items_required)
+{
+    /// only wait on the selected input, the others are drained whenever we run.
+    /// With nothing selected there is no input to wait on, asking for an item
+    /// everywhere keeps the scheduler from spinning on empty work calls
+    int input = _input.load();
+    bool idle = (input < 0) || (input >= (int)ninput_items_required.size());
+    for(unsigned int i=0;i<ninput_items_required.size();i++)
+    {
+        if(idle)
+            ninput_items_required[i] = 1;
+        else
+            ninput_items_required[i] = ((int)i == input) ? noutput_items : 0;
+    }
+}
+
+int gr_mode_selector::general_work(int noutput_items,
+       gr_vector_int &ninput_items,
+       gr_vector_const_void_star &input_items,
+       gr_vector_void_star &output_items)
+{
+    int input = _input.load();
+    int ninputs = (int)ninput_items.size();
+    /// whatever waits on a newly selected input is left from its last use
+    bool flush = _selected.exchange(false);
+    for(int i=0;i<ninputs;i++)
+    {
+        if((i != input) || flush)
+            consume(i, ninput_items[i]);
+    }
+    if(flush || (input < 0) || (input >= ninputs))
+    {
+        return 0;
+    }
+    int n = std::min(noutput_items, ninput_items[input]);
+    memcpy(output_items[0], input_items[input], n * _itemsize);
+    consume(input, n);
+    return n;
+}
@@ -0,0 +1,58 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef GR_MODE_SELECTOR_H
+#define GR_MODE_SELECTOR_H
+
+#include <gnuradio/block.h>
+#include <gnuradio/io_signature.h>
+#include <atomic>
+
+class gr_mode_selector;
+typedef boost::shared_ptr<gr_mode_selector> gr_mode_selector_sptr;
+
+gr_mode_selector_sptr make_gr_mode_selector(size_t itemsize);
+
+/// N to 1 stream selector used for switching modes without locking the flowgraph
+/// Only the selected input is copied to the output, anything arriving on the
+/// other inputs is discarded. With no input selected nothing is produced and
+/// the block only runs when every input has data, which it drops.
+/// Inputs are numbered in the order they were wired, see add_input()
+class gr_mode_selector : public gr::block
+{
+public:
+    gr_mode_selector(size_t itemsize);
+
+    void forecast(int noutput_items, gr_vector_int &ninput_items_required);
+    int general_work(int noutput_items,
+           gr_vector_int &ninput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+
+    /// Returns the next free input port, to be connected by the caller
+    int add_input();
+    void set_input(int input);
+    int get_input();
+
+private:
+    size_t _itemsize;
+    int _ninputs;
+    std::atomic<int> _input;
+    std::atomic<bool> _selected; // input changed since the last work call
+};
+
+#endif // GR_MODE_SELECTOR_H
@@ -0,0 +1,124 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "gr_rssi_sink.h"
+#include <volk/volk.h>
+#include <math.h>
+#include <algorithm>
+
+/// 50 msec of history at 20 ksps and the default block size
+static const unsigned int RSSI_HISTORY_SIZE = 50;
+
+gr_rssi_sink_sptr make_gr_rssi_sink(int block_size, int window, float calibration)
+{
+    return gnuradio::get_initial_sptr(new gr_rssi_sink(block_size, window, calibration));
+}
+
+gr_rssi_sink::gr_rssi_sink(int block_size, int window, float calibration) :
+        gr::sync_block("gr_rssi_sink",
+                       gr::io_signature::make (1, 1, sizeof (gr_complex)),
+                       gr::io_signature::make (0, 0, 0))
+{
+    _block_size = block_size;
+    _block_fill = 0;
+    _block_sum = 0;
+    _smoothed = 0;
+    _window_sum = 0;
+    _window_index = 0;
+    _window.resize(std::max(1, window / block_size), 0.0f);
+    _history_index = 0;
+    _history.resize(RSSI_HISTORY_SIZE, 0.0f);
+    /// single pole filter with 0.04 per sample, applied once per block
+    _alpha = 1.0f - powf(1.0f - 0.04f, (float)block_size);
+    _level.store(0.0f);
+    _calibration.store(calibration);
+    _mag_squared = (float*)volk_malloc(block_size * sizeof(float), volk_get_alignment());
+}
+
+gr_rssi_sink::~gr_rssi_sink()
+{
+    volk_free(_mag_squared);
+}
+
+float gr_rssi_sink::level()
+{
+    return _level.load(std::memory_order_relaxed);
+}
+
+void gr_rssi_sink::set_calibration(float calibration)
+{
+    _calibration.store(calibration);
+}
+
+void gr_rssi_sink::get_history(std::vector<float> &history)
+{
+    gr::thread::scoped_lock guard(_mutex);
+    history.clear();
+    history.reserve(_history.size());
+    for(unsigned int i=0;i<_history.size();i++)
+    {
+        history.push_back(_history.at((_history_index + i) % _history.size()));
+    }
+}
+
+void gr_rssi_sink::block_done()
+{
+    _window_sum += _block_sum - _window.at(_window_index);
+    _window.at(_window_index) = _block_sum;
+    _window_index++;
+    if(_window_index >= _window.size())
+    {
+        /// avoid drifting from the accumulated rounding errors
+        _window_index = 0;
+        _window_sum = 0;
+        for(unsigned int i=0;i<_window.size();i++)
+            _window_sum += _window.at(i);
+    }
+    _smoothed += _alpha * ((float)_window_sum - _smoothed);
+    float level = 10.0f * log10f(_smoothed + 1e-20f) + _calibration.load(std::memory_order_relaxed);
+    _level.store(level, std::memory_order_relaxed);
+
+    gr::thread::scoped_lock guard(_mutex);
+    _history.at(_history_index) = level;
+    _history_index = (_history_index + 1) % _history.size();
+}
+
+int gr_rssi_sink::work(int noutput_items,
+       gr_vector_const_void_star &input_items,
+       gr_vector_void_star &output_items)
+{
+    (void) output_items;
+    const gr_complex *in = (const gr_complex*)(input_items[0]);
+    int consumed = 0;
+    while(consumed < noutput_items)
+    {
+        int n = std::min(noutput_items - consumed, _block_size - _block_fill);
+        float sum = 0;
+        volk_32fc_magnitude_squared_32f(_mag_squared, in + consumed, n);
+        volk_32f_accumulator_s32f(&sum, _mag_squared, n);
+        _block_sum += sum;
+        _block_fill += n;
+        consumed += n;
+        if(_block_fill >= _block_size)
+        {
+            block_done();
+            _block_sum = 0;
+            _block_fill = 0;
+        }
+    }
+    return noutput_items;
+}
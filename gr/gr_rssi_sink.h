@@ -0,0 +1,68 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef GR_RSSI_SINK_H
+#define GR_RSSI_SINK_H
+
+#include <gnuradio/sync_block.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/gr_complex.h>
+#include <atomic>
+#include <vector>
+
+class gr_rssi_sink;
+typedef boost::shared_ptr<gr_rssi_sink> gr_rssi_sink_sptr;
+
+gr_rssi_sink_sptr make_gr_rssi_sink(int block_size=20, int window=2000, float calibration=-80.0f);
+
+/// Signal level in dB, computed once per block of samples instead of per sample
+/// The level is the power summed over the last window samples, with the same
+/// scale the old moving average / log10 chain used so calibration values still apply
+class gr_rssi_sink : public gr::sync_block
+{
+public:
+    gr_rssi_sink(int block_size, int window, float calibration);
+    ~gr_rssi_sink();
+    int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+
+    float level();
+    void set_calibration(float calibration);
+    /// Most recent levels, oldest first, one per block
+    void get_history(std::vector<float> &history);
+
+private:
+    void block_done();
+
+    int _block_size;
+    int _block_fill;
+    float _block_sum;
+    float _smoothed;
+    float _alpha;
+    double _window_sum;
+    unsigned int _window_index;
+    std::vector<float> _window;
+    unsigned int _history_index;
+    std::vector<float> _history;
+    float *_mag_squared;
+    std::atomic<float> _level;
+    std::atomic<float> _calibration;
+    gr::thread::mutex _mutex;
+};
+
+#endif // GR_RSSI_SINK_H
@@ -0,0 +1,247 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "gr_sigmf_sink.h"
+#include <boost/bind.hpp>
+#include <string.h>
+#include <time.h>
+
+/// 2 MiB per block, roughly 260 msec at 1 Msps
+static const unsigned int SIGMF_BLOCK_SAMPLES = 262144;
+/// 32 MiB of buffering before we start dropping samples
+static const unsigned int SIGMF_NUM_BLOCKS = 16;
+
+gr_sigmf_sink_sptr
+make_gr_sigmf_sink ()
+{
+    return gnuradio::get_initial_sptr(new gr_sigmf_sink);
+}
+
+gr_sigmf_sink::gr_sigmf_sink() :
+        gr::sync_block("gr_sigmf_sink",
+                       gr::io_signature::make (1, 1, sizeof (gr_complex)),
+                       gr::io_signature::make (0, 0, 0))
+{
+    _data_file = nullptr;
+    _samp_rate = 0;
+    _gain = 0;
+    _recording = false;
+    _writer_running = false;
+    _sample_count = 0;
+    _dropped_samples = 0;
+    _current_block = nullptr;
+    for(unsigned int i=0;i<SIGMF_NUM_BLOCKS;i++)
+    {
+        std::vector<gr_complex> *block = new std::vector<gr_complex>;
+        block->reserve(SIGMF_BLOCK_SAMPLES);
+        _free_blocks.push_back(block);
+    }
+}
+
+gr_sigmf_sink::~gr_sigmf_sink()
+{
+    stop_recording();
+    for(unsigned int i=0;i<_free_blocks.size();i++)
+    {
+        delete _free_blocks.at(i);
+    }
+    _free_blocks.clear();
+}
+
+bool gr_sigmf_sink::start_recording(const std::string &base_path, double samp_rate,
+                                    double center_freq, double gain, const std::string &mode)
+{
+    stop_recording();
+    std::string data_path = base_path + ".sigmf-data";
+    FILE *data_file = fopen(data_path.c_str(), "wb");
+    if(data_file == nullptr)
+    {
+        return false;
+    }
+    char datetime[32];
+    time_t now = time(nullptr);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+    gr::thread::scoped_lock guard(_mutex);
+    _data_file = data_file;
+    _base_path = base_path;
+    _datetime = std::string(datetime);
+    _samp_rate = samp_rate;
+    _gain = gain;
+    _mode = mode;
+    _sample_count = 0;
+    _dropped_samples = 0;
+    _captures.clear();
+    capture first = {0, center_freq};
+    _captures.push_back(first);
+    _current_block = _free_blocks.front();
+    _free_blocks.pop_front();
+    _current_block->clear();
+    _writer_running = true;
+    _writer_thread = gr::thread::thread(boost::bind(&gr_sigmf_sink::writer_loop, this));
+    _recording = true;
+    guard.unlock();
+    // write metadata early as well, so an aborted session is still usable
+    write_metadata();
+    return true;
+}
+
+void gr_sigmf_sink::stop_recording()
+{
+    gr::thread::scoped_lock guard(_mutex);
+    if(!_writer_running)
+        return;
+    _recording = false;
+    if(_current_block != nullptr)
+    {
+        _full_blocks.push_back(_current_block);
+        _current_block = nullptr;
+    }
+    _writer_running = false;
+    _cond_wait.notify_one();
+    guard.unlock();
+    _writer_thread.join();
+    fclose(_data_file);
+    _data_file = nullptr;
+    write_metadata();
+}
+
+void gr_sigmf_sink::set_center_freq(double center_freq)
+{
+    gr::thread::scoped_lock guard(_mutex);
+    if(!_recording)
+        return;
+    capture next = {_sample_count, center_freq};
+    if((_captures.size() > 0) && (_captures.back().sample_start == _sample_count))
+        _captures.back() = next;
+    else
+        _captures.push_back(next);
+}
+
+bool gr_sigmf_sink::is_recording()
+{
+    gr::thread::scoped_lock guard(_mutex);
+    return _recording;
+}
+
+uint64_t gr_sigmf_sink::get_dropped_samples()
+{
+    gr::thread::scoped_lock guard(_mutex);
+    return _dropped_samples;
+}
+
+void gr_sigmf_sink::writer_loop()
+{
+    while(true)
+    {
+        gr::thread::scoped_lock guard(_mutex);
+        while(_full_blocks.empty() && _writer_running)
+        {
+            _cond_wait.wait(guard);
+        }
+        if(_full_blocks.empty())
+            break;
+        std::vector<gr_complex> *block = _full_blocks.front();
+        _full_blocks.pop_front();
+        guard.unlock();
+
+        fwrite(block->data(), sizeof(gr_complex), block->size(), _data_file);
+        block->clear();
+
+        guard.lock();
+        _free_blocks.push_back(block);
+    }
+    fflush(_data_file);
+}
+
+void gr_sigmf_sink::write_metadata()
+{
+    std::string meta_path = _base_path + ".sigmf-meta";
+    FILE *meta_file = fopen(meta_path.c_str(), "w");
+    if(meta_file == nullptr)
+        return;
+    gr::thread::scoped_lock guard(_mutex);
+    fprintf(meta_file, "{\n    \"global\": {\n");
+    fprintf(meta_file, "        \"core:datatype\": \"cf32_le\",\n");
+    fprintf(meta_file, "        \"core:sample_rate\": %.1f,\n", _samp_rate);
+    fprintf(meta_file, "        \"core:version\": \"1.0.0\",\n");
+    fprintf(meta_file, "        \"core:recorder\": \"qradiolink\",\n");
+    fprintf(meta_file, "        \"qradiolink:gain\": %.2f,\n", _gain);
+    fprintf(meta_file, "        \"qradiolink:mode\": \"%s\",\n", _mode.c_str());
+    fprintf(meta_file, "        \"qradiolink:dropped_samples\": %llu\n",
+            (unsigned long long)_dropped_samples);
+    fprintf(meta_file, "    },\n    \"captures\": [\n");
+    for(unsigned int i=0;i<_captures.size();i++)
+    {
+        fprintf(meta_file, "        {\n");
+        fprintf(meta_file, "            \"core:sample_start\": %llu,\n",
+                (unsigned long long)_captures.at(i).sample_start);
+        if(i == 0)
+            fprintf(meta_file, "            \"core:datetime\": \"%s\",\n", _datetime.c_str());
+        fprintf(meta_file, "            \"core:frequency\": %.1f\n", _captures.at(i).frequency);
+        fprintf(meta_file, (i + 1 < _captures.size()) ? "        },\n" : "        }\n");
+    }
+    fprintf(meta_file, "    ],\n    \"annotations\": []\n}\n");
+    fclose(meta_file);
+}
+
+int gr_sigmf_sink::work(int noutput_items,
+       gr_vector_const_void_star &input_items,
+       gr_vector_void_star &output_items)
+{
+    (void) output_items;
+    if(noutput_items < 1)
+    {
+        return noutput_items;
+    }
+    gr::thread::scoped_lock guard(_mutex);
+    if(!_recording)
+    {
+        return noutput_items;
+    }
+    const gr_complex *in = (const gr_complex*)(input_items[0]);
+    int consumed = 0;
+    while(consumed < noutput_items)
+    {
+        if(_current_block == nullptr)
+        {
+            if(_free_blocks.empty())
+            {
+                // writer is not keeping up, drop rather than stall the radio
+                _dropped_samples += noutput_items - consumed;
+                break;
+            }
+            _current_block = _free_blocks.front();
+            _free_blocks.pop_front();
+        }
+        int space = SIGMF_BLOCK_SAMPLES - _current_block->size();
+        int n = std::min(space, noutput_items - consumed);
+        _current_block->insert(_current_block->end(), in + consumed, in + consumed + n);
+        consumed += n;
+        _sample_count += n;
+        if(_current_block->size() >= SIGMF_BLOCK_SAMPLES)
+        {
+            _full_blocks.push_back(_current_block);
+            _current_block = nullptr;
+            _cond_wait.notify_one();
+        }
+    }
+
+    return noutput_items;
+}
@@ -0,0 +1,84 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef GR_SIGMF_SINK_H
+#define GR_SIGMF_SINK_H
+
+#include <gnuradio/sync_block.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/thread/thread.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+class gr_sigmf_sink;
+typedef boost::shared_ptr<gr_sigmf_sink> gr_sigmf_sink_sptr;
+
+gr_sigmf_sink_sptr make_gr_sigmf_sink();
+
+/// Records complex baseband to a SigMF dataset (.sigmf-data + .sigmf-meta)
+/// The flowgraph thread only copies into large blocks, a separate writer
+/// thread does the actual disk I/O so a slow disk never stalls the source
+class gr_sigmf_sink : public gr::sync_block
+{
+public:
+    gr_sigmf_sink();
+    ~gr_sigmf_sink();
+    int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+
+    bool start_recording(const std::string &base_path, double samp_rate,
+                         double center_freq, double gain, const std::string &mode);
+    void stop_recording();
+    void set_center_freq(double center_freq);
+    bool is_recording();
+    uint64_t get_dropped_samples();
+
+private:
+    struct capture
+    {
+        uint64_t sample_start;
+        double frequency;
+    };
+
+    void writer_loop();
+    void write_metadata();
+
+    FILE *_data_file;
+    std::string _base_path;
+    std::string _datetime;
+    std::string _mode;
+    double _samp_rate;
+    double _gain;
+    bool _recording;
+    bool _writer_running;
+    uint64_t _sample_count;
+    uint64_t _dropped_samples;
+    std::vector<capture> _captures;
+
+    std::vector<gr_complex> *_current_block;
+    std::deque<std::vector<gr_complex>*> _full_blocks;
+    std::deque<std::vector<gr_complex>*> _free_blocks;
+    gr::thread::thread _writer_thread;
+    gr::thread::condition_variable _cond_wait;
+    gr::thread::mutex _mutex;
+};
+
+#endif // GR_SIGMF_SINK_H
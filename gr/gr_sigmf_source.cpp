@@ -0,0 +1,125 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "gr_sigmf_source.h"
+#include <time.h>
+
+gr_sigmf_source_sptr
+make_gr_sigmf_source (const std::string &data_path, double samp_rate, bool throttle, bool repeat)
+{
+    return gnuradio::get_initial_sptr(new gr_sigmf_source(data_path, samp_rate, throttle, repeat));
+}
+
+gr_sigmf_source::gr_sigmf_source(const std::string &data_path, double samp_rate,
+                                 bool throttle, bool repeat) :
+        gr::sync_block("gr_sigmf_source",
+                       gr::io_signature::make (0, 0, 0),
+                       gr::io_signature::make (1, 1, sizeof (gr_complex)))
+{
+    _samp_rate = samp_rate;
+    _throttle = throttle;
+    _repeat = repeat;
+    _samples_read = 0;
+    _throttle_samples = 0;
+    _data_file = fopen(data_path.c_str(), "rb");
+    if(_data_file == nullptr)
+    {
+        throw std::runtime_error("gr_sigmf_source: can't open " + data_path);
+    }
+}
+
+gr_sigmf_source::~gr_sigmf_source()
+{
+    if(_data_file != nullptr)
+        fclose(_data_file);
+}
+
+bool gr_sigmf_source::start()
+{
+    gr::thread::scoped_lock guard(_mutex);
+    _samples_read = 0;
+    _throttle_samples = 0;
+    _start_time = std::chrono::steady_clock::now();
+    _throttle_start = _start_time;
+    return true;
+}
+
+void gr_sigmf_source::set_samp_rate(double samp_rate)
+{
+    gr::thread::scoped_lock guard(_mutex);
+    _samp_rate = samp_rate;
+    _throttle_samples = 0;
+    _throttle_start = std::chrono::steady_clock::now();
+}
+
+uint64_t gr_sigmf_source::get_samples_read()
+{
+    gr::thread::scoped_lock guard(_mutex);
+    return _samples_read;
+}
+
+double gr_sigmf_source::get_elapsed_time()
+{
+    gr::thread::scoped_lock guard(_mutex);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _start_time;
+    return elapsed.count();
+}
+
+int gr_sigmf_source::work(int noutput_items,
+       gr_vector_const_void_star &input_items,
+       gr_vector_void_star &output_items)
+{
+    (void) input_items;
+    gr_complex *out = (gr_complex*)(output_items[0]);
+    gr::thread::scoped_lock guard(_mutex);
+
+    int produced = 0;
+    while(produced < noutput_items)
+    {
+        size_t n = fread(out + produced, sizeof(gr_complex), noutput_items - produced, _data_file);
+        produced += (int)n;
+        if(produced < noutput_items)
+        {
+            if(!_repeat)
+                break;
+            rewind(_data_file);
+            if(n == 0 && _samples_read == 0 && produced == 0)
+                break; // empty file
+        }
+    }
+    _samples_read += produced;
+    if(produced == 0)
+    {
+        return WORK_DONE;
+    }
+
+    if(_throttle && _samp_rate > 0)
+    {
+        _throttle_samples += produced;
+        std::chrono::duration<double> ahead =
+                std::chrono::duration<double>((double)_throttle_samples / _samp_rate) -
+                (std::chrono::steady_clock::now() - _throttle_start);
+        if(ahead.count() > 0.0)
+        {
+            guard.unlock();
+            struct timespec time_to_sleep = {(time_t)ahead.count(),
+                    (long)((ahead.count() - (time_t)ahead.count()) * 1e9)};
+            nanosleep(&time_to_sleep, NULL);
+        }
+    }
+    return produced;
+}
@@ -0,0 +1,64 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef GR_SIGMF_SOURCE_H
+#define GR_SIGMF_SOURCE_H
+
+#include <gnuradio/sync_block.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/gr_complex.h>
+#include <stdio.h>
+#include <string>
+#include <chrono>
+
+class gr_sigmf_source;
+typedef boost::shared_ptr<gr_sigmf_source> gr_sigmf_source_sptr;
+
+gr_sigmf_source_sptr make_gr_sigmf_source(const std::string &data_path, double samp_rate,
+                                          bool throttle=true, bool repeat=false);
+
+/// Replays a cf32_le SigMF recording in place of the SDR device
+/// With throttle disabled the RX chain runs as fast as the CPU allows
+class gr_sigmf_source : public gr::sync_block
+{
+public:
+    gr_sigmf_source(const std::string &data_path, double samp_rate,
+                    bool throttle, bool repeat);
+    ~gr_sigmf_source();
+
+    int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+
+    bool start();
+    void set_samp_rate(double samp_rate);
+    uint64_t get_samples_read();
+    double get_elapsed_time();
+
+private:
+    FILE *_data_file;
+    double _samp_rate;
+    bool _throttle;
+    bool _repeat;
+    uint64_t _samples_read;
+    uint64_t _throttle_samples;
+    std::chrono::steady_clock::time_point _start_time;
+    std::chrono::steady_clock::time_point _throttle_start;
+    gr::thread::mutex _mutex;
+};
+
+#endif // GR_SIGMF_SOURCE_H
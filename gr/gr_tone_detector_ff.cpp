@@ -0,0 +1,287 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "gr_tone_detector_ff.h"
+#include "ext/utils.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+/// 0.5 sec per decision, 2 Hz resolution like the old ctcss_squelch_ff
+static const int TONE_BLOCK_LEN = 400;
+static const float TONE_DECIMATED_RATE = 800.0f;
+/// fraction of the low band energy a tone must hold
+static const float TONE_OPEN_RATIO = 0.3f;
+static const float TONE_HOLD_RATIO = 0.15f;
+static const float DCS_BAUD_RATE = 134.4f;
+/// DCS (23,12) Golay code, x^11+x^10+x^6+x^5+x^4+x^2+1
+static const unsigned int DCS_GOLAY_POLY = 0xC75;
+static const int dcs_code_list[] = {
+    023, 025, 026, 031, 032, 036, 043, 047, 051, 053, 054, 065, 071, 072, 073, 074,
+    0114, 0115, 0116, 0122, 0125, 0131, 0132, 0134, 0143, 0145, 0152, 0155, 0156, 0162, 0165, 0172, 0174,
+    0205, 0212, 0223, 0225, 0226, 0243, 0244, 0245, 0246, 0251, 0252, 0255, 0261, 0263, 0265, 0266, 0271, 0274,
+    0306, 0311, 0315, 0325, 0331, 0332, 0343, 0346, 0351, 0356, 0364, 0365, 0371,
+    0411, 0412, 0413, 0423, 0431, 0432, 0445, 0446, 0452, 0454, 0455, 0462, 0464, 0465, 0466,
+    0503, 0506, 0516, 0523, 0526, 0532, 0546, 0565,
+    0606, 0612, 0624, 0627, 0631, 0632, 0654, 0662, 0664,
+    0703, 0712, 0723, 0731, 0732, 0734, 0743, 0754};
+
+static unsigned int dcs_codeword(int code)
+{
+    /// 9 code bits and 100, sent LSB first, followed by the parity bits
+    unsigned int data = (unsigned int)code | 0x800;
+    unsigned int remainder = data << 11;
+    for(int bit=22;bit>=11;bit--)
+    {
+        if(remainder & (1u << bit))
+            remainder ^= DCS_GOLAY_POLY << (bit - 11);
+    }
+    return data | ((remainder & 0x7FF) << 12);
+}
+
+gr_tone_detector_ff_sptr make_gr_tone_detector_ff(int samp_rate)
+{
+    return gnuradio::get_initial_sptr(new gr_tone_detector_ff(samp_rate));
+}
+
+gr_tone_detector_ff::gr_tone_detector_ff(int samp_rate) :
+    gr::block("gr_tone_detector_ff",
+              gr::io_signature::make (1, 1, sizeof (float)),
+              gr::io_signature::make (1, 1, sizeof (float)))
+{
+    _decimation = std::max(1, (int)(samp_rate / TONE_DECIMATED_RATE));
+    _decim_rate = (float)samp_rate / _decimation;
+    _decim_count = 0;
+
+    /// Butterworth low pass at 300 Hz, applied twice
+    float w0 = 2.0f * M_PI * 300.0f / samp_rate;
+    float alpha = sinf(w0) / (2.0f * 0.7071f);
+    float a0 = 1.0f + alpha;
+    _b[0] = (1.0f - cosf(w0)) / 2.0f / a0;
+    _b[1] = (1.0f - cosf(w0)) / a0;
+    _b[2] = _b[0];
+    _a[0] = -2.0f * cosf(w0) / a0;
+    _a[1] = (1.0f - alpha) / a0;
+    memset(_z, 0, sizeof(_z));
+
+    int num_tones = sizeof(tone_list) / sizeof(tone_list[0]);
+    for(int i=0;i<num_tones;i++)
+    {
+        _tones.push_back(tone_list[i]);
+        _coeff.push_back(2.0f * cosf(2.0f * M_PI * tone_list[i] / _decim_rate));
+    }
+    _s1.resize(num_tones, 0.0f);
+    _s2.resize(num_tones, 0.0f);
+    _block_len = TONE_BLOCK_LEN;
+    _block_count = 0;
+    _energy = 0;
+    _candidate = -1;
+    _current = -1;
+
+    _dc = 0;
+    _last_sample = 0;
+    _dcs_phase = 0;
+    _dcs_step = DCS_BAUD_RATE / _decim_rate;
+    _dcs_reg = 0;
+    int num_codes = sizeof(dcs_code_list) / sizeof(dcs_code_list[0]);
+    for(int i=0;i<num_codes;i++)
+    {
+        _dcs_codes.push_back(dcs_code_list[i]);
+        _dcs_words.push_back(dcs_codeword(dcs_code_list[i]));
+    }
+    _dcs_last_match.resize(num_codes, 0);
+    _dcs_hits.resize(num_codes, 0);
+    _dcs_match = -1;
+    _dcs_bit_count = 0;
+
+    _required_tone.store(0.0f);
+    _detected_tone.store(0.0f);
+    _detected_dcs.store(0);
+}
+
+void gr_tone_detector_ff::set_required_tone(float tone)
+{
+    _required_tone.store(tone);
+}
+
+float gr_tone_detector_ff::get_tone()
+{
+    return _detected_tone.load();
+}
+
+int gr_tone_detector_ff::get_dcs_code()
+{
+    return _detected_dcs.load();
+}
+
+void gr_tone_detector_ff::forecast(int noutput_items, gr_vector_int &ninput_items_required)
+{
+    ninput_items_required[0] = noutput_items;
+}
+
+void gr_tone_detector_ff::goertzel_done()
+{
+    int best = -1;
+    float best_power = 0;
+    float second_power = 0;
+    for(unsigned int i=0;i<_tones.size();i++)
+    {
+        float power = _s1[i] * _s1[i] + _s2[i] * _s2[i] - _coeff[i] * _s1[i] * _s2[i];
+        if(power > best_power)
+        {
+            second_power = best_power;
+            best_power = power;
+            best = i;
+        }
+        else if(power > second_power)
+        {
+            second_power = power;
+        }
+        _s1[i] = 0;
+        _s2[i] = 0;
+    }
+    /// a pure tone holds all of the energy, |X|^2 = N * E / 2
+    float ratio = (_energy > 0) ? best_power / (_block_len * _energy / 2.0f) : 0.0f;
+    _energy = 0;
+
+    if((_current >= 0) && (best == _current) && (ratio > TONE_HOLD_RATIO))
+    {
+        return;
+    }
+    if((best >= 0) && (ratio > TONE_OPEN_RATIO) && (best_power > 2.0f * second_power))
+    {
+        /// two blocks in a row before reporting a new tone
+        if(best == _candidate)
+        {
+            _current = best;
+            _detected_tone.store(_tones[best]);
+        }
+        _candidate = best;
+        return;
+    }
+    _candidate = -1;
+    _current = -1;
+    _detected_tone.store(0.0f);
+}
+
+void gr_tone_detector_ff::dcs_bit(int bit)
+{
+    _dcs_reg = ((_dcs_reg >> 1) | ((unsigned int)bit << 22)) & 0x7FFFFF;
+    _dcs_bit_count++;
+    unsigned int inverted = (~_dcs_reg) & 0x7FFFFF;
+    /// rotations of one code word can be other valid codes, so every code
+    /// keeps its own repeat count
+    for(unsigned int i=0;i<_dcs_words.size();i++)
+    {
+        if((_dcs_reg != _dcs_words[i]) && (inverted != _dcs_words[i]))
+            continue;
+        if(_dcs_bit_count - _dcs_last_match[i] == 23)
+            _dcs_hits[i]++;
+        else
+            _dcs_hits[i] = 0;
+        _dcs_last_match[i] = _dcs_bit_count;
+        if((_dcs_hits[i] >= 2) && (_dcs_match < 0))
+        {
+            _dcs_match = i;
+            int code = _dcs_codes[i];
+            _detected_dcs.store((code >> 6) * 100 + ((code >> 3) & 7) * 10 + (code & 7));
+        }
+    }
+    if((_dcs_match >= 0) && (_dcs_bit_count - _dcs_last_match[_dcs_match] > 3 * 23))
+    {
+        _dcs_match = -1;
+        _detected_dcs.store(0);
+    }
+}
+
+void gr_tone_detector_ff::process_decimated(float sample)
+{
+    _energy += sample * sample;
+    for(unsigned int i=0;i<_tones.size();i++)
+    {
+        float s = sample + _coeff[i] * _s1[i] - _s2[i];
+        _s2[i] = _s1[i];
+        _s1[i] = s;
+    }
+    _block_count++;
+    if(_block_count >= _block_len)
+    {
+        goertzel_done();
+        _block_count = 0;
+    }
+
+    /// DCS: NRZ slicer with a simple transition tracking clock
+    _dc += 0.01f * (sample - _dc);
+    float level = sample - _dc;
+    if((level > 0) != (_last_sample > 0))
+    {
+        /// transitions should happen at phase 0
+        float error = (_dcs_phase > 0.5f) ? _dcs_phase - 1.0f : _dcs_phase;
+        _dcs_phase -= 0.2f * error;
+        if(_dcs_phase < 0)
+            _dcs_phase += 1.0f;
+    }
+    _last_sample = level;
+    float previous = _dcs_phase;
+    _dcs_phase += _dcs_step;
+    if((previous < 0.5f) && (_dcs_phase >= 0.5f))
+        dcs_bit(level > 0 ? 1 : 0);
+    if(_dcs_phase >= 1.0f)
+        _dcs_phase -= 1.0f;
+}
+
+int gr_tone_detector_ff::general_work(int noutput_items,
+       gr_vector_int &ninput_items,
+       gr_vector_const_void_star &input_items,
+       gr_vector_void_star &output_items)
+{
+    const float *in = (const float*)(input_items[0]);
+    float *out = (float*)(output_items[0]);
+    int n = std::min(noutput_items, ninput_items[0]);
+    for(int i=0;i<n;i++)
+    {
+        float x = in[i];
+        for(int k=0;k<2;k++)
+        {
+            float y = _b[0] * x + _z[k][0];
+            _z[k][0] = _b[1] * x - _a[0] * y + _z[k][1];
+            _z[k][1] = _b[2] * x - _a[1] * y;
+            x = y;
+        }
+        _decim_count++;
+        if(_decim_count >= _decimation)
+        {
+            _decim_count = 0;
+            process_decimated(x);
+        }
+    }
+    consume_each(n);
+
+    float required = _required_tone.load();
+    if(required == 0.0f)
+    {
+        memcpy(out, in, n * sizeof(float));
+        return n;
+    }
+    /// gated like ctcss_squelch_ff, nothing goes out while closed
+    if(fabs(_detected_tone.load() - required) < 0.05f)
+    {
+        memcpy(out, in, n * sizeof(float));
+        return n;
+    }
+    return 0;
+}
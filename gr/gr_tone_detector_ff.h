@@ -0,0 +1,94 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef GR_TONE_DETECTOR_FF_H
+#define GR_TONE_DETECTOR_FF_H
+
+#include <gnuradio/block.h>
+#include <gnuradio/io_signature.h>
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+class gr_tone_detector_ff;
+typedef boost::shared_ptr<gr_tone_detector_ff> gr_tone_detector_ff_sptr;
+
+gr_tone_detector_ff_sptr make_gr_tone_detector_ff(int samp_rate=8000);
+
+/// Finds the CTCSS tone (any of tone_list) or DCS code present in FM audio
+/// The audio is low passed and decimated to 800 Hz, where a Goertzel filter
+/// per tone and a 134.4 baud DCS slicer run side by side.
+/// When a tone is required, audio is gated on it instead of rewiring the graph
+class gr_tone_detector_ff : public gr::block
+{
+public:
+    gr_tone_detector_ff(int samp_rate);
+
+    void forecast(int noutput_items, gr_vector_int &ninput_items_required);
+    int general_work(int noutput_items,
+           gr_vector_int &ninput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+
+    /// 0 passes all audio
+    void set_required_tone(float tone);
+    /// 0 when no tone is detected
+    float get_tone();
+    /// DCS code as its octal digits read in decimal, 0 when none is detected
+    int get_dcs_code();
+
+private:
+    void process_decimated(float sample);
+    void goertzel_done();
+    void dcs_bit(int bit);
+
+    int _decimation;
+    int _decim_count;
+    float _decim_rate;
+    /// two cascaded biquad low pass sections
+    float _b[3];
+    float _a[2];
+    float _z[2][2];
+
+    std::vector<float> _tones;
+    std::vector<float> _coeff;
+    std::vector<float> _s1;
+    std::vector<float> _s2;
+    int _block_len;
+    int _block_count;
+    float _energy;
+    int _candidate;
+    int _current;
+
+    float _dc;
+    float _last_sample;
+    float _dcs_phase;
+    float _dcs_step;
+    unsigned int _dcs_reg;
+    std::vector<unsigned int> _dcs_words;
+    std::vector<int> _dcs_codes;
+    std::vector<uint64_t> _dcs_last_match;
+    std::vector<int> _dcs_hits;
+    int _dcs_match;
+    uint64_t _dcs_bit_count;
+
+    std::atomic<float> _required_tone;
+    std::atomic<float> _detected_tone;
+    std::atomic<int> _detected_dcs;
+};
+
+#endif // GR_TONE_DETECTOR_FF_H
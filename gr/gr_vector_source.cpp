@@ -63,6 +63,19 @@ int gr_vector_source::set_data(std::vector<unsigned char> *data)
     }
 }
 
+void gr_vector_source::append_data(const unsigned char *data, unsigned int size)
+{
+    gr::thread::scoped_lock guard(_mutex);
+    _data->insert(_data->end(), data, data + size);
+    _finished = false;
+}
+
+unsigned int gr_vector_source::get_queued()
+{
+    gr::thread::scoped_lock guard(_mutex);
+    return (unsigned int)_data->size() - _offset;
+}
+
 int gr_vector_source::work(int noutput_items,
        gr_vector_const_void_star &input_items,
        gr_vector_void_star &output_items)
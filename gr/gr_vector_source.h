@@ -39,6 +39,10 @@ public:
            gr_vector_void_star &output_items);
 
     int set_data(std::vector<unsigned char> *data);
+    /// Appends to the data being sent, even if sending is in progress
+    void append_data(const unsigned char *data, unsigned int size);
+    /// Bytes not yet sent
+    unsigned int get_queued();
     void flush();
 private:
     unsigned _offset;
@@ -0,0 +1,40 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "gr_viterbi_k7_bb.h"
+
+gr_viterbi_k7_bb_sptr make_gr_viterbi_k7_bb()
+{
+    return gnuradio::get_initial_sptr(new gr_viterbi_k7_bb);
+}
+
+gr_viterbi_k7_bb::gr_viterbi_k7_bb() :
+    gr::sync_decimator("gr_viterbi_k7_bb",
+                       gr::io_signature::make (1, 1, sizeof (unsigned char)),
+                       gr::io_signature::make (1, 1, sizeof (unsigned char)), 2)
+{
+}
+
+int gr_viterbi_k7_bb::work(int noutput_items,
+       gr_vector_const_void_star &input_items,
+       gr_vector_void_star &output_items)
+{
+    const unsigned char *in = (const unsigned char*)(input_items[0]);
+    unsigned char *out = (unsigned char*)(output_items[0]);
+    _decoder.decode(in, noutput_items, out);
+    return noutput_items;
+}
@@ -0,0 +1,44 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef GR_VITERBI_K7_BB_H
+#define GR_VITERBI_K7_BB_H
+
+#include <gnuradio/sync_decimator.h>
+#include <gnuradio/io_signature.h>
+#include "viterbi_k7.h"
+
+class gr_viterbi_k7_bb;
+typedef boost::shared_ptr<gr_viterbi_k7_bb> gr_viterbi_k7_bb_sptr;
+
+gr_viterbi_k7_bb_sptr make_gr_viterbi_k7_bb();
+
+/// Replaces gr::fec::decoder around cc_decoder(80, 7, 2, {109, 79}) for the
+/// same code, decodes the soft symbol stream continuously instead of in 80 bit frames
+class gr_viterbi_k7_bb : public gr::sync_decimator
+{
+public:
+    gr_viterbi_k7_bb();
+    int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+
+private:
+    viterbi_k7_decoder _decoder;
+};
+
+#endif // GR_VITERBI_K7_BB_H
@@ -0,0 +1,338 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "viterbi_k7.h"
+#include <string.h>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+#include <immintrin.h>
+#define VITERBI_K7_X86 1
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define VITERBI_K7_NEON 1
+#endif
+
+/// 6*(K-1) steps like the cc_decoder lookahead, keeps latency low
+static const int VITERBI_K7_DEPTH = 36;
+static const int VITERBI_K7_CHUNK = 32;
+static const int VITERBI_K7_STEPS = VITERBI_K7_DEPTH + VITERBI_K7_CHUNK;
+static const int VITERBI_K7_POLY0 = 109;
+static const int VITERBI_K7_POLY1 = 79;
+/// must hold the primed delay plus two chunks
+static const unsigned int VITERBI_K7_FIFO = 256;
+
+
+static void acs_generic(int16_t *metrics, const unsigned char *soft, int nsteps,
+                        uint32_t *decisions, const int16_t *bt0, const int16_t *bt1)
+{
+    int16_t next[64];
+    for(int k=0;k<nsteps;k++)
+    {
+        int16_t s0 = soft[2*k];
+        int16_t s1 = soft[2*k+1];
+        uint32_t dec_even = 0;
+        uint32_t dec_odd = 0;
+        for(int i=0;i<32;i++)
+        {
+            int16_t bm = (int16_t)((((bt0[i] ^ s0) + (bt1[i] ^ s1)) + 1) >> 1);
+            int16_t cbm = 255 - bm;
+            int16_t a = metrics[i];
+            int16_t b = metrics[i+32];
+            int16_t m0 = a + bm;
+            int16_t m1 = b + cbm;
+            int16_t m2 = a + cbm;
+            int16_t m3 = b + bm;
+            next[2*i] = (m0 > m1) ? m1 : m0;
+            next[2*i+1] = (m2 > m3) ? m3 : m2;
+            dec_even |= (uint32_t)(m0 > m1) << i;
+            dec_odd |= (uint32_t)(m2 > m3) << i;
+        }
+        int16_t base = next[0];
+        for(int i=0;i<64;i++)
+            metrics[i] = next[i] - base;
+        decisions[2*k] = dec_even;
+        decisions[2*k+1] = dec_odd;
+    }
+}
+
+#ifdef VITERBI_K7_X86
+static void acs_sse2(int16_t *metrics, const unsigned char *soft, int nsteps,
+                     uint32_t *decisions, const int16_t *bt0, const int16_t *bt1)
+{
+    __m128i m[8];
+    __m128i t0[4];
+    __m128i t1[4];
+    for(int j=0;j<8;j++)
+        m[j] = _mm_load_si128((const __m128i*)(metrics + 8*j));
+    for(int j=0;j<4;j++)
+    {
+        t0[j] = _mm_load_si128((const __m128i*)(bt0 + 8*j));
+        t1[j] = _mm_load_si128((const __m128i*)(bt1 + 8*j));
+    }
+    const __m128i v255 = _mm_set1_epi16(255);
+    const __m128i one = _mm_set1_epi16(1);
+    for(int k=0;k<nsteps;k++)
+    {
+        __m128i s0 = _mm_set1_epi16(soft[2*k]);
+        __m128i s1 = _mm_set1_epi16(soft[2*k+1]);
+        __m128i n[8];
+        __m128i de[4];
+        __m128i dd[4];
+        for(int j=0;j<4;j++)
+        {
+            __m128i bm = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(
+                            _mm_xor_si128(t0[j], s0), _mm_xor_si128(t1[j], s1)), one), 1);
+            __m128i cbm = _mm_sub_epi16(v255, bm);
+            __m128i m0 = _mm_add_epi16(m[j], bm);
+            __m128i m1 = _mm_add_epi16(m[j+4], cbm);
+            __m128i m2 = _mm_add_epi16(m[j], cbm);
+            __m128i m3 = _mm_add_epi16(m[j+4], bm);
+            __m128i even = _mm_min_epi16(m0, m1);
+            __m128i odd = _mm_min_epi16(m2, m3);
+            de[j] = _mm_cmpgt_epi16(m0, m1);
+            dd[j] = _mm_cmpgt_epi16(m2, m3);
+            n[2*j] = _mm_unpacklo_epi16(even, odd);
+            n[2*j+1] = _mm_unpackhi_epi16(even, odd);
+        }
+        decisions[2*k] = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(de[0], de[1])) |
+                ((uint32_t)_mm_movemask_epi8(_mm_packs_epi16(de[2], de[3])) << 16);
+        decisions[2*k+1] = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(dd[0], dd[1])) |
+                ((uint32_t)_mm_movemask_epi8(_mm_packs_epi16(dd[2], dd[3])) << 16);
+        __m128i base = _mm_set1_epi16((int16_t)_mm_cvtsi128_si32(n[0]));
+        for(int j=0;j<8;j++)
+            m[j] = _mm_sub_epi16(n[j], base);
+    }
+    for(int j=0;j<8;j++)
+        _mm_store_si128((__m128i*)(metrics + 8*j), m[j]);
+}
+
+__attribute__((target("avx2")))
+static void acs_avx2(int16_t *metrics, const unsigned char *soft, int nsteps,
+                     uint32_t *decisions, const int16_t *bt0, const int16_t *bt1)
+{
+    __m256i m[4];
+    __m256i t0[2];
+    __m256i t1[2];
+    for(int j=0;j<4;j++)
+        m[j] = _mm256_load_si256((const __m256i*)(metrics + 16*j));
+    for(int j=0;j<2;j++)
+    {
+        t0[j] = _mm256_load_si256((const __m256i*)(bt0 + 16*j));
+        t1[j] = _mm256_load_si256((const __m256i*)(bt1 + 16*j));
+    }
+    const __m256i v255 = _mm256_set1_epi16(255);
+    const __m256i one = _mm256_set1_epi16(1);
+    for(int k=0;k<nsteps;k++)
+    {
+        __m256i s0 = _mm256_set1_epi16(soft[2*k]);
+        __m256i s1 = _mm256_set1_epi16(soft[2*k+1]);
+        __m256i n[4];
+        __m256i de[2];
+        __m256i dd[2];
+        for(int j=0;j<2;j++)
+        {
+            __m256i bm = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(
+                            _mm256_xor_si256(t0[j], s0), _mm256_xor_si256(t1[j], s1)), one), 1);
+            __m256i cbm = _mm256_sub_epi16(v255, bm);
+            __m256i m0 = _mm256_add_epi16(m[j], bm);
+            __m256i m1 = _mm256_add_epi16(m[j+2], cbm);
+            __m256i m2 = _mm256_add_epi16(m[j], cbm);
+            __m256i m3 = _mm256_add_epi16(m[j+2], bm);
+            __m256i even = _mm256_min_epi16(m0, m1);
+            __m256i odd = _mm256_min_epi16(m2, m3);
+            de[j] = _mm256_cmpgt_epi16(m0, m1);
+            dd[j] = _mm256_cmpgt_epi16(m2, m3);
+            /// unpack works per 128 bit lane, put the states back in order
+            __m256i lo = _mm256_unpacklo_epi16(even, odd);
+            __m256i hi = _mm256_unpackhi_epi16(even, odd);
+            n[2*j] = _mm256_permute2x128_si256(lo, hi, 0x20);
+            n[2*j+1] = _mm256_permute2x128_si256(lo, hi, 0x31);
+        }
+        decisions[2*k] = (uint32_t)_mm256_movemask_epi8(
+                    _mm256_permute4x64_epi64(_mm256_packs_epi16(de[0], de[1]), 0xD8));
+        decisions[2*k+1] = (uint32_t)_mm256_movemask_epi8(
+                    _mm256_permute4x64_epi64(_mm256_packs_epi16(dd[0], dd[1]), 0xD8));
+        __m256i base = _mm256_broadcastw_epi16(_mm256_castsi256_si128(n[0]));
+        for(int j=0;j<4;j++)
+            m[j] = _mm256_sub_epi16(n[j], base);
+    }
+    for(int j=0;j<4;j++)
+        _mm256_store_si256((__m256i*)(metrics + 16*j), m[j]);
+}
+#endif
+
+#ifdef VITERBI_K7_NEON
+static inline uint32_t neon_movemask(uint16x8_t mask)
+{
+    static const uint16_t weights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    return vaddvq_u16(vandq_u16(mask, vld1q_u16(weights)));
+}
+
+static void acs_neon(int16_t *metrics, const unsigned char *soft, int nsteps,
+                     uint32_t *decisions, const int16_t *bt0, const int16_t *bt1)
+{
+    int16x8_t m[8];
+    int16x8_t t0[4];
+    int16x8_t t1[4];
+    for(int j=0;j<8;j++)
+        m[j] = vld1q_s16(metrics + 8*j);
+    for(int j=0;j<4;j++)
+    {
+        t0[j] = vld1q_s16(bt0 + 8*j);
+        t1[j] = vld1q_s16(bt1 + 8*j);
+    }
+    const int16x8_t v255 = vdupq_n_s16(255);
+    const int16x8_t one = vdupq_n_s16(1);
+    for(int k=0;k<nsteps;k++)
+    {
+        int16x8_t s0 = vdupq_n_s16(soft[2*k]);
+        int16x8_t s1 = vdupq_n_s16(soft[2*k+1]);
+        int16x8_t n[8];
+        uint32_t dec_even = 0;
+        uint32_t dec_odd = 0;
+        for(int j=0;j<4;j++)
+        {
+            int16x8_t bm = vshrq_n_s16(vaddq_s16(vaddq_s16(
+                            veorq_s16(t0[j], s0), veorq_s16(t1[j], s1)), one), 1);
+            int16x8_t cbm = vsubq_s16(v255, bm);
+            int16x8_t m0 = vaddq_s16(m[j], bm);
+            int16x8_t m1 = vaddq_s16(m[j+4], cbm);
+            int16x8_t m2 = vaddq_s16(m[j], cbm);
+            int16x8_t m3 = vaddq_s16(m[j+4], bm);
+            int16x8x2_t zipped = vzipq_s16(vminq_s16(m0, m1), vminq_s16(m2, m3));
+            n[2*j] = zipped.val[0];
+            n[2*j+1] = zipped.val[1];
+            dec_even |= neon_movemask(vcgtq_s16(m0, m1)) << (8*j);
+            dec_odd |= neon_movemask(vcgtq_s16(m2, m3)) << (8*j);
+        }
+        decisions[2*k] = dec_even;
+        decisions[2*k+1] = dec_odd;
+        int16x8_t base = vdupq_n_s16(vgetq_lane_s16(n[0], 0));
+        for(int j=0;j<8;j++)
+            m[j] = vsubq_s16(n[j], base);
+    }
+    for(int j=0;j<8;j++)
+        vst1q_s16(metrics + 8*j, m[j]);
+}
+#endif
+
+static int parity(int x)
+{
+    x ^= x >> 4;
+    x ^= x >> 2;
+    x ^= x >> 1;
+    return x & 1;
+}
+
+viterbi_k7_decoder::viterbi_k7_decoder()
+{
+    /// 32 byte alignment for the vector loads
+    _memory.resize(3 * 64 * sizeof(int16_t) + 32);
+    uintptr_t aligned = ((uintptr_t)_memory.data() + 31) & ~(uintptr_t)31;
+    _metrics = (int16_t*)aligned;
+    _bt0 = _metrics + 64;
+    _bt1 = _bt0 + 64;
+    for(int i=0;i<32;i++)
+    {
+        _bt0[i] = parity((2*i) & VITERBI_K7_POLY0) ? 255 : 0;
+        _bt1[i] = parity((2*i) & VITERBI_K7_POLY1) ? 255 : 0;
+    }
+    _decisions.resize(2 * VITERBI_K7_STEPS);
+    _fifo.resize(VITERBI_K7_FIFO);
+
+    _acs = &acs_generic;
+    _kernel_name = "generic";
+#ifdef VITERBI_K7_X86
+    _acs = &acs_sse2;
+    _kernel_name = "sse2";
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        _acs = &acs_avx2;
+        _kernel_name = "avx2";
+    }
+#endif
+#ifdef VITERBI_K7_NEON
+    _acs = &acs_neon;
+    _kernel_name = "neon";
+#endif
+    reset();
+}
+
+void viterbi_k7_decoder::reset()
+{
+    /// unbiased start, the decoder may join the stream anywhere
+    for(int i=0;i<64;i++)
+        _metrics[i] = 0;
+    _steps = 0;
+    _fifo_read = 0;
+    _fifo_write = 0;
+    /// primed with the pipeline delay so output keeps pace with input
+    for(int i=0;i<VITERBI_K7_STEPS;i++)
+        _fifo[_fifo_write++ % VITERBI_K7_FIFO] = 0;
+}
+
+const char *viterbi_k7_decoder::kernel_name()
+{
+    return _kernel_name;
+}
+
+void viterbi_k7_decoder::traceback()
+{
+    int state = 0;
+    int16_t best = _metrics[0];
+    for(int i=1;i<64;i++)
+    {
+        if(_metrics[i] < best)
+        {
+            best = _metrics[i];
+            state = i;
+        }
+    }
+    unsigned char bits[VITERBI_K7_CHUNK];
+    for(int k=VITERBI_K7_STEPS-1;k>=0;k--)
+    {
+        if(k < VITERBI_K7_CHUNK)
+            bits[k] = state & 1;
+        uint32_t decision = _decisions[2*k + (state & 1)];
+        state = (state >> 1) | (((decision >> (state >> 1)) & 1) << 5);
+    }
+    for(int k=0;k<VITERBI_K7_CHUNK;k++)
+        _fifo[_fifo_write++ % VITERBI_K7_FIFO] = bits[k];
+    memmove(_decisions.data(), _decisions.data() + 2 * VITERBI_K7_CHUNK,
+            2 * VITERBI_K7_DEPTH * sizeof(uint32_t));
+    _steps = VITERBI_K7_DEPTH;
+}
+
+void viterbi_k7_decoder::decode(const unsigned char *soft, int npairs, unsigned char *out)
+{
+    int pos = 0;
+    int popped = 0;
+    while(pos < npairs)
+    {
+        int n = std::min(npairs - pos, VITERBI_K7_STEPS - _steps);
+        _acs(_metrics, soft + 2 * pos, n, _decisions.data() + 2 * _steps, _bt0, _bt1);
+        _steps += n;
+        pos += n;
+        if(_steps == VITERBI_K7_STEPS)
+            traceback();
+        while((popped < pos) && (_fifo_read != _fifo_write))
+            out[popped++] = _fifo[_fifo_read++ % VITERBI_K7_FIFO];
+    }
+}
@@ -0,0 +1,60 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef VITERBI_K7_H
+#define VITERBI_K7_H
+
+#include <stdint.h>
+#include <vector>
+
+/// Add-compare-select over nsteps symbol pairs, one kernel per instruction set
+typedef void (*viterbi_k7_acs_fn)(int16_t *metrics, const unsigned char *soft, int nsteps,
+                                  uint32_t *decisions, const int16_t *bt0, const int16_t *bt1);
+
+/// Streaming K=7 rate 1/2 Viterbi decoder for the 109/79 code used by the
+/// gr_mod_*_sdr encoders. Soft symbols are 0..255 with 128 as erasure, as
+/// the gr-fec cc_decoder takes them.
+/// Decisions are traced back in chunks of VITERBI_K7_CHUNK bits with
+/// VITERBI_K7_DEPTH extra steps, and every input pair yields exactly one
+/// output bit, VITERBI_K7_DEPTH + VITERBI_K7_CHUNK bits late.
+class viterbi_k7_decoder
+{
+public:
+    viterbi_k7_decoder();
+
+    void reset();
+    /// Decodes npairs symbol pairs from soft into npairs unpacked bits
+    void decode(const unsigned char *soft, int npairs, unsigned char *out);
+    const char *kernel_name();
+
+private:
+    void traceback();
+
+    viterbi_k7_acs_fn _acs;
+    const char *_kernel_name;
+    int _steps;
+    unsigned int _fifo_read;
+    unsigned int _fifo_write;
+    int16_t *_metrics;
+    int16_t *_bt0;
+    int16_t *_bt1;
+    std::vector<uint32_t> _decisions;
+    std::vector<unsigned char> _fifo;
+    std::vector<unsigned char> _memory;
+};
+
+#endif // VITERBI_K7_H
@@ -14,8 +14,12 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#ifndef HEADLESS_DAEMON
 #include <QApplication>
+#endif
 #include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QThread>
 #include <QDebug>
 #include <QObject>
@@ -24,27 +28,39 @@
 #include <QMetaType>
 #include <QtGlobal>
 #include <string>
+#ifndef HEADLESS_DAEMON
 #include "mainwindow.h"
+#endif
 #include "src/mumbleclient.h"
+#include "src/voiplinks.h"
 #include "audio/audiowriter.h"
 #include "audio/audioreader.h"
 #include "src/mumblechannel.h"
 #include "src/radiochannel.h"
 #include "src/radiocontroller.h"
 #include "src/telnetserver.h"
+#include "src/remoteserver.h"
+#include "src/telemetry.h"
+#include "src/threadscheduler.h"
 #include "src/logger.h"
 
 void connectIndependentSignals(AudioWriter *audiowriter, AudioReader *audioreader,
                                RadioController *radio_op, MumbleClient *mumbleclient);
-void connectGuiSignals(TelnetServer *telnet_server, AudioWriter *audiowriter,
-                       AudioReader *audioreader, MainWindow *w, MumbleClient *mumbleclient,
-                       RadioController *radio_op, Logger *logger);
+#ifndef HEADLESS_DAEMON
+void connectGuiSignals(TelnetServer *telnet_server, RemoteServer *remote_server,
+                       AudioWriter *audiowriter, AudioReader *audioreader, MainWindow *w,
+                       MumbleClient *mumbleclient, RadioController *radio_op, Logger *logger);
+#endif
 void connectCommandSignals(TelnetServer *telnet_server, MumbleClient *mumbleclient,
                        RadioController *radio_op);
+void connectVoipLinks(VoipLinks *voip_links, RadioController *radio_op);
+long residentMemoryKb();
 class Station;
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startup_timer;
+    startup_timer.start();
 
     typedef QVector<Station*> StationList;
     qRegisterMetaType<StationList>("StationList");
@@ -57,6 +73,12 @@ int main(int argc, char *argv[])
     qRegisterMetaType<std::string>("std::string");
 
 
+#ifdef HEADLESS_DAEMON
+    /// no widgets, no display connection
+    QCoreApplication a(argc, argv);
+    bool headless = true;
+    Logger *logger = new Logger;
+#else
     QApplication a(argc, argv);
     QStringList arguments = QCoreApplication::arguments();
     bool headless = false;
@@ -67,19 +89,39 @@ int main(int argc, char *argv[])
         logger->set_console_log(false);
         headless = true;
     }
+#endif
 
     /// Init main logic
     ///
     logger->log(Logger::LogLevelInfo, "Starting qradiolink");
     Settings *settings = new Settings(logger);
     settings->readConfig();
+    logger->set_log_level(settings->log_level);
+    logger->set_output_format(settings->log_format);
+    logger->set_rate_limit(settings->log_rate_limit);
+#ifndef HEADLESS_DAEMON
+    /// nobody looks at the spectrum or constellation on a headless node,
+    /// they can still be turned on remotely
+    int show_fft = settings->show_fft;
+    int show_constellation = settings->show_constellation;
+    if(headless)
+    {
+        settings->show_fft = 0;
+        settings->show_constellation = 0;
+    }
+#endif
     RadioChannels *radio_channels = new RadioChannels(logger);
     radio_channels->readConfig();
     MumbleClient *mumbleclient = new MumbleClient(settings, logger);
-    RadioController *radio_op = new RadioController(settings, logger, radio_channels);
+    VoipLinks *voip_links = new VoipLinks(settings, logger);
+    Telemetry *telemetry = new Telemetry;
+    ThreadScheduler *thread_scheduler = new ThreadScheduler(settings, logger, telemetry);
+    RadioController *radio_op = new RadioController(settings, logger, radio_channels, telemetry);
     AudioWriter *audiowriter = new AudioWriter(settings, logger);
     AudioReader *audioreader = new AudioReader(settings, logger);
-    TelnetServer *telnet_server = new TelnetServer(settings, logger);
+    TelnetServer *telnet_server = new TelnetServer(settings, logger, telemetry);
+    RemoteServer *remote_server = new RemoteServer(settings, logger,
+                                                   telnet_server->command_processor, telemetry);
 
 
     /// Init threads
@@ -111,13 +153,14 @@ int main(int argc, char *argv[])
     QObject::connect(t3, SIGNAL(finished()), t3, SLOT(deleteLater()));
     t3->start();
 
+#ifndef HEADLESS_DAEMON
     MainWindow *w;
     if(!headless)
     {
         /// Init GUI
         ///
         w = new MainWindow(settings, logger, radio_channels);
-        connectGuiSignals(telnet_server, audiowriter, audioreader, w,
+        connectGuiSignals(telnet_server, remote_server, audiowriter, audioreader, w,
                           mumbleclient, radio_op, logger);
         /// requires the slots to be set up
         w->initSettings();
@@ -132,29 +175,56 @@ int main(int argc, char *argv[])
         w->activateWindow();
         w->raise();
     }
+#endif
 
     /// Connect non-GUI signals
     ///
     connectCommandSignals(telnet_server, mumbleclient, radio_op);
+    QObject::connect(remote_server,SIGNAL(enableGUIFFT(bool)),radio_op,SLOT(enableGUIFFT(bool)));
+    QObject::connect(remote_server,SIGNAL(enableGUIConst(bool)),radio_op,SLOT(enableGUIConst(bool)));
 
     /// Signals independent of GUI or remote interface
     connectIndependentSignals(audiowriter, audioreader, radio_op, mumbleclient);
+    connectVoipLinks(voip_links, radio_op);
+    voip_links->start();
+    /// after the worker threads were created, they don't inherit the main profile
+    ThreadScheduler::applyProfile(settings, logger, "main");
+    thread_scheduler->start();
 
 
     /// Start remote command listener
     if(headless)
+    {
         telnet_server->start();
+        remote_server->start();
+    }
+
+    logger->log(Logger::LogLevelInfo, QString("Startup took %1 ms, resident memory %2 kB").arg(
+                    startup_timer.elapsed()).arg(residentMemoryKb()));
 
     int ret = a.exec();
 
     /// Cleanup on exit
     ///
+#ifndef HEADLESS_DAEMON
     if(!headless)
         delete w;
+#endif
+    delete remote_server;
     delete telnet_server;
+    delete thread_scheduler;
+    delete telemetry;
+    delete voip_links;
     delete mumbleclient;
     radio_channels->saveConfig();
     delete radio_channels;
+#ifndef HEADLESS_DAEMON
+    if(headless)
+    {
+        settings->show_fft = show_fft;
+        settings->show_constellation = show_constellation;
+    }
+#endif
     settings->saveConfig();
     delete settings;
     logger->log(Logger::LogLevelInfo, "Stopping qradiolink");
@@ -165,22 +235,23 @@ int main(int argc, char *argv[])
 void connectIndependentSignals(AudioWriter *audiowriter, AudioReader *audioreader,
                                RadioController *radio_op, MumbleClient *mumbleclient)
 {
+    /// writePCM fills the lock-free playout ring from the radio thread
     QObject::connect(radio_op, SIGNAL(writePCM(short*,int,bool,int)),
-                     audiowriter, SLOT(writePCM(short*,int,bool, int)));
+                     audiowriter, SLOT(writePCM(short*,int,bool, int)), Qt::DirectConnection);
     QObject::connect(radio_op, SIGNAL(recordAudio(bool)),
                      audiowriter, SLOT(recordAudio(bool)));
-    QObject::connect(radio_op, SIGNAL(setAudioReadMode(bool,bool,int)),
-                     audioreader, SLOT(setReadMode(bool,bool,int)));
-    QObject::connect(audioreader, SIGNAL(audioPCM(short*,int,int, bool)),
-                     radio_op, SLOT(txAudio(short*,int,int, bool)));
-    QObject::connect(radio_op, SIGNAL(voipDataOpus(unsigned char*,int)),
-                     mumbleclient, SLOT(processOpusAudio(unsigned char*, int)));
+    QObject::connect(radio_op, SIGNAL(setAudioReadMode(bool,bool,int,int)),
+                     audioreader, SLOT(setReadMode(bool,bool,int,int)));
+    QObject::connect(audioreader, SIGNAL(audioPCM(QByteArray,int,bool)),
+                     radio_op, SLOT(txAudioFrame(QByteArray,int,bool)));
+    QObject::connect(radio_op, SIGNAL(voipDataOpus(QByteArray,int)),
+                     mumbleclient, SLOT(processOpusAudio(QByteArray,int)));
     QObject::connect(radio_op, SIGNAL(voipVideoData(unsigned char*,int)),
                      mumbleclient, SLOT(processVideoFrame(unsigned char*, int)));
     QObject::connect(radio_op, SIGNAL(voipDataPCM(short*,int)),
                      mumbleclient, SLOT(processPCMAudio(short*,int)));
-    QObject::connect(mumbleclient, SIGNAL(pcmAudio(short*,int,quint64)),
-                     radio_op, SLOT(processVoipAudioFrame(short*, int, quint64)));
+    QObject::connect(mumbleclient, SIGNAL(pcmAudio(QByteArray,quint64)),
+                     radio_op, SLOT(processVoipAudioFrame(QByteArray,quint64)));
     QObject::connect(mumbleclient, SIGNAL(videoFrame(unsigned char*,int,quint64)),
                      radio_op, SLOT(processVoipVideoFrame(unsigned char*,int,quint64)));
     QObject::connect(mumbleclient,SIGNAL(newChannels(ChannelList)),
@@ -194,6 +265,20 @@ void connectIndependentSignals(AudioWriter *audiowriter, AudioReader *audioreade
 }
 
 
+void connectVoipLinks(VoipLinks *voip_links, RadioController *radio_op)
+{
+    /// every session gets the same encoded packets, incoming audio
+    /// goes to the radio mixer like the primary session
+    QVector<MumbleClient*> clients = voip_links->getClients();
+    for(int i=0;i<clients.size();i++)
+    {
+        QObject::connect(radio_op, SIGNAL(voipDataOpus(QByteArray,int)),
+                         clients.at(i), SLOT(processOpusAudio(QByteArray,int)));
+        QObject::connect(clients.at(i), SIGNAL(pcmAudio(QByteArray,quint64)),
+                         radio_op, SLOT(processVoipAudioFrame(QByteArray,quint64)));
+    }
+}
+
 void connectCommandSignals(TelnetServer *telnet_server, MumbleClient *mumbleclient,
                        RadioController *radio_op)
 {
@@ -289,6 +374,8 @@ void connectCommandSignals(TelnetServer *telnet_server, MumbleClient *mumbleclie
                      radio_op,SLOT(startMemoryScan(int)));
     QObject::connect(telnet_server->command_processor,SIGNAL(stopMemoryTune()),
                      radio_op,SLOT(stopMemoryScan()));
+    QObject::connect(telnet_server->command_processor,SIGNAL(tuneMemoryChannel(int)),
+                     radio_op,SLOT(tuneMemoryChannel(int)));
     QObject::connect(telnet_server->command_processor,SIGNAL(setVoxLevel(int)),
                      radio_op,SLOT(setVoxLevel(int)));
     QObject::connect(telnet_server->command_processor,SIGNAL(setVoipBitrate(int)),
@@ -297,16 +384,37 @@ void connectCommandSignals(TelnetServer *telnet_server, MumbleClient *mumbleclie
                      radio_op,SLOT(setMuteForwardedAudio(bool)));
     QObject::connect(telnet_server->command_processor,SIGNAL(setAudioRecord(bool)),
                      radio_op,SLOT(setAudioRecord(bool)));
+    QObject::connect(telnet_server->command_processor,SIGNAL(setIQRecord(bool)),
+                     radio_op,SLOT(setIQRecord(bool)));
     QObject::connect(telnet_server->command_processor,SIGNAL(setTxLimits(bool)),
                      radio_op,SLOT(setTxLimits(bool)));
     QObject::connect(mumbleclient,SIGNAL(commandMessage(QString,int)),
                      telnet_server->command_processor,SLOT(parseMumbleMessage(QString,int)));
 }
 
+/// VmRSS of this process, 0 if /proc is not available
+long residentMemoryKb()
+{
+    QFile status("/proc/self/status");
+    if(!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return 0;
+    while(!status.atEnd())
+    {
+        QString line = QString(status.readLine());
+        if(line.startsWith("VmRSS:"))
+        {
+            status.close();
+            return line.mid(6).remove("kB").trimmed().toLong();
+        }
+    }
+    status.close();
+    return 0;
+}
 
-void connectGuiSignals(TelnetServer *telnet_server, AudioWriter *audiowriter,
-                       AudioReader *audioreader, MainWindow *w, MumbleClient *mumbleclient,
-                       RadioController *radio_op, Logger *logger)
+#ifndef HEADLESS_DAEMON
+void connectGuiSignals(TelnetServer *telnet_server, RemoteServer *remote_server,
+                       AudioWriter *audiowriter, AudioReader *audioreader, MainWindow *w,
+                       MumbleClient *mumbleclient, RadioController *radio_op, Logger *logger)
 {
     /// GUI to radio and Mumble
     QObject::connect(w,SIGNAL(startTransmission()),radio_op,SLOT(startTransmission()));
@@ -381,6 +489,9 @@ void connectGuiSignals(TelnetServer *telnet_server, AudioWriter *audiowriter,
     QObject::connect(w,SIGNAL(terminateConnections()),telnet_server,SLOT(stop()));
     QObject::connect(w,SIGNAL(disableRemote()),telnet_server,SLOT(stop()));
     QObject::connect(w,SIGNAL(enableRemote()),telnet_server,SLOT(start()));
+    QObject::connect(w,SIGNAL(terminateConnections()),remote_server,SLOT(stop()));
+    QObject::connect(w,SIGNAL(disableRemote()),remote_server,SLOT(stop()));
+    QObject::connect(w,SIGNAL(enableRemote()),remote_server,SLOT(start()));
     QObject::connect(w,SIGNAL(setMute(bool)),mumbleclient,SLOT(setMute(bool)));
     QObject::connect(w,SIGNAL(changeChannel(int)),mumbleclient,SLOT(joinChannel(int)));
     QObject::connect(w,SIGNAL(newMumbleMessage(QString)),
@@ -409,6 +520,7 @@ void connectGuiSignals(TelnetServer *telnet_server, AudioWriter *audiowriter,
     QObject::connect(radio_op, SIGNAL(newFFTData(float*,int)),
                      w, SLOT(newFFTData(float*,int)));
     QObject::connect(radio_op, SIGNAL(newRSSIValue(float)), w, SLOT(updateRSSI(float)));
+    QObject::connect(radio_op, SIGNAL(newDetectedTone(float,int)), w, SLOT(updateDetectedTone(float,int)));
     QObject::connect(radio_op, SIGNAL(newConstellationData(complex_vector*)),
                      w, SLOT(updateConstellation(complex_vector*)));
     QObject::connect(radio_op, SIGNAL(initError(QString)), w, SLOT(initError(QString)));
@@ -433,3 +545,4 @@ void connectGuiSignals(TelnetServer *telnet_server, AudioWriter *audiowriter,
     QObject::connect(mumbleclient,SIGNAL(disconnected()),w,SLOT(disconnectedFromServer()));
     QObject::connect(logger,SIGNAL(applicationLog(QString)),w,SLOT(applicationLog(QString)));
 }
+#endif
@@ -1616,6 +1616,17 @@ void MainWindow::updateRSSI(float value)
     ui->labelSMeter->setPixmap(s_meter);
 }
 
+void MainWindow::updateDetectedTone(float tone, int dcs_code)
+{
+    /// shown on the "off" entry, so the index does not change
+    QString text = "CTCSS";
+    if(tone > 0.0f)
+        text = QString("CTCSS %1").arg(tone, 0, 'f', 1);
+    else if(dcs_code > 0)
+        text = QString("DCS %1").arg(dcs_code, 3, 10, QChar('0'));
+    ui->comboBoxRxCTCSS->setItemText(0, text);
+}
+
 void MainWindow::updateSampleRate()
 {
     int samp_rate = ui->sampleRateBox->currentText().toInt();
@@ -118,6 +118,7 @@ public slots:
     void setEnabledDuplex(bool value);
     void setPeakDetect(bool value);
     void updateRSSI(float value);
+    void updateDetectedTone(float tone, int dcs_code);
     void updateConstellation(complex_vector* constellation_data);
     void newWaterfallFPS();
     void updateSampleRate();
@@ -43,9 +43,23 @@ CONFIG(qtaudio) {
     LIBS += -lpulse-simple -lpulse
 }
 
+CONFIG(headless) {
+    message(Building the qradiolinkd headless daemon)
+    TARGET = qradiolinkd
+    QT -= gui widgets
+    DEFINES += HEADLESS_DAEMON
+} else {
+    SOURCES += mainwindow.cpp \
+        qtgui/freqctrl.cpp \
+        qtgui/plotter.cpp
+    HEADERS += mainwindow.h \
+        qtgui/freqctrl.h \
+        qtgui/plotter.h
+    FORMS += mainwindow.ui
+}
+
 
 SOURCES += main.cpp\
-        mainwindow.cpp\
         audio/audioencoder.cpp\
         audio/audioprocessor.cpp \
         video/videoencoder.cpp \
@@ -53,6 +67,7 @@ SOURCES += main.cpp\
         src/mumbleclient.cpp\
         src/layer2.cpp \
         audio/audiowriter.cpp \
+        audio/audioplayout.cpp \
         audio/audioreader.cpp \
         audio/audiorecorder.cpp \
         src/mumblechannel.cpp \
@@ -61,6 +76,13 @@ SOURCES += main.cpp\
         src/radiocontroller.cpp \
         src/commandprocessor.cpp \
         src/telnetserver.cpp \
+        src/remoteserver.cpp \
+        src/telemetry.cpp \
+        src/voipuplink.cpp \
+        src/voiplinks.cpp \
+        src/threadscheduler.cpp \
+        src/tdmamac.cpp \
+        src/linkarq.cpp \
         src/settings.cpp\
         src/sslclient.cpp\
         src/station.cpp\
@@ -76,10 +98,15 @@ SOURCES += main.cpp\
         ext/snd.c \
         ext/mem.c \
         net/netdevice.cpp \
-    qtgui/freqctrl.cpp \
-    qtgui/plotter.cpp \
     gr/gr_vector_source.cpp \
     gr/gr_vector_sink.cpp \
+    gr/gr_sigmf_sink.cpp \
+    gr/gr_sigmf_source.cpp \
+    gr/gr_block_profiler.cpp \
+    gr/gr_rssi_sink.cpp \
+    gr/gr_tone_detector_ff.cpp \
+    gr/gr_mode_selector.cpp \
+    gr/gr_audio_bridge.cpp \
     gr/gr_demod_bpsk_sdr.cpp \
     gr/gr_mod_bpsk_sdr.cpp \
     gr/gr_mod_qpsk_sdr.cpp \
@@ -100,6 +127,9 @@ SOURCES += main.cpp\
     gr/gr_demod_freedv.cpp \
     gr/gr_mod_freedv.cpp \
     gr/gr_deframer_bb.cpp \
+    gr/gr_aligned_viterbi_bb.cpp \
+    gr/gr_viterbi_k7_bb.cpp \
+    gr/viterbi_k7.cpp \
     gr/gr_audio_source.cpp \
     gr/gr_audio_sink.cpp \
     gr/gr_4fsk_discriminator.cpp \
@@ -110,20 +140,28 @@ SOURCES += main.cpp\
 
 
 
-HEADERS  += mainwindow.h\
-        audio/audioencoder.h\
+HEADERS  += audio/audioencoder.h\
         audio/audioprocessor.h \
         video/videoencoder.h \
         src/layer2.h \
         audio/audiowriter.h \
+        audio/audioplayout.h \
         audio/audioreader.h \
         audio/audiorecorder.h \
         src/mumblechannel.h \
         src/radiochannel.h \
+        src/radioconfig.h \
         src/relaycontroller.h \
         src/commandprocessor.h \
         src/mumbleclient.h\
         src/telnetserver.h \
+        src/remoteserver.h \
+        src/telemetry.h \
+        src/voipuplink.h \
+        src/voiplinks.h \
+        src/threadscheduler.h \
+        src/tdmamac.h \
+        src/linkarq.h \
         src/settings.h\
         src/sslclient.h\
         src/station.h\
@@ -144,10 +182,15 @@ HEADERS  += mainwindow.h\
         ext/compressor.h \
         net/netdevice.h \
         src/radiocontroller.h \
-    qtgui/freqctrl.h \
-    qtgui/plotter.h \
     gr/gr_vector_source.h \
     gr/gr_vector_sink.h \
+    gr/gr_sigmf_sink.h \
+    gr/gr_sigmf_source.h \
+    gr/gr_block_profiler.h \
+    gr/gr_rssi_sink.h \
+    gr/gr_tone_detector_ff.h \
+    gr/gr_mode_selector.h \
+    gr/gr_audio_bridge.h \
     gr/gr_demod_bpsk_sdr.h \
     gr/gr_mod_bpsk_sdr.h \
     gr/gr_mod_qpsk_sdr.h \
@@ -169,6 +212,9 @@ HEADERS  += mainwindow.h\
     gr/gr_mod_freedv.h \
     gr/rx_fft.h \
     gr/gr_deframer_bb.h \
+    gr/gr_aligned_viterbi_bb.h \
+    gr/gr_viterbi_k7_bb.h \
+    gr/viterbi_k7.h \
     gr/gr_audio_source.h \
     gr/gr_audio_sink.h \
     gr/gr_4fsk_discriminator.h \
@@ -189,8 +235,6 @@ HEADERS  += mainwindow.h\
 #CONFIG += link_pkgconfig
 #PKGCONFIG += gnuradio
 
-FORMS    += mainwindow.ui
-
 
 LIBS += -lgnuradio-pmt -lgnuradio-analog -lgnuradio-fft -lgnuradio-vocoder \
         -lgnuradio-osmosdr -lvolk \
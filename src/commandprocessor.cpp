@@ -15,12 +15,18 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "commandprocessor.h"
+#include "linkarq.h"
 
-CommandProcessor::CommandProcessor(const Settings *settings, Logger *logger, QObject *parent)
+/// packets sent through the arqtest loopback
+static const int ARQ_TEST_PACKETS = 1000;
+
+CommandProcessor::CommandProcessor(const Settings *settings, Logger *logger, Telemetry *telemetry,
+                                   QObject *parent)
     : QObject(parent)
 {
     _settings = settings;
     _logger = logger;
+    _telemetry = telemetry;
     _command_list = new QVector<command*>;
     buildCommandList();
     _mode_list = new QVector<QString>;
@@ -141,10 +147,9 @@ QStringList CommandProcessor::getCommand(QString message, int &command_index)
 bool CommandProcessor::validateCommand(QString message)
 {
     QRegularExpression re("^[a-zA-Z0-9_]+[\\sa-zA-Z0-9_.\\-]*\\r?\\n?$");
-    QRegularExpressionValidator validator(re, 0);
-
-    int pos = 0;
-    if(QValidator::Acceptable != validator.validate(message, pos))
+    /// the whole message has to match, like QValidator::Acceptable
+    QRegularExpressionMatch match = re.match(message);
+    if(!match.hasMatch() || (match.capturedLength() != message.length()))
     {
         // regex match failed
         return false;
@@ -290,7 +295,10 @@ bool CommandProcessor::processStatusCommands(int command_index, QString &respons
             response.append(QString("VOX is off."));
         break;
     case 16:
-        if(_settings->repeater_enabled)
+        if(_settings->repeater_enabled && (_settings->repeater_latency > 0))
+            response.append(QString("Repeater is enabled, last latency %1 ms.").arg(
+                                _settings->repeater_latency, 0, 'f', 1));
+        else if(_settings->repeater_enabled)
             response.append(QString("Repeater is enabled."));
         else
             response.append(QString("Repeater is disabled."));
@@ -329,6 +337,94 @@ bool CommandProcessor::processStatusCommands(int command_index, QString &respons
         else
             response.append(QString("TX band limits are disabled."));
         break;
+    case 65:
+        if(_settings->recording_iq)
+            response.append(QString("IQ recording is enabled."));
+        else
+            response.append(QString("IQ recording is disabled."));
+        break;
+    case 67:
+        if(_settings->rx_detected_tone > 0.0f)
+            response.append(QString("Detected CTCSS tone is %1.").arg(_settings->rx_detected_tone));
+        else if(_settings->rx_detected_dcs > 0)
+            response.append(QString("Detected DCS code is %1.").arg(
+                                _settings->rx_detected_dcs, 3, 10, QChar('0')));
+        else
+            response.append(QString("No CTCSS tone or DCS code detected."));
+        break;
+    case 69:
+    {
+        std::vector<float> load;
+        _telemetry->getCoreLoad(load);
+        for(unsigned int i=0;i<load.size();i++)
+            response.append(QString("CPU %1 load %2%.\n").arg(i).arg(load.at(i), 0, 'f', 1));
+        std::vector<Telemetry::deadline> deadlines = _telemetry->getDeadlines();
+        for(unsigned int i=0;i<deadlines.size();i++)
+        {
+            const Telemetry::deadline &d = deadlines.at(i);
+            response.append(QString("%1: %2 cycles, %3 missed %4 usec, worst %5 usec.\n")
+                            .arg(d.name).arg(d.cycles).arg(d.missed).arg(d.budget_usec).arg(d.worst_usec));
+        }
+        break;
+    }
+    case 70:
+    {
+        if(_settings->block_profiler < 1)
+        {
+            response.append("Block profiler is disabled.");
+            break;
+        }
+        std::vector<Telemetry::blockstats> stats = _telemetry->getBlockStats();
+        for(unsigned int i=0;i<stats.size();i++)
+        {
+            const Telemetry::blockstats &block = stats.at(i);
+            response.append(QString("%1 %2: %3% CPU, %4 usec per call, %5 items/s, buffers in %6% out %7%.\n")
+                            .arg(block.tx ? "TX" : "RX").arg(block.name)
+                            .arg(block.cpu_percent, 0, 'f', 1).arg(block.work_usec, 0, 'f', 0)
+                            .arg(block.items_per_sec, 0, 'f', 0).arg(block.input_full * 100, 0, 'f', 0)
+                            .arg(block.output_full * 100, 0, 'f', 0));
+        }
+        if(stats.size() < 1)
+            response.append("No block profile yet.");
+        break;
+    }
+    case 71:
+    {
+        std::vector<Telemetry::bufferstats> stats = _telemetry->getBufferStats();
+        for(unsigned int i=0;i<stats.size();i++)
+        {
+            const Telemetry::bufferstats &buffers = stats.at(i);
+            response.append(QString("%1 %2: %3 bytes, %4 msec, scale %5%6, %7 %8.\n")
+                            .arg(buffers.tx ? "TX" : "RX").arg(_mode_list->at(buffers.mode))
+                            .arg(buffers.bytes).arg(buffers.latency_msec, 0, 'f', 1)
+                            .arg(buffers.scale, 0, 'f', 3).arg(buffers.tuned ? " (tuned)" : "")
+                            .arg(buffers.events).arg(buffers.tx ? "underflows" : "overflows"));
+        }
+        if(stats.size() < 1)
+            response.append("No buffer report yet.");
+        break;
+    }
+    case 72:
+    {
+        Telemetry::tdmastats stats;
+        if(!_telemetry->getTdmaStats(stats))
+        {
+            response.append("TDMA is not running.");
+            break;
+        }
+        if(stats.synced && (stats.slot >= 0))
+            response.append(QString("Synchronized, data slot %1 of %2, guard %3 usec.\n")
+                            .arg(stats.slot).arg(stats.slots).arg(stats.guard_usec));
+        else if(stats.synced)
+            response.append(QString("Synchronized, no data slot, %1 slots in use, %2 requests sent.\n")
+                            .arg(stats.slots).arg(stats.requests));
+        else
+            response.append("Not synchronized, waiting for a beacon.\n");
+        response.append(QString("%1 frames sent, %2 packets sent, %3 received, %4 dropped.")
+                        .arg(stats.frames_sent).arg(stats.packets_sent)
+                        .arg(stats.packets_received).arg(stats.packets_dropped));
+        break;
+    }
 
     default:
         break;
@@ -946,6 +1042,61 @@ bool CommandProcessor::processActionCommands(int command_index, QString &respons
         }
         break;
     }
+    case 66:
+    {
+        int set = param1.toInt();
+        if(set != 0 && set !=1)
+        {
+            response = "Parameter value is not supported";
+            success = false;
+        }
+        else
+        {
+            response = QString("Setting IQ recording to %1").arg(set);
+            emit setIQRecord((bool)set);
+        }
+        break;
+    }
+    case 68:
+    {
+        bool ok;
+        int id = param1.toInt(&ok);
+        if(!ok || (id < 0))
+        {
+            response = "Parameter value is not supported";
+            success = false;
+        }
+        else
+        {
+            response = QString("Tuning to memory channel %1").arg(id);
+            emit tuneMemoryChannel(id);
+        }
+        break;
+    }
+    case 73:
+    {
+        bool ok;
+        float percent = param1.toFloat(&ok);
+        if(!ok || (percent < 0) || (percent >= 100))
+        {
+            response = "Parameter value is not supported";
+            success = false;
+        }
+        else
+        {
+            /// offline, two ARQ endpoints over a channel dropping frames at random
+            LinkArq::loopbackresult result = LinkArq::loopback(percent / 100,
+                                (qint64)_settings->arq_max_delay * 1000, ARQ_TEST_PACKETS);
+            response = QString("ARQ goodput %1 kbit/s, without ARQ %2 kbit/s at %3% frame loss.\n")
+                    .arg(result.goodput_kbps, 0, 'f', 1).arg(result.plain_kbps, 0, 'f', 1)
+                    .arg(percent);
+            response.append(QString("Residual loss %1%, %2 retransmissions per packet, mean delay %3 msec.")
+                    .arg(result.residual_loss * 100, 0, 'f', 2)
+                    .arg(result.retransmit_ratio, 0, 'f', 2)
+                    .arg(result.mean_delay_msec, 0, 'f', 0));
+        }
+        break;
+    }
 
     default:
         break;
@@ -1025,4 +1176,13 @@ void CommandProcessor::buildCommandList()
     _command_list->append(new command("setmuteforwarding", 1, "Toggle local mute status of VOIP forwarded radio, (1 enabled, 0 disabled)"));
     _command_list->append(new command("gettxlimits", 0, "Get status of TX band limiter"));
     _command_list->append(new command("settxlimits", 1, "Toggle TX band limits, (1 enabled, 0 disabled)"));
+    _command_list->append(new command("iqrecordstatus", 0, "Status of SigMF IQ recorder"));
+    _command_list->append(new command("setiqrecorder", 1, "Toggle SigMF IQ recording, (1 enabled, 0 disabled)"));
+    _command_list->append(new command("detectedtone", 0, "Get CTCSS tone or DCS code detected on RX"));
+    _command_list->append(new command("tunememory", 1, "Tune to memory channel, all settings applied at once (integer channel id)"));
+    _command_list->append(new command("schedstats", 0, "Per core load and missed deadlines of the realtime loops"));
+    _command_list->append(new command("blockstats", 0, "CPU use, throughput and buffer fullness of the busiest flowgraph blocks"));
+    _command_list->append(new command("bufferstats", 0, "Memory and latency of the flowgraph buffers for each mode used"));
+    _command_list->append(new command("tdmastats", 0, "Slot, guard time and packet counters of the IP modem TDMA access"));
+    _command_list->append(new command("arqtest", 1, "Offline IP modem ARQ goodput on a lossy channel (frame error rate, percent)"));
 }
@@ -22,18 +22,20 @@
 #include <QString>
 #include <QStringList>
 #include <QList>
-#include <QRegularExpressionValidator>
+#include <QRegularExpression>
 #include <QVector>
 #include <string>
 #include "settings.h"
 #include "logger.h"
+#include "telemetry.h"
 #include "ext/utils.h"
 
 class CommandProcessor : public QObject
 {
     Q_OBJECT
 public:
-    explicit CommandProcessor(const Settings *settings, Logger *logger, QObject *parent = nullptr);
+    explicit CommandProcessor(const Settings *settings, Logger *logger, Telemetry *telemetry,
+                              QObject *parent = nullptr);
     ~CommandProcessor();
     QStringList listAvailableCommands(bool mumble_text=false);
     bool validateCommand(QString message);
@@ -90,6 +92,7 @@ signals:
     void stopAutoTuneFreq();
     void startMemoryTune(int scan_direction);
     void stopMemoryTune();
+    void tuneMemoryChannel(int id);
 
     /// VOIP
     void connectToServer(QString server, unsigned port);
@@ -101,6 +104,7 @@ signals:
     void toggleSelfDeaf(bool deaf);
     void toggleSelfMute(bool mute);
     void setAudioRecord(bool value);
+    void setIQRecord(bool value);
 
     //void stopRadio();
 
@@ -127,6 +131,7 @@ private:
 
     const Settings *_settings;
     Logger *_logger;
+    Telemetry *_telemetry;
     QVector<command*> *_command_list;
     QVector<QString> *_mode_list;
 
@@ -14,6 +14,7 @@
 #define PROTOCOL_VERSION ((PROTVER_MAJOR << 16) | (PROTVER_MINOR << 8) | (PROTVER_PATCH))
 
 #define CONTROL_PORT 4939
+#define REMOTE_CONTROL_PORT 4940
 #ifdef LOCAL
 #define UDP_PORT 0 // multiple clients on local station can't bind to the same port
 #else
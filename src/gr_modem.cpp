@@ -21,12 +21,24 @@ gr_modem::gr_modem(const Settings *settings, Logger *logger, QObject *parent) :
 {
     _settings = settings;
     _logger = logger;
+    /// counters cost a little on every work() call, only keep them when asked
+    gr_block_profiler::enable_counters(settings->block_profiler > 0);
     _limits = new Limits;
     _bit_buf_len = 8 *8;
     _bit_buf = new unsigned char[_bit_buf_len];
     _modem_type_rx = gr_modem_types::ModemTypeBPSK2000;
     _modem_type_tx = gr_modem_types::ModemTypeBPSK2000;
     _direct_mode_repeater = false;
+    _repeater_turnaround = 80;
+    _repeater_buf = new unsigned char[_bit_buf_len / 8 + 3];
+    _repeater_fill = 0;
+    _repeater_sent = 0;
+    _repeater_hold = 0;
+    _repeater_frame_open = false;
+    _repeater_latency = 0;
+    /// at most 40 msec of audio between receiver and transmitter
+    _audio_bridge = make_gr_audio_bridge(320, 100);
+    _config_batch = false;
     _rx_frame_length = 7;
     _tx_frame_length = 7;
     _bit_buf_index = 0;
@@ -37,7 +49,8 @@ gr_modem::gr_modem(const Settings *settings, Logger *logger, QObject *parent) :
     _current_frame_type = FrameTypeNone;
     _gr_mod_base = 0;
     _gr_demod_base = 0;
-    _burst_ip_modem = false;
+    /// bursts need a preamble for the receiver to lock before the sync word
+    _burst_ip_modem = settings->burst_ip_modem || settings->tdma_mac;
     _modem_sync = 0;
 }
 
@@ -48,6 +61,7 @@ gr_modem::~gr_modem()
     if(_gr_mod_base)
         deinitTX(_modem_type_tx);
     delete[] _bit_buf;
+    delete[] _repeater_buf;
     delete _limits;
 }
 
@@ -56,6 +70,13 @@ void gr_modem::initTX(int modem_type, std::string device_args, std::string devic
     _modem_type_tx = modem_type;
     _gr_mod_base = new gr_mod_base(
                 0, 433500000, 0.5, device_args, device_antenna, freq_corr);
+    _gr_mod_base->set_audio_bridge(_audio_bridge);
+    _gr_mod_base->enable_audio_bridge(_audio_bridge->is_enabled());
+    if(_settings->sched_profiles.contains("modulator"))
+    {
+        schedprofile profile = _settings->sched_profiles.value("modulator");
+        _gr_mod_base->set_sched_group(profile.cpus.toStdVector(), profile.priority);
+    }
     toggleTxMode(modem_type);
 
 }
@@ -65,6 +86,18 @@ void gr_modem::initRX(int modem_type, std::string device_args, std::string devic
     _modem_type_rx = modem_type;
     _gr_demod_base = new gr_demod_base(
                 0, 433500000, 0.9, device_args, device_antenna, freq_corr);
+    _gr_demod_base->set_audio_bridge(_audio_bridge);
+    /// later groups override the affinity of the earlier ones
+    const char *groups[] = {"frontend", "demod", "fec"};
+    const int group_ids[] = {gr_demod_base::SchedFrontEnd, gr_demod_base::SchedDemod,
+                             gr_demod_base::SchedFec};
+    for(int i=0;i<3;i++)
+    {
+        if(!_settings->sched_profiles.contains(groups[i]))
+            continue;
+        schedprofile profile = _settings->sched_profiles.value(groups[i]);
+        _gr_demod_base->set_sched_group(group_ids[i], profile.cpus.toStdVector(), profile.priority);
+    }
     toggleRxMode(modem_type);
 
 }
@@ -98,7 +131,10 @@ void gr_modem::toggleTxMode(int modem_type)
     _modem_type_tx = modem_type;
     if(_gr_mod_base)
     {
-        _gr_mod_base->set_mode(modem_type);
+        if(_config_batch)
+            _pending_config.setTxMode(modem_type);
+        else
+            _gr_mod_base->set_mode(modem_type);
         if(modem_type == gr_modem_types::ModemTypeBPSK2000)
         {
             _tx_frame_length = 7;
@@ -167,12 +203,88 @@ void gr_modem::toggleTxMode(int modem_type)
 
 }
 
+double gr_modem::getRxModeSwitchTime()
+{
+    if(_gr_demod_base)
+        return _gr_demod_base->get_mode_switch_time();
+    return 0;
+}
+
+double gr_modem::getTxModeSwitchTime()
+{
+    if(_gr_mod_base)
+        return _gr_mod_base->get_mode_switch_time();
+    return 0;
+}
+
+void gr_modem::getBlockStats(std::vector<gr_block_profiler::stats> &rx_stats,
+                             std::vector<gr_block_profiler::stats> &tx_stats)
+{
+    rx_stats.clear();
+    tx_stats.clear();
+    if(_gr_demod_base)
+        _gr_demod_base->get_block_stats(rx_stats);
+    if(_gr_mod_base)
+        _gr_mod_base->get_block_stats(tx_stats);
+}
+
+float gr_modem::getRxSampleRatio()
+{
+    if(!_gr_demod_base)
+        return 1.0f;
+    return _gr_demod_base->get_sample_ratio();
+}
+
+float gr_modem::getTxSampleRatio()
+{
+    if(!_gr_mod_base)
+        return 1.0f;
+    return _gr_mod_base->get_sample_ratio();
+}
+
+bool gr_modem::tuneRxBuffers(bool overflow)
+{
+    if(!_gr_demod_base)
+        return false;
+    return _gr_demod_base->tune_buffers(overflow);
+}
+
+bool gr_modem::tuneTxBuffers(bool underflow)
+{
+    if(!_gr_mod_base)
+        return false;
+    return _gr_mod_base->tune_buffers(underflow);
+}
+
+void gr_modem::getRxBufferStats(int &bytes, float &latency_msec, float &scale, bool &tuned)
+{
+    bytes = 0;
+    latency_msec = 0;
+    scale = 1.0f;
+    tuned = false;
+    if(_gr_demod_base)
+        _gr_demod_base->get_buffer_stats(bytes, latency_msec, scale, tuned);
+}
+
+void gr_modem::getTxBufferStats(int &bytes, float &latency_msec, float &scale, bool &tuned)
+{
+    bytes = 0;
+    latency_msec = 0;
+    scale = 1.0f;
+    tuned = false;
+    if(_gr_mod_base)
+        _gr_mod_base->get_buffer_stats(bytes, latency_msec, scale, tuned);
+}
+
 void gr_modem::toggleRxMode(int modem_type)
 {
     _modem_type_rx = modem_type;
     if(_gr_demod_base)
     {
-        _gr_demod_base->set_mode(modem_type);
+        if(_config_batch)
+            _pending_config.setRxMode(modem_type);
+        else
+            _gr_demod_base->set_mode(modem_type);
         if(modem_type == gr_modem_types::ModemTypeBPSK2000)
         {
             _bit_buf_len = 8 *8;
@@ -255,6 +367,11 @@ void gr_modem::toggleRxMode(int modem_type)
         }
         delete[] _bit_buf;
         _bit_buf = new unsigned char[_bit_buf_len];
+        if(_repeater_frame_open)
+            repeaterEnd();
+        /// room for the longest sync word plus the frame
+        delete[] _repeater_buf;
+        _repeater_buf = new unsigned char[_bit_buf_len / 8 + 3];
     }
 }
 
@@ -334,33 +451,90 @@ double gr_modem::getFreqGUI()
 
 void gr_modem::tune(long long center_freq)
 {
-    if(_gr_demod_base)
+    if(_config_batch)
+        _pending_config.setRxFrequency(center_freq);
+    else if(_gr_demod_base)
         _gr_demod_base->tune(center_freq);
 }
 
+bool gr_modem::txFrequencyAllowed(long long center_freq)
+{
+    if(_limits->checkLimit(center_freq))
+        return true;
+    if(!_settings->tx_band_limits)
+    {
+        _logger->log(Logger::LogLevelInfo,
+                 "TX frequency is outside of configured band limits",
+                     Logger::LogSubsystemModem);
+        return true;
+    }
+    _logger->log(Logger::LogLevelWarning,
+             "Blocked attempt to set TX frequency outside of configured band limits",
+                 Logger::LogSubsystemModem);
+    return false;
+}
+
 void gr_modem::tuneTx(long long center_freq)
 {
     if(_gr_mod_base)
     {
-        if(_limits->checkLimit(center_freq))
-            _gr_mod_base->tune(center_freq);
+        if(!txFrequencyAllowed(center_freq))
+            return;
+        if(_config_batch)
+            _pending_config.setTxFrequency(center_freq);
         else
-        {
-            if(!_settings->tx_band_limits)
-            {
-                _gr_mod_base->tune(center_freq);
-                _logger->log(Logger::LogLevelInfo,
-                         "TX frequency is outside of configured band limits");
-            }
-            else
-            {
-                _logger->log(Logger::LogLevelWarning,
-                         "Blocked attempt to set TX frequency outside of configured band limits");
-            }
-        }
+            _gr_mod_base->tune(center_freq);
     }
 }
 
+void gr_modem::beginConfig()
+{
+    _pending_config.clear();
+    _config_batch = true;
+}
+
+void gr_modem::commitConfig()
+{
+    _config_batch = false;
+    RadioConfig config = _pending_config;
+    _pending_config.clear();
+    if(config.isEmpty())
+        return;
+    if(_gr_demod_base)
+        _gr_demod_base->apply_config(config);
+    if(_gr_mod_base)
+        _gr_mod_base->apply_config(config);
+}
+
+bool gr_modem::configPending()
+{
+    return _config_batch;
+}
+
+void gr_modem::applyConfig(const RadioConfig &config)
+{
+    beginConfig();
+    if(config.has(RadioConfig::RxFrequency))
+        tune(config.rx_frequency);
+    if(config.has(RadioConfig::RxMode))
+        toggleRxMode(config.rx_mode);
+    if(config.has(RadioConfig::TxFrequency))
+        tuneTx(config.tx_frequency);
+    if(config.has(RadioConfig::TxMode))
+        toggleTxMode(config.tx_mode);
+    if(config.has(RadioConfig::Squelch))
+        setSquelch(config.squelch);
+    if(config.has(RadioConfig::RxCTCSS))
+        setRxCTCSS(config.rx_ctcss);
+    if(config.has(RadioConfig::TxCTCSS))
+        setTxCTCSS(config.tx_ctcss);
+    if(config.has(RadioConfig::FFTSize))
+        setFFTSize(config.fft_size);
+    if(config.has(RadioConfig::SampleRate))
+        setSampRate(config.samp_rate);
+    commitConfig();
+}
+
 void gr_modem::setCarrierOffset(long long offset)
 {
     if(_gr_demod_base)
@@ -375,13 +549,17 @@ void gr_modem::setTxCarrierOffset(long long offset)
 
 void gr_modem::setSampRate(int samp_rate)
 {
-    if(_gr_demod_base)
+    if(_config_batch)
+        _pending_config.setSampleRate(samp_rate);
+    else if(_gr_demod_base)
         _gr_demod_base->set_samp_rate(samp_rate);
 }
 
 void gr_modem::setFFTSize(int size)
 {
-    if(_gr_demod_base)
+    if(_config_batch)
+        _pending_config.setFFTSize(size);
+    else if(_gr_demod_base)
         _gr_demod_base->set_fft_size(size);
 }
 
@@ -430,7 +608,9 @@ void gr_modem::setAgcDecay(float value)
 
 void gr_modem::setSquelch(int value)
 {
-    if(_gr_demod_base)
+    if(_config_batch)
+        _pending_config.setSquelch(value);
+    else if(_gr_demod_base)
         _gr_demod_base->set_squelch(value);
 }
 
@@ -444,13 +624,30 @@ void gr_modem::setFilterWidth(int width)
 
 void gr_modem::setRxCTCSS(float value)
 {
-    if(_gr_demod_base)
+    if(_config_batch)
+        _pending_config.setRxCTCSS(value);
+    else if(_gr_demod_base)
         _gr_demod_base->set_ctcss(value);
 }
 
+bool gr_modem::startIQRecording(std::string base_path, std::string mode_name)
+{
+    if(_gr_demod_base)
+        return _gr_demod_base->start_iq_recording(base_path, mode_name);
+    return false;
+}
+
+void gr_modem::stopIQRecording()
+{
+    if(_gr_demod_base)
+        _gr_demod_base->stop_iq_recording();
+}
+
 void gr_modem::setTxCTCSS(float value)
 {
-    if(_gr_mod_base)
+    if(_config_batch)
+        _pending_config.setTxCTCSS(value);
+    else if(_gr_mod_base)
         _gr_mod_base->set_ctcss(value);
 }
 
@@ -490,10 +687,39 @@ void gr_modem::enableDemod(bool value)
 
 
 /// allows audio to bypass RadioController transcoding and loop
-/// back directly to radio
+/// back directly to radio. Digital frames are cut through bit by bit,
+/// so RX and TX must use the same mode
 void gr_modem::setRepeater(bool value)
 {
     _direct_mode_repeater = value;
+    if(!value && _repeater_frame_open)
+        repeaterEnd();
+}
+
+void gr_modem::setRepeaterTurnaround(int msec)
+{
+    _repeater_turnaround = std::max(0, msec);
+}
+
+double gr_modem::getRepeaterLatency()
+{
+    return _repeater_latency;
+}
+
+/// analog repeater audio goes from the demodulator straight into the
+/// modulator through a short FIFO, without passing through RadioController
+void gr_modem::setAudioBridge(bool value)
+{
+    if(value == _audio_bridge->is_enabled())
+        return;
+    _audio_bridge->set_enabled(value);
+    if(_gr_mod_base)
+        _gr_mod_base->enable_audio_bridge(value);
+}
+
+bool gr_modem::audioBridgeActive()
+{
+    return _audio_bridge->is_active();
 }
 
 void gr_modem::sendCallsign(QString callsign)
@@ -600,7 +826,6 @@ void gr_modem::transmitDigitalAudio(unsigned char *data, int size)
     QVector<std::vector<unsigned char>*> frames;
     frames.append(one_frame);
     transmit(frames);
-    delete[] data;
 }
 
 
@@ -630,21 +855,30 @@ void gr_modem::transmitVideoData(unsigned char *data, int size)
 
 void gr_modem::transmitNetData(unsigned char *data, int size)
 {
+    /// several frames back to back make one burst
     QVector<std::vector<unsigned char>*> frames;
-    std::vector<unsigned char> *one_frame = frame(data, size, FrameTypeIP);
-    frames.append(one_frame);
+    for(int i=0;i<size;i+=_tx_frame_length)
+    {
+        std::vector<unsigned char> *one_frame = frame(data + i, std::min(_tx_frame_length, size - i),
+                                                      FrameTypeIP);
+        frames.append(one_frame);
+    }
+    if(_burst_ip_modem && (frames.size() > 0))
+        frames.at(0)->insert(frames.at(0)->begin(), 25, 0xCC);
     transmit(frames);
     delete[] data;
 }
 
+unsigned int gr_modem::getTxQueuedData()
+{
+    if(!_gr_mod_base)
+        return 0;
+    return _gr_mod_base->get_queued_data();
+}
+
 std::vector<unsigned char>* gr_modem::frame(unsigned char *encoded_audio, int data_size, int frame_type)
 {
     std::vector<unsigned char> *data = new std::vector<unsigned char>;
-    if(frame_type == FrameTypeIP && _burst_ip_modem)
-    {
-        for(int i = 0;i < 25;i++)
-            data->push_back(0xCC);
-    }
     if(frame_type == FrameTypeVoice)
     {
         if((_modem_type_tx == gr_modem_types::ModemTypeBPSK1000)
@@ -707,6 +941,14 @@ void gr_modem::transmit(QVector<std::vector<unsigned char>*> frames)
         frames.at(i)->clear();
         delete frames.at(i);
     }
+    if(_repeater_frame_open && (_repeater_sent > 0))
+    {
+        /// don't split a frame which is being repeated, send after it.
+        /// Until its first bytes go out, local frames like the preamble go first
+        _deferred_tx.insert(_deferred_tx.end(), all_frames->begin(), all_frames->end());
+        delete all_frames;
+        return;
+    }
     int ret = 1;
     while(ret)
     {
@@ -737,6 +979,14 @@ void gr_modem::getFFTData(float* data, unsigned int &size)
         _gr_demod_base->get_FFT_data(data, size);
 }
 
+void gr_modem::getDetectedTone(float &tone, int &dcs_code)
+{
+    tone = 0;
+    dcs_code = 0;
+    if(_gr_demod_base)
+        _gr_demod_base->get_detected_tone(tone, dcs_code);
+}
+
 float gr_modem::getRSSI()
 {
     if(_gr_demod_base)
@@ -770,7 +1020,7 @@ bool gr_modem::demodulateAnalog()
         return false;
     if(audio_data->size() > 0)
     {
-        if(_direct_mode_repeater)
+        if(_direct_mode_repeater && !_audio_bridge->is_enabled())
         {
             std::vector<float> *repeated_audio = new std::vector<float>(
                         audio_data->begin(),audio_data->end());
@@ -793,9 +1043,7 @@ bool gr_modem::demodulate()
     {
         return false;
     }
-    std::vector<unsigned char> *demod_data = nullptr;
-    std::vector<unsigned char> *demod_data2 = nullptr;
-    std::vector<unsigned char> *data;
+    std::vector<unsigned char> *data = nullptr;
 
     if((_modem_type_rx == gr_modem_types::ModemTypeBPSK2000)
             || (_modem_type_rx == gr_modem_types::ModemType2FSK2000FM)
@@ -805,58 +1053,18 @@ bool gr_modem::demodulate()
             || (_modem_type_rx == gr_modem_types::ModemType2FSK1000FM)
             || (_modem_type_rx == gr_modem_types::ModemType2FSK1000))
     {
-        demod_data = _gr_demod_base->getData(1);
-        demod_data2 = _gr_demod_base->getData(2);
-        if((demod_data == nullptr) || (demod_data2 == nullptr))
-            return false;
-    }     
-    else
-    {
-        demod_data = _gr_demod_base->getData();
-        if(demod_data == nullptr)
-            return false;
-    }
-
-    int v_size;
-    if((_modem_type_rx == gr_modem_types::ModemTypeBPSK2000)
-            || (_modem_type_rx == gr_modem_types::ModemTypeBPSK1000)
-            || (_modem_type_rx == gr_modem_types::ModemType2FSK20000)
-            || (_modem_type_rx == gr_modem_types::ModemType2FSK2000FM)
-            || (_modem_type_rx == gr_modem_types::ModemType2FSK2000)
-            || (_modem_type_rx == gr_modem_types::ModemType2FSK1000FM)
-            || (_modem_type_rx == gr_modem_types::ModemType2FSK1000))
-    {
-        if(demod_data->size() >= demod_data2->size())
-        {
-            v_size = demod_data->size();
-            data = demod_data;
-        }
-        else
-        {
-            v_size = demod_data2->size();
-            data = demod_data2;
-        }
+        data = _gr_demod_base->getFrameData();
     }
     else
     {
-        v_size = demod_data->size();
-        data = demod_data;
+        data = _gr_demod_base->getData();
     }
+    if(data == nullptr)
+        return false;
 
-    bool data_to_process = synchronize(v_size, data);
-    demod_data->clear();
-    delete demod_data;
-    if((_modem_type_rx == gr_modem_types::ModemTypeBPSK2000)
-            || (_modem_type_rx == gr_modem_types::ModemTypeBPSK1000)
-            || (_modem_type_rx == gr_modem_types::ModemType2FSK20000)
-            || (_modem_type_rx == gr_modem_types::ModemType2FSK2000FM)
-            || (_modem_type_rx == gr_modem_types::ModemType2FSK2000)
-            || (_modem_type_rx == gr_modem_types::ModemType2FSK1000FM)
-            || (_modem_type_rx == gr_modem_types::ModemType2FSK1000))
-    {
-        demod_data2->clear();
-        delete demod_data2;
-    }
+    bool data_to_process = synchronize(data->size(), data);
+    data->clear();
+    delete data;
     return data_to_process;
 
 }
@@ -874,6 +1082,8 @@ bool gr_modem::synchronize(int v_size, std::vector<unsigned char> *data)
                 _bit_buf_index = 0;
                 if(_modem_sync < 32)
                     _modem_sync += 8;
+                if(_direct_mode_repeater)
+                    repeaterStart(_current_frame_type);
                 continue;
             }
             else
@@ -887,6 +1097,11 @@ bool gr_modem::synchronize(int v_size, std::vector<unsigned char> *data)
             data_to_process = true;
             _bit_buf[_bit_buf_index] =  (data->at(i)) & 0x1;
             _bit_buf_index++;
+            if(_repeater_frame_open && ((_bit_buf_index % 8) == 0))
+            {
+                packBytes(_repeater_buf + _repeater_fill, _bit_buf + _bit_buf_index - 8, 8);
+                _repeater_fill++;
+            }
             int frame_length = _rx_frame_length;
             int bit_buf_len = _bit_buf_len;
             if((_modem_type_rx != gr_modem_types::ModemTypeBPSK1000)
@@ -907,7 +1122,8 @@ bool gr_modem::synchronize(int v_size, std::vector<unsigned char> *data)
             }
             if(_bit_buf_index >= bit_buf_len)
             {
-
+                if(_repeater_frame_open)
+                    repeaterEnd();
                 unsigned char *frame_data = new unsigned char[frame_length];
                 packBytes(frame_data,_bit_buf,_bit_buf_index);
                 processReceivedData(frame_data, _current_frame_type);
@@ -917,9 +1133,95 @@ bool gr_modem::synchronize(int v_size, std::vector<unsigned char> *data)
             }
         }
     }
+    if(_repeater_frame_open)
+        repeaterRelease(false);
     return data_to_process;
 }
 
+int gr_modem::voiceFrameBytes()
+{
+    if((_modem_type_rx == gr_modem_types::ModemTypeBPSK1000) ||
+            (_modem_type_rx == gr_modem_types::ModemType2FSK1000FM) ||
+            (_modem_type_rx == gr_modem_types::ModemType2FSK1000) ||
+            (_modem_type_rx == gr_modem_types::ModemType4FSK1000FM))
+        return _rx_frame_length + 1;
+    return _rx_frame_length + 3;
+}
+
+void gr_modem::repeaterStart(int frame_type)
+{
+    _repeater_frame_open = false;
+    if(!_gr_mod_base || (_modem_type_rx != _modem_type_tx))
+        return;
+    bool low_rate = (voiceFrameBytes() == _rx_frame_length + 1);
+    int header_bytes;
+    if(frame_type == FrameTypeVoice)
+    {
+        /// the 8 bit sync word is too weak to trust on its own
+        if(low_rate && (_modem_sync < 16))
+            return;
+        header_bytes = low_rate ? 1 : 2;
+    }
+    else if((frame_type == FrameTypeCallsign) || ((frame_type == FrameTypeText) && !low_rate))
+    {
+        header_bytes = 3;
+    }
+    else
+    {
+        return;
+    }
+    /// the sync word just matched becomes the header of the repeated frame
+    for(int i=0;i<header_bytes;i++)
+    {
+        _repeater_buf[i] = (_shift_reg >> (8 * (header_bytes - 1 - i))) & 0xFF;
+    }
+    _repeater_fill = header_bytes;
+    _repeater_sent = 0;
+    _repeater_sync_time = std::chrono::steady_clock::now();
+    /// every digital voice frame carries 40 msec of audio, which gives the byte rate.
+    /// The turnaround delay is only built up again when the transmitter ran dry
+    _repeater_hold = 0;
+    if(_gr_mod_base->get_queued_data() == 0)
+    {
+        /// receivers need a preamble to sync on, which also covers the PTT settling
+        std::vector<unsigned char> preamble(_tx_frame_length * 2, 0xAA);
+        _gr_mod_base->append_data(preamble.data(), preamble.size());
+        _repeater_hold = std::min(_repeater_turnaround * voiceFrameBytes() / 40,
+                                  _bit_buf_len / 8 + header_bytes);
+    }
+    _repeater_frame_open = true;
+    emit repeatedFrame();
+}
+
+void gr_modem::repeaterRelease(bool frame_end)
+{
+    if(!_gr_mod_base)
+        return;
+    if(!frame_end && (_repeater_fill < _repeater_hold))
+        return;
+    if(_repeater_fill <= _repeater_sent)
+        return;
+    if(_repeater_sent == 0)
+    {
+        /// sync word to hand-off, plus the time to send what is queued ahead of us
+        std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - _repeater_sync_time;
+        _repeater_latency = elapsed.count() +
+                40.0 * _gr_mod_base->get_queued_data() / voiceFrameBytes();
+    }
+    _gr_mod_base->append_data(_repeater_buf + _repeater_sent, _repeater_fill - _repeater_sent);
+    _repeater_sent = _repeater_fill;
+}
+
+void gr_modem::repeaterEnd()
+{
+    repeaterRelease(true);
+    _repeater_frame_open = false;
+    if(_gr_mod_base && (_deferred_tx.size() > 0))
+        _gr_mod_base->append_data(_deferred_tx.data(), _deferred_tx.size());
+    _deferred_tx.clear();
+}
+
 int gr_modem::findSync(unsigned char bit)
 {
     _shift_reg = (_shift_reg << 1) | (bit & 0x1);
@@ -1015,8 +1317,9 @@ void gr_modem::processReceivedData(unsigned char *received_data, int current_fra
             }
         }
         QString text = QString::fromLocal8Bit(text_data,string_length);
-        if(_direct_mode_repeater)
+        if(_direct_mode_repeater && (voiceFrameBytes() == _rx_frame_length + 1))
         {
+            /// the 700 bps modes have no room for the text start byte, can't cut through
             transmitTextData(text);
         }
         emit textReceived(text);
@@ -1038,18 +1341,14 @@ void gr_modem::processReceivedData(unsigned char *received_data, int current_fra
 
         QString callsign(text_data);
         callsign = callsign.remove(QRegExp("[^a-zA-Z/\\d\\s]"));
-        if(_direct_mode_repeater)
-        {
-            sendCallsign(callsign);
-        }
         emit callsignReceived(callsign);
         delete[] text_data;
     }
     else if (current_frame_type == FrameTypeVoice)
     {            
         _last_frame_type = FrameTypeVoice;
-        unsigned char *codec2_data = new unsigned char[_rx_frame_length];
-        memset(codec2_data,0,_rx_frame_length);
+        _voice_data.assign(_rx_frame_length, 0);
+        unsigned char *codec2_data = _voice_data.data();
         if(((_modem_type_rx == gr_modem_types::ModemTypeBPSK1000) ||
             (_modem_type_rx == gr_modem_types::ModemType2FSK1000FM) ||
             (_modem_type_rx == gr_modem_types::ModemType2FSK1000) ||
@@ -1069,14 +1368,6 @@ void gr_modem::processReceivedData(unsigned char *received_data, int current_fra
             emit digitalAudio(codec2_data,_rx_frame_length);
             emit audioFrameReceived();
         }
-        if(_direct_mode_repeater)
-        {
-            unsigned char *repeated_frame = new unsigned char[_rx_frame_length];
-            memcpy(repeated_frame, codec2_data, _rx_frame_length);
-            transmitDigitalAudio(repeated_frame, _rx_frame_length);
-            emit audioFrameReceived();
-        }
-
     }
     else if (current_frame_type == FrameTypeVideo )
     {
@@ -27,12 +27,15 @@
 #include <QByteArray>
 #include <QCoreApplication>
 #include <string>
+#include <chrono>
+#include <algorithm>
 #include "ext/utils.h"
 #include "src/settings.h"
 #include "src/limits.h"
 #include "src/logger.h"
 #include "src/layer1framing.h"
 #include "src/modem_types.h"
+#include "src/radioconfig.h"
 #include "gr/gr_mod_base.h"
 #include "gr/gr_demod_base.h"
 
@@ -51,6 +54,7 @@ public:
 
 signals:
     void pcmAudio(std::vector<float>* pcm);
+    /// c2data is only valid for the duration of the call
     void digitalAudio(unsigned char *c2data, int size);
     void videoData(unsigned char *video_data, int size);
     void netData(unsigned char *net_data, int size);
@@ -63,9 +67,11 @@ signals:
     void syncIssues();
     void receiveEnd();
     void endAudioTransmission();
+    void repeatedFrame();
 
 public slots:
     void transmitPCMAudio(std::vector<float> *audio_data);
+    /// data is lent from the RadioController encoder pool and not freed here
     void transmitDigitalAudio(unsigned char *data, int size);
     void transmitVideoData(unsigned char *data, int size);
     void transmitNetData(unsigned char *data, int size);
@@ -82,6 +88,18 @@ public slots:
     void deinitRX(int modem_type);
     void toggleRxMode(int modem_type);
     void toggleTxMode(int modem_type);
+    double getRxModeSwitchTime();
+    double getTxModeSwitchTime();
+    void getBlockStats(std::vector<gr_block_profiler::stats> &rx_stats,
+                       std::vector<gr_block_profiler::stats> &tx_stats);
+    /// Bytes the modulator has not taken yet
+    unsigned int getTxQueuedData();
+    float getRxSampleRatio();
+    float getTxSampleRatio();
+    bool tuneRxBuffers(bool overflow);
+    bool tuneTxBuffers(bool underflow);
+    void getRxBufferStats(int &bytes, float &latency_msec, float &scale, bool &tuned);
+    void getTxBufferStats(int &bytes, float &latency_msec, float &scale, bool &tuned);
     void tune(long long center_freq);
     void tuneTx(long long center_freq);
     void startRX(int buffer_size=0);
@@ -112,10 +130,23 @@ public slots:
     void setSampRate(int samp_rate);
     void setFFTSize(int size);
     float getRSSI();
+    void getDetectedTone(float &tone, int &dcs_code);
     void flushSources();
     std::vector<gr_complex> *getConstellation();
     const QMap<std::string, QVector<int> > getRxGainNames() const;
     const QMap<std::string, QVector<int> > getTxGainNames() const;
+    bool startIQRecording(std::string base_path, std::string mode_name);
+    void stopIQRecording();
+    void setRepeaterTurnaround(int msec);
+    double getRepeaterLatency();
+    void setAudioBridge(bool value);
+    /// Squelch is open and audio is flowing through the repeater bridge
+    bool audioBridgeActive();
+    /// Changes made between beginConfig() and commitConfig() are applied together
+    void beginConfig();
+    void commitConfig();
+    bool configPending();
+    void applyConfig(const RadioConfig &config);
 
 private:
     std::vector<unsigned char>* frame(unsigned char *encoded_audio,
@@ -125,6 +156,11 @@ private:
     int findSync(unsigned char bit);
     void transmit(QVector<std::vector<unsigned char>*> frames);
     bool synchronize(int v_size, std::vector<unsigned char> *data);
+    void repeaterStart(int frame_type);
+    void repeaterRelease(bool frame_end);
+    void repeaterEnd();
+    int voiceFrameBytes();
+    bool txFrequencyAllowed(long long center_freq);
 
     const Settings *_settings;
     Logger *_logger;
@@ -136,10 +172,23 @@ private:
     long _bit_buf_index;
     int _bit_buf_len;
     bool _direct_mode_repeater;
+    int _repeater_turnaround;
+    unsigned char *_repeater_buf;
+    int _repeater_fill;
+    int _repeater_sent;
+    int _repeater_hold;
+    bool _repeater_frame_open;
+    double _repeater_latency;
+    std::chrono::steady_clock::time_point _repeater_sync_time;
+    gr_audio_bridge_sptr _audio_bridge;
+    bool _config_batch;
+    RadioConfig _pending_config;
+    std::vector<unsigned char> _deferred_tx;
     int _modem_type_rx;
     int _modem_type_tx;
     int _tx_frame_length;
     int _rx_frame_length;
+    std::vector<unsigned char> _voice_data;
     quint64 _frame_counter;
     int _last_frame_type;
     bool _sync_found;
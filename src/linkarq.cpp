@@ -0,0 +1,337 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "linkarq.h"
+#include <string.h>
+#include <algorithm>
+#include <random>
+
+/// sequence, sender window start, next expected and the receive bitmap,
+/// small enough that a full size tap frame still fits the radio frame
+static const int HEADER_SIZE = 5;
+/// frames in flight, the bitmap covers the ones after the next expected
+static const int ARQ_WINDOW = 16;
+static const int MAX_QUEUE_PACKETS = 32;
+static const qint64 INITIAL_RTT_USEC = 300000;
+static const qint64 MIN_RTO_USEC = 150000;
+/// radio frame period and pipeline delay of the loopback channel
+static const qint64 LOOPBACK_FRAME_USEC = 48400;
+static const qint64 LOOPBACK_LATENCY_USEC = 100000;
+static const int LOOPBACK_PAYLOAD_SIZE = 1500;
+static const int LOOPBACK_PACKET_SIZE = 1400;
+
+LinkArq::LinkArq(int payload_size, qint64 max_delay_usec)
+{
+    _payload_size = payload_size;
+    _max_delay_usec = max_delay_usec;
+    _next_seq = 0;
+    _expected = 0;
+    _ack_owed = false;
+    _rx_slots.resize(ARQ_WINDOW);
+    for(int i=0;i<_rx_slots.size();i++)
+        _rx_slots[i].present = false;
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.rtt_usec = INITIAL_RTT_USEC;
+}
+
+bool LinkArq::queuePacket(const unsigned char *data, int size)
+{
+    if((size > _payload_size - HEADER_SIZE) || (_queue.size() >= MAX_QUEUE_PACKETS))
+    {
+        _stats.dropped++;
+        return false;
+    }
+    _queue.enqueue(QByteArray((const char*)data, size));
+    return true;
+}
+
+qint64 LinkArq::retransmitTimeout() const
+{
+    return std::max(2 * _stats.rtt_usec, MIN_RTO_USEC);
+}
+
+QByteArray LinkArq::nextFrame(qint64 now_usec, bool force)
+{
+    for(int i=0;i<_window.size();i++)
+    {
+        txentry &entry = _window[i];
+        if(!entry.done && (now_usec - entry.first_sent > _max_delay_usec))
+        {
+            entry.done = true;
+            _stats.expired++;
+        }
+    }
+    while(!_window.isEmpty() && _window.first().done)
+        _window.removeFirst();
+
+    txentry *send = nullptr;
+    for(int i=0;(i<_window.size()) && !send;i++)
+    {
+        txentry &entry = _window[i];
+        if(entry.done)
+            continue;
+        /// a hole reported again before our resend could arrive is not news
+        qint64 since = now_usec - entry.last_sent;
+        if((entry.nacked && (since > _stats.rtt_usec)) || (since > retransmitTimeout()))
+        {
+            send = &entry;
+            _stats.retransmissions++;
+        }
+    }
+    if(!send && (_window.size() < ARQ_WINDOW) && !_queue.isEmpty())
+    {
+        txentry entry;
+        entry.packet = _queue.dequeue();
+        entry.seq = _next_seq++;
+        entry.first_sent = now_usec;
+        entry.transmissions = 0;
+        entry.done = false;
+        entry.nacked = false;
+        _window.append(entry);
+        send = &_window.last();
+    }
+    if(!send && !force && !_ack_owed)
+        return QByteArray();
+
+    quint8 base = _window.isEmpty() ? _next_seq : _window.first().seq;
+    quint16 bitmap = 0;
+    for(int i=1;i<_rx_slots.size();i++)
+    {
+        if(_rx_slots.at(i).present)
+            bitmap |= 1 << (i - 1);
+    }
+    QByteArray frame;
+    frame.append((char)(send ? send->seq : 0));
+    frame.append((char)base);
+    frame.append((char)_expected);
+    frame.append((const char*)&bitmap, 2);
+    if(send)
+    {
+        send->last_sent = now_usec;
+        send->transmissions++;
+        send->nacked = false;
+        frame.append(send->packet);
+    }
+    _ack_owed = false;
+    _stats.frames_sent++;
+    return frame;
+}
+
+void LinkArq::readFeedback(quint8 ack, quint16 bitmap, qint64 now_usec)
+{
+    if(_window.isEmpty())
+        return;
+    int acked = (quint8)(ack - _window.first().seq);
+    if(acked > _window.size())
+        return; // stale or not for us
+    int highest = -1;
+    for(int i=0;i<_window.size();i++)
+    {
+        txentry &entry = _window[i];
+        bool received = (i < acked) ||
+                ((i > acked) && (i - acked <= 15) && (bitmap & (1 << (i - acked - 1))));
+        if(received)
+        {
+            if(!entry.done && (entry.transmissions == 1))
+                _stats.rtt_usec += (now_usec - entry.last_sent - _stats.rtt_usec) / 8;
+            entry.done = true;
+            highest = i;
+        }
+    }
+    for(int i=acked;i<highest;i++)
+    {
+        if(!_window.at(i).done)
+            _window[i].nacked = true;
+    }
+    while(!_window.isEmpty() && _window.first().done)
+        _window.removeFirst();
+}
+
+void LinkArq::advanceReceiver(QVector<QByteArray> &packets)
+{
+    if(_rx_slots.first().present)
+    {
+        packets.append(_rx_slots.first().packet);
+        _stats.delivered++;
+    }
+    rxslot empty;
+    empty.present = false;
+    _rx_slots.removeFirst();
+    _rx_slots.append(empty);
+    _expected++;
+}
+
+void LinkArq::deliverInOrder(QVector<QByteArray> &packets)
+{
+    while(_rx_slots.first().present)
+        advanceReceiver(packets);
+}
+
+QVector<QByteArray> LinkArq::receive(const unsigned char *data, int size, qint64 now_usec)
+{
+    QVector<QByteArray> packets;
+    if(size < HEADER_SIZE)
+        return packets;
+    quint8 seq = data[0];
+    quint8 base = data[1];
+    quint16 bitmap;
+    memcpy(&bitmap, &data[3], 2);
+    readFeedback(data[2], bitmap, now_usec);
+
+    /// the sender gave up on everything before its window, a base behind
+    /// what we expect is only an old frame
+    int skip = (quint8)(base - _expected);
+    for(int i=0;(i<skip) && (skip < 128);i++)
+    {
+        if(!_rx_slots.first().present)
+            _stats.skipped++;
+        advanceReceiver(packets);
+    }
+    deliverInOrder(packets);
+
+    if(size > HEADER_SIZE)
+    {
+        _ack_owed = true;
+        int offset = (quint8)(seq - _expected);
+        if((offset < _rx_slots.size()) && !_rx_slots.at(offset).present)
+        {
+            rxslot &slot = _rx_slots[offset];
+            slot.present = true;
+            slot.packet = QByteArray((const char*)&data[HEADER_SIZE], size - HEADER_SIZE);
+            slot.received = now_usec;
+            deliverInOrder(packets);
+        }
+        else
+        {
+            _stats.duplicates++;
+        }
+    }
+    return packets;
+}
+
+QVector<QByteArray> LinkArq::expire(qint64 now_usec)
+{
+    QVector<QByteArray> packets;
+    bool waited_too_long = true;
+    while(waited_too_long)
+    {
+        waited_too_long = false;
+        for(int i=1;i<_rx_slots.size();i++)
+        {
+            if(_rx_slots.at(i).present)
+            {
+                waited_too_long = (now_usec - _rx_slots.at(i).received > _max_delay_usec);
+                break;
+            }
+        }
+        if(waited_too_long)
+        {
+            _stats.skipped++;
+            advanceReceiver(packets);
+            deliverInOrder(packets);
+        }
+    }
+    return packets;
+}
+
+LinkArq::stats LinkArq::getStats() const
+{
+    return _stats;
+}
+
+LinkArq::loopbackresult LinkArq::loopback(float frame_error_rate, qint64 max_delay_usec, int packets)
+{
+    struct inflight
+    {
+        qint64 arrival;
+        bool to_remote;
+        QByteArray frame;
+    };
+    LinkArq local(LOOPBACK_PAYLOAD_SIZE, max_delay_usec);
+    LinkArq remote(LOOPBACK_PAYLOAD_SIZE, max_delay_usec);
+    QVector<inflight> channel;
+    std::minstd_rand random(1);
+    std::uniform_real_distribution<float> loss(0.0f, 1.0f);
+    int queued = 0;
+    quint64 received = 0;
+    double total_delay = 0;
+    qint64 now = 0;
+    qint64 last_delivery = 0;
+    /// packets carry the time they were queued, for the delay
+    unsigned char packet[LOOPBACK_PACKET_SIZE];
+    memset(packet, 0, sizeof(packet));
+    qint64 drain_end = -1;
+    while((drain_end < 0) || (now < drain_end))
+    {
+        /// keep the queue short so the delay is the link's, not the backlog's
+        while((queued < packets) && (local._queue.size() < 2))
+        {
+            memcpy(packet, &now, sizeof(now));
+            if(!local.queuePacket(packet, sizeof(packet)))
+                break;
+            queued++;
+        }
+        /// both sides send a frame every period, like the continuous IP modem
+        inflight out;
+        out.arrival = now + LOOPBACK_FRAME_USEC + LOOPBACK_LATENCY_USEC;
+        out.to_remote = true;
+        out.frame = local.nextFrame(now, true);
+        if(loss(random) >= frame_error_rate)
+            channel.append(out);
+        out.to_remote = false;
+        out.frame = remote.nextFrame(now, true);
+        if(loss(random) >= frame_error_rate)
+            channel.append(out);
+
+        now += LOOPBACK_FRAME_USEC;
+        QVector<QByteArray> delivered = remote.expire(now);
+        for(int i=0;i<channel.size();)
+        {
+            if(channel.at(i).arrival > now)
+            {
+                i++;
+                continue;
+            }
+            const QByteArray &frame = channel.at(i).frame;
+            LinkArq &endpoint = channel.at(i).to_remote ? remote : local;
+            QVector<QByteArray> in_order = endpoint.receive((const unsigned char*)frame.constData(),
+                                                            frame.size(), now);
+            delivered += in_order;
+            channel.removeAt(i);
+        }
+        for(int i=0;i<delivered.size();i++)
+        {
+            qint64 sent;
+            memcpy(&sent, delivered.at(i).constData(), sizeof(sent));
+            total_delay += now - sent;
+            last_delivery = now;
+            received++;
+        }
+        /// everything acknowledged or given up on, let the last holes expire
+        if((drain_end < 0) && (queued >= packets) && local._window.isEmpty())
+            drain_end = now + max_delay_usec + LOOPBACK_FRAME_USEC + LOOPBACK_LATENCY_USEC;
+    }
+    loopbackresult result;
+    float seconds = (float)std::max(last_delivery, LOOPBACK_FRAME_USEC) / 1000000;
+    result.goodput_kbps = received * LOOPBACK_PACKET_SIZE * 8 / seconds / 1000;
+    result.plain_kbps = (1.0f - frame_error_rate) * LOOPBACK_PACKET_SIZE * 8 * 1000 /
+            LOOPBACK_FRAME_USEC;
+    result.residual_loss = 1.0f - (float)received / packets;
+    result.retransmit_ratio = (float)local._stats.retransmissions / packets;
+    result.mean_delay_msec = (received > 0) ? total_delay / received / 1000 : 0;
+    return result;
+}
@@ -0,0 +1,111 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef LINKARQ_H
+#define LINKARQ_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QQueue>
+
+/// Selective repeat ARQ for the point to point IP modem link.
+/// Every frame carries a sequence number when it has a packet, the oldest
+/// sequence the sender still holds and what was received from the other
+/// side: the next sequence expected plus a bitmap of the frames after it.
+/// Holes below the highest bit set work as negative acknowledgements and
+/// are sent again at once, frames without any feedback after a timeout.
+/// Nothing is retried for longer than max_delay, after that the sender
+/// gives up and the receiver releases what it held behind the hole, so
+/// TCP never sees more delay than that from this link
+class LinkArq
+{
+public:
+    struct stats
+    {
+        quint64 frames_sent;
+        quint64 dropped; // too large or queue full
+        quint64 retransmissions;
+        quint64 expired; // given up after max_delay
+        quint64 delivered;
+        quint64 duplicates;
+        quint64 skipped; // holes the receiver stopped waiting for
+        qint64 rtt_usec;
+    };
+
+    /// Offline run of two endpoints over a channel losing frames at random
+    struct loopbackresult
+    {
+        float goodput_kbps;
+        float plain_kbps; // the same channel without ARQ
+        float residual_loss;
+        float retransmit_ratio;
+        float mean_delay_msec;
+    };
+
+    /// payload_size is what one radio frame carries, ARQ header included
+    LinkArq(int payload_size, qint64 max_delay_usec);
+
+    /// Copies the packet, false when it is too large for a frame or the
+    /// queue is full and it was dropped
+    bool queuePacket(const unsigned char *data, int size);
+    /// Next frame payload to send, empty when there is nothing to say.
+    /// With force set an acknowledgement is sent even if nothing changed
+    QByteArray nextFrame(qint64 now_usec, bool force);
+    /// Takes a frame payload which passed the CRC, returns the packets now in order
+    QVector<QByteArray> receive(const unsigned char *data, int size, qint64 now_usec);
+    /// Packets held behind a hole for longer than max_delay
+    QVector<QByteArray> expire(qint64 now_usec);
+    stats getStats() const;
+
+    static loopbackresult loopback(float frame_error_rate, qint64 max_delay_usec, int packets);
+
+private:
+    struct txentry
+    {
+        QByteArray packet;
+        quint8 seq;
+        qint64 first_sent;
+        qint64 last_sent;
+        int transmissions;
+        bool done; // acknowledged or expired
+        bool nacked;
+    };
+
+    struct rxslot
+    {
+        bool present;
+        QByteArray packet;
+        qint64 received;
+    };
+
+    void readFeedback(quint8 ack, quint16 bitmap, qint64 now_usec);
+    void advanceReceiver(QVector<QByteArray> &packets);
+    void deliverInOrder(QVector<QByteArray> &packets);
+    qint64 retransmitTimeout() const;
+
+    int _payload_size;
+    qint64 _max_delay_usec;
+    QQueue<QByteArray> _queue;
+    QVector<txentry> _window;
+    quint8 _next_seq;
+    QVector<rxslot> _rx_slots; // index 0 is the next sequence expected
+    quint8 _expected;
+    bool _ack_owed;
+    stats _stats;
+};
+
+#endif // LINKARQ_H
@@ -15,6 +15,8 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "logger.h"
+#include <time.h>
+#include <algorithm>
 
 
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
@@ -65,13 +67,60 @@ void logMessage(QtMsgType type, const char *msg)
 Logger::Logger(QObject *parent)
 {
     Q_UNUSED(parent);
+    _log_file = nullptr;
+    _stream = nullptr;
+    _console_log = true;
+    _log_level = LogLevelDebug;
+    _rate_limit = 10;
+    _format = LogFormatText;
+    _current_format = -1;
+    _cached_second = -1;
+    for(int i=0;i<LogSubsystemCount;i++)
+    {
+        _rate_limits[i].window = 0;
+        _rate_limits[i].count = 0;
+        _rate_limits[i].suppressed = 0;
+    }
+    _stub.next = nullptr;
+    _head = &_stub;
+    _tail = &_stub;
+    open_log_file(LogFormatText);
+    _running = true;
+    _writer_thread = std::thread(&Logger::writer_loop, this);
+}
+
+Logger::~Logger()
+{
+    /// writer drains whatever is still queued before exiting
+    _running = false;
+    _writer_thread.join();
+    delete _stream;
+    _log_file->close();
+    delete _log_file;
+}
+
+void Logger::open_log_file(int format)
+{
+    QString file_name;
+    switch(format)
+    {
+    case LogFormatJson:
+        file_name = ".config/qradiolink/qradiolink.log.json";
+        break;
+    case LogFormatBinary:
+        file_name = ".config/qradiolink/qradiolink.log.bin";
+        break;
+    default:
+        file_name = ".config/qradiolink/qradiolink.log";
+        break;
+    }
     QDir files = QDir::homePath();
     if(!QDir(files.absolutePath()+"/.config/qradiolink").exists())
     {
         QDir().mkdir(files.absolutePath()+"/.config/qradiolink");
     }
-    QFileInfo log_file = files.filePath(".config/qradiolink/qradiolink.log");
-    if(!log_file.exists())
+    QFileInfo log_file = files.filePath(file_name);
+    if(!log_file.exists() && (format == LogFormatText))
     {
         QString txt = "[Log start]\n";
         QFile newfile(log_file.absoluteFilePath());
@@ -82,63 +131,221 @@ Logger::Logger(QObject *parent)
             newfile.close();
         }
     }
+    if(_log_file != nullptr)
+    {
+        delete _stream;
+        _log_file->close();
+        delete _log_file;
+    }
     _log_file = new QFile(log_file.absoluteFilePath());
     _log_file->open(QIODevice::WriteOnly | QIODevice::Append);
     _stream = new QTextStream(_log_file);
-    _console_log = true;
+    _current_format = format;
 }
 
-Logger::~Logger()
+void Logger::set_console_log(bool value)
 {
-    delete _stream;
-    _log_file->close();
-    delete _log_file;
+    _console_log = value;
 }
 
-void Logger::set_console_log(bool value)
+void Logger::set_log_level(int level)
 {
-    _console_log = value;
+    _log_level = level;
 }
 
-void Logger::log(int type, QString msg)
+void Logger::set_rate_limit(int messages_per_second)
 {
-    _mutex.lock();
-    QString time= QDateTime::currentDateTime().toString(
-                "d/MMM/yyyy hh:mm:ss");
-    QString txt;
-    bool err = false;
+    _rate_limit = messages_per_second;
+}
 
-    switch (type) {
-    case LogLevelInfo:
-        txt = QString("[%1] [Info] %2").arg(time).arg(msg);
-        break;
+void Logger::set_output_format(int format)
+{
+    _format = format;
+}
+
+int Logger::severity(int type)
+{
+    /// Debug is declared after Info but is the least severe
+    switch(type)
+    {
     case LogLevelDebug:
-        txt = QString("[%1] [Debug] %2").arg(time).arg(msg);
-        break;
+        return 0;
+    case LogLevelInfo:
+        return 1;
     case LogLevelWarning:
-        txt = QString("[%1] [Warning] %2").arg(time).arg(msg);
-        break;
+        return 2;
     case LogLevelCritical:
-        txt = QString("[%1] [Critical] %2").arg(time).arg(msg);
-        err = true;
-        break;
-    case LogLevelFatal:
-        txt = QString("[%1] [Fatal] %2").arg(time).arg(msg);
-        err = true;
-        break;
+        return 3;
+    default:
+        return 4;
     }
+}
+
+void Logger::log(int type, QString msg, int subsystem)
+{
+    if(severity(type) < severity(_log_level))
+        return;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if((subsystem > LogSubsystemGeneral) && (subsystem < LogSubsystemCount) && (_rate_limit > 0))
+    {
+        RateLimit &limit = _rate_limits[subsystem];
+        qint64 second = now / 1000;
+        qint64 window = limit.window.load();
+        if((window != second) && limit.window.compare_exchange_strong(window, second))
+        {
+            limit.count = 0;
+            int suppressed = limit.suppressed.exchange(0);
+            if(suppressed > 0)
+            {
+                LogEntry *note = new LogEntry;
+                note->type = LogLevelWarning;
+                note->subsystem = subsystem;
+                note->timestamp = now;
+                note->msg = QString("%1 similar messages suppressed").arg(suppressed);
+                enqueue(note);
+            }
+        }
+        if(limit.count.fetch_add(1) >= _rate_limit)
+        {
+            limit.suppressed.fetch_add(1);
+            return;
+        }
+    }
+    LogEntry *entry = new LogEntry;
+    entry->type = type;
+    entry->subsystem = subsystem;
+    entry->timestamp = now;
+    entry->msg = msg;
+    enqueue(entry);
+}
+
+void Logger::enqueue(LogEntry *entry)
+{
+    entry->next.store(nullptr, std::memory_order_relaxed);
+    LogEntry *prev = _head.exchange(entry, std::memory_order_acq_rel);
+    prev->next.store(entry, std::memory_order_release);
+}
+
+Logger::LogEntry* Logger::dequeue()
+{
+    LogEntry *tail = _tail;
+    LogEntry *next = tail->next.load(std::memory_order_acquire);
+    if(tail == &_stub)
+    {
+        if(next == nullptr)
+            return nullptr;
+        _tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if(next != nullptr)
+    {
+        _tail = next;
+        return tail;
+    }
+    if(tail != _head.load(std::memory_order_acquire))
+    {
+        // a producer is halfway through enqueue, pick it up next round
+        return nullptr;
+    }
+    enqueue(&_stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if(next != nullptr)
+    {
+        _tail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+void Logger::writer_loop()
+{
+    while(true)
+    {
+        bool running = _running;
+        if(_format != _current_format)
+            open_log_file(_format);
+        bool written = false;
+        LogEntry *entry;
+        while((entry = dequeue()) != nullptr)
+        {
+            write_entry(entry);
+            delete entry;
+            written = true;
+        }
+        if(written)
+        {
+            /// one flush per batch instead of one per message
+            _stream->flush();
+            if(_console_log)
+            {
+                std::cout.flush();
+                std::cerr.flush();
+            }
+        }
+        if(!running)
+            break;
+        struct timespec time_to_sleep = {0, 10000000L };
+        nanosleep(&time_to_sleep, NULL);
+    }
+}
+
+void Logger::write_entry(LogEntry *entry)
+{
+    static const char *level_names[] = {"Info", "Debug", "Warning", "Critical", "Fatal"};
+    static const char *subsystem_names[] = {"general", "modem", "video", "net", "audio", "voip"};
+    int type = std::min(std::max(entry->type, (int)LogLevelInfo), (int)LogLevelFatal);
+    int subsystem = std::min(std::max(entry->subsystem, (int)LogSubsystemGeneral),
+                             (int)LogSubsystemCount - 1);
+
+    /// Timestamp is formatted once per second
+    qint64 second = entry->timestamp / 1000;
+    if(second != _cached_second)
+    {
+        _cached_second = second;
+        _cached_time = QDateTime::fromMSecsSinceEpoch(entry->timestamp).toString(
+                    "d/MMM/yyyy hh:mm:ss");
+    }
+    QString txt = QString("[%1] [%2] %3").arg(_cached_time).arg(level_names[type]).arg(entry->msg);
+    bool err = (type == LogLevelCritical) || (type == LogLevelFatal);
+
     if(_console_log)
     {
         if(err)
-            std::cerr << txt.toStdString() << std::endl;
+            std::cerr << txt.toStdString() << '\n';
         else
-            std::cout << txt.toStdString() << std::endl;
+            std::cout << txt.toStdString() << '\n';
         emit applicationLog(txt);
     }
 
-    *_stream << txt << endl;
-    _mutex.unlock();
-
+    switch(_current_format)
+    {
+    case LogFormatJson:
+    {
+        QString msg = entry->msg;
+        msg.replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n");
+        *_stream << QString("{\"time\":%1,\"level\":\"%2\",\"subsystem\":\"%3\",\"msg\":\"%4\"}\n")
+                    .arg(entry->timestamp).arg(level_names[type])
+                    .arg(subsystem_names[subsystem]).arg(msg);
+        break;
+    }
+    case LogFormatBinary:
+    {
+        /// u8 level, u8 subsystem, i64 msec timestamp, u32 length, utf8 text
+        QByteArray text = entry->msg.toUtf8();
+        quint32 len = text.size();
+        QByteArray record;
+        record.append((char)type);
+        record.append((char)subsystem);
+        record.append((const char*)&entry->timestamp, sizeof(entry->timestamp));
+        record.append((const char*)&len, sizeof(len));
+        record.append(text);
+        _stream->flush();
+        _log_file->write(record);
+        break;
+    }
+    default:
+        *_stream << txt << '\n';
+        break;
+    }
 }
-
-
@@ -26,6 +26,9 @@
 #include <QFileInfo>
 #include <QDateTime>
 #include <iostream>
+#include <atomic>
+#include <thread>
+#include <string>
 
 
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
@@ -47,19 +50,77 @@ public:
         LogLevelCritical,
         LogLevelFatal
     };
+    /// Rate limits are applied per subsystem, General is never limited
+    enum
+    {
+        LogSubsystemGeneral,
+        LogSubsystemModem,
+        LogSubsystemVideo,
+        LogSubsystemNet,
+        LogSubsystemAudio,
+        LogSubsystemVoip,
+        LogSubsystemCount
+    };
+    enum
+    {
+        LogFormatText,
+        LogFormatJson,
+        LogFormatBinary
+    };
     explicit Logger(QObject *parent = 0);
     ~Logger();
-    void log(int type, QString msg);
+    /// Safe to call from any thread, never blocks on I/O
+    void log(int type, QString msg, int subsystem=LogSubsystemGeneral);
     void set_console_log(bool value);
+    void set_log_level(int level);
+    void set_rate_limit(int messages_per_second);
+    void set_output_format(int format);
 
 signals:
     void applicationLog(QString msg);
 
 private:
+    struct LogEntry
+    {
+        std::atomic<LogEntry*> next;
+        int type;
+        int subsystem;
+        qint64 timestamp; // msec since epoch
+        QString msg;
+    };
+    struct RateLimit
+    {
+        std::atomic<qint64> window;
+        std::atomic<int> count;
+        std::atomic<int> suppressed;
+    };
+
+    void enqueue(LogEntry *entry);
+    LogEntry *dequeue();
+    void writer_loop();
+    void write_entry(LogEntry *entry);
+    void open_log_file(int format);
+    static int severity(int type);
+
     QFile *_log_file;
-    bool _console_log;
     QTextStream *_stream;
-    QMutex _mutex;
+    std::atomic<bool> _console_log;
+    std::atomic<int> _log_level;
+    std::atomic<int> _rate_limit;
+    std::atomic<int> _format;
+    int _current_format;
+    RateLimit _rate_limits[LogSubsystemCount];
+
+    /// Intrusive MPSC queue: producers swap the head, the writer walks from the tail
+    std::atomic<LogEntry*> _head;
+    LogEntry *_tail;
+    LogEntry _stub;
+    std::thread _writer_thread;
+    std::atomic<bool> _running;
+
+    /// Only touched by the writer thread
+    qint64 _cached_second;
+    QString _cached_time;
 };
 
 #endif // LOGGER_H
@@ -16,6 +16,9 @@
 
 #include "mumbleclient.h"
 
+/// 120 msec at 8 ksps, the longest Opus packet
+static const int DECODE_MAX_SAMPLES = 960;
+
 
 MumbleClient::MumbleClient(const Settings *settings, Logger *logger, QObject *parent) :
     QObject(parent)
@@ -33,6 +36,8 @@ MumbleClient::MumbleClient(const Settings *settings, Logger *logger, QObject *pa
     _temp_channel_name = "";
     _sequence_number = 0;
     _connection_in_progress = false;
+    _link_id = 0;
+    _link_bitrate = 0;
 
 #ifndef NO_CRYPT
     _crypt_state = new CryptState;
@@ -49,6 +54,19 @@ MumbleClient::~MumbleClient()
 #endif
 }
 
+void MumbleClient::setLink(int link_id, QString password, QString channel, int bitrate)
+{
+    _link_id = link_id;
+    _link_password = password;
+    _link_channel = channel;
+    _link_bitrate = bitrate;
+}
+
+int MumbleClient::getLinkId()
+{
+    return _link_id;
+}
+
 void MumbleClient::connectToServer(QString address, unsigned port)
 {
     if(_connection_in_progress)
@@ -89,9 +107,12 @@ void MumbleClient::cleanup()
     _authenticated = false;
     _synchronized = false;
     _ping_timer->stop();
-    Settings *settings = const_cast<Settings*>(_settings);
-    settings->voip_connected = false;
-    settings->current_voip_channel = -1;
+    if(_link_id == 0)
+    {
+        Settings *settings = const_cast<Settings*>(_settings);
+        settings->voip_connected = false;
+        settings->current_voip_channel = -1;
+    }
     _session_id = INT64_MAX;
     _channel_id = INT64_MAX;
     for(int i=0; i < _channels.size();i++)
@@ -134,7 +155,10 @@ void MumbleClient::authenticate()
     QString username = _settings->callsign;
     username += "-" + QString::fromLocal8Bit(rand);
     auth->set_username(username.toStdString());
-    auth->set_password(_settings->voip_password.toStdString());
+    if(_link_id > 0)
+        auth->set_password(_link_password.toStdString());
+    else
+        auth->set_password(_settings->voip_password.toStdString());
     auth->set_opus(true);
     int size = auth->ByteSize();
     unsigned char data[size];
@@ -284,6 +308,19 @@ void MumbleClient::processServerSync(quint8 *message, quint64 size)
     _logger->log(Logger::LogLevelInfo, msg);
     emit connectedToServer(msg);
     _ping_timer->start(10000);
+    if(_link_id > 0)
+    {
+        /// channel states arrive before the sync
+        for(int i=0;i<_channels.size();i++)
+        {
+            if(!_link_channel.isEmpty() && (_channels.at(i)->name == _link_channel))
+            {
+                joinChannel(_channels.at(i)->id);
+                break;
+            }
+        }
+        return;
+    }
     Settings *settings = const_cast<Settings*>(_settings);
     settings->voip_connected = true;
 }
@@ -337,8 +374,11 @@ void MumbleClient::processUserState(quint8 *message, quint64 size)
         _channel_id = us.channel_id();
         emit textMessage(QString("Joined channel: %1\n").arg(_channel_id), false);
         emit joinedChannel(_channel_id);
-        Settings *settings = const_cast<Settings*>(_settings);
-        settings->current_voip_channel = _channel_id;
+        if(_link_id == 0)
+        {
+            Settings *settings = const_cast<Settings*>(_settings);
+            settings->current_voip_channel = _channel_id;
+        }
     }
     if(us.session() == _session_id)
     {
@@ -359,8 +399,11 @@ void MumbleClient::processUserState(quint8 *message, quint64 size)
             emit textMessage(QString("Joined channel: %1\n").arg(_channel_id), false);
             emit joinedChannel(_channel_id);
             s->channel_id = us.channel_id();
-            Settings *settings = const_cast<Settings*>(_settings);
-            settings->current_voip_channel = _channel_id;
+            if(_link_id == 0)
+            {
+                Settings *settings = const_cast<Settings*>(_settings);
+                settings->current_voip_channel = _channel_id;
+            }
         }
     }
 
@@ -436,8 +479,11 @@ void MumbleClient::joinChannel(int id)
     us.SerializeToArray(data,size);
     sendProtoMessage(data,9,size);
     _channel_id = id;
-    Settings *settings = const_cast<Settings*>(_settings);
-    settings->current_voip_channel = _channel_id;
+    if(_link_id == 0)
+    {
+        Settings *settings = const_cast<Settings*>(_settings);
+        settings->current_voip_channel = _channel_id;
+    }
 }
 
 int MumbleClient::muteStation(QString radio_id)
@@ -669,24 +715,27 @@ void MumbleClient::processPCMAudio(short *audiobuffer, int audiobuffersize)
         delete[] audiobuffer;
         return;
     }
-    int packet_size = 0;
-    unsigned char *encoded_audio;
+    unsigned char encoded_audio[4096];
     /// encode the PCM with higher quality and bitrate
-    encoded_audio = _codec->encode_opus_voip(audiobuffer, audiobuffersize, packet_size);
-    createVoicePacket(encoded_audio, packet_size);
-    delete[] encoded_audio;
+    int packet_size = _codec->encode_opus_voip(audiobuffer, audiobuffersize/sizeof(short),
+                                               encoded_audio, sizeof(encoded_audio));
+    if(packet_size > 0)
+        createVoicePacket(encoded_audio, packet_size);
     delete[] audiobuffer;
 }
 
-void MumbleClient::processOpusAudio(unsigned char *opus_packet, int packet_size)
+void MumbleClient::processOpusAudio(QByteArray opus_packet, int bitrate)
 {
     if(!_synchronized)
     {
-        delete[] opus_packet;
         return;
     }
-    createVoicePacket(opus_packet, packet_size);
-    delete[] opus_packet;
+    int wanted_bitrate = (_link_bitrate > 0) ? _link_bitrate : _settings->voip_bitrate;
+    if(bitrate != wanted_bitrate)
+    {
+        return;
+    }
+    createVoicePacket((unsigned char*)opus_packet.constData(), opus_packet.size());
 }
 
 void MumbleClient::processVideoFrame(unsigned char *video_frame, int frame_size)
@@ -712,14 +761,13 @@ void MumbleClient::createVoicePacket(unsigned char *encoded_audio, int packet_si
     char data[data_size];
     data[0] = static_cast<unsigned char>(type);
     PacketDataStream pds(data + 1, data_size-1);
-    int nr_of_frames = opus_packet_get_nb_frames(encoded_audio,packet_size);
+    /// the sequence counts 10 msec units, whatever the frame size and count
+    int nr_of_samples = opus_packet_get_nb_samples(encoded_audio, packet_size, 8000);
 
     pds << _sequence_number;
     int real_packet_size = packet_size;
-    /// Not documented anywhere by Mumble:
-    /// by incrementing the sequence by more frames than needed, we can force the client
-    /// to wait more time before playing the audio and thus eliminate interruptions on slow networks
-    _sequence_number += nr_of_frames * 4;
+    if(nr_of_samples > 0)
+        _sequence_number += nr_of_samples / 80;
     //packet_size |= 1 << 13;
     pds << packet_size;
 
@@ -835,18 +883,21 @@ void MumbleClient::decodeAudio(unsigned char *audiobuffer,
                                short audiobuffersize, quint8 type, quint64 session_id)
 {
     int samples =0;
-    short *pcm = nullptr;
+    /// decoded audio crosses to the radio thread, which gets the buffer
+    QByteArray frame(DECODE_MAX_SAMPLES * sizeof(short), Qt::Uninitialized);
+    short *pcm = (short*)frame.data();
     if(type == 5) // never
     {
-        pcm = _codec->decode_codec2_1400(audiobuffer,audiobuffersize, samples);
+        samples = _codec->decode_codec2_1400(audiobuffer,audiobuffersize, pcm, DECODE_MAX_SAMPLES);
     }
     else // always
     {
-        pcm = _codec->decode_opus_voip(audiobuffer,audiobuffersize, samples);
+        samples = _codec->decode_opus_voip(audiobuffer,audiobuffersize, pcm, DECODE_MAX_SAMPLES);
     }
-    if(pcm == nullptr)
+    if(samples <= 0)
         return;
-    emit pcmAudio(pcm, samples, session_id);
+    frame.resize(samples * sizeof(short));
+    emit pcmAudio(frame, ((quint64)_link_id << 32) | session_id);
     emit userSpeaking(session_id);
 }
 
@@ -47,13 +47,18 @@ class MumbleClient : public QObject
 public:
     explicit MumbleClient(const Settings *settings, Logger *logger, QObject *parent = 0);
     ~MumbleClient();
+    /// Extra sessions bridged to the same radio use their own password, channel
+    /// and bitrate and leave the shared VOIP state in Settings alone
+    void setLink(int link_id, QString password, QString channel, int bitrate);
+    int getLinkId();
 
 
 signals:
     void connectedToServer(QString message);
     void disconnected();
     void channelName(QString name);
-    void pcmAudio(short *pcm, int size, quint64 session_id);
+    /// session_id carries the link id in the upper 32 bits
+    void pcmAudio(QByteArray pcm, quint64 session_id);
     void opusAudio(unsigned char *audio, int size, quint64 session_id);
     void onlineStations(StationList stations);
     void newStation(Station* s);
@@ -78,7 +83,8 @@ public slots:
     void processUDPData(QByteArray data);
     void sendUDPPing();
     void processPCMAudio(short *audiobuffer, int audiobuffersize);
-    void processOpusAudio(unsigned char *opus_packet, int packet_size);
+    /// packets encoded at another bitrate than ours are ignored
+    void processOpusAudio(QByteArray opus_packet, int bitrate);
     void processVideoFrame(unsigned char *video_frame, int frame_size);
     QString getChannelName();
     int getChannelId();
@@ -130,6 +136,10 @@ private:
     quint64 _session_id;
     quint64 _channel_id;
     quint64 _sequence_number;
+    int _link_id;
+    QString _link_password;
+    QString _link_channel;
+    int _link_bitrate;
 
     /// not used
     std::string _key;
@@ -0,0 +1,69 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef RADIOCONFIG_H
+#define RADIOCONFIG_H
+
+/// A set of radio changes applied as one transaction.
+/// Only fields that were set are applied, the flowgraph is locked at most
+/// once for the whole set and values equal to the current state are skipped
+struct RadioConfig
+{
+    enum Field
+    {
+        RxFrequency = 1 << 0,
+        TxFrequency = 1 << 1,
+        RxMode = 1 << 2,
+        TxMode = 1 << 3,
+        Squelch = 1 << 4,
+        RxCTCSS = 1 << 5,
+        TxCTCSS = 1 << 6,
+        FFTSize = 1 << 7,
+        SampleRate = 1 << 8,
+    };
+
+    RadioConfig() : fields(0), rx_frequency(0), tx_frequency(0), rx_mode(0), tx_mode(0),
+        squelch(0), rx_ctcss(0), tx_ctcss(0), fft_size(0), samp_rate(0) {}
+
+    bool has(Field field) const { return (fields & field) != 0; }
+    bool isEmpty() const { return fields == 0; }
+    void clear() { fields = 0; }
+    void remove(Field field) { fields &= ~field; }
+
+    void setRxFrequency(long long value) { rx_frequency = value; fields |= RxFrequency; }
+    void setTxFrequency(long long value) { tx_frequency = value; fields |= TxFrequency; }
+    void setRxMode(int value) { rx_mode = value; fields |= RxMode; }
+    void setTxMode(int value) { tx_mode = value; fields |= TxMode; }
+    void setSquelch(int value) { squelch = value; fields |= Squelch; }
+    void setRxCTCSS(float value) { rx_ctcss = value; fields |= RxCTCSS; }
+    void setTxCTCSS(float value) { tx_ctcss = value; fields |= TxCTCSS; }
+    void setFFTSize(int value) { fft_size = value; fields |= FFTSize; }
+    void setSampleRate(int value) { samp_rate = value; fields |= SampleRate; }
+
+    unsigned int fields;
+    long long rx_frequency;
+    long long tx_frequency;
+    int rx_mode;    // gr_modem_types
+    int tx_mode;    // gr_modem_types
+    int squelch;
+    float rx_ctcss;
+    float tx_ctcss;
+    int fft_size;
+    int samp_rate;
+};
+
+#endif // RADIOCONFIG_H
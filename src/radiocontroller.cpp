@@ -16,15 +16,43 @@
 
 #include "radiocontroller.h"
 
+/// 40 msec of Opus at 9400 bps is the largest encoded voice frame
+static const int ENCODED_MAX_FRAME_BYTES = 47;
+/// encoded frames cross to the modem thread, keep more than a second of them
+static const int ENCODED_POOL_FRAMES = 64;
+/// one loop must not take longer than a voice frame
+static const qint64 RADIOOP_DEADLINE_USEC = 40000;
+/// busiest flowgraph blocks written to the log on each profile
+static const unsigned int PROFILE_LOG_BLOCKS = 5;
+/// seconds between buffer reports and auto-tuning steps
+static const int BUFFER_TUNE_SEC = 5;
+/// fewer samples than this share of the sample rate means the receiver dropped some
+static const float RX_SAMPLE_RATIO_MIN = 0.99f;
+/// and while transmitting that the sink ran out of samples
+static const float TX_SAMPLE_RATIO_MIN = 0.99f;
+/// the transmitter throughput is measured over intervals this long
+static const qint64 TX_SAMPLE_MSEC = 1000;
+/// restarting the receiver to resize its buffers waits for a quiet channel
+static const qint64 RX_IDLE_MSEC = 2000;
+/// IP modem radio frame, length and CRC header followed by the payload
+static const int NET_FRAME_SIZE = 1516;
+static const int NET_FRAME_HEADER = 16;
+
 
 RadioController::RadioController(Settings *settings, Logger *logger,
-                                 RadioChannels *radio_channels, QObject *parent) :
+                                 RadioChannels *radio_channels, Telemetry *telemetry, QObject *parent) :
     QObject(parent)
 {
     /// these pointers are owned by main()
     _settings = settings;
     _logger = logger;
     _radio_channels = radio_channels;
+    _telemetry = telemetry;
+    _loop_deadline = _telemetry->addDeadline("radioop", RADIOOP_DEADLINE_USEC);
+    _rx_buffer_overflow = false;
+    _tx_buffer_underflow = false;
+    _tx_buffer_sampled = false;
+    _tx_buffer_sampling = false;
 
     _modem = new gr_modem(settings, logger);
     _codec = new AudioEncoder(settings);
@@ -34,11 +62,24 @@ RadioController::RadioController(Settings *settings, Logger *logger,
     _video = new VideoEncoder(logger);
     //_camera = new ImageCapture(settings, logger);
     _net_device = new NetDevice(logger, 0, _settings->ip_address);
+    _tdma_mac = new TdmaMac(settings, logger, NET_FRAME_SIZE - NET_FRAME_HEADER);
+    _link_arq = new LinkArq(NET_FRAME_SIZE - NET_FRAME_HEADER, (qint64)settings->arq_max_delay * 1000);
     _mutex = new QMutex;
 
     _rand_frame_data = new unsigned char[4000];
-    /// one way queue from radio and local voice to Mumble
-    _to_voip_buffer = new QVector<short>;
+    _encoded_pool = new unsigned char[ENCODED_POOL_FRAMES * ENCODED_MAX_FRAME_BYTES];
+    _encoded_pool_index = 0;
+    _rx_pcm.reserve(4096);
+    /// one way queue from radio and local voice to Mumble, encoded in its own thread
+    _voip_uplink = new VoipUplink(settings, logger, telemetry);
+    _voip_uplink_thread = new QThread;
+    _voip_uplink_thread->setObjectName("voipuplink");
+    _voip_uplink->moveToThread(_voip_uplink_thread);
+    QObject::connect(_voip_uplink_thread, SIGNAL(started()), _voip_uplink, SLOT(run()));
+    QObject::connect(_voip_uplink, SIGNAL(finished()), _voip_uplink_thread, SLOT(quit()));
+    QObject::connect(_voip_uplink, SIGNAL(voipDataOpus(QByteArray,int)),
+                     this, SIGNAL(voipDataOpus(QByteArray,int)));
+    _voip_uplink_thread->start();
     /// pre-allocated at maximum possible FFT size (make it a constant?)
     _fft_data = new float[1048576];
     _end_rec_sound = nullptr;
@@ -57,6 +98,13 @@ RadioController::RadioController(Settings *settings, Logger *logger,
     _data_read_timer = new QElapsedTimer();
     _data_modem_reset_timer = new QElapsedTimer();
     _data_modem_sleep_timer = new QElapsedTimer();
+    _tdma_timer = new QElapsedTimer();
+    _tdma_timer->start();
+    _arq_timer = new QElapsedTimer();
+    _arq_timer->start();
+    _rx_activity_timer = new QElapsedTimer();
+    _rx_activity_timer->start();
+    _tx_sample_timer = new QElapsedTimer();
     _scan_timer = new QElapsedTimer();
     _const_read_timer = new QElapsedTimer();
     _const_read_timer->start();
@@ -75,12 +123,13 @@ RadioController::RadioController(Settings *settings, Logger *logger,
     _memory_scan_done = true;
 
     _data_modem_sleeping = false;
-    _radio_to_voip_on = false;
     _video_on = false;
     _text_transmit_on = false;
     _proto_transmit_on = false;
     _cw_tone = false;
     _transmitting = false;
+    _cut_through_repeater = false;
+    _audio_bridge_repeater = false;
     _process_text = false;
     _process_data = false;
     _repeat_text = false;
@@ -118,6 +167,7 @@ RadioController::RadioController(Settings *settings, Logger *logger,
     QObject::connect(_modem,SIGNAL(dataFrameReceived()),this,SLOT(dataFrameReceived()));
     QObject::connect(_modem,SIGNAL(receiveEnd()),this,SLOT(receiveEnd()));
     QObject::connect(_modem,SIGNAL(endAudioTransmission()),this,SLOT(endAudioTransmission()));
+    QObject::connect(_modem,SIGNAL(repeatedFrame()),this,SLOT(repeatedFrame()));
     QObject::connect(this,SIGNAL(audioData(unsigned char*,int)),_modem,
                      SLOT(transmitDigitalAudio(unsigned char*,int)));
     QObject::connect(this,SIGNAL(pcmData(std::vector<float>*)),_modem,
@@ -170,6 +220,8 @@ RadioController::~RadioController()
     delete _audio_mixer_in;
     delete _video;
     delete _net_device;
+    delete _tdma_mac;
+    delete _link_arq;
     delete _layer2;
     delete _voice_led_timer;
     delete _data_led_timer;
@@ -179,8 +231,12 @@ RadioController::~RadioController()
     delete _cw_timer;
     delete _modem;
     delete[] _rand_frame_data;
-    _to_voip_buffer->clear();
-    delete _to_voip_buffer;
+    delete[] _encoded_pool;
+    _voip_uplink->stop();
+    _voip_uplink_thread->quit();
+    _voip_uplink_thread->wait();
+    delete _voip_uplink;
+    delete _voip_uplink_thread;
     delete _relay_controller;
     delete _end_rec_sound;
     delete _data_rec_sound;
@@ -202,15 +258,18 @@ void RadioController::run()
     bool data_to_process = false;
     bool buffers_filling = false;
     int last_channel_broadcast_time = 0;
+    int last_block_profile_time = 0;
+    int last_buffer_tune_time = 0;
+    ThreadScheduler::applyProfile(_settings, _logger, "radioop");
+    QElapsedTimer loop_timer;
     while(!_stop_thread)
     {
+        loop_timer.start();
         bool transmitting = _transmitting;
         bool voip_forwarding = _settings->voip_forwarding;
         bool data_modem_sleeping = _data_modem_sleeping;
 
         QCoreApplication::processEvents(); // process signals
-        if(_settings->voip_connected)
-            QtConcurrent::run(this, &RadioController::flushRadioToVoipBuffer);
         buffers_filling = processMixerQueue();
 
         int time = QDateTime::currentDateTime().toTime_t();
@@ -224,6 +283,19 @@ void RadioController::run()
                 //transmitServerInfoBeacon();
             }
         }
+        if((_settings->block_profiler > 0) &&
+                ((time - last_block_profile_time) >= _settings->block_profiler))
+        {
+            last_block_profile_time = time;
+            profileBlocks();
+        }
+        if(_settings->block_buffer_auto)
+            sampleBuffers(transmitting);
+        if((time - last_buffer_tune_time) >= BUFFER_TUNE_SEC)
+        {
+            last_buffer_tune_time = time;
+            tuneBuffers(transmitting);
+        }
 
         updateDataModemReset(transmitting, ptt_activated); // for IP modem latency buildup
 
@@ -244,8 +316,10 @@ void RadioController::run()
             _process_data = false;
 
         /// Get all available data from the demodulator
-        QtConcurrent::run(this, &RadioController::getFFTData);
-        QtConcurrent::run(this, &RadioController::getConstellationData);
+        if(_settings->show_fft)
+            QtConcurrent::run(this, &RadioController::getFFTData);
+        if(_settings->show_constellation)
+            QtConcurrent::run(this, &RadioController::getConstellationData);
         QtConcurrent::run(this, &RadioController::getRSSI);
 
         if(transmitting)
@@ -265,6 +339,8 @@ void RadioController::run()
         }
 
         data_to_process = getDemodulatorData();
+        if(_audio_bridge_repeater && _modem->audioBridgeActive())
+            repeatedFrame();
 
         if(_process_text && !_text_transmit_on && (_tx_radio_type == radio_type::RADIO_TYPE_DIGITAL))
         {
@@ -275,6 +351,9 @@ void RadioController::run()
             QtConcurrent::run(this, &RadioController::transmitBinData);
         }
 
+        /// sleeping doesn't count against the deadline
+        _telemetry->countCycle(_loop_deadline, loop_timer.nsecsElapsed() / 1000);
+
         /// Needed to keep the thread from using the CPU
         if(!data_to_process && !buffers_filling && !_process_text && !_process_data)
         {
@@ -303,7 +382,7 @@ void RadioController::updateInputAudioStream()
             || (_tx_mode == gr_modem_types::ModemTypeCW600USB)
             || (_text_transmit_on || _proto_transmit_on))
     {
-        emit setAudioReadMode(false, false, AudioProcessor::AUDIO_MODE_ANALOG);
+        emit setAudioReadMode(false, false, AudioProcessor::AUDIO_MODE_ANALOG, 40);
         return;
     }
 
@@ -321,7 +400,8 @@ void RadioController::updateInputAudioStream()
             (_tx_mode == gr_modem_types::ModemType4FSK1000FM))
     {
         audio_mode = AudioProcessor::AUDIO_MODE_CODEC2;
-        emit setAudioReadMode(true, (bool)_settings->audio_compressor, audio_mode);
+        /// codec frames are 40 msec
+        emit setAudioReadMode(true, (bool)_settings->audio_compressor, audio_mode, 40);
     }
     else if((_tx_mode == gr_modem_types::ModemTypeQPSK20000) ||
             (_tx_mode == gr_modem_types::ModemType2FSK20000) ||
@@ -329,12 +409,14 @@ void RadioController::updateInputAudioStream()
             (_tx_mode == gr_modem_types::ModemType4FSK20000FM))
     {
         audio_mode = AudioProcessor::AUDIO_MODE_OPUS;
-        emit setAudioReadMode(true, (bool)_settings->audio_compressor, audio_mode);
+        emit setAudioReadMode(true, (bool)_settings->audio_compressor, audio_mode, 40);
     }
     else
     {
         audio_mode = AudioProcessor::AUDIO_MODE_ANALOG;
-        emit setAudioReadMode(true, (bool)_settings->audio_compressor, audio_mode);
+        /// analog and VOIP take any frame length, shorter frames go out sooner
+        emit setAudioReadMode(true, (bool)_settings->audio_compressor, audio_mode,
+                              _settings->audio_capture_frame);
     }
 }
 
@@ -361,32 +443,6 @@ void RadioController::updateCWK()
     _cw_timer->restart();
 }
 
-void RadioController::flushRadioToVoipBuffer()
-{
-    if(!_settings->voip_connected || _radio_to_voip_on)
-        return;
-    _radio_to_voip_on = true;
-    /// large size of frames (120 ms) are better for Mumble client compatibility, but...
-    int samples_in_buffer = _to_voip_buffer->size();
-    if(samples_in_buffer >= 320)
-    {
-
-        short *pcm = new short[320];
-        for(int i =0; i< 320;i++)
-        {
-            pcm[i] = _to_voip_buffer->at(i) * _voip_volume;
-        }
-        int packet_size = 0;
-        unsigned char *encoded_audio;
-        /// encode the PCM with higher quality and bitrate
-        encoded_audio = _codec->encode_opus_voip(pcm, 320*sizeof(short), packet_size);
-        emit voipDataOpus(encoded_audio,packet_size);
-        delete[] pcm;
-        _to_voip_buffer->remove(0,320);
-    }
-    _radio_to_voip_on = false;
-}
-
 bool RadioController::processMixerQueue()
 {
     if(_audio_mixer_in->buffers_available())
@@ -394,10 +450,17 @@ bool RadioController::processMixerQueue()
         short *pcm = _audio_mixer_in->mix_samples(_rx_volume);
         if(pcm == nullptr)
             return false;
-        short *local_pcm = new short[320];
-        memcpy(local_pcm, pcm, 320*sizeof(short));
 
-        if(_settings->voip_forwarding || _settings->repeater_enabled)
+        if(!((_settings->voip_forwarding || _settings->repeater_enabled) &&
+                _settings->mute_forwarded_audio))
+        {
+            /// Routed to local audio output, the writer copies it before
+            /// txAudio() encodes the buffer in place
+            emit writePCM(pcm, 320*sizeof(short), (bool)_settings->audio_compressor,
+                          AudioProcessor::AUDIO_MODE_OPUS);
+            audioFrameReceived();
+        }
+        if(_settings->voip_forwarding || (_settings->repeater_enabled && !_cut_through_repeater))
         {
             if(!_voip_tx_timer->isActive())
             {
@@ -407,29 +470,19 @@ bool RadioController::processMixerQueue()
             /// Out to radio and don't loop back to Mumble
             txAudio(pcm, 320*sizeof(short), 1, true);
         }
-        else
-        {
-            /// nothing towards radio or VOIP
-            delete[] pcm;
-        }
-        if((_settings->voip_forwarding || _settings->repeater_enabled) &&
-                _settings->mute_forwarded_audio)
-        {
-            delete[] local_pcm;
-        }
-        else
-        {
-            /// Routed to local audio output
-            emit writePCM(local_pcm, 320*sizeof(short), (bool)_settings->audio_compressor,
-                          AudioProcessor::AUDIO_MODE_OPUS);
-            audioFrameReceived();
-        }
+        delete[] pcm;
         return true;
     }
     return false;
 }
 
 
+void RadioController::txAudioFrame(QByteArray pcm, int vad, bool radio_only)
+{
+    /// txAudio() scales the samples in place, data() detaches if still shared
+    txAudio((short*)pcm.data(), pcm.size(), vad, radio_only);
+}
+
 void RadioController::txAudio(short *audiobuffer, int audiobuffer_size,
                               int vad, bool radio_only)
 {
@@ -448,23 +501,17 @@ void RadioController::txAudio(short *audiobuffer, int audiobuffer_size,
             if(_settings->tx_started && !_settings->voip_ptt_enabled)
                 _transmitting = false;
             /// Audio input stream will be stopped at the next thread iteration
-            delete[] audiobuffer;
             return;
         }
     }
 
     if(_transmitting && _settings->voip_ptt_enabled && !radio_only)
     {
-
-        for(unsigned int i=0;i< (unsigned int)audiobuffer_size/sizeof(short);i++)
-        {
-            _to_voip_buffer->push_back(audiobuffer[i] * _tx_volume);
-        }
+        _voip_uplink->push(audiobuffer, audiobuffer_size/sizeof(short), _tx_volume);
     }
 
     if(!_settings->tx_inited || !_settings->tx_started)
     {
-        delete[] audiobuffer; // safety
         return;
     }
 
@@ -481,16 +528,16 @@ void RadioController::txAudio(short *audiobuffer, int audiobuffer_size,
         }
 
         emit pcmData(pcm);
-        delete[] audiobuffer;
         return;
     }
 
     /// Digital voice
     ///
+    int samples = audiobuffer_size/sizeof(short);
     int packet_size = 0;
-    unsigned char *encoded_audio;
+    unsigned char *encoded_audio = &_encoded_pool[_encoded_pool_index * ENCODED_MAX_FRAME_BYTES];
     /// digital volume adjust
-    for(unsigned int i = 0;i< audiobuffer_size/sizeof(short);i++)
+    for(int i = 0;i< samples;i++)
     {
         audiobuffer[i] = audiobuffer[i] * _tx_volume;
     }
@@ -500,17 +547,21 @@ void RadioController::txAudio(short *audiobuffer, int audiobuffer_size,
             (_tx_mode == gr_modem_types::ModemType4FSK2000) ||
             (_tx_mode == gr_modem_types::ModemType4FSK2000FM) ||
             (_tx_mode == gr_modem_types::ModemTypeQPSK2000))
-        encoded_audio = _codec->encode_codec2_1400(audiobuffer, audiobuffer_size, packet_size);
+        packet_size = _codec->encode_codec2_1400(audiobuffer, samples, encoded_audio,
+                                                 ENCODED_MAX_FRAME_BYTES);
     else if((_tx_mode == gr_modem_types::ModemTypeBPSK1000) ||
             (_tx_mode == gr_modem_types::ModemType2FSK1000FM) ||
             (_tx_mode == gr_modem_types::ModemType2FSK1000) ||
             (_tx_mode == gr_modem_types::ModemType4FSK1000FM))
-        encoded_audio = _codec->encode_codec2_700(audiobuffer, audiobuffer_size, packet_size);
+        packet_size = _codec->encode_codec2_700(audiobuffer, samples, encoded_audio,
+                                                ENCODED_MAX_FRAME_BYTES);
     else
-        encoded_audio = _codec->encode_opus(audiobuffer, audiobuffer_size, packet_size);
-
+        packet_size = _codec->encode_opus(audiobuffer, samples, encoded_audio,
+                                          ENCODED_MAX_FRAME_BYTES);
+    if(packet_size <= 0)
+        return;
+    _encoded_pool_index = (_encoded_pool_index + 1) % ENCODED_POOL_FRAMES;
     emit audioData(encoded_audio,packet_size);
-    delete[] audiobuffer;
 }
 
 void RadioController::triggerImageCapture()
@@ -563,6 +614,13 @@ void RadioController::processVideoFrame()
     }
 
     //qDebug() << "video out " << microsec << " / " << encoded_size;
+    if(encoded_size == 0)
+    {
+        /// no frame from the capture thread yet
+        free(videobuffer);
+        _video_on = false;
+        return;
+    }
 
     if(encoded_size > max_video_frame_size - 24)
     {
@@ -589,6 +647,11 @@ void RadioController::processInputNetStream()
 {
     if(_tx_mode != gr_modem_types::ModemTypeQPSK250000)
         return;
+    if(_settings->tdma_mac)
+    {
+        processTdmaNetStream();
+        return;
+    }
     // 48400 microsec per frame, during this time data enters the interface socket buffer
     qint64 time_per_frame = 48400000;
     qint64 microsec, time_left;
@@ -603,6 +666,11 @@ void RadioController::processInputNetStream()
     if(time_left > 0)
         nanosleep(&time_to_sleep, NULL);
     _data_read_timer->restart();
+    if(_settings->ip_arq)
+    {
+        processArqNetStream();
+        return;
+    }
     int max_frame_size = 1516;
     unsigned char *netbuffer = (unsigned char*)calloc(max_frame_size, sizeof(unsigned char));
     int nread;
@@ -645,6 +713,91 @@ void RadioController::processInputNetStream()
     }
 }
 
+void RadioController::processTdmaNetStream()
+{
+    /// the MAC decides when to send, the net device only fills its queue
+    bool queued = true;
+    while(queued)
+    {
+        int nread;
+        unsigned char *buffer = _net_device->read_buffered(nread);
+        queued = (nread > 0) && _tdma_mac->queuePacket(buffer, nread);
+        delete[] buffer;
+    }
+    QVector<QByteArray> payloads = _tdma_mac->poll(_tdma_timer->nsecsElapsed() / 1000,
+                                                   _modem->getTxQueuedData());
+    publishTdmaStats();
+    emitNetFrames(payloads);
+}
+
+void RadioController::processArqNetStream()
+{
+    qint64 now = _arq_timer->nsecsElapsed() / 1000;
+    bool queued = true;
+    while(queued)
+    {
+        int nread;
+        unsigned char *buffer = _net_device->read_buffered(nread);
+        queued = (nread > 0) && _link_arq->queuePacket(buffer, nread);
+        delete[] buffer;
+    }
+    writeNetPackets(_link_arq->expire(now));
+    /// acknowledgements ride on the fill frames of the continuous modem
+    QByteArray payload = _link_arq->nextFrame(now, !_settings->burst_ip_modem);
+    if(payload.size() < 1)
+        return;
+    emitNetFrames(QVector<QByteArray>() << payload);
+}
+
+void RadioController::emitNetFrames(const QVector<QByteArray> &payloads)
+{
+    if(payloads.size() < 1)
+        return;
+    unsigned char *netbuffer = new unsigned char[NET_FRAME_SIZE * payloads.size()];
+    for(int i=0;i<payloads.size();i++)
+    {
+        unsigned char *frame = netbuffer + i * NET_FRAME_SIZE;
+        unsigned int size = payloads.at(i).size();
+        unsigned int crc = gr::digital::crc32((const unsigned char*)payloads.at(i).constData(), size);
+        memcpy(&(frame[0]), &size, 4);
+        memcpy(&(frame[4]), &size, 4);
+        memcpy(&(frame[8]), &size, 4);
+        memcpy(&(frame[12]), &crc, 4);
+        memcpy(&(frame[NET_FRAME_HEADER]), payloads.at(i).constData(), size);
+        for(int k=size+NET_FRAME_HEADER,j=0;k<NET_FRAME_SIZE;k++,j++)
+        {
+            frame[k] = _rand_frame_data[j];
+        }
+    }
+    emit netData(netbuffer, NET_FRAME_SIZE * payloads.size());
+}
+
+void RadioController::writeNetPackets(const QVector<QByteArray> &packets)
+{
+    for(int i=0;i<packets.size();i++)
+    {
+        unsigned char *packet = new unsigned char[packets.at(i).size()];
+        memcpy(packet, packets.at(i).constData(), packets.at(i).size());
+        _net_device->write_buffered(packet, packets.at(i).size());
+    }
+}
+
+void RadioController::publishTdmaStats()
+{
+    TdmaMac::stats mac = _tdma_mac->getStats();
+    Telemetry::tdmastats stats;
+    stats.synced = mac.synced;
+    stats.slot = mac.slot;
+    stats.slots = mac.slots;
+    stats.guard_usec = mac.guard_usec;
+    stats.frames_sent = mac.frames_sent;
+    stats.packets_sent = mac.packets_sent;
+    stats.packets_received = mac.packets_received;
+    stats.packets_dropped = mac.packets_dropped;
+    stats.requests = mac.requests;
+    _telemetry->setTdmaStats(stats);
+}
+
 void RadioController::transmitTextData()
 {
     if(!_settings->tx_inited)
@@ -992,15 +1145,16 @@ void RadioController::radioTimeout()
     for(unsigned int i=0;i<size/sizeof(short);i++)
     {
         samples[i] = short(origin[i] / 2);
-        if(_settings->voip_forwarding)
-        {
-            /// routed to Mumble
-            _to_voip_buffer->push_back(samples[i]);
-        }
+    }
+    if(_settings->voip_forwarding)
+    {
+        /// routed to Mumble
+        _voip_uplink->push(samples, size/sizeof(short));
     }
 
     //_audio_mixer_in->addSamples(samples, size, -1000);
     emit writePCM(samples, size, false, AudioProcessor::AUDIO_MODE_ANALOG);
+    delete[] samples;
     if(_settings->tot_tx_end)
         _transmitting = false;
 }
@@ -1018,6 +1172,39 @@ void RadioController::setAudioRecord(bool value)
 }
 
 
+void RadioController::setIQRecord(bool value)
+{
+    if(!value)
+    {
+        if(_settings->recording_iq)
+            _logger->log(Logger::LogLevelInfo, QString("Stopping IQ recording"));
+        _modem->stopIQRecording();
+        _settings->recording_iq = false;
+        return;
+    }
+    if(!_settings->rx_inited)
+    {
+        _logger->log(Logger::LogLevelWarning, "Receiver is not started, can't record IQ");
+        return;
+    }
+    QVector<QString> modes;
+    buildModeList(&modes);
+    QString mode_name = modes.at(_settings->rx_mode);
+    QString time= QDateTime::currentDateTime().toString(
+                "d_MMM_yyyy_hh-mm-ss");
+    QString base_path = QString("%1/%2").arg(_settings->iq_record_path).arg(time);
+    if(!_modem->startIQRecording(base_path.toStdString(), mode_name.toStdString()))
+    {
+        _logger->log(Logger::LogLevelCritical, QString("Could not open IQ file %1 for recording").arg(
+                         base_path));
+        return;
+    }
+    _logger->log(Logger::LogLevelInfo, QString("Starting IQ recording to %1.sigmf-data").arg(
+                     base_path));
+    _settings->recording_iq = true;
+}
+
+
 void RadioController::updateDataModemReset(bool transmitting, bool ptt_activated)
 {
     if((_tx_mode == gr_modem_types::ModemTypeQPSK250000) && !_data_modem_sleeping
@@ -1068,6 +1255,142 @@ bool RadioController::getDemodulatorData()
 }
 
 
+void RadioController::profileBlocks()
+{
+    std::vector<gr_block_profiler::stats> rx_stats;
+    std::vector<gr_block_profiler::stats> tx_stats;
+    _modem->getBlockStats(rx_stats, tx_stats);
+    std::vector<Telemetry::blockstats> stats;
+    for(unsigned int i=0;i<rx_stats.size() + tx_stats.size();i++)
+    {
+        bool tx = (i >= rx_stats.size());
+        const gr_block_profiler::stats &s = tx ? tx_stats.at(i - rx_stats.size()) : rx_stats.at(i);
+        Telemetry::blockstats block;
+        block.name = QString::fromStdString(s.name);
+        block.tx = tx;
+        block.cpu_percent = s.cpu_percent;
+        block.work_usec = s.work_usec;
+        block.items_per_sec = s.items_per_sec;
+        block.input_full = s.input_full;
+        block.output_full = s.output_full;
+        stats.push_back(block);
+    }
+    std::sort(stats.begin(), stats.end(),
+              [](const Telemetry::blockstats &a, const Telemetry::blockstats &b)
+                    { return a.cpu_percent > b.cpu_percent; });
+    _telemetry->setBlockStats(stats);
+    for(unsigned int i=0;(i<stats.size()) && (i<PROFILE_LOG_BLOCKS);i++)
+    {
+        const Telemetry::blockstats &block = stats.at(i);
+        _logger->log(Logger::LogLevelInfo, QString("Block %1 %2: %3% CPU, %4 usec per call, "
+                                                   "%5 items/s, buffers in %6% out %7%")
+                     .arg(block.tx ? "TX" : "RX").arg(block.name)
+                     .arg(block.cpu_percent, 0, 'f', 1).arg(block.work_usec, 0, 'f', 0)
+                     .arg(block.items_per_sec, 0, 'f', 0).arg(block.input_full * 100, 0, 'f', 0)
+                     .arg(block.output_full * 100, 0, 'f', 0), Logger::LogSubsystemModem);
+    }
+}
+
+void RadioController::sampleBuffers(bool transmitting)
+{
+    if(!_settings->tx_started || !transmitting)
+    {
+        _tx_buffer_sampling = false;
+        return;
+    }
+    if(!_tx_buffer_sampling)
+    {
+        /// the first interval starts with the transmission, not before it
+        _modem->getTxSampleRatio();
+        _tx_sample_timer->start();
+        _tx_buffer_sampling = true;
+        _tx_buffer_sampled = true;
+    }
+    else if(_tx_sample_timer->elapsed() >= TX_SAMPLE_MSEC)
+    {
+        _tx_sample_timer->start();
+        if(_modem->getTxSampleRatio() < TX_SAMPLE_RATIO_MIN)
+        {
+            _tx_buffer_events[_tx_mode]++;
+            _tx_buffer_underflow = true;
+        }
+    }
+}
+
+void RadioController::tuneBuffers(bool transmitting)
+{
+    /// a transmission in the window pauses or shares the device, only
+    /// count the samples lost on a window the receiver had to itself
+    if(_settings->rx_inited && _settings->block_buffer_auto)
+    {
+        float ratio = _modem->getRxSampleRatio();
+        if(!transmitting && !_tx_buffer_sampled && (ratio < RX_SAMPLE_RATIO_MIN))
+        {
+            _rx_buffer_events[_rx_mode]++;
+            _rx_buffer_overflow = true;
+        }
+    }
+    Telemetry::bufferstats stats;
+    if(_settings->rx_inited)
+    {
+        stats.tx = false;
+        stats.mode = _rx_mode;
+        stats.events = _rx_buffer_events.value(_rx_mode, 0);
+        _modem->getRxBufferStats(stats.bytes, stats.latency_msec, stats.scale, stats.tuned);
+        _telemetry->setBufferStats(stats);
+    }
+    if(_settings->tx_inited)
+    {
+        stats.tx = true;
+        stats.mode = _tx_mode;
+        stats.events = _tx_buffer_events.value(_tx_mode, 0);
+        _modem->getTxBufferStats(stats.bytes, stats.latency_msec, stats.scale, stats.tuned);
+        _telemetry->setBufferStats(stats);
+        _tdma_mac->setTxLatency((qint64)(stats.latency_msec * 1000));
+    }
+    if(!_settings->block_buffer_auto)
+        return;
+
+    /// new buffer sizes only apply when the flowgraph is started again, which
+    /// would cut a reception short, so keep the verdict until the channel is quiet
+    bool rx_idle = !transmitting && (_rx_activity_timer->elapsed() >= RX_IDLE_MSEC);
+    if(_settings->rx_inited && rx_idle && _modem->tuneRxBuffers(_rx_buffer_overflow))
+    {
+        _mutex->lock();
+        _modem->stopRX();
+        _modem->startRX(_settings->block_buffer_size);
+        _mutex->unlock();
+        _modem->getRxBufferStats(stats.bytes, stats.latency_msec, stats.scale, stats.tuned);
+        _logger->log(Logger::LogLevelInfo, QString("RX buffers %1 after %2, now %3 bytes, %4 msec")
+                     .arg(_rx_buffer_overflow ? "grown" : "shrunk")
+                     .arg(_rx_buffer_overflow ? "overflow" : "no overflow")
+                     .arg(stats.bytes).arg(stats.latency_msec, 0, 'f', 1),
+                     Logger::LogSubsystemModem);
+    }
+    if(rx_idle)
+        _rx_buffer_overflow = false;
+    /// only judge the TX buffers on a window which had a transmission in it
+    if(_settings->tx_inited && !_settings->tx_started && _tx_buffer_sampled &&
+            _modem->tuneTxBuffers(_tx_buffer_underflow))
+    {
+        _mutex->lock();
+        _modem->stopTX();
+        _modem->startTX(_settings->block_buffer_size);
+        _mutex->unlock();
+        _modem->getTxBufferStats(stats.bytes, stats.latency_msec, stats.scale, stats.tuned);
+        _logger->log(Logger::LogLevelInfo, QString("TX buffers %1 after %2, now %3 bytes, %4 msec")
+                     .arg(_tx_buffer_underflow ? "grown" : "shrunk")
+                     .arg(_tx_buffer_underflow ? "underflow" : "no underflow")
+                     .arg(stats.bytes).arg(stats.latency_msec, 0, 'f', 1),
+                     Logger::LogSubsystemModem);
+    }
+    if(!transmitting)
+    {
+        _tx_buffer_underflow = false;
+        _tx_buffer_sampled = false;
+    }
+}
+
 void RadioController::getRSSI()
 {
     qint64 msec = (quint64)_rssi_read_timer->nsecsElapsed() / 1000000;
@@ -1078,6 +1401,16 @@ void RadioController::getRSSI()
     float rssi = _modem->getRSSI();
     _rssi_read_timer->restart();
     _settings->rssi = rssi;
+    _telemetry->setRSSI(rssi);
+    float tone;
+    int dcs_code;
+    _modem->getDetectedTone(tone, dcs_code);
+    if((tone != _settings->rx_detected_tone) || (dcs_code != _settings->rx_detected_dcs))
+    {
+        _settings->rx_detected_tone = tone;
+        _settings->rx_detected_dcs = dcs_code;
+        emit newDetectedTone(tone, dcs_code);
+    }
     if(!_settings->show_controls)
         return;
     if(rssi < 99.0f)
@@ -1101,6 +1434,7 @@ void RadioController::getFFTData()
     _modem->getFFTData(_fft_data, fft_size);
     if(fft_size > 0)
     {
+        _telemetry->setFFT(_fft_data, fft_size);
         emit newFFTData(_fft_data, (int)fft_size);
         _fft_read_timer->restart();
     }
@@ -1126,16 +1460,23 @@ void RadioController::getConstellationData()
     std::vector<std::complex<float>> *const_data = _modem->getConstellation();
     if(const_data->size() > 1)
     {
-        emit newConstellationData(const_data);
+        _telemetry->setConstellation(const_data);
         _const_read_timer->restart();
     }
+    /// the GUI takes ownership, without one nobody else will free it
+    if((const_data->size() > 1) &&
+            (receivers(SIGNAL(newConstellationData(complex_vector*))) > 0))
+        emit newConstellationData(const_data);
+    else
+        delete const_data;
 }
 
-/// callback from gr_modem via signal
+/// callback from gr_modem via signal, data is only borrowed for the call
 void RadioController::receiveDigitalAudio(unsigned char *data, int size)
 {
-    short *audio_out;
-    int samples; // reference
+    _rx_pcm.resize(320);
+    short *audio_out = _rx_pcm.data();
+    int samples;
     int audio_mode = AudioProcessor::AUDIO_MODE_OPUS;
     if((_rx_mode == gr_modem_types::ModemTypeBPSK2000) ||
             (_rx_mode == gr_modem_types::ModemType2FSK2000FM) ||
@@ -1144,18 +1485,17 @@ void RadioController::receiveDigitalAudio(unsigned char *data, int size)
             (_rx_mode == gr_modem_types::ModemType4FSK2000FM) ||
             (_rx_mode == gr_modem_types::ModemTypeQPSK2000))
     {
-        audio_out = _codec->decode_codec2_1400(data, size, samples);
+        samples = _codec->decode_codec2_1400(data, size, audio_out, _rx_pcm.size());
     }
     else if((_rx_mode == gr_modem_types::ModemTypeBPSK1000) ||
             (_rx_mode == gr_modem_types::ModemType2FSK1000FM) ||
             (_rx_mode == gr_modem_types::ModemType2FSK1000) ||
             (_rx_mode == gr_modem_types::ModemType4FSK1000FM))
-        audio_out = _codec->decode_codec2_700(data, size, samples);
+        samples = _codec->decode_codec2_700(data, size, audio_out, _rx_pcm.size());
     else
     {
-        audio_out = _codec->decode_opus(data, size, samples);
+        samples = _codec->decode_opus(data, size, audio_out, _rx_pcm.size());
     }
-    delete[] data;
     if(samples > 0)
     {
         if((_rx_mode == gr_modem_types::ModemTypeBPSK2000) ||
@@ -1174,21 +1514,17 @@ void RadioController::receiveDigitalAudio(unsigned char *data, int size)
         for(int i=0;i<samples;i++)
         {
             audio_out[i] = (short)((float)audio_out[i] * _rx_volume);
-            if(_settings->voip_forwarding)
-            {
-                /// routing to Mumble
-                _to_voip_buffer->push_back(audio_out[i]);
-            }
         }
-        if(_settings->voip_forwarding && _settings->mute_forwarded_audio
-                && !_settings->repeater_enabled)
+        if(_settings->voip_forwarding)
         {
-            /// no local audio
-            delete[] audio_out;
+            /// routing to Mumble
+            _voip_uplink->push(audio_out, samples);
         }
-        else
+        if(!(_settings->voip_forwarding && _settings->mute_forwarded_audio
+                && !_settings->repeater_enabled))
         {
-            if(_settings->voip_connected || _settings->repeater_enabled)
+            if(_settings->voip_connected || (_settings->voip_links_connected > 0) ||
+                    (_settings->repeater_enabled && !_cut_through_repeater))
             {
                 /// need to mix several audio channels
                 _audio_mixer_in->addSamples(audio_out, samples, -9999); // radio id hardcoded
@@ -1205,27 +1541,26 @@ void RadioController::receiveDigitalAudio(unsigned char *data, int size)
 /// callback from gr_modem via signal
 void RadioController::receivePCMAudio(std::vector<float> *audio_data)
 {
+    /// only flows while the squelch is open
+    _rx_activity_timer->start();
     int size = audio_data->size();
-    short *pcm = new short[size];
+    _rx_pcm.resize(size);
+    short *pcm = _rx_pcm.data();
     for(int i=0;i<size;i++)
     {
         pcm[i] = (short)(audio_data->at(i) * _rx_volume * 32767.0f);
-        if(_settings->voip_forwarding)
-        {
-            /// routed to Mumble
-            _to_voip_buffer->push_back(pcm[i]);
-        }
     }
-
-    if(_settings->voip_forwarding && !_settings->repeater_enabled
-            && _settings->mute_forwarded_audio)
+    if(_settings->voip_forwarding)
     {
-        /// No local audio
-        delete[] pcm;
+        /// routed to Mumble
+        _voip_uplink->push(pcm, size);
     }
-    else
+
+    if(!(_settings->voip_forwarding && !_settings->repeater_enabled
+            && _settings->mute_forwarded_audio))
     {
-        if(_settings->voip_connected || _settings->repeater_enabled)
+        if(_settings->voip_connected || (_settings->voip_links_connected > 0) ||
+                (_settings->repeater_enabled && !_cut_through_repeater))
         {
             /// Need to mix several audio channels
             _audio_mixer_in->addSamples(pcm, size, -9999); // radio id hardcoded
@@ -1286,18 +1621,21 @@ unsigned int RadioController::getFrameCRC32(unsigned char *data)
 /// callback from gr_modem via signal
 void RadioController::receiveVideoData(unsigned char *data, int size)
 {
+    _rx_activity_timer->start();
     Q_UNUSED(size);
     unsigned int frame_size = getFrameLength(data);
     unsigned int crc = getFrameCRC32(data);
     if(frame_size == 0)
     {
-        _logger->log(Logger::LogLevelWarning, "received wrong video frame size, dropping frame ");
+        _logger->log(Logger::LogLevelWarning, "received wrong video frame size, dropping frame ",
+                     Logger::LogSubsystemVideo);
         delete[] data;
         return;
     }
     if(frame_size > 3122 - 24)
     {
-        _logger->log(Logger::LogLevelWarning, "video frame size too large, dropping frame ");
+        _logger->log(Logger::LogLevelWarning, "video frame size too large, dropping frame ",
+                     Logger::LogSubsystemVideo);
         delete[] data;
         return;
     }
@@ -1308,39 +1646,47 @@ void RadioController::receiveVideoData(unsigned char *data, int size)
     if(crc != crc_check)
     {
         /// JPEG decoder has this nasty habit of segfaulting on image errors
-        _logger->log(Logger::LogLevelWarning, "Video CRC check failed, dropping frame");
+        _logger->log(Logger::LogLevelWarning, "Video CRC check failed, dropping frame",
+                     Logger::LogSubsystemVideo);
         delete[] jpeg_frame;
         return;
     }
 
-    unsigned char *raw_output = _video->decode_jpeg(jpeg_frame,frame_size);
+#ifdef HEADLESS_DAEMON
+    /// the daemon has no display for the pictures
+    delete[] jpeg_frame;
+#else
+    unsigned char *raw_output = _video->decode_jpeg(jpeg_frame, frame_size,
+                                                    VideoEncoder::RADIO_VIDEO_SOURCE);
 
     delete[] jpeg_frame;
     if(!raw_output)
     {
         return;
     }
+    /// raw_output belongs to the decoder, convertToFormat makes our own copy
     QImage img (raw_output, 320,240, QImage::Format_RGB888);
     if(img.isNull())
     {
-        delete[] raw_output;
         return;
     }
     QImage image = img.convertToFormat(QImage::Format_RGB32);
 
     emit videoImage(image);
-    delete[] raw_output;
+#endif
 }
 
 /// callback from gr_modem via signal
 void RadioController::receiveNetData(unsigned char *data, int size)
 {
+    _rx_activity_timer->start();
     Q_UNUSED(size); // size comes from frame header
     unsigned int frame_size = getFrameLength(data);
 
     if(frame_size > 1500) // FIXME: The MTU setting in netdevice
     {
-        _logger->log(Logger::LogLevelWarning, "received wrong IP frame size, dropping frame ");
+        _logger->log(Logger::LogLevelWarning, "received wrong IP frame size, dropping frame ",
+                     Logger::LogSubsystemNet);
         delete[] data;
         return;
     }
@@ -1359,8 +1705,27 @@ void RadioController::receiveNetData(unsigned char *data, int size)
 
     if(crc != crc_check)
     {
-        _logger->log(Logger::LogLevelWarning, "IP frame CRC check failed, dropping frame ");
+        _logger->log(Logger::LogLevelWarning, "IP frame CRC check failed, dropping frame ",
+                     Logger::LogSubsystemNet);
+        delete[] net_frame;
+        return;
+    }
+    if(_settings->tdma_mac)
+    {
+        QVector<QByteArray> packets = _tdma_mac->receive(net_frame, frame_size,
+                                                         _tdma_timer->nsecsElapsed() / 1000);
+        delete[] net_frame;
+        writeNetPackets(packets);
+        publishTdmaStats();
+        return;
+    }
+    if(_settings->ip_arq)
+    {
+        qint64 now = _arq_timer->nsecsElapsed() / 1000;
+        QVector<QByteArray> packets = _link_arq->receive(net_frame, frame_size, now);
         delete[] net_frame;
+        writeNetPackets(packets);
+        writeNetPackets(_link_arq->expire(now));
         return;
     }
 
@@ -1374,31 +1739,35 @@ void RadioController::protoReceived(QByteArray data)
 }
 
 /// signal from Mumble
-void RadioController::processVoipAudioFrame(short *pcm, int samples, quint64 sid)
+void RadioController::processVoipAudioFrame(QByteArray pcm, quint64 sid)
 {
-    _audio_mixer_in->addSamples(pcm, samples, sid);
+    _audio_mixer_in->addSamples((short*)pcm.constData(), pcm.size() / sizeof(short), sid);
 }
 
 void RadioController::processVoipVideoFrame(unsigned char *video_frame, int size, quint64 sid)
 {
-    Q_UNUSED(sid); // multiple video users not implemented yet
-    unsigned char *raw_output = _video->decode_jpeg(video_frame, size);
+#ifdef HEADLESS_DAEMON
+    Q_UNUSED(size);
+    Q_UNUSED(sid);
+    delete[] video_frame;
+#else
+    unsigned char *raw_output = _video->decode_jpeg(video_frame, size, sid);
 
     delete[] video_frame;
     if(!raw_output)
     {
         return;
     }
+    /// raw_output belongs to the decoder, convertToFormat makes our own copy
     QImage img (raw_output, 320,240, QImage::Format_RGB888);
     if(img.isNull())
     {
-        delete[] raw_output;
         return;
     }
     QImage image = img.convertToFormat(QImage::Format_RGB32);
 
     emit videoImage(image);
-    delete[] raw_output;
+#endif
 }
 
 void RadioController::startTransmission()
@@ -1444,7 +1813,8 @@ void RadioController::textMumble(QString text, bool channel)
 /// callback from gr_modem via signal
 void RadioController::textReceived(QString text)
 {
-    if(_settings->repeater_enabled && _tx_radio_type == radio_type::RADIO_TYPE_DIGITAL)
+    if(_settings->repeater_enabled && !_cut_through_repeater
+            && _tx_radio_type == radio_type::RADIO_TYPE_DIGITAL)
     {
         _modem->transmitTextData(text);
     }
@@ -1463,7 +1833,8 @@ void RadioController::textReceived(QString text)
 /// GUI only
 void RadioController::callsignReceived(QString callsign)
 {
-    if(_settings->repeater_enabled && _tx_radio_type == radio_type::RADIO_TYPE_DIGITAL)
+    if(_settings->repeater_enabled && !_cut_through_repeater
+            && _tx_radio_type == radio_type::RADIO_TYPE_DIGITAL)
     {
         _modem->sendCallsign(callsign);
     }
@@ -1483,6 +1854,8 @@ void RadioController::callsignReceived(QString callsign)
 /// GUI only
 void RadioController::audioFrameReceived()
 {
+    _telemetry->countVoiceFrame();
+    _rx_activity_timer->start();
     emit displayReceiveStatus(true);
     _voice_led_timer->start(500);
 }
@@ -1490,6 +1863,8 @@ void RadioController::audioFrameReceived()
 /// GUI only
 void RadioController::dataFrameReceived()
 {
+    _telemetry->countDataFrame();
+    _rx_activity_timer->start();
     emit displayDataReceiveStatus(true);
     _data_led_timer->start(500);
     /*
@@ -1507,6 +1882,7 @@ void RadioController::dataFrameReceived()
 /// GUI leds and Mumble text signal
 void RadioController::receiveEnd()
 {
+    _telemetry->countTransmission();
     if(_incoming_text_buffer.size() > 0 && _settings->voip_forwarding)
     {
         emit newMumbleMessage(_incoming_text_buffer);
@@ -1523,7 +1899,15 @@ void RadioController::receiveEnd()
 
 void RadioController::endAudioTransmission()
 {
-    if(_settings->repeater_enabled && _tx_radio_type == radio_type::RADIO_TYPE_DIGITAL)
+    if(_cut_through_repeater)
+    {
+        /// our own end of transmission goes out when the repeater TX times out
+        _settings->repeater_latency = (float)_modem->getRepeaterLatency();
+        _telemetry->setRepeaterLatency(_settings->repeater_latency);
+        _logger->log(Logger::LogLevelDebug, QString("Repeater latency %1 ms").arg(
+                         _settings->repeater_latency, 0, 'f', 1));
+    }
+    else if(_settings->repeater_enabled && _tx_radio_type == radio_type::RADIO_TYPE_DIGITAL)
     {
         _modem->endTransmission(_callsign);
     }
@@ -1548,7 +1932,8 @@ void RadioController::endAudioTransmission()
         samples[i] = short(origin[i] / 2);
     }
     emit writePCM(samples, size, false, AudioProcessor::AUDIO_MODE_ANALOG);
-    short *silence = new short[4096/sizeof(short)];
+    delete[] samples;
+    short silence[4096/sizeof(short)];
     memset(silence, 0, 4096);
     emit writePCM(silence, 4096, false, AudioProcessor::AUDIO_MODE_ANALOG);
 }
@@ -1639,6 +2024,7 @@ void RadioController::toggleRX(bool value)
         _mutex->unlock();
 
         _settings->rx_inited = false;
+        _settings->recording_iq = false;
     }
 }
 
@@ -1668,8 +2054,12 @@ void RadioController::toggleTX(bool value)
             return;
         }
         if(_tx_mode == gr_modem_types::ModemTypeQPSKVideo)
+        {
+            _video->set_options((bool)_settings->video_downscale, (bool)_settings->video_frame_skip,
+                                (bool)_settings->video_inter_frames);
             _video->init(_settings->video_device);
             //_camera->init();
+        }
         else
             _video->deinit();
 
@@ -1711,18 +2101,6 @@ void RadioController::toggleRxMode(int value)
 {
     if((_settings->rx_mode == value) && _settings->rx_inited)
         return;
-    if(_settings->rx_inited)
-    {
-        _mutex->lock();
-        _modem->stopRX();
-        _mutex->unlock();
-    }
-
-    bool rx_inited_before = _settings->rx_inited;
-    if(rx_inited_before)
-    {
-        _settings->rx_inited = false;
-    }
     _rx_radio_type = radio_type::RADIO_TYPE_DIGITAL;
     switch(value)
     {
@@ -1886,18 +2264,15 @@ void RadioController::toggleRxMode(int value)
         break;
     }
 
+    /// the receiver keeps running, the demodulator chains are switched in place
+    _mutex->lock();
     _modem->toggleRxMode(_rx_mode);
-    if(rx_inited_before)
-    {
-        _settings->rx_inited = true;
-    }
-    if(_settings->rx_inited)
-    {
-        _mutex->lock();
-        _modem->startRX(_settings->block_buffer_size);
-        _mutex->unlock();
-    }
+    _mutex->unlock();
+    /// inside a batch the switch only happens at commitConfig()
+    if(!_modem->configPending())
+        publishModeSwitchTime(false);
     _settings->rx_mode = value;
+    updateRepeaterMode();
 }
 
 void RadioController::toggleTxMode(int value)
@@ -2009,18 +2384,21 @@ void RadioController::toggleTxMode(int value)
         break;
     }
     if(_tx_mode == gr_modem_types::ModemTypeQPSKVideo)
+    {
+        _video->set_options((bool)_settings->video_downscale, (bool)_settings->video_frame_skip,
+                            (bool)_settings->video_inter_frames);
         _video->init(_settings->video_device);
         //_camera->init();
+    }
     else
         _video->deinit();
     _mutex->lock();
-    if(_settings->tx_inited)
-        _modem->stopTX();
     _modem->toggleTxMode(_tx_mode);
-    if(_settings->tx_inited)
-        _modem->startTX(_settings->block_buffer_size);
     _mutex->unlock();
+    if(!_modem->configPending())
+        publishModeSwitchTime(true);
     _settings->tx_mode = value;
+    updateRepeaterMode();
 }
 
 void RadioController::usePTTForVOIP(bool value)
@@ -2061,11 +2439,44 @@ void RadioController::toggleRepeat(bool value)
     {
         _settings->repeater_enabled = value;
     }
-    /// old code: this enables direct repeat in same mode only (direct loopback)
-    /**
-     if(_rx_mode == _tx_mode)
-        _modem->setRepeater(value);
-    */
+    updateRepeaterMode();
+}
+
+void RadioController::updateRepeaterMode()
+{
+    /// digital frames in the same RX and TX mode are repeated by the modem
+    /// as they come in, everything else goes through decoding and encoding
+    bool digital_repeater = _settings->repeater_enabled && _settings->repeater_cut_through
+            && (_rx_mode == _tx_mode)
+            && (_rx_radio_type == radio_type::RADIO_TYPE_DIGITAL)
+            && (_tx_radio_type == radio_type::RADIO_TYPE_DIGITAL);
+    /// analog audio is bridged inside the flowgraphs, PTT follows the squelch
+    _audio_bridge_repeater = _settings->repeater_enabled && _settings->repeater_cut_through
+            && (_rx_radio_type == radio_type::RADIO_TYPE_ANALOG)
+            && (_tx_radio_type == radio_type::RADIO_TYPE_ANALOG)
+            && (_tx_mode != gr_modem_types::ModemTypeCW600USB);
+    _cut_through_repeater = digital_repeater || _audio_bridge_repeater;
+    _modem->setRepeaterTurnaround(_settings->repeater_turnaround);
+    _modem->setRepeater(digital_repeater);
+    _modem->setAudioBridge(_audio_bridge_repeater);
+    if(!_audio_bridge_repeater)
+        _modem->setTxCTCSS(_settings->tx_ctcss);
+}
+
+/// callback from gr_modem via signal, keys the transmitter like VOIP forwarding does
+void RadioController::repeatedFrame()
+{
+    if(!_voip_tx_timer->isActive())
+    {
+        if(_audio_bridge_repeater && _settings->repeater_ctcss_regen)
+        {
+            /// pass on the access tone the user transmitted
+            _modem->setTxCTCSS((_settings->rx_detected_tone > 0) ?
+                                   _settings->rx_detected_tone : _settings->tx_ctcss);
+        }
+        _transmitting = true;
+    }
+    _voip_tx_timer->start(500);
 }
 
 void RadioController::fineTuneFreq(long long center_freq)
@@ -2195,6 +2606,7 @@ void RadioController::setTxVolume(int value)
 void RadioController::setVoipVolume(int value)
 {
     _voip_volume = 1e-3*exp(((float)value/50.0)*6.908);
+    _voip_uplink->setVolume(_voip_volume);
 }
 
 void RadioController::setVoxLevel(int value)
@@ -2206,7 +2618,7 @@ void RadioController::setVoipBitrate(int value)
 {
     _settings->voip_bitrate = value;
     _logger->log(Logger::LogLevelInfo,QString("Setting VOIP bitrate to %1").arg(value));
-    _codec->set_voip_bitrate(value);
+    _voip_uplink->setBitrate(value);
 }
 
 void RadioController::setEndBeep(int value)
@@ -2498,7 +2910,6 @@ void RadioController::memoryScan(bool receiving, bool wait_for_timer)
             return;
         }
     }
-    struct timespec time_to_sleep;
     radiochannel *chan = _memory_channels.at(_memory_scan_index);
     if(chan->skip)
     {
@@ -2507,17 +2918,7 @@ void RadioController::memoryScan(bool receiving, bool wait_for_timer)
             _memory_scan_index = 0;
         return;
     }
-    _settings->rx_frequency = chan->rx_frequency - _settings->demod_offset;
-    tuneFreq(_settings->rx_frequency);
-    time_to_sleep = {0, 1000L }; /// Give PLL time to settle
-    nanosleep(&time_to_sleep, NULL);
-    toggleRxMode(chan->rx_mode);
-
-    _settings->tx_shift = chan->tx_shift;
-    tuneTxFreq(chan->rx_frequency);
-    time_to_sleep = {0, 1000L };
-    nanosleep(&time_to_sleep, NULL);
-    toggleTxMode(chan->tx_mode);
+    applyMemoryChannel(chan);
 
     emit tuneToMemoryChannel(chan);
 
@@ -2527,3 +2928,48 @@ void RadioController::memoryScan(bool receiving, bool wait_for_timer)
 
     _scan_timer->restart();
 }
+
+void RadioController::applyMemoryChannel(radiochannel *chan)
+{
+    /// collect all channel settings first so the flowgraphs are
+    /// reconfigured in one step instead of once per parameter
+    _modem->beginConfig();
+    _settings->rx_frequency = chan->rx_frequency - _settings->demod_offset;
+    tuneFreq(_settings->rx_frequency);
+    toggleRxMode(chan->rx_mode);
+    _settings->tx_shift = chan->tx_shift;
+    tuneTxFreq(chan->rx_frequency);
+    toggleTxMode(chan->tx_mode);
+    setSquelch(chan->squelch);
+    setRxCTCSS(chan->rx_ctcss);
+    setTxCTCSS(chan->tx_ctcss);
+    _mutex->lock();
+    _modem->commitConfig();
+    _mutex->unlock();
+    publishModeSwitchTime(false);
+    publishModeSwitchTime(true);
+}
+
+void RadioController::publishModeSwitchTime(bool tx)
+{
+    double usec = tx ? _modem->getTxModeSwitchTime() : _modem->getRxModeSwitchTime();
+    _logger->log(Logger::LogLevelDebug, QString("%1 mode switch took %2 us").arg(
+                     tx ? "TX" : "RX").arg(usec, 0, 'f', 0));
+    _telemetry->setModeSwitchTime(tx, (float)usec);
+}
+
+void RadioController::tuneMemoryChannel(int id)
+{
+    QVector<radiochannel*> *channels = _radio_channels->getChannels();
+    for(int i=0;i<channels->size();i++)
+    {
+        radiochannel *chan = channels->at(i);
+        if(chan->id == id)
+        {
+            applyMemoryChannel(chan);
+            emit tuneToMemoryChannel(chan);
+            return;
+        }
+    }
+    _logger->log(Logger::LogLevelWarning, QString("Memory channel %1 not found").arg(id));
+}
@@ -27,7 +27,10 @@
 #include <QDebug>
 #include <QCoreApplication>
 #include <QElapsedTimer>
+#include <QThread>
+#ifndef HEADLESS_DAEMON
 #include <QImage>
+#endif
 #include <QtConcurrent/QtConcurrent>
 #include <unistd.h>
 #include <cmath>
@@ -46,6 +49,11 @@
 #include "src/gr_modem.h"
 #include "net/netdevice.h"
 #include "logger.h"
+#include "telemetry.h"
+#include "voipuplink.h"
+#include "threadscheduler.h"
+#include "tdmamac.h"
+#include "linkarq.h"
 
 
 typedef QVector<Station*> StationList;
@@ -65,15 +73,14 @@ class RadioController : public QObject
     Q_OBJECT
 public:
     explicit RadioController(Settings *settings, Logger *logger, RadioChannels *radio_channels,
-                      QObject *parent = 0);
+                      Telemetry *telemetry, QObject *parent = 0);
     ~RadioController();
 
-    void flushRadioToVoipBuffer();
     void updateDataModemReset(bool transmitting, bool ptt_activated);
 
 signals:
     void finished();
-    void setAudioReadMode(bool capture, bool preprocess, int audio_mode);
+    void setAudioReadMode(bool capture, bool preprocess, int audio_mode, int frame_msec);
     void printText(QString text, bool html);
     void printCallsign(QString text);
     void displayReceiveStatus(bool status);
@@ -84,15 +91,18 @@ signals:
     void videoData(unsigned char *buf, int size);
     void netData(unsigned char *buf, int size);
     void voipVideoData(unsigned char *buf, int size);
+#ifndef HEADLESS_DAEMON
     void videoImage(QImage img);
+#endif
     void endAudio(int secs);
     void startAudio();
     void freqToGUI(long long center_freq,long long carrier_offset);
     void voipDataPCM(short *pcm, int samples);
-    void voipDataOpus(unsigned char *pcm, int packet_size);
+    void voipDataOpus(QByteArray opus_packet, int bitrate);
     void newFFTData(float*, int);
     void newConstellationData(complex_vector*);
     void newRSSIValue(float rssi);
+    void newDetectedTone(float tone, int dcs_code);
     void initError(QString error);
     void writePCM(short *pcm, int bytes, bool preprocess, int mode);
     void rxGainStages(gain_vector rx_gains);
@@ -109,7 +119,10 @@ public slots:
     void startTransmission();
     void endTransmission();
     void radioTimeout();
+    /// audiobuffer is only borrowed for the duration of the call
     void txAudio(short *audiobuffer, int audiobuffer_size, int vad, bool radio_only);
+    /// capture frames from another thread, handed over with the buffer
+    void txAudioFrame(QByteArray pcm, int vad, bool radio_only);
     void processVideoFrame();
     void textData(QString text, bool repeat = false);
     void textMumble(QString text, bool channel = false);
@@ -154,8 +167,9 @@ public slots:
     void stopScan();
     void startMemoryScan(int direction);
     void stopMemoryScan();
+    void tuneMemoryChannel(int id);
     void endAudioTransmission();
-    void processVoipAudioFrame(short *pcm, int samples, quint64 sid);
+    void processVoipAudioFrame(QByteArray pcm, quint64 sid);
     void processVoipVideoFrame(unsigned char *video_frame, int size, quint64 sid);
     void usePTTForVOIP(bool value);
     void setVOIPForwarding(bool value);
@@ -164,6 +178,7 @@ public slots:
     void endTx();
     void stopVoipTx();
     void toggleRepeat(bool value);
+    void repeatedFrame();
     void setChannels(ChannelList channels);
     void setStations(StationList list);
     void setVox(bool value);
@@ -177,6 +192,7 @@ public slots:
     void setCallsign();
     void setScanResumeTime(int value);
     void setAudioRecord(bool value);
+    void setIQRecord(bool value);
     void setVoxLevel(int value);
     void setVoipBitrate(int value);
     void setEndBeep(int value);
@@ -195,6 +211,12 @@ private:
     void updateInputAudioStream();
     void triggerImageCapture();
     void processInputNetStream();
+    void processTdmaNetStream();
+    void processArqNetStream();
+    void emitNetFrames(const QVector<QByteArray> &payloads);
+    void writeNetPackets(const QVector<QByteArray> &packets);
+    void publishTdmaStats();
+    void publishModeSwitchTime(bool tx);
     void sendTxBeep(int sound=0);
     void transmitServerInfoBeacon();
     void transmitTextData();
@@ -203,16 +225,29 @@ private:
     void getFFTData();
     void getConstellationData();
     void getRSSI();
+    void profileBlocks();
+    void sampleBuffers(bool transmitting);
+    void tuneBuffers(bool transmitting);
     void setRelays(bool transmitting);
     void memoryScan(bool receiving, bool wait_for_timer=true);
+    void applyMemoryChannel(radiochannel *chan);
     bool processMixerQueue();
     void updateCWK();
+    void updateRepeaterMode();
 
 
     // FIXME: inflation of members
     Settings *_settings;
     Logger *_logger;
     RadioChannels *_radio_channels;
+    Telemetry *_telemetry;
+    int _loop_deadline;
+    QMap<int, quint64> _rx_buffer_events;
+    QMap<int, quint64> _tx_buffer_events;
+    bool _rx_buffer_overflow;
+    bool _tx_buffer_underflow;
+    bool _tx_buffer_sampled;
+    bool _tx_buffer_sampling;
     RelayController *_relay_controller;
     AudioEncoder *_codec;
     AudioMixer *_audio_mixer_in;
@@ -220,6 +255,8 @@ private:
     VideoEncoder *_video;
     ImageCapture *_camera;
     NetDevice *_net_device;
+    TdmaMac *_tdma_mac;
+    LinkArq *_link_arq;
     gr_modem *_modem;
     Layer2Protocol *_layer2;
     QMutex *_mutex;
@@ -232,14 +269,24 @@ private:
     QElapsedTimer *_data_read_timer;
     QElapsedTimer *_data_modem_reset_timer;
     QElapsedTimer *_data_modem_sleep_timer;
+    QElapsedTimer *_tdma_timer;
+    QElapsedTimer *_arq_timer;
+    QElapsedTimer *_rx_activity_timer;
+    QElapsedTimer *_tx_sample_timer;
     QElapsedTimer *_fft_read_timer;
     QElapsedTimer *_const_read_timer;
     QElapsedTimer *_rssi_read_timer;
     QElapsedTimer *_scan_timer;
     QElapsedTimer *_cw_timer;
     unsigned char *_rand_frame_data;
+    /// encoded voice frames lent to the modem, valid until the pool wraps around
+    unsigned char *_encoded_pool;
+    int _encoded_pool_index;
+    /// decoded radio audio, lent to the audio writer and mixer which copy it
+    std::vector<short> _rx_pcm;
     float *_fft_data;
-    QVector<short> *_to_voip_buffer;
+    VoipUplink *_voip_uplink;
+    QThread *_voip_uplink_thread;
     QByteArray *_data_rec_sound;
     QByteArray *_end_rec_sound;
     QByteArray * _timeout_sound;
@@ -255,6 +302,8 @@ private:
 
     bool _stop_thread;
     bool _transmitting;
+    bool _cut_through_repeater;
+    bool _audio_bridge_repeater;
     bool _process_text;
     bool _process_data;
     bool _repeat_text;
@@ -262,7 +311,6 @@ private:
     bool _scan_stop;
     bool _memory_scan_done;
     bool _data_modem_sleeping;
-    bool _radio_to_voip_on;
     bool _video_on;
     bool _text_transmit_on;
     bool _proto_transmit_on;
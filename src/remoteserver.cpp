@@ -0,0 +1,357 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "remoteserver.h"
+#include <QDateTime>
+#include <algorithm>
+
+/// requests are small, anything larger is a broken or hostile client
+static const quint32 REMOTE_MAX_MESSAGE = 65536;
+static const int REMOTE_PUBLISH_INTERVAL = 10; // msec
+/// a client that can't keep up skips telemetry instead of growing our buffers
+static const qint64 REMOTE_MAX_QUEUED = 1024 * 1024;
+
+RemoteServer::RemoteServer(const Settings *settings, Logger *logger,
+                           CommandProcessor *command_processor, Telemetry *telemetry,
+                           QObject *parent) :
+    QObject(parent)
+{
+    _settings = settings;
+    _logger = logger;
+    _command_processor = command_processor;
+    _telemetry = telemetry;
+    _server = new QTcpServer;
+    _publish_timer = new QTimer(this);
+    _publish_timer->setInterval(REMOTE_PUBLISH_INTERVAL);
+    _fft_enabled = false;
+    _const_enabled = false;
+    _clock.start();
+    QObject::connect(_publish_timer, SIGNAL(timeout()), this, SLOT(publishTelemetry()));
+}
+
+RemoteServer::~RemoteServer()
+{
+    stop();
+    delete _server;
+}
+
+void RemoteServer::start()
+{
+    if(_server->isListening())
+        return;
+    int port = (_settings->remote_control_port != 0) ?
+                _settings->remote_control_port : REMOTE_CONTROL_PORT;
+    if(!_server->listen(QHostAddress::Any, port))
+    {
+        _logger->log(Logger::LogLevelWarning, QString(
+            "Remote server could not bind to port %1").arg(port));
+        return;
+    }
+    QObject::connect(_server,SIGNAL(newConnection()),this,SLOT(getConnection()));
+}
+
+void RemoteServer::stop()
+{
+    while(!_clients.isEmpty())
+    {
+        removeClient(_clients.last());
+    }
+    updateDataCollection();
+    if(!_server->isListening())
+        return;
+    QObject::disconnect(_server,SIGNAL(newConnection()),this,SLOT(getConnection()));
+    _server->close();
+}
+
+void RemoteServer::getConnection()
+{
+    while(_server->hasPendingConnections())
+    {
+        QTcpSocket *socket = _server->nextPendingConnection();
+        _logger->log(Logger::LogLevelInfo, "Remote client connected from: "
+                  + socket->peerAddress().toString()
+                  + QString(" port: %1").arg(socket->peerPort()));
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        remote_client *client = new remote_client;
+        client->socket = socket;
+        _clients.append(client);
+        QObject::connect(socket, SIGNAL(readyRead()), this, SLOT(processData()));
+        QObject::connect(socket, SIGNAL(disconnected()), this, SLOT(clientDisconnected()));
+    }
+}
+
+void RemoteServer::clientDisconnected()
+{
+    remote_client *client = findClient(dynamic_cast<QTcpSocket*>(QObject::sender()));
+    if(client == nullptr)
+        return;
+    _logger->log(Logger::LogLevelInfo, "Remote client disconnected: "
+              + client->socket->peerAddress().toString());
+    removeClient(client);
+    updateDataCollection();
+}
+
+void RemoteServer::processData()
+{
+    remote_client *client = findClient(dynamic_cast<QTcpSocket*>(QObject::sender()));
+    if(client == nullptr)
+        return;
+    client->buffer.append(client->socket->readAll());
+
+    /// handle every complete request, clients are free to pipeline
+    int offset = 0;
+    while(client->buffer.size() - offset >= 4)
+    {
+        quint32 size = qFromBigEndian<quint32>(
+                    (const uchar*)client->buffer.constData() + offset);
+        if(size > REMOTE_MAX_MESSAGE)
+        {
+            _logger->log(Logger::LogLevelWarning, "Remote request too large, dropping client "
+                      + client->socket->peerAddress().toString());
+            removeClient(client);
+            updateDataCollection();
+            return;
+        }
+        if((quint32)(client->buffer.size() - offset - 4) < size)
+            break;
+        QRadioLink::RemoteRequest request;
+        if(request.ParseFromArray(client->buffer.constData() + offset + 4, (int)size))
+            processRequest(client, request);
+        else
+            _logger->log(Logger::LogLevelWarning, "Malformed remote request from "
+                      + client->socket->peerAddress().toString());
+        offset += 4 + size;
+    }
+    client->buffer.remove(0, offset);
+}
+
+void RemoteServer::processRequest(remote_client *client, const QRadioLink::RemoteRequest &request)
+{
+    bool success = true;
+    QString result;
+    if(request.has_subscribe())
+    {
+        const QRadioLink::RemoteSubscribe &subscribe = request.subscribe();
+        int stream = (int)subscribe.stream();
+        if(subscribe.interval_msec() == 0)
+        {
+            client->subscriptions.remove(stream);
+        }
+        else
+        {
+            subscription sub;
+            sub.interval = std::max(REMOTE_PUBLISH_INTERVAL, (int)subscribe.interval_msec());
+            sub.next_time = _clock.elapsed();
+            sub.fft_bins = (int)subscribe.fft_bins();
+            sub.last_seq = 0;
+            client->subscriptions[stream] = sub;
+        }
+        updateDataCollection();
+        result = "OK";
+    }
+    if(request.has_command())
+    {
+        QString command = QString::fromStdString(request.command());
+        if(!_command_processor->validateCommand(command))
+        {
+            success = false;
+            result = "Command not recognized";
+        }
+        else
+        {
+            result = _command_processor->runCommand(command);
+        }
+    }
+
+    QRadioLink::RemoteMessage message;
+    QRadioLink::RemoteResponse *response = message.mutable_response();
+    response->set_request_id(request.request_id());
+    response->set_success(success);
+    response->set_result(result.toStdString());
+    sendMessage(client->socket, message);
+}
+
+void RemoteServer::sendMessage(QTcpSocket *socket, const QRadioLink::RemoteMessage &message)
+{
+    int size = message.ByteSize();
+    QByteArray frame(4 + size, 0);
+    qToBigEndian<quint32>((quint32)size, (uchar*)frame.data());
+    message.SerializeToArray(frame.data() + 4, size);
+    socket->write(frame);
+}
+
+const RemoteServer::cached_frame &RemoteServer::streamFrame(int stream, int fft_bins)
+{
+    QPair<int, int> key(stream, fft_bins);
+    if(_frame_cache.contains(key))
+        return _frame_cache[key];
+
+    cached_frame &frame = _frame_cache[key];
+    frame.seq = 0;
+    QRadioLink::RemoteMessage message;
+    QRadioLink::Telemetry *telemetry = message.mutable_telemetry();
+    telemetry->set_timestamp_msec(QDateTime::currentMSecsSinceEpoch());
+    telemetry->set_stream((QRadioLink::RemoteSubscribe::Stream)stream);
+    switch(stream)
+    {
+    case QRadioLink::RemoteSubscribe::RSSI:
+    {
+        telemetry->set_rssi(_telemetry->getRSSI());
+        break;
+    }
+    case QRadioLink::RemoteSubscribe::FFT:
+    {
+        std::vector<float> fft;
+        frame.seq = _telemetry->getFFT(fft);
+        int size = (int)fft.size();
+        if((fft_bins < 1) || (fft_bins >= size))
+        {
+            for(int i=0;i<size;i++)
+                telemetry->add_fft(fft[i]);
+            break;
+        }
+        /// peak hold so narrow carriers survive the decimation
+        for(int i=0;i<fft_bins;i++)
+        {
+            int start = i * size / fft_bins;
+            int end = (i + 1) * size / fft_bins;
+            telemetry->add_fft(*std::max_element(fft.begin() + start, fft.begin() + end));
+        }
+        break;
+    }
+    case QRadioLink::RemoteSubscribe::CONSTELLATION:
+    {
+        std::vector<float> constellation;
+        frame.seq = _telemetry->getConstellation(constellation);
+        for(unsigned int i=0;i<constellation.size();i++)
+            telemetry->add_constellation(constellation[i]);
+        break;
+    }
+    case QRadioLink::RemoteSubscribe::FRAME_COUNTERS:
+    {
+        quint64 voice_frames, data_frames, transmissions;
+        _telemetry->getFrameCounters(voice_frames, data_frames, transmissions);
+        telemetry->set_rx_voice_frames(voice_frames);
+        telemetry->set_rx_data_frames(data_frames);
+        telemetry->set_rx_transmissions(transmissions);
+        break;
+    }
+    case QRadioLink::RemoteSubscribe::LATENCY:
+    {
+        float repeater_latency, rx_switch_time, tx_switch_time;
+        _telemetry->getLatency(repeater_latency, rx_switch_time, tx_switch_time);
+        telemetry->set_repeater_latency_msec(repeater_latency);
+        telemetry->set_rx_mode_switch_usec(rx_switch_time);
+        telemetry->set_tx_mode_switch_usec(tx_switch_time);
+        break;
+    }
+    default:
+        break;
+    }
+    int size = message.ByteSize();
+    frame.data.resize(4 + size);
+    qToBigEndian<quint32>((quint32)size, (uchar*)frame.data.data());
+    message.SerializeToArray(frame.data.data() + 4, size);
+    return frame;
+}
+
+void RemoteServer::publishTelemetry()
+{
+    qint64 now = _clock.elapsed();
+    _frame_cache.clear();
+    for(int i=0;i<_clients.size();i++)
+    {
+        remote_client *client = _clients.at(i);
+        if(client->socket->bytesToWrite() > REMOTE_MAX_QUEUED)
+            continue;
+        QMap<int, subscription>::iterator it;
+        for(it = client->subscriptions.begin(); it != client->subscriptions.end(); ++it)
+        {
+            subscription &sub = it.value();
+            if(now < sub.next_time)
+                continue;
+            sub.next_time = std::max(sub.next_time + sub.interval, now);
+            const cached_frame &frame = streamFrame(it.key(), sub.fft_bins);
+            /// snapshots are only sent when the radio produced a new one
+            if(((it.key() == QRadioLink::RemoteSubscribe::FFT) ||
+                (it.key() == QRadioLink::RemoteSubscribe::CONSTELLATION)) &&
+                    (frame.seq == sub.last_seq))
+                continue;
+            sub.last_seq = frame.seq;
+            client->socket->write(frame.data);
+        }
+    }
+}
+
+void RemoteServer::updateDataCollection()
+{
+    bool subscribed = false;
+    bool wants_fft = false;
+    bool wants_const = false;
+    for(int i=0;i<_clients.size();i++)
+    {
+        const QMap<int, subscription> &subscriptions = _clients.at(i)->subscriptions;
+        subscribed = subscribed || !subscriptions.isEmpty();
+        wants_fft = wants_fft || subscriptions.contains(QRadioLink::RemoteSubscribe::FFT);
+        wants_const = wants_const ||
+                subscriptions.contains(QRadioLink::RemoteSubscribe::CONSTELLATION);
+    }
+    /// the radio only collects FFT and constellation data when asked to
+    if(wants_fft && !_fft_enabled && !_settings->show_fft)
+    {
+        _fft_enabled = true;
+        emit enableGUIFFT(true);
+    }
+    else if(!wants_fft && _fft_enabled)
+    {
+        _fft_enabled = false;
+        emit enableGUIFFT(false);
+    }
+    if(wants_const && !_const_enabled && !_settings->show_constellation)
+    {
+        _const_enabled = true;
+        emit enableGUIConst(true);
+    }
+    else if(!wants_const && _const_enabled)
+    {
+        _const_enabled = false;
+        emit enableGUIConst(false);
+    }
+    if(subscribed && !_publish_timer->isActive())
+        _publish_timer->start();
+    else if(!subscribed && _publish_timer->isActive())
+        _publish_timer->stop();
+}
+
+RemoteServer::remote_client *RemoteServer::findClient(QTcpSocket *socket)
+{
+    for(int i=0;i<_clients.size();i++)
+    {
+        if(_clients.at(i)->socket == socket)
+            return _clients.at(i);
+    }
+    return nullptr;
+}
+
+void RemoteServer::removeClient(remote_client *client)
+{
+    _clients.removeOne(client);
+    QObject::disconnect(client->socket, 0, this, 0);
+    client->socket->abort();
+    client->socket->deleteLater();
+    delete client;
+}
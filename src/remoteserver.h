@@ -0,0 +1,109 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef REMOTESERVER_H
+#define REMOTESERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QVector>
+#include <QMap>
+#include <QPair>
+#include <QtEndian>
+#include <vector>
+#include "config_defines.h"
+#include "settings.h"
+#include "commandprocessor.h"
+#include "telemetry.h"
+#include "logger.h"
+#include "ext/QRadioLink.pb.h"
+
+/// Binary counterpart of TelnetServer for dashboards and automation.
+/// Clients send length prefixed QRadioLink::RemoteRequest messages and may
+/// pipeline as many as they like; each is answered with a RemoteResponse
+/// carrying the same request_id. Subscriptions push Telemetry messages at
+/// the interval chosen by the client. A message is serialized at most once
+/// per publish tick and the same bytes go to every subscriber
+class RemoteServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RemoteServer(const Settings *settings, Logger *logger,
+                          CommandProcessor *command_processor, Telemetry *telemetry,
+                          QObject *parent = 0);
+    ~RemoteServer();
+
+signals:
+    void enableGUIFFT(bool value);
+    void enableGUIConst(bool value);
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void getConnection();
+    void processData();
+    void clientDisconnected();
+    void publishTelemetry();
+
+private:
+    struct subscription
+    {
+        int interval;
+        qint64 next_time;
+        int fft_bins;
+        quint64 last_seq;
+    };
+    struct cached_frame
+    {
+        QByteArray data;
+        quint64 seq;
+    };
+    struct remote_client
+    {
+        QTcpSocket *socket;
+        QByteArray buffer;
+        QMap<int, subscription> subscriptions;
+    };
+
+    void processRequest(remote_client *client, const QRadioLink::RemoteRequest &request);
+    void sendMessage(QTcpSocket *socket, const QRadioLink::RemoteMessage &message);
+    const cached_frame &streamFrame(int stream, int fft_bins);
+    void updateDataCollection();
+    remote_client *findClient(QTcpSocket *socket);
+    void removeClient(remote_client *client);
+
+    const Settings *_settings;
+    Logger *_logger;
+    CommandProcessor *_command_processor;
+    Telemetry *_telemetry;
+    QTcpServer *_server;
+    QTimer *_publish_timer;
+    QElapsedTimer _clock;
+    QVector<remote_client*> _clients;
+    /// frames already serialized during the current publish tick
+    QMap<QPair<int, int>, cached_frame> _frame_cache; // stream, fft bins
+    bool _fft_enabled;
+    bool _const_enabled;
+};
+
+#endif // REMOTESERVER_H
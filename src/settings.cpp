@@ -26,12 +26,17 @@ Settings::Settings(Logger *logger)
     tx_inited = false;
     tx_started = false;
     voip_connected = false;
+    voip_links_connected = 0;
     voip_forwarding = false;
     voip_ptt_enabled = false;
     vox_enabled = false;
     repeater_enabled = false;
+    repeater_latency = 0.0;
     current_voip_channel = -1;
     rssi = 0.0;
+    rx_detected_tone = 0.0;
+    rx_detected_dcs = 0;
+    recording_iq = false;
 
     /// saved to config
     demod_offset = 0;
@@ -49,6 +54,17 @@ Settings::Settings(Logger *logger)
     fft_size = 32768;
     waterfall_fps = 15;
     control_port = 4939;
+    remote_control_port = 0;
+    audio_capture_frame = 20;
+    voip_frame_duration = 40;
+    voip_frames_per_packet = 1;
+    voip_dtx = 1;
+    block_profiler = 0;
+    block_buffer_auto = 0;
+    tdma_mac = 0;
+    tdma_slot_frames = 4;
+    ip_arq = 0;
+    arq_max_delay = 1000;
     voip_server="127.0.0.1";
     bb_gain = 1;
     night_mode = 0;
@@ -181,6 +197,30 @@ void Settings::readConfig()
         video_device = "/dev/video0";
     }
     try
+    {
+        video_downscale = cfg.lookup("video_downscale");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        video_downscale = 0;
+    }
+    try
+    {
+        video_frame_skip = cfg.lookup("video_frame_skip");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        video_frame_skip = 0;
+    }
+    try
+    {
+        video_inter_frames = cfg.lookup("video_inter_frames");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        video_inter_frames = 0;
+    }
+    try
     {
         audio_input_device = QString(cfg.lookup("audio_input_device"));
     }
@@ -388,6 +428,12 @@ void Settings::readConfig()
     {
         show_controls = 1;
     }
+#ifdef HEADLESS_DAEMON
+    /// GUI preferences, the daemon starts without them and they can only
+    /// be turned on remotely for the session
+    show_constellation = 0;
+    show_fft = 0;
+#else
     try
     {
         show_constellation = cfg.lookup("show_constellation");
@@ -404,6 +450,7 @@ void Settings::readConfig()
     {
         show_fft = 1;
     }
+#endif
     try
     {
         fft_size = cfg.lookup("fft_size");
@@ -509,6 +556,14 @@ void Settings::readConfig()
         audio_record_path = QDir::homePath();
     }
     try
+    {
+        iq_record_path = QString(cfg.lookup("iq_record_path"));
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        iq_record_path = QDir::homePath();
+    }
+    try
     {
         vox_level = cfg.lookup("vox_level");
     }
@@ -604,6 +659,236 @@ void Settings::readConfig()
     {
         lnb_lo_freq = 0;
     }
+    try
+    {
+        log_level = cfg.lookup("log_level");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        log_level = Logger::LogLevelDebug;
+    }
+    try
+    {
+        log_format = cfg.lookup("log_format");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        log_format = Logger::LogFormatText;
+    }
+    try
+    {
+        log_rate_limit = cfg.lookup("log_rate_limit");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        log_rate_limit = 10;
+    }
+    try
+    {
+        repeater_cut_through = cfg.lookup("repeater_cut_through");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        repeater_cut_through = 1;
+    }
+    try
+    {
+        repeater_turnaround = cfg.lookup("repeater_turnaround");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        repeater_turnaround = 80;
+    }
+    try
+    {
+        repeater_ctcss_regen = cfg.lookup("repeater_ctcss_regen");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        repeater_ctcss_regen = 0;
+    }
+    try
+    {
+        remote_control_port = cfg.lookup("remote_control_port");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        remote_control_port = 0;
+    }
+    try
+    {
+        audio_capture_frame = cfg.lookup("audio_capture_frame");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        audio_capture_frame = 20;
+    }
+    try
+    {
+        voip_frame_duration = cfg.lookup("voip_frame_duration");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        voip_frame_duration = 40;
+    }
+    try
+    {
+        voip_frames_per_packet = cfg.lookup("voip_frames_per_packet");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        voip_frames_per_packet = 1;
+    }
+    try
+    {
+        voip_dtx = cfg.lookup("voip_dtx");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        voip_dtx = 1;
+    }
+    voip_links.clear();
+    try
+    {
+        const libconfig::Setting &links = cfg.lookup("voip_links");
+        for(int i=0;i<links.getLength();i++)
+        {
+            voiplink link;
+            try
+            {
+                link.server = QString(links[i]["server"].c_str());
+                link.port = links[i]["port"];
+            }
+            catch(const libconfig::SettingNotFoundException &nfex)
+            {
+                continue;
+            }
+            try
+            {
+                link.password = QString(links[i]["password"].c_str());
+            }
+            catch(const libconfig::SettingNotFoundException &nfex)
+            {
+                link.password = "";
+            }
+            try
+            {
+                link.channel = QString(links[i]["channel"].c_str());
+            }
+            catch(const libconfig::SettingNotFoundException &nfex)
+            {
+                link.channel = "";
+            }
+            try
+            {
+                link.bitrate = links[i]["bitrate"];
+            }
+            catch(const libconfig::SettingNotFoundException &nfex)
+            {
+                link.bitrate = 0;
+            }
+            voip_links.append(link);
+        }
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        voip_links.clear();
+    }
+    sched_profiles.clear();
+    try
+    {
+        const libconfig::Setting &profiles = cfg.lookup("scheduling");
+        for(int i=0;i<profiles.getLength();i++)
+        {
+            schedprofile profile;
+            try
+            {
+                const libconfig::Setting &cpus = profiles[i]["cpus"];
+                for(int j=0;j<cpus.getLength();j++)
+                    profile.cpus.append((int)cpus[j]);
+            }
+            catch(const libconfig::SettingNotFoundException &nfex)
+            {
+                profile.cpus.clear();
+            }
+            try
+            {
+                profile.policy = QString(profiles[i]["policy"].c_str());
+            }
+            catch(const libconfig::SettingNotFoundException &nfex)
+            {
+                profile.policy = "other";
+            }
+            try
+            {
+                profile.priority = profiles[i]["priority"];
+            }
+            catch(const libconfig::SettingNotFoundException &nfex)
+            {
+                profile.priority = 0;
+            }
+            sched_profiles[QString(profiles[i].getName())] = profile;
+        }
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        sched_profiles.clear();
+    }
+    try
+    {
+        block_profiler = cfg.lookup("block_profiler");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        block_profiler = 0;
+    }
+    try
+    {
+        block_buffer_auto = cfg.lookup("block_buffer_auto");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        block_buffer_auto = 0;
+    }
+    try
+    {
+        tdma_mac = cfg.lookup("tdma_mac");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        tdma_mac = 0;
+    }
+    try
+    {
+        tdma_slot_frames = cfg.lookup("tdma_slot_frames");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        tdma_slot_frames = 4;
+    }
+    try
+    {
+        ip_arq = cfg.lookup("ip_arq");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        ip_arq = 0;
+    }
+    try
+    {
+        arq_max_delay = cfg.lookup("arq_max_delay");
+    }
+    catch(const libconfig::SettingNotFoundException &nfex)
+    {
+        arq_max_delay = 1000;
+    }
+    /// the TDMA slots carry the IP packets directly, there is no ARQ layer in them
+    if(ip_arq && tdma_mac)
+    {
+        _logger->log(Logger::LogLevelWarning,
+                     "ip_arq can not be used together with tdma_mac, disabling ARQ");
+        ip_arq = 0;
+    }
 
 }
 
@@ -619,6 +904,9 @@ void Settings::saveConfig()
     root.add("tx_freq_corr",libconfig::Setting::TypeInt) = tx_freq_corr;
     root.add("callsign",libconfig::Setting::TypeString) = callsign.toStdString();
     root.add("video_device",libconfig::Setting::TypeString) = video_device.toStdString();
+    root.add("video_downscale",libconfig::Setting::TypeInt) = video_downscale;
+    root.add("video_frame_skip",libconfig::Setting::TypeInt) = video_frame_skip;
+    root.add("video_inter_frames",libconfig::Setting::TypeInt) = video_inter_frames;
     root.add("audio_input_device",libconfig::Setting::TypeString) = audio_input_device.toStdString();
     root.add("audio_output_device",libconfig::Setting::TypeString) = audio_output_device.toStdString();
     root.add("tx_power",libconfig::Setting::TypeInt) = tx_power;
@@ -643,8 +931,10 @@ void Settings::saveConfig()
     root.add("rx_sample_rate",libconfig::Setting::TypeInt64) = rx_sample_rate;
     root.add("scan_step",libconfig::Setting::TypeInt) = scan_step;
     root.add("show_controls",libconfig::Setting::TypeInt) = show_controls;
+#ifndef HEADLESS_DAEMON
     root.add("show_constellation",libconfig::Setting::TypeInt) = show_constellation;
     root.add("show_fft",libconfig::Setting::TypeInt) = show_fft;
+#endif
     root.add("enable_duplex",libconfig::Setting::TypeInt) = enable_duplex;
     root.add("fft_size",libconfig::Setting::TypeInt) = fft_size;
     root.add("fft_averaging",libconfig::Setting::TypeFloat) = fft_averaging;
@@ -660,6 +950,7 @@ void Settings::saveConfig()
     root.add("night_mode",libconfig::Setting::TypeInt) = night_mode;
     root.add("scan_resume_time",libconfig::Setting::TypeInt) = scan_resume_time;
     root.add("audio_record_path",libconfig::Setting::TypeString) = audio_record_path.toStdString();
+    root.add("iq_record_path",libconfig::Setting::TypeString) = iq_record_path.toStdString();
     root.add("vox_level",libconfig::Setting::TypeInt) = vox_level;
     root.add("voip_bitrate",libconfig::Setting::TypeInt) = voip_bitrate;
     root.add("end_beep",libconfig::Setting::TypeInt) = end_beep;
@@ -672,6 +963,46 @@ void Settings::saveConfig()
     root.add("window_height",libconfig::Setting::TypeInt) = window_height;
     root.add("relay_sequence",libconfig::Setting::TypeInt) = relay_sequence;
     root.add("lnb_lo_freq",libconfig::Setting::TypeInt64) = lnb_lo_freq;
+    root.add("log_level",libconfig::Setting::TypeInt) = log_level;
+    root.add("log_format",libconfig::Setting::TypeInt) = log_format;
+    root.add("log_rate_limit",libconfig::Setting::TypeInt) = log_rate_limit;
+    root.add("repeater_cut_through",libconfig::Setting::TypeInt) = repeater_cut_through;
+    root.add("repeater_turnaround",libconfig::Setting::TypeInt) = repeater_turnaround;
+    root.add("repeater_ctcss_regen",libconfig::Setting::TypeInt) = repeater_ctcss_regen;
+    root.add("remote_control_port",libconfig::Setting::TypeInt) = remote_control_port;
+    root.add("audio_capture_frame",libconfig::Setting::TypeInt) = audio_capture_frame;
+    root.add("voip_frame_duration",libconfig::Setting::TypeInt) = voip_frame_duration;
+    root.add("voip_frames_per_packet",libconfig::Setting::TypeInt) = voip_frames_per_packet;
+    root.add("voip_dtx",libconfig::Setting::TypeInt) = voip_dtx;
+    root.add("voip_links",libconfig::Setting::TypeList);
+    for(int i=0;i<voip_links.size();i++)
+    {
+        libconfig::Setting &link = root["voip_links"].add(libconfig::Setting::TypeGroup);
+        link.add("server",libconfig::Setting::TypeString) = voip_links.at(i).server.toStdString();
+        link.add("port",libconfig::Setting::TypeInt) = voip_links.at(i).port;
+        link.add("password",libconfig::Setting::TypeString) = voip_links.at(i).password.toStdString();
+        link.add("channel",libconfig::Setting::TypeString) = voip_links.at(i).channel.toStdString();
+        link.add("bitrate",libconfig::Setting::TypeInt) = voip_links.at(i).bitrate;
+    }
+    libconfig::Setting &scheduling = root.add("scheduling",libconfig::Setting::TypeGroup);
+    QMap<QString, schedprofile>::const_iterator iter = sched_profiles.constBegin();
+    while(iter != sched_profiles.constEnd())
+    {
+        libconfig::Setting &profile = scheduling.add(iter.key().toStdString(),
+                                                     libconfig::Setting::TypeGroup);
+        libconfig::Setting &cpus = profile.add("cpus",libconfig::Setting::TypeArray);
+        for(int i=0;i<iter.value().cpus.size();i++)
+            cpus.add(libconfig::Setting::TypeInt) = iter.value().cpus.at(i);
+        profile.add("policy",libconfig::Setting::TypeString) = iter.value().policy.toStdString();
+        profile.add("priority",libconfig::Setting::TypeInt) = iter.value().priority;
+        ++iter;
+    }
+    root.add("block_profiler",libconfig::Setting::TypeInt) = block_profiler;
+    root.add("block_buffer_auto",libconfig::Setting::TypeInt) = block_buffer_auto;
+    root.add("tdma_mac",libconfig::Setting::TypeInt) = tdma_mac;
+    root.add("tdma_slot_frames",libconfig::Setting::TypeInt) = tdma_slot_frames;
+    root.add("ip_arq",libconfig::Setting::TypeInt) = ip_arq;
+    root.add("arq_max_delay",libconfig::Setting::TypeInt) = arq_max_delay;
     try
     {
         cfg.writeFile(_config_file->absoluteFilePath().toStdString().c_str());
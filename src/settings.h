@@ -19,13 +19,32 @@
 
 #include <QObject>
 #include <QFile>
-#include <QFileDialog>
 #include <QDir>
 #include <QDebug>
 #include <QFileInfo>
+#include <QVector>
+#include <QMap>
 #include <libconfig.h++>
 #include "logger.h"
 
+/// An extra VOIP server session bridged to the same radio
+struct voiplink
+{
+    QString server;
+    int port;
+    QString password;
+    QString channel; // joined by name after connecting, empty stays in the root channel
+    int bitrate; // 0 follows voip_bitrate
+};
+
+/// CPU placement and scheduling for one thread or GNU Radio block group
+struct schedprofile
+{
+    QVector<int> cpus; // empty leaves the affinity alone
+    QString policy; // "fifo", "rr" or "other"
+    int priority; // 1 to 99 with fifo or rr
+};
+
 class Settings
 {
 public:
@@ -55,6 +74,9 @@ public:
     long long tx_shift;
     QString callsign;
     QString video_device;
+    int video_downscale;
+    int video_frame_skip;
+    int video_inter_frames;
     QString voip_server;
     int voip_port;
     QString voip_password;
@@ -78,6 +100,7 @@ public:
     QString audio_output_device;
     QString audio_input_device;
     int control_port; // FIXME: this should be unsigned uint16
+    int remote_control_port; // binary protocol, 0 for default
     int remote_control;
     int agc_attack;
     int agc_decay;
@@ -85,6 +108,7 @@ public:
     int night_mode;
     int scan_resume_time;   // seconds
     QString audio_record_path;
+    QString iq_record_path;
     int vox_level;
     int voip_bitrate;
     int end_beep;
@@ -96,6 +120,26 @@ public:
     int window_height;
     int relay_sequence;
     long long lnb_lo_freq;
+    int log_level;
+    int log_format;
+    int log_rate_limit;
+    int repeater_cut_through;
+    int repeater_turnaround; // msec
+    int repeater_ctcss_regen; // analog repeater sends the received tone
+    int audio_capture_frame; // msec, 10, 20 or 40 when the codec does not fix it
+    int voip_frame_duration; // msec, 20, 40, 60 or 120
+    int voip_frames_per_packet; // Opus frames sent in one VOIP packet
+    int voip_dtx; // don't send silence to the VOIP server
+    QList<voiplink> voip_links;
+    /// keyed by thread name (main, radioop, audioreader, audiowriter, voipuplink)
+    /// or block group (frontend, demod, fec, modulator)
+    QMap<QString, schedprofile> sched_profiles;
+    int block_profiler; // seconds between flowgraph block profiles, 0 disabled
+    int block_buffer_auto; // shrink flowgraph buffers until they overflow or underflow
+    int tdma_mac; // IP modem channel access, 0 disabled, 1 member, 2 coordinator
+    int tdma_slot_frames; // radio frames in one TDMA data slot
+    int ip_arq; // retransmit lost IP modem frames, point to point links only
+    int arq_max_delay; // msec an IP modem frame is retried for
 
     /// Not saved to config:
 
@@ -105,14 +149,19 @@ public:
     bool tx_started;
     qint64 tx_frequency;
     float rssi;
+    float rx_detected_tone;
+    int rx_detected_dcs;
     bool voip_connected;
+    int voip_links_connected;
     bool vox_enabled;
     bool repeater_enabled;
+    float repeater_latency; // msec
     bool voip_forwarding;
     bool voip_ptt_enabled;
     int current_voip_channel;
     bool voip_self_deaf;
     bool recording_audio;
+    bool recording_iq;
 
 
 
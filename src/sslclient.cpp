@@ -15,7 +15,12 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "sslclient.h"
+#include <QRandomGenerator>
+#include <algorithm>
 
+/// Reconnect backoff, doubled on every failed attempt
+static const int RECONNECT_MIN_DELAY = 1000;
+static const int RECONNECT_MAX_DELAY = 60000;
 
 SSLClient::SSLClient(QObject *parent) :
     QObject(parent)
@@ -45,9 +50,17 @@ SSLClient::SSLClient(QObject *parent) :
 #else
     _socket->setProtocol(QSsl::TlsV1);
 #endif
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    QSslConfiguration config = _socket->sslConfiguration();
+    config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    _socket->setSslConfiguration(config);
+#endif
+    _reconnect_timer = new QTimer(this);
+    _reconnect_timer->setSingleShot(true);
+    QObject::connect(_reconnect_timer,SIGNAL(timeout()),this,SLOT(tryReconnect()));
     QObject::connect(_socket,SIGNAL(error(QAbstractSocket::SocketError )),
                      this,SLOT(connectionFailed(QAbstractSocket::SocketError)));
-    QObject::connect(_socket,SIGNAL(disconnected()),this,SLOT(tryReconnect()));
+    QObject::connect(_socket,SIGNAL(disconnected()),this,SLOT(socketDisconnected()));
     QObject::connect(_socket,SIGNAL(sslErrors(QList<QSslError>)),
                      this,SLOT(sslError(QList<QSslError>)));
     QObject::connect(_socket,SIGNAL(encrypted()),this,SLOT(connectionSuccess()));
@@ -68,6 +81,7 @@ SSLClient::SSLClient(QObject *parent) :
 SSLClient::~SSLClient()
 {
     _reconnect = false;
+    _reconnect_timer->stop();
     _socket->disconnectFromHost();
     delete _socket;
     delete _udp_socket;
@@ -84,6 +98,12 @@ void SSLClient::connectionSuccess()
     _status=1;
     _connection_tries=0;
     _reconnect = true;
+    /// a reconnect scheduled by closing the previous connection is stale now
+    _reconnect_timer->stop();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    /// Kept so the next handshake to this server can resume the session
+    _session_ticket = _socket->sslConfiguration().sessionTicket();
+#endif
     emit connectedToHost();
 }
 
@@ -99,39 +119,47 @@ void SSLClient::connectionFailed(QAbstractSocket::SocketError)
     emit logMessage(QString("Outgoing connection failed %1").arg(_socket->errorString()));
     if(_status==1)
     {
+        /// socketDisconnected() takes care of scheduling the reconnect
         _socket->close();
         _status=0;
         return;
     }
     else
     {
-        QMetaObject::invokeMethod(this, "tryReconnect", Qt::QueuedConnection);
+        scheduleReconnect();
     }
 }
 
-void SSLClient::tryReconnect()
+void SSLClient::socketDisconnected()
 {
     if(!_reconnect)
         return;
     emit logMessage("Disconnected from server");
+    _status=0;
+    scheduleReconnect();
+}
+
+void SSLClient::scheduleReconnect()
+{
+    if(!_reconnect || _reconnect_timer->isActive())
+        return;
+    /// Exponential backoff with +-25% jitter so a restarted server
+    /// does not get all clients back in the same instant
+    int delay = RECONNECT_MAX_DELAY;
+    if(_connection_tries < 16)
+        delay = std::min(RECONNECT_MAX_DELAY, RECONNECT_MIN_DELAY << _connection_tries);
+    int jitter = delay / 4;
+    delay += QRandomGenerator::global()->bounded(2 * jitter + 1) - jitter;
     _connection_tries++;
-    // FIXME: blocks the main thread
-    QTimer timer;
-    timer.setSingleShot(true);
-    timer.start(1000);
-    while(timer.isActive())
-    {
-        QCoreApplication::processEvents();
-    }
-    if(_connection_tries < 2000000)
-    {
-        QMetaObject::invokeMethod(this, "connectHost", Qt:: QueuedConnection,
-        Q_ARG(QString, _hostname), Q_ARG(const unsigned, _port));
-    }
-    else
-    {
+    emit logMessage(QString("Reconnecting in %1 ms, attempt %2").arg(delay).arg(_connection_tries));
+    _reconnect_timer->start(delay);
+}
+
+void SSLClient::tryReconnect()
+{
+    if(!_reconnect || (_status==1))
         return;
-    }
+    startConnection();
 }
 
 void SSLClient::sslError(QList<QSslError> errors)
@@ -146,25 +174,44 @@ void SSLClient::sslError(QList<QSslError> errors)
 }
 
 void SSLClient::connectHost(const QString &host, const unsigned &port)
+{
+    _reconnect_timer->stop();
+    _connection_tries=0;
+    if((host != _hostname) || (port != _port))
+        _session_ticket.clear();
+    _hostname = host;
+    _port = port;
+    startConnection();
+}
+
+void SSLClient::startConnection()
 {
     if(_status==1)
     {
+        /// closing on purpose, not a lost connection to come back to
         _socket->close();
         _status=0;
+        _reconnect_timer->stop();
     }
-    emit logMessage("Trying connection to" + host);
-    _socket->connectToHostEncrypted(host, port);
-    _hostname = host;
-    _port = port;
+    emit logMessage("Trying connection to" + _hostname);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    if(!_session_ticket.isEmpty())
+    {
+        QSslConfiguration config = _socket->sslConfiguration();
+        config.setSessionTicket(_session_ticket);
+        _socket->setSslConfiguration(config);
+    }
+#endif
+    _socket->connectToHostEncrypted(_hostname, _port);
 }
 
 void SSLClient::disconnectHost()
 {
+    _reconnect = false;
+    _reconnect_timer->stop();
     if(_status==0)
         return;
-    QObject::disconnect(_socket,SIGNAL(disconnected()),this,SLOT(tryReconnect()));
     _socket->disconnectFromHost();
-    _reconnect = false;
     _status=0;
     _connection_tries=0;
     emit disconnectedFromHost();
@@ -232,8 +279,9 @@ void SSLClient::sendUDP(quint8 *payload, quint64 size)
 {
     char *message = reinterpret_cast<char*>(payload);
 
-    quint64 sent = _udp_socket->writeDatagram(
+    qint64 sent = _udp_socket->writeDatagram(
                 message,size,QHostAddress(_hostname),_port);
     _udp_socket->flush();
-    emit logMessage(QString("SSL socket write failed, sent %1 bytes").arg(sent));
+    if(sent != (qint64)size)
+        emit logMessage(QString("UDP socket write failed, sent %1 bytes").arg(sent));
 }
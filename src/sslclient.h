@@ -21,6 +21,7 @@
 #include <QByteArray>
 #include <QSslCipher>
 #include <QSslCertificate>
+#include <QSslConfiguration>
 #include <QAbstractSocket>
 #include <QUdpSocket>
 #include <QHostAddress>
@@ -61,18 +62,24 @@ signals:
     void logMessage(QString log_msg);
 
 private:
+    void startConnection();
+    void scheduleReconnect();
+
     QSslSocket *_socket;
     QUdpSocket *_udp_socket;
+    QTimer *_reconnect_timer;
     unsigned _connection_tries;
     unsigned _status;
     QString _hostname;
     unsigned _port;
     bool _reconnect;
+    QByteArray _session_ticket;
 
 
 private slots:
     void connectionSuccess();
     void connectionFailed(QAbstractSocket::SocketError);
+    void socketDisconnected();
     void sslError(QList<QSslError> errors);
     void tryReconnect();
 
@@ -34,6 +34,7 @@ Station::~Station()
 
 }
 
+#ifndef HEADLESS_DAEMON
 void Station::initWidget()
 {
     _tree_item->setText(0,callsign);
@@ -51,3 +52,4 @@ QTreeWidgetItem* Station::getWidget() const
 {
     return _tree_item;
 }
+#endif
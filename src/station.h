@@ -18,17 +18,21 @@
 #define STATION_H
 
 #include <QString>
-#include <QTreeWidgetItem>
 #include <QTimer>
+#ifndef HEADLESS_DAEMON
+#include <QTreeWidgetItem>
 #include <QIcon>
+#endif
 
 class Station
 {
 public:
     Station();
     ~Station();
+#ifndef HEADLESS_DAEMON
     void initWidget();
     QTreeWidgetItem *getWidget() const;
+#endif
     quint64 id;
     QString callsign;
     QString radio_id;
@@ -39,7 +43,9 @@ public:
     bool mute;
     bool deaf;
     bool is_user;
+#ifndef HEADLESS_DAEMON
     QTreeWidgetItem *_tree_item;
+#endif
     QTimer *_icon_timer;
 };
 
@@ -0,0 +1,371 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "tdmamac.h"
+#include <QStringList>
+#include <QtGlobal>
+#include <QRandomGenerator>
+#include <string.h>
+#include <algorithm>
+
+/// air time of one 1516 byte radio frame at 250 kbit/s
+static const qint64 FRAME_USEC = 48400;
+/// turnaround assumed until the first burst is measured
+static const qint64 DEFAULT_TURNAROUND_USEC = 40000;
+static const qint64 MAX_TURNAROUND_USEC = 200000;
+/// beacon timing and the radio loop period are not exact
+static const qint64 SYNC_MARGIN_USEC = 5000;
+/// the contention slot is longer than the beacon slot by more than one
+/// radio loop period, so requests get a chance to start in it
+static const qint64 CONTENTION_WINDOW_USEC = 25000;
+static const int TDMA_MAX_SLOTS = 16;
+/// members stop transmitting after this many superframes without a beacon
+static const int SYNC_LOST_BEACONS = 4;
+/// an owner not heard for this long loses its slot
+static const int SLOT_IDLE_SUPERFRAMES = 64;
+/// owners with nothing to send still show they are alive
+static const int KEEPALIVE_SUPERFRAMES = 16;
+static const int MAX_REQUEST_BACKOFF = 8;
+/// about one second of traffic at 250 kbit/s
+static const int MAX_QUEUE_BYTES = 32768;
+static const int HEADER_SIZE = 2;
+static const int BEACON_SIZE = HEADER_SIZE + 15;
+
+TdmaMac::TdmaMac(const Settings *settings, Logger *logger, int payload_size)
+{
+    _settings = settings;
+    _logger = logger;
+    _role = settings->tdma_mac;
+    _node_id = settings->ip_address.split(".").last().toInt();
+    _payload_size = payload_size;
+    _slot_usec = settings->tdma_slot_frames * FRAME_USEC + DEFAULT_TURNAROUND_USEC + SYNC_MARGIN_USEC;
+    _control_usec = FRAME_USEC + DEFAULT_TURNAROUND_USEC + SYNC_MARGIN_USEC;
+    _queued_bytes = 0;
+    _superframe = 0;
+    _superframe_start = -1;
+    _missed_beacons = 0;
+    _synced = false;
+    _own_slot = -1;
+    _slot_handled = -1;
+    _last_sent = 0;
+    _contention_done = false;
+    _request_pending = false;
+    _request_backoff = 1;
+    _coordinator_turnaround = 0;
+    _turnaround_usec = DEFAULT_TURNAROUND_USEC;
+    _tx_latency_usec = 0;
+    _burst_slot_start = 0;
+    _burst_queued = 0;
+    _burst_frames = 0;
+    _burst_pending = false;
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.slot = -1;
+}
+
+bool TdmaMac::queuePacket(const unsigned char *data, int size)
+{
+    if((size > _payload_size - HEADER_SIZE - 2) || (_queued_bytes + size > MAX_QUEUE_BYTES))
+    {
+        _stats.packets_dropped++;
+        return false;
+    }
+    _queue.enqueue(QByteArray((const char*)data, size));
+    _queued_bytes += size;
+    return true;
+}
+
+qint64 TdmaMac::superframeLength() const
+{
+    return 2 * _control_usec + CONTENTION_WINDOW_USEC + _slot_owners.size() * _slot_usec;
+}
+
+qint64 TdmaMac::guardUsec() const
+{
+    return _turnaround_usec + _tx_latency_usec + SYNC_MARGIN_USEC;
+}
+
+QByteArray TdmaMac::makeHeader(int type) const
+{
+    QByteArray header;
+    header.append((char)type);
+    header.append((char)_node_id);
+    return header;
+}
+
+QByteArray TdmaMac::makeBeacon() const
+{
+    QByteArray beacon = makeHeader(FrameBeacon);
+    quint16 superframe = _superframe;
+    quint32 control_usec = (quint32)_control_usec;
+    quint32 slot_usec = (quint32)_slot_usec;
+    quint32 turnaround = (quint32)(_turnaround_usec + _tx_latency_usec);
+    beacon.append((const char*)&superframe, 2);
+    beacon.append((const char*)&control_usec, 4);
+    beacon.append((const char*)&slot_usec, 4);
+    beacon.append((const char*)&turnaround, 4);
+    beacon.append((char)_slot_owners.size());
+    for(int i=0;i<_slot_owners.size();i++)
+        beacon.append((char)_slot_owners.at(i));
+    return beacon;
+}
+
+QByteArray TdmaMac::nextDataFrame()
+{
+    /// length prefixed packets, as many as fit
+    QByteArray frame = makeHeader(FrameData);
+    while(!_queue.isEmpty() && (frame.size() + 2 + _queue.head().size() <= _payload_size))
+    {
+        QByteArray packet = _queue.dequeue();
+        quint16 size = (quint16)packet.size();
+        frame.append((const char*)&size, 2);
+        frame.append(packet);
+        _queued_bytes -= packet.size();
+        _stats.packets_sent++;
+    }
+    return frame;
+}
+
+void TdmaMac::startSuperframe(qint64 now_usec)
+{
+    _superframe++;
+    _superframe_start = now_usec;
+    _contention_done = false;
+    _control_usec = FRAME_USEC + guardUsec();
+    _slot_usec = _settings->tdma_slot_frames * FRAME_USEC + guardUsec();
+
+    for(int i=_slot_owners.size()-1;i>=0;i--)
+    {
+        int owner = _slot_owners.at(i);
+        if((quint16)(_superframe - _last_heard.value(owner, 0)) > SLOT_IDLE_SUPERFRAMES)
+        {
+            _slot_owners.removeAt(i);
+            _last_heard.remove(owner);
+            _logger->log(Logger::LogLevelInfo, QString("TDMA slot of node %1 expired").arg(owner),
+                         Logger::LogSubsystemNet);
+        }
+    }
+    /// the coordinator reserves its own slot directly
+    if(!_queue.isEmpty() && !_slot_owners.contains(_node_id) &&
+            (_slot_owners.size() < TDMA_MAX_SLOTS))
+    {
+        _slot_owners.append(_node_id);
+        _last_heard[_node_id] = _superframe;
+    }
+    _own_slot = _slot_owners.indexOf(_node_id);
+    _synced = true;
+}
+
+void TdmaMac::measureTurnaround(qint64 now_usec, unsigned int queued_bytes)
+{
+    if(!_burst_pending || (queued_bytes > 0))
+        return;
+    /// late start in the slot plus whatever the modulator took beyond the air time
+    qint64 excess = (now_usec - _burst_queued) - _burst_frames * FRAME_USEC;
+    qint64 sample = (_burst_queued - _burst_slot_start) + std::max((qint64)0, excess);
+    sample = std::min(sample, MAX_TURNAROUND_USEC);
+    /// follow increases at once, decreases slowly
+    if(sample > _turnaround_usec)
+        _turnaround_usec = sample;
+    else
+        _turnaround_usec -= (_turnaround_usec - sample) / 8;
+    _burst_pending = false;
+}
+
+QVector<QByteArray> TdmaMac::poll(qint64 now_usec, unsigned int queued_bytes)
+{
+    QVector<QByteArray> frames;
+    measureTurnaround(now_usec, queued_bytes);
+    if(_role == TdmaCoordinator)
+    {
+        if((_superframe_start < 0) || (now_usec >= _superframe_start + superframeLength()))
+        {
+            startSuperframe(now_usec);
+            frames.append(makeBeacon());
+        }
+    }
+    else
+    {
+        if(!_synced)
+            return frames;
+        /// keep counting superframes when beacons are missed
+        while(now_usec >= _superframe_start + superframeLength())
+        {
+            _superframe_start += superframeLength();
+            _superframe++;
+            _contention_done = false;
+            if(++_missed_beacons > SYNC_LOST_BEACONS)
+            {
+                _synced = false;
+                _own_slot = -1;
+                _logger->log(Logger::LogLevelWarning, "TDMA beacon lost, not transmitting",
+                             Logger::LogSubsystemNet);
+                return frames;
+            }
+        }
+    }
+    qint64 offset = now_usec - _superframe_start;
+    qint64 guard = guardUsec();
+
+    /// slotted ALOHA for reservations, backing off while collisions keep us out
+    if((_role == TdmaMember) && (_own_slot < 0) && !_queue.isEmpty() && !_contention_done &&
+            (offset >= _control_usec) && (offset + FRAME_USEC + guard <= 2 * _control_usec + CONTENTION_WINDOW_USEC))
+    {
+        _contention_done = true;
+        if(QRandomGenerator::global()->bounded(_request_backoff) == 0)
+        {
+            frames.append(makeHeader(FrameRequest));
+            _request_pending = true;
+            _stats.requests++;
+        }
+    }
+
+    qint64 slot_start = 2 * _control_usec + CONTENTION_WINDOW_USEC + _own_slot * _slot_usec;
+    if((_own_slot >= 0) && (_slot_handled != _superframe) &&
+            (offset >= slot_start) && (offset < slot_start + _slot_usec))
+    {
+        _slot_handled = _superframe;
+        int room = (int)((slot_start + _slot_usec - offset - guard) / FRAME_USEC);
+        for(int i=0;(i<room) && !_queue.isEmpty();i++)
+            frames.append(nextDataFrame());
+        if((frames.size() < 1) && (room > 0) &&
+                ((quint16)(_superframe - _last_sent) >= KEEPALIVE_SUPERFRAMES))
+            frames.append(makeHeader(FrameData));
+        if(frames.size() > 0)
+        {
+            _last_sent = _superframe;
+            if(_role == TdmaCoordinator)
+                _last_heard[_node_id] = _superframe;
+        }
+        slot_start += _superframe_start;
+    }
+    else
+    {
+        /// beacon or request, sent at the start of their control slot
+        slot_start = _superframe_start + ((frames.size() > 0) && (_role == TdmaMember) ?
+                                              _control_usec : 0);
+    }
+
+    if(frames.size() > 0)
+    {
+        _burst_slot_start = slot_start;
+        _burst_queued = now_usec;
+        _burst_frames = frames.size();
+        _burst_pending = true;
+        _stats.frames_sent += frames.size();
+    }
+    return frames;
+}
+
+void TdmaMac::readBeacon(const unsigned char *data, int size, qint64 now_usec)
+{
+    if((size < BEACON_SIZE) || (size < BEACON_SIZE + data[BEACON_SIZE - 1]))
+        return;
+    quint16 superframe;
+    quint32 control_usec, slot_usec, turnaround;
+    memcpy(&superframe, &data[HEADER_SIZE], 2);
+    memcpy(&control_usec, &data[HEADER_SIZE + 2], 4);
+    memcpy(&slot_usec, &data[HEADER_SIZE + 6], 4);
+    memcpy(&turnaround, &data[HEADER_SIZE + 10], 4);
+    _superframe = superframe;
+    _control_usec = control_usec;
+    _slot_usec = slot_usec;
+    _coordinator_turnaround = turnaround;
+    /// the beacon went out one turnaround after the superframe start
+    _superframe_start = now_usec - FRAME_USEC - _coordinator_turnaround;
+    _missed_beacons = 0;
+    _contention_done = false;
+    _slot_owners.clear();
+    for(int i=0;i<data[BEACON_SIZE - 1];i++)
+        _slot_owners.append(data[BEACON_SIZE + i]);
+
+    int own_slot = _slot_owners.indexOf(_node_id);
+    if(!_synced)
+        _logger->log(Logger::LogLevelInfo, QString("TDMA synchronized to node %1").arg(data[1]),
+                     Logger::LogSubsystemNet);
+    if((own_slot >= 0) && (_own_slot < 0))
+    {
+        _logger->log(Logger::LogLevelInfo, QString("TDMA data slot %1 of %2 reserved")
+                     .arg(own_slot).arg(_slot_owners.size()), Logger::LogSubsystemNet);
+        _request_backoff = 1;
+    }
+    else if((own_slot < 0) && _request_pending)
+    {
+        _request_backoff = std::min(_request_backoff * 2, MAX_REQUEST_BACKOFF);
+    }
+    _request_pending = false;
+    _own_slot = own_slot;
+    _synced = true;
+}
+
+QVector<QByteArray> TdmaMac::receive(const unsigned char *data, int size, qint64 now_usec)
+{
+    QVector<QByteArray> packets;
+    /// a duplex radio hears itself
+    if((size < HEADER_SIZE) || (data[1] == _node_id))
+        return packets;
+    int type = data[0];
+    int source = data[1];
+    if(type == FrameBeacon)
+    {
+        if(_role == TdmaMember)
+            readBeacon(data, size, now_usec);
+        return packets;
+    }
+    if(_role == TdmaCoordinator)
+    {
+        if((type == FrameRequest) && !_slot_owners.contains(source) &&
+                (_slot_owners.size() < TDMA_MAX_SLOTS))
+        {
+            /// granted in the next beacon
+            _slot_owners.append(source);
+            _logger->log(Logger::LogLevelInfo, QString("TDMA slot granted to node %1").arg(source),
+                         Logger::LogSubsystemNet);
+        }
+        if(_slot_owners.contains(source))
+            _last_heard[source] = _superframe;
+    }
+    if(type != FrameData)
+        return packets;
+    int pos = HEADER_SIZE;
+    while(pos + 2 <= size)
+    {
+        quint16 packet_size;
+        memcpy(&packet_size, &data[pos], 2);
+        pos += 2;
+        if((packet_size == 0) || (pos + packet_size > size))
+            break;
+        packets.append(QByteArray((const char*)&data[pos], packet_size));
+        pos += packet_size;
+    }
+    _stats.packets_received += packets.size();
+    return packets;
+}
+
+void TdmaMac::setTxLatency(qint64 usec)
+{
+    _tx_latency_usec = usec;
+}
+
+TdmaMac::stats TdmaMac::getStats() const
+{
+    stats current = _stats;
+    current.synced = _synced;
+    current.slot = _own_slot;
+    current.slots = _slot_owners.size();
+    current.guard_usec = guardUsec();
+    return current;
+}
@@ -0,0 +1,126 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef TDMAMAC_H
+#define TDMAMAC_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QQueue>
+#include <QMap>
+#include "src/settings.h"
+#include "src/logger.h"
+
+/// Time division access to a shared IP modem channel.
+/// A superframe starts with a beacon from the coordinator, followed by a
+/// contention slot where nodes ask for a data slot, then one data slot for
+/// every node holding a reservation. Nodes keep their superframe timing from
+/// the beacons and only transmit inside their own slot, sending as many
+/// radio frames as fit before the guard time. Packets from the net device
+/// are packed several to a radio frame.
+/// The node id is the last octet of ip_address.
+class TdmaMac
+{
+public:
+    enum TdmaRole
+    {
+        TdmaDisabled = 0,
+        TdmaMember = 1,
+        TdmaCoordinator = 2
+    };
+
+    struct stats
+    {
+        bool synced;
+        int slot; // own data slot, -1 without a reservation
+        int slots;
+        qint64 guard_usec;
+        quint64 frames_sent;
+        quint64 packets_sent;
+        quint64 packets_received;
+        quint64 packets_dropped;
+        quint64 requests;
+    };
+
+    /// payload_size is what one radio frame carries, MAC header included
+    TdmaMac(const Settings *settings, Logger *logger, int payload_size);
+
+    /// Copies the packet, false when the queue is full and it was dropped
+    bool queuePacket(const unsigned char *data, int size);
+    /// Called from the radio loop, returns the frame payloads to transmit now.
+    /// queued_bytes is what the modulator still has to send, used to measure
+    /// the TX turnaround of the previous burst
+    QVector<QByteArray> poll(qint64 now_usec, unsigned int queued_bytes);
+    /// Takes a received frame payload, returns the packets it carried
+    QVector<QByteArray> receive(const unsigned char *data, int size, qint64 now_usec);
+    /// Queueing latency of the TX flowgraph after the data source, which the
+    /// turnaround measurement does not see
+    void setTxLatency(qint64 usec);
+    stats getStats() const;
+
+private:
+    enum FrameType
+    {
+        FrameData = 1,
+        FrameBeacon = 2,
+        FrameRequest = 3
+    };
+
+    qint64 superframeLength() const;
+    qint64 guardUsec() const;
+    void startSuperframe(qint64 now_usec);
+    QByteArray makeHeader(int type) const;
+    QByteArray makeBeacon() const;
+    QByteArray nextDataFrame();
+    void measureTurnaround(qint64 now_usec, unsigned int queued_bytes);
+    void readBeacon(const unsigned char *data, int size, qint64 now_usec);
+
+    const Settings *_settings;
+    Logger *_logger;
+    int _role;
+    int _node_id;
+    int _payload_size;
+    qint64 _slot_usec;
+
+    QQueue<QByteArray> _queue;
+    int _queued_bytes;
+    QVector<int> _slot_owners;
+    QMap<int, quint16> _last_heard; // coordinator, superframe a slot owner was last heard in
+    quint16 _superframe;
+    qint64 _superframe_start;
+    int _missed_beacons;
+    bool _synced;
+    qint64 _control_usec;
+    int _own_slot;
+    int _slot_handled; // superframe our slot was last used in, -1 for none
+    quint16 _last_sent;
+    bool _contention_done;
+    bool _request_pending;
+    int _request_backoff;
+
+    qint64 _coordinator_turnaround;
+    qint64 _turnaround_usec;
+    qint64 _tx_latency_usec;
+    qint64 _burst_slot_start;
+    qint64 _burst_queued;
+    int _burst_frames;
+    bool _burst_pending;
+
+    stats _stats;
+};
+
+#endif // TDMAMAC_H
@@ -0,0 +1,214 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "telemetry.h"
+
+Telemetry::Telemetry()
+{
+    _rssi = 0;
+    _fft_seq = 0;
+    _constellation_seq = 0;
+    _voice_frames = 0;
+    _data_frames = 0;
+    _transmissions = 0;
+    _repeater_latency = 0;
+    _rx_switch_time = 0;
+    _tx_switch_time = 0;
+    _tdma_active = false;
+}
+
+void Telemetry::setRSSI(float rssi)
+{
+    QMutexLocker locker(&_mutex);
+    _rssi = rssi;
+}
+
+void Telemetry::setFFT(const float *data, unsigned int size)
+{
+    QMutexLocker locker(&_mutex);
+    _fft.assign(data, data + size);
+    _fft_seq++;
+}
+
+void Telemetry::setConstellation(const std::vector<std::complex<float>> *data)
+{
+    QMutexLocker locker(&_mutex);
+    _constellation.resize(data->size() * 2);
+    for(unsigned int i=0;i<data->size();i++)
+    {
+        _constellation[2*i] = data->at(i).real();
+        _constellation[2*i+1] = data->at(i).imag();
+    }
+    _constellation_seq++;
+}
+
+void Telemetry::countVoiceFrame()
+{
+    QMutexLocker locker(&_mutex);
+    _voice_frames++;
+}
+
+void Telemetry::countDataFrame()
+{
+    QMutexLocker locker(&_mutex);
+    _data_frames++;
+}
+
+void Telemetry::countTransmission()
+{
+    QMutexLocker locker(&_mutex);
+    _transmissions++;
+}
+
+void Telemetry::setRepeaterLatency(float msec)
+{
+    QMutexLocker locker(&_mutex);
+    _repeater_latency = msec;
+}
+
+void Telemetry::setModeSwitchTime(bool tx, float usec)
+{
+    QMutexLocker locker(&_mutex);
+    if(tx)
+        _tx_switch_time = usec;
+    else
+        _rx_switch_time = usec;
+}
+
+void Telemetry::setCoreLoad(const std::vector<float> &load)
+{
+    QMutexLocker locker(&_mutex);
+    _core_load = load;
+}
+
+int Telemetry::addDeadline(const QString &name, qint64 budget_usec)
+{
+    QMutexLocker locker(&_mutex);
+    deadline d;
+    d.name = name;
+    d.budget_usec = budget_usec;
+    d.cycles = 0;
+    d.missed = 0;
+    d.worst_usec = 0;
+    _deadlines.push_back(d);
+    return (int)_deadlines.size() - 1;
+}
+
+void Telemetry::countCycle(int deadline_id, qint64 usec)
+{
+    QMutexLocker locker(&_mutex);
+    deadline &d = _deadlines[deadline_id];
+    d.cycles++;
+    if(usec > d.budget_usec)
+        d.missed++;
+    if(usec > d.worst_usec)
+        d.worst_usec = usec;
+}
+
+void Telemetry::setBlockStats(const std::vector<blockstats> &stats)
+{
+    QMutexLocker locker(&_mutex);
+    _block_stats = stats;
+}
+
+void Telemetry::setBufferStats(const bufferstats &stats)
+{
+    QMutexLocker locker(&_mutex);
+    for(unsigned int i=0;i<_buffer_stats.size();i++)
+    {
+        if((_buffer_stats[i].tx == stats.tx) && (_buffer_stats[i].mode == stats.mode))
+        {
+            _buffer_stats[i] = stats;
+            return;
+        }
+    }
+    _buffer_stats.push_back(stats);
+}
+
+void Telemetry::setTdmaStats(const tdmastats &stats)
+{
+    QMutexLocker locker(&_mutex);
+    _tdma_stats = stats;
+    _tdma_active = true;
+}
+
+float Telemetry::getRSSI()
+{
+    QMutexLocker locker(&_mutex);
+    return _rssi;
+}
+
+quint64 Telemetry::getFFT(std::vector<float> &data)
+{
+    QMutexLocker locker(&_mutex);
+    data = _fft;
+    return _fft_seq;
+}
+
+quint64 Telemetry::getConstellation(std::vector<float> &data)
+{
+    QMutexLocker locker(&_mutex);
+    data = _constellation;
+    return _constellation_seq;
+}
+
+void Telemetry::getFrameCounters(quint64 &voice_frames, quint64 &data_frames, quint64 &transmissions)
+{
+    QMutexLocker locker(&_mutex);
+    voice_frames = _voice_frames;
+    data_frames = _data_frames;
+    transmissions = _transmissions;
+}
+
+void Telemetry::getLatency(float &repeater_latency, float &rx_switch_time, float &tx_switch_time)
+{
+    QMutexLocker locker(&_mutex);
+    repeater_latency = _repeater_latency;
+    rx_switch_time = _rx_switch_time;
+    tx_switch_time = _tx_switch_time;
+}
+
+void Telemetry::getCoreLoad(std::vector<float> &load)
+{
+    QMutexLocker locker(&_mutex);
+    load = _core_load;
+}
+
+std::vector<Telemetry::deadline> Telemetry::getDeadlines()
+{
+    QMutexLocker locker(&_mutex);
+    return _deadlines;
+}
+
+std::vector<Telemetry::blockstats> Telemetry::getBlockStats()
+{
+    QMutexLocker locker(&_mutex);
+    return _block_stats;
+}
+
+std::vector<Telemetry::bufferstats> Telemetry::getBufferStats()
+{
+    QMutexLocker locker(&_mutex);
+    return _buffer_stats;
+}
+
+bool Telemetry::getTdmaStats(tdmastats &stats)
+{
+    QMutexLocker locker(&_mutex);
+    stats = _tdma_stats;
+    return _tdma_active;
+}
@@ -0,0 +1,135 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+#include <complex>
+
+/// Latest radio state published once by RadioController and read by any
+/// number of remote clients, so the RX thread does the same work no matter
+/// how many dashboards are connected
+class Telemetry
+{
+public:
+    /// A periodic loop which should finish each cycle within budget_usec
+    struct deadline
+    {
+        QString name;
+        qint64 budget_usec;
+        quint64 cycles;
+        quint64 missed;
+        qint64 worst_usec;
+    };
+
+    /// Performance counters of one flowgraph block
+    struct blockstats
+    {
+        QString name;
+        bool tx;
+        float cpu_percent;
+        float work_usec;
+        float items_per_sec;
+        float input_full;
+        float output_full;
+    };
+
+    /// Buffer footprint of one flowgraph mode, kept for every mode used
+    struct bufferstats
+    {
+        bool tx;
+        int mode;
+        int bytes;
+        float latency_msec;
+        float scale;
+        bool tuned;
+        quint64 events; // overflows for RX, underflows for TX
+    };
+
+    /// State of the IP modem TDMA channel access
+    struct tdmastats
+    {
+        bool synced;
+        int slot;
+        int slots;
+        qint64 guard_usec;
+        quint64 frames_sent;
+        quint64 packets_sent;
+        quint64 packets_received;
+        quint64 packets_dropped;
+        quint64 requests;
+    };
+
+    Telemetry();
+
+    void setRSSI(float rssi);
+    void setFFT(const float *data, unsigned int size);
+    void setConstellation(const std::vector<std::complex<float>> *data);
+    void countVoiceFrame();
+    void countDataFrame();
+    void countTransmission();
+    void setRepeaterLatency(float msec);
+    void setModeSwitchTime(bool tx, float usec);
+    void setCoreLoad(const std::vector<float> &load);
+    /// Returns the id used with countCycle()
+    int addDeadline(const QString &name, qint64 budget_usec);
+    void countCycle(int deadline_id, qint64 usec);
+    void setBlockStats(const std::vector<blockstats> &stats);
+    /// Replaces the entry of the same direction and mode
+    void setBufferStats(const bufferstats &stats);
+    void setTdmaStats(const tdmastats &stats);
+
+    float getRSSI();
+    /// Returns a sequence number which changes with every new FFT frame
+    quint64 getFFT(std::vector<float> &data);
+    /// Interleaved I and Q
+    quint64 getConstellation(std::vector<float> &data);
+    void getFrameCounters(quint64 &voice_frames, quint64 &data_frames, quint64 &transmissions);
+    void getLatency(float &repeater_latency, float &rx_switch_time, float &tx_switch_time);
+    void getCoreLoad(std::vector<float> &load);
+    std::vector<deadline> getDeadlines();
+    std::vector<blockstats> getBlockStats();
+    std::vector<bufferstats> getBufferStats();
+    /// Returns false when the TDMA MAC has not run yet
+    bool getTdmaStats(tdmastats &stats);
+
+private:
+    QMutex _mutex;
+    float _rssi;
+    std::vector<float> _fft;
+    quint64 _fft_seq;
+    std::vector<float> _constellation;
+    quint64 _constellation_seq;
+    quint64 _voice_frames;
+    quint64 _data_frames;
+    quint64 _transmissions;
+    float _repeater_latency;
+    float _rx_switch_time;
+    float _tx_switch_time;
+    std::vector<float> _core_load;
+    std::vector<deadline> _deadlines;
+    std::vector<blockstats> _block_stats;
+    std::vector<bufferstats> _buffer_stats;
+    tdmastats _tdma_stats;
+    bool _tdma_active;
+};
+
+#endif // TELEMETRY_H
@@ -22,7 +22,7 @@
 #include <QTcpSocket>
 #include <QString>
 #include <QStringList>
-#include <QRegularExpressionValidator>
+#include <QRegularExpression>
 #include <QTime>
 #include <QAbstractSocket>
 #include <QElapsedTimer>
@@ -36,12 +36,14 @@
 #include "station.h"
 #include "commandprocessor.h"
 #include "logger.h"
+#include "telemetry.h"
 
 class TelnetServer : public QObject
 {
     Q_OBJECT
 public:
-    explicit TelnetServer(const Settings *settings, Logger *logger, QObject *parent = 0);
+    explicit TelnetServer(const Settings *settings, Logger *logger, Telemetry *telemetry,
+                          QObject *parent = 0);
     ~TelnetServer();
 
     CommandProcessor *command_processor; // public needed for signals and slots
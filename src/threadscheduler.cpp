@@ -0,0 +1,146 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "threadscheduler.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+/// msec between core load and deadline samples
+static const int SCHED_SAMPLE_MSEC = 2000;
+
+ThreadScheduler::ThreadScheduler(const Settings *settings, Logger *logger,
+                                 Telemetry *telemetry, QObject *parent) :
+    QObject(parent)
+{
+    _settings = settings;
+    _logger = logger;
+    _telemetry = telemetry;
+    _timer = new QTimer(this);
+    QObject::connect(_timer, SIGNAL(timeout()), this, SLOT(sample()));
+}
+
+bool ThreadScheduler::applyProfile(const Settings *settings, Logger *logger, const QString &name)
+{
+    if(!settings->sched_profiles.contains(name))
+        return true;
+    schedprofile profile = settings->sched_profiles.value(name);
+    bool ok = true;
+    if(!profile.cpus.isEmpty())
+    {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        for(int i=0;i<profile.cpus.size();i++)
+            CPU_SET(profile.cpus.at(i), &cpuset);
+        int res = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+        if(res != 0)
+        {
+            logger->log(Logger::LogLevelWarning, QString("Could not set CPU affinity for %1: %2")
+                        .arg(name).arg(strerror(res)));
+            ok = false;
+        }
+    }
+    int policy = SCHED_OTHER;
+    if(profile.policy == "fifo")
+        policy = SCHED_FIFO;
+    else if(profile.policy == "rr")
+        policy = SCHED_RR;
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if(policy != SCHED_OTHER)
+        param.sched_priority = profile.priority;
+    int res = pthread_setschedparam(pthread_self(), policy, &param);
+    if(res != 0)
+    {
+        /// usually missing CAP_SYS_NICE or an rtprio limit
+        logger->log(Logger::LogLevelWarning, QString("Could not set %1 scheduling for %2: %3")
+                    .arg(profile.policy).arg(name).arg(strerror(res)));
+        ok = false;
+    }
+    if(ok)
+        logger->log(Logger::LogLevelInfo, QString("Thread %1 scheduled with policy %2 priority %3")
+                    .arg(name).arg(profile.policy).arg(param.sched_priority));
+    return ok;
+}
+
+void ThreadScheduler::start()
+{
+    readCoreLoad();
+    _timer->start(SCHED_SAMPLE_MSEC);
+}
+
+void ThreadScheduler::stop()
+{
+    _timer->stop();
+}
+
+void ThreadScheduler::sample()
+{
+    readCoreLoad();
+    std::vector<Telemetry::deadline> deadlines = _telemetry->getDeadlines();
+    _last_missed.resize(deadlines.size(), 0);
+    for(unsigned int i=0;i<deadlines.size();i++)
+    {
+        const Telemetry::deadline &d = deadlines.at(i);
+        if(d.missed > _last_missed.at(i))
+        {
+            _logger->log(Logger::LogLevelWarning, QString("%1 missed %2 deadlines of %3 usec, worst %4 usec")
+                         .arg(d.name).arg(d.missed - _last_missed.at(i))
+                         .arg(d.budget_usec).arg(d.worst_usec));
+        }
+        _last_missed[i] = d.missed;
+    }
+}
+
+void ThreadScheduler::readCoreLoad()
+{
+    QFile stat("/proc/stat");
+    if(!stat.open(QIODevice::ReadOnly | QIODevice::Text))
+        return;
+    std::vector<float> load;
+    unsigned int core = 0;
+    while(!stat.atEnd())
+    {
+        QByteArray line = stat.readLine();
+        /// "cpu0 user nice system idle iowait irq softirq steal ..."
+        if(!line.startsWith("cpu") || line.startsWith("cpu "))
+            continue;
+        QList<QByteArray> fields = line.simplified().split(' ');
+        if(fields.size() < 5)
+            continue;
+        quint64 total = 0;
+        for(int i=1;i<fields.size();i++)
+            total += fields.at(i).toULongLong();
+        quint64 idle = fields.at(4).toULongLong();
+        if(fields.size() > 5)
+            idle += fields.at(5).toULongLong();
+        quint64 busy = total - idle;
+        if(core >= _last_total.size())
+        {
+            _last_total.push_back(0);
+            _last_busy.push_back(0);
+        }
+        quint64 delta_total = total - _last_total.at(core);
+        quint64 delta_busy = busy - _last_busy.at(core);
+        load.push_back((delta_total > 0) ? 100.0f * delta_busy / delta_total : 0.0f);
+        _last_total[core] = total;
+        _last_busy[core] = busy;
+        core++;
+    }
+    stat.close();
+    _telemetry->setCoreLoad(load);
+}
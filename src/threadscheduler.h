@@ -0,0 +1,60 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef THREADSCHEDULER_H
+#define THREADSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QFile>
+#include <vector>
+#include "src/settings.h"
+#include "src/logger.h"
+#include "src/telemetry.h"
+
+/// Applies the sched_profiles of Settings to the Qt worker threads and
+/// samples per core load and missed deadlines into Telemetry
+class ThreadScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThreadScheduler(const Settings *settings, Logger *logger,
+                             Telemetry *telemetry, QObject *parent = nullptr);
+    /// Sets affinity and policy of the calling thread from the named profile,
+    /// does nothing if the profile is not configured
+    static bool applyProfile(const Settings *settings, Logger *logger, const QString &name);
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void sample();
+
+private:
+    void readCoreLoad();
+
+    const Settings *_settings;
+    Logger *_logger;
+    Telemetry *_telemetry;
+    QTimer *_timer;
+    std::vector<quint64> _last_busy;
+    std::vector<quint64> _last_total;
+    std::vector<quint64> _last_missed;
+};
+
+#endif // THREADSCHEDULER_H
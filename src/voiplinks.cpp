@@ -0,0 +1,134 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "voiplinks.h"
+
+/// msec between attempts to bring back a dropped session
+static const int LINK_RECONNECT_MSEC = 10000;
+
+VoipLinks::VoipLinks(const Settings *settings, Logger *logger, QObject *parent) :
+    QObject(parent)
+{
+    _settings = settings;
+    _logger = logger;
+    _running = false;
+    _reconnect_timer = new QTimer(this);
+    _reconnect_timer->setSingleShot(true);
+    QObject::connect(_reconnect_timer, SIGNAL(timeout()), this, SLOT(reconnect()));
+    for(int i=0;i<settings->voip_links.size();i++)
+    {
+        const voiplink &link = settings->voip_links.at(i);
+        MumbleClient *client = new MumbleClient(settings, logger);
+        /// link 0 is the primary session
+        client->setLink(i + 1, link.password, link.channel, link.bitrate);
+        QObject::connect(client, SIGNAL(connectedToServer(QString)),
+                         this, SLOT(linkConnected(QString)));
+        QObject::connect(client, SIGNAL(disconnected()), this, SLOT(linkDisconnected()));
+        _clients.append(client);
+        _connected.append(false);
+    }
+}
+
+VoipLinks::~VoipLinks()
+{
+    stop();
+    for(int i=0;i<_clients.size();i++)
+    {
+        delete _clients.at(i);
+    }
+    _clients.clear();
+}
+
+QVector<MumbleClient*> VoipLinks::getClients()
+{
+    return _clients;
+}
+
+int VoipLinks::getConnected()
+{
+    return _connected.count(true);
+}
+
+void VoipLinks::start()
+{
+    _running = true;
+    for(int i=0;i<_clients.size();i++)
+    {
+        const voiplink &link = _settings->voip_links.at(i);
+        _logger->log(Logger::LogLevelInfo, QString("Connecting VOIP link %1 to %2:%3").arg(
+                         i + 1).arg(link.server).arg(link.port));
+        _clients.at(i)->connectToServer(link.server, (unsigned)link.port);
+    }
+}
+
+void VoipLinks::stop()
+{
+    _running = false;
+    _reconnect_timer->stop();
+    for(int i=0;i<_clients.size();i++)
+    {
+        if(_connected.at(i))
+            _clients.at(i)->disconnectFromServer();
+    }
+}
+
+void VoipLinks::linkConnected(QString message)
+{
+    Q_UNUSED(message);
+    MumbleClient *client = qobject_cast<MumbleClient*>(sender());
+    int index = _clients.indexOf(client);
+    if(index < 0)
+        return;
+    _connected[index] = true;
+    _logger->log(Logger::LogLevelInfo, QString("VOIP link %1 connected").arg(index + 1));
+    updateConnected();
+}
+
+void VoipLinks::linkDisconnected()
+{
+    MumbleClient *client = qobject_cast<MumbleClient*>(sender());
+    int index = _clients.indexOf(client);
+    if(index < 0)
+        return;
+    if(_connected.at(index))
+        _logger->log(Logger::LogLevelWarning, QString("VOIP link %1 disconnected").arg(index + 1));
+    _connected[index] = false;
+    updateConnected();
+    if(_running && !_reconnect_timer->isActive())
+        _reconnect_timer->start(LINK_RECONNECT_MSEC);
+}
+
+void VoipLinks::reconnect()
+{
+    if(!_running)
+        return;
+    for(int i=0;i<_clients.size();i++)
+    {
+        if(_connected.at(i))
+            continue;
+        const voiplink &link = _settings->voip_links.at(i);
+        /// drop the old socket state before trying again
+        _clients.at(i)->disconnectFromServer();
+        _clients.at(i)->connectToServer(link.server, (unsigned)link.port);
+    }
+}
+
+void VoipLinks::updateConnected()
+{
+    Settings *settings = const_cast<Settings*>(_settings);
+    settings->voip_links_connected = getConnected();
+}
@@ -0,0 +1,61 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef VOIPLINKS_H
+#define VOIPLINKS_H
+
+#include <QObject>
+#include <QVector>
+#include <QTimer>
+#include "src/mumbleclient.h"
+#include "src/settings.h"
+#include "src/logger.h"
+
+/// Extra VOIP sessions from voip_links, bridging the radio to several
+/// servers or channels from one process. Each session gets the shared
+/// Opus stream for its bitrate and feeds the same audio mixer as the
+/// primary session, sessions which drop are reconnected
+class VoipLinks : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VoipLinks(const Settings *settings, Logger *logger, QObject *parent = nullptr);
+    ~VoipLinks();
+    QVector<MumbleClient*> getClients();
+    int getConnected();
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void linkConnected(QString message);
+    void linkDisconnected();
+    void reconnect();
+
+private:
+    void updateConnected();
+
+    const Settings *_settings;
+    Logger *_logger;
+    QVector<MumbleClient*> _clients;
+    QVector<bool> _connected;
+    QTimer *_reconnect_timer;
+    bool _running;
+};
+
+#endif // VOIPLINKS_H
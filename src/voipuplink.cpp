@@ -0,0 +1,337 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+#include "voipuplink.h"
+#include <time.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+/// one second at 8 ksps
+static const unsigned int UPLINK_BUFFER_SAMPLES = 8192;
+/// 120 msec, the longest Opus frame and the longest Opus packet
+static const int UPLINK_MAX_FRAME_SAMPLES = 960;
+static const int UPLINK_MAX_PACKET_MSEC = 120;
+static const int UPLINK_MAX_PACKET_FRAMES = UPLINK_MAX_PACKET_MSEC / 20;
+/// largest Opus packet the encoder can produce for one frame
+static const int UPLINK_MAX_FRAME_BYTES = 1276;
+static const int UPLINK_MAX_PACKET_BYTES = UPLINK_MAX_PACKET_FRAMES * UPLINK_MAX_FRAME_BYTES;
+/// frames quieter than this are silence for DTX, about -50 dBFS
+static const float UPLINK_DTX_RMS = 100.0f;
+/// silence still sent after speech, so word endings are not clipped
+static const int UPLINK_DTX_HANGOVER_MSEC = 200;
+/// encoding a frame for all streams must finish before the next 20 msec frame
+static const qint64 UPLINK_DEADLINE_USEC = 20000;
+
+VoipUplink::VoipUplink(const Settings *settings, Logger *logger, Telemetry *telemetry,
+                       QObject *parent) :
+    QObject(parent)
+{
+    _settings = settings;
+    _logger = logger;
+    _telemetry = telemetry;
+    _encode_deadline = telemetry->addDeadline("voipuplink", UPLINK_DEADLINE_USEC);
+    _buffer.resize(UPLINK_BUFFER_SAMPLES, 0);
+    _mask = UPLINK_BUFFER_SAMPLES - 1;
+    _write_index.store(0);
+    _read_index.store(0);
+    _volume.store(1.0f);
+    _bitrate.store(settings->voip_bitrate);
+    _dropped.store(0);
+    _packets_sent.store(0);
+    _working.store(true);
+    _links_changed.store(false);
+    _silent_msec = 0;
+    _idle_msec = 0;
+    _dtx = false;
+    _streams.push_back(createStream(settings->voip_bitrate));
+    updateStreams();
+}
+
+VoipUplink::~VoipUplink()
+{
+    for(unsigned int i=0;i<_streams.size();i++)
+        destroyStream(_streams.at(i));
+    _streams.clear();
+}
+
+VoipUplink::stream* VoipUplink::createStream(int bitrate)
+{
+    stream *s = new stream;
+    s->bitrate = bitrate;
+    s->codec = new AudioEncoder(_settings);
+    s->codec->set_voip_bitrate(bitrate);
+    s->codec->set_voip_dtx(_dtx);
+    s->repacketizer = opus_repacketizer_create();
+    s->frames.resize(UPLINK_MAX_PACKET_BYTES);
+    s->frame_count = 0;
+    return s;
+}
+
+void VoipUplink::destroyStream(stream *s)
+{
+    opus_repacketizer_destroy(s->repacketizer);
+    delete s->codec;
+    delete s;
+}
+
+void VoipUplink::updateStreams()
+{
+    int bitrate = _bitrate.load();
+    stream *primary = _streams.at(0);
+    if(primary->bitrate != bitrate)
+    {
+        sendPacket(primary);
+        primary->bitrate = bitrate;
+        primary->codec->set_voip_bitrate(bitrate);
+    }
+    /// links using their own bitrate get their own encoder, everyone
+    /// else shares the primary stream
+    std::vector<int> wanted;
+    for(int i=0;i<_settings->voip_links.size();i++)
+    {
+        int link_bitrate = _settings->voip_links.at(i).bitrate;
+        if((link_bitrate > 0) && (link_bitrate != bitrate) &&
+                (std::find(wanted.begin(), wanted.end(), link_bitrate) == wanted.end()))
+            wanted.push_back(link_bitrate);
+    }
+    for(int i=(int)_streams.size()-1;i>0;i--)
+    {
+        std::vector<int>::iterator it = std::find(wanted.begin(), wanted.end(),
+                                                  _streams.at(i)->bitrate);
+        if(it == wanted.end())
+        {
+            sendPacket(_streams.at(i));
+            destroyStream(_streams.at(i));
+            _streams.erase(_streams.begin() + i);
+        }
+        else
+        {
+            wanted.erase(it);
+        }
+    }
+    for(unsigned int i=0;i<wanted.size();i++)
+    {
+        _streams.push_back(createStream(wanted.at(i)));
+    }
+}
+
+void VoipUplink::stop()
+{
+    _working.store(false);
+}
+
+void VoipUplink::setVolume(float value)
+{
+    _volume.store(value);
+}
+
+void VoipUplink::setBitrate(int bitrate)
+{
+    _bitrate.store(bitrate);
+}
+
+void VoipUplink::linksChanged()
+{
+    _links_changed.store(true);
+}
+
+quint64 VoipUplink::getDropped()
+{
+    return _dropped.load();
+}
+
+quint64 VoipUplink::getPacketsSent()
+{
+    return _packets_sent.load();
+}
+
+void VoipUplink::push(const short *samples, int count, float gain)
+{
+    unsigned int write_index = _write_index.load(std::memory_order_relaxed);
+    unsigned int read_index = _read_index.load(std::memory_order_acquire);
+    int space = (int)(UPLINK_BUFFER_SAMPLES - (write_index - read_index));
+    if(count > space)
+    {
+        /// uplink is not keeping up, the newest audio is lost
+        _dropped.fetch_add(count - space);
+        count = space;
+    }
+    for(int i=0;i<count;i++)
+    {
+        _buffer[(write_index + i) & _mask] = (short)(samples[i] * gain);
+    }
+    _write_index.store(write_index + count, std::memory_order_release);
+}
+
+int VoipUplink::fill()
+{
+    return (int)(_write_index.load(std::memory_order_acquire) -
+                 _read_index.load(std::memory_order_relaxed));
+}
+
+int VoipUplink::pop(short *samples, int count)
+{
+    unsigned int read_index = _read_index.load(std::memory_order_relaxed);
+    int n = std::min(fill(), count);
+    float volume = _volume.load();
+    for(int i=0;i<n;i++)
+    {
+        samples[i] = (short)(_buffer[(read_index + i) & _mask] * volume);
+    }
+    _read_index.store(read_index + n, std::memory_order_release);
+    return n;
+}
+
+void VoipUplink::discard()
+{
+    _read_index.store(_write_index.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+bool VoipUplink::isSilent(short *samples, int count)
+{
+    float power = 0.0f;
+    for(int i=0;i<count;i++)
+    {
+        power += (float)samples[i] * (float)samples[i];
+    }
+    return sqrt(power / (float)count) < UPLINK_DTX_RMS;
+}
+
+void VoipUplink::sendPacket(stream *s)
+{
+    if(s->frame_count == 0)
+        return;
+    /// shared by every session using this bitrate, freed after the last one
+    QByteArray packet(UPLINK_MAX_PACKET_BYTES, Qt::Uninitialized);
+    int size = opus_repacketizer_out(s->repacketizer, (unsigned char*)packet.data(),
+                                     UPLINK_MAX_PACKET_BYTES);
+    if(size > 0)
+    {
+        _packets_sent.fetch_add(1);
+        packet.resize(size);
+        emit voipDataOpus(packet, s->bitrate);
+    }
+    s->frame_count = 0;
+    opus_repacketizer_init(s->repacketizer);
+}
+
+void VoipUplink::sendPackets()
+{
+    for(unsigned int i=0;i<_streams.size();i++)
+        sendPacket(_streams.at(i));
+}
+
+void VoipUplink::encodeFrame(stream *s, short *pcm, int frame_samples, int frames_per_packet)
+{
+    /// the repacketizer keeps pointers to the frames until the packet is sent
+    unsigned char *frame = &s->frames[s->frame_count * UPLINK_MAX_FRAME_BYTES];
+    int size = s->codec->encode_opus_voip(pcm, frame_samples, frame, UPLINK_MAX_FRAME_BYTES);
+    if(size <= 2)
+    {
+        /// encoder DTX frame or error, nothing worth sending
+        return;
+    }
+    if(opus_repacketizer_cat(s->repacketizer, frame, size) != OPUS_OK)
+    {
+        /// frame configuration changed, start a new packet
+        if(s->frame_count > 0)
+        {
+            sendPacket(s);
+            memmove(&s->frames[0], frame, size);
+            frame = &s->frames[0];
+        }
+        if(opus_repacketizer_cat(s->repacketizer, frame, size) != OPUS_OK)
+        {
+            return;
+        }
+    }
+    s->frame_count++;
+    if(s->frame_count >= frames_per_packet)
+        sendPacket(s);
+}
+
+void VoipUplink::run()
+{
+    short pcm[UPLINK_MAX_FRAME_SAMPLES];
+    ThreadScheduler::applyProfile(_settings, _logger, "voipuplink");
+    QElapsedTimer encode_timer;
+    while(_working.load())
+    {
+        if((_bitrate.load() != _streams.at(0)->bitrate) || _links_changed.exchange(false))
+        {
+            updateStreams();
+        }
+        if((bool)_settings->voip_dtx != _dtx)
+        {
+            _dtx = (bool)_settings->voip_dtx;
+            for(unsigned int i=0;i<_streams.size();i++)
+                _streams.at(i)->codec->set_voip_dtx(_dtx);
+        }
+        if(!_settings->voip_connected && (_settings->voip_links_connected < 1))
+        {
+            discard();
+            sendPackets();
+            struct timespec time_to_sleep = {0, 20000000L };
+            nanosleep(&time_to_sleep, NULL);
+            continue;
+        }
+        int frame_msec = _settings->voip_frame_duration;
+        if((frame_msec != 20) && (frame_msec != 60) && (frame_msec != 120))
+            frame_msec = 40;
+        int frame_samples = frame_msec * 8;
+        int frames_per_packet = std::max(1, std::min(_settings->voip_frames_per_packet,
+                                                     UPLINK_MAX_PACKET_MSEC / frame_msec));
+
+        if(fill() < frame_samples)
+        {
+            /// audio stopped, don't hold back what is already encoded
+            if(_idle_msec >= frame_msec)
+                sendPackets();
+            struct timespec time_to_sleep = {0, 5000000L };
+            nanosleep(&time_to_sleep, NULL);
+            _idle_msec += 5;
+            continue;
+        }
+        _idle_msec = 0;
+        pop(pcm, frame_samples);
+
+        if(_dtx && isSilent(pcm, frame_samples))
+        {
+            _silent_msec += frame_msec;
+            if(_silent_msec > UPLINK_DTX_HANGOVER_MSEC)
+            {
+                sendPackets();
+                continue;
+            }
+        }
+        else
+        {
+            _silent_msec = 0;
+        }
+
+        /// the same frame goes to every stream, sessions sharing a bitrate
+        /// share the packets
+        encode_timer.start();
+        for(unsigned int i=0;i<_streams.size();i++)
+            encodeFrame(_streams.at(i), pcm, frame_samples, frames_per_packet);
+        _telemetry->countCycle(_encode_deadline, encode_timer.nsecsElapsed() / 1000);
+    }
+    sendPackets();
+    emit finished();
+}
@@ -0,0 +1,110 @@
+// Written by Adrian Musceac YO8RZZ , started March 2016.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+#ifndef VOIPUPLINK_H
+#define VOIPUPLINK_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <atomic>
+#include <vector>
+#include <opus/opus.h>
+#include "audio/audioencoder.h"
+#include "src/settings.h"
+#include "src/logger.h"
+#include "src/telemetry.h"
+#include "src/threadscheduler.h"
+
+/// Encodes radio and local audio for the VOIP server in its own thread.
+/// The radio thread pushes samples into a single producer / single consumer
+/// ring, the uplink cuts them into Opus frames of voip_frame_duration msec
+/// and sends voip_frames_per_packet frames in one Opus packet.
+/// With DTX enabled, silence is neither encoded nor sent after a short hangover.
+/// Audio is encoded once per distinct bitrate used by the VOIP sessions,
+/// each packet carries its bitrate so sessions pick the stream they use
+class VoipUplink : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VoipUplink(const Settings *settings, Logger *logger, Telemetry *telemetry,
+                        QObject *parent = nullptr);
+    ~VoipUplink();
+
+    /// producer side, called from the radio thread only
+    void push(const short *samples, int count, float gain=1.0f);
+    void setVolume(float value);
+    void setBitrate(int bitrate);
+    /// voip_links was edited, the streams are rebuilt before the next frame
+    void linksChanged();
+    quint64 getDropped();
+    quint64 getPacketsSent();
+
+signals:
+    void finished();
+    void voipDataOpus(QByteArray opus_packet, int bitrate);
+
+public slots:
+    void run();
+    void stop();
+
+private:
+    /// one encoder per distinct bitrate
+    struct stream
+    {
+        int bitrate;
+        AudioEncoder *codec;
+        OpusRepacketizer *repacketizer;
+        /// encoded frames waiting to be sent as one packet
+        std::vector<unsigned char> frames;
+        int frame_count;
+    };
+
+    stream *createStream(int bitrate);
+    void destroyStream(stream *s);
+    void updateStreams();
+    void encodeFrame(stream *s, short *pcm, int frame_samples, int frames_per_packet);
+    int fill();
+    int pop(short *samples, int count);
+    void discard();
+    bool isSilent(short *samples, int count);
+    void sendPacket(stream *s);
+    void sendPackets();
+
+    const Settings *_settings;
+    Logger *_logger;
+    Telemetry *_telemetry;
+    int _encode_deadline;
+    /// the first stream always follows voip_bitrate
+    std::vector<stream*> _streams;
+    std::vector<short> _buffer;
+    unsigned int _mask;
+    std::atomic<unsigned int> _write_index;
+    std::atomic<unsigned int> _read_index;
+    std::atomic<float> _volume;
+    std::atomic<int> _bitrate;
+    std::atomic<quint64> _dropped;
+    std::atomic<quint64> _packets_sent;
+    std::atomic<bool> _working;
+    std::atomic<bool> _links_changed;
+    bool _dtx;
+    int _silent_msec;
+    int _idle_msec;
+};
+
+#endif // VOIPUPLINK_H
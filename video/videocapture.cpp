@@ -42,7 +42,7 @@ struct buffer {
 static char            *dev_name;
 static enum io_method   io = IO_METHOD_MMAP;
 static int              fd = -1;
-struct buffer          *buffers;
+static struct buffer   *buffers;
 static unsigned int     n_buffers;
 static int              out_buf;
 static int              force_format = 1;
@@ -74,105 +74,56 @@ static void process_image(const void *p, int size)
         fflush(stderr);
 }
 
-static int read_frame(unsigned char *frame, int& len)
+/* Zero-copy capture: the buffer stays dequeued while its contents are
+ * being used and must be given back with requeue_frame().
+ * Only IO_METHOD_MMAP is supported here. */
+static int dequeue_frame(int& index, int& len)
 {
         struct v4l2_buffer buf;
-        unsigned int i;
-
-        switch (io) {
-        case IO_METHOD_READ:
-                if (-1 == read(fd, buffers[0].start, buffers[0].length)) {
-                        switch (errno) {
-                        case EAGAIN:
-                                return 0;
-
-                        case EIO:
-                                /* Could ignore EIO, see spec. */
 
-                                /* fall through */
+        CLEAR(buf);
 
-                        default:
-                                errno_exit("read");
-                        }
-                }
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
 
-                //process_image(buffers[0].start, buffers[0].length);
-                memcpy(frame, buffers[0].start, buffers[0].length);
-                len = buffers[0].length;
-                break;
+        if (-1 == xioctl(fd, VIDIOC_DQBUF, &buf)) {
+                switch (errno) {
+                case EAGAIN:
+                        return 0;
 
-        case IO_METHOD_MMAP:
-                CLEAR(buf);
+                case EIO:
+                        /* Could ignore EIO, see spec. */
 
-                buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                buf.memory = V4L2_MEMORY_MMAP;
+                        /* fall through */
 
-                if (-1 == xioctl(fd, VIDIOC_DQBUF, &buf)) {
-                        switch (errno) {
-                        case EAGAIN:
-                                return 0;
-
-                        case EIO:
-                                /* Could ignore EIO, see spec. */
-
-                                /* fall through */
-
-                        default:
-                                errno_exit("VIDIOC_DQBUF");
-                        }
+                default:
+                        errno_exit("VIDIOC_DQBUF");
                 }
+        }
 
-                assert(buf.index < n_buffers);
-
-                //process_image(buffers[buf.index].start, buf.bytesused);
-                memcpy(frame, buffers[buf.index].start, buf.bytesused);
-                len = buf.bytesused;
-
-                if (-1 == xioctl(fd, VIDIOC_QBUF, &buf))
-                        errno_exit("VIDIOC_QBUF");
-                break;
-
-        case IO_METHOD_USERPTR:
-                CLEAR(buf);
-
-                buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                buf.memory = V4L2_MEMORY_USERPTR;
-
-                if (-1 == xioctl(fd, VIDIOC_DQBUF, &buf)) {
-                        switch (errno) {
-                        case EAGAIN:
-                                return 0;
-
-                        case EIO:
-                                /* Could ignore EIO, see spec. */
-
-                                /* fall through */
-
-                        default:
-                                errno_exit("VIDIOC_DQBUF");
-                        }
-                }
+        assert(buf.index < n_buffers);
 
-                for (i = 0; i < n_buffers; ++i)
-                        if (buf.m.userptr == (unsigned long)buffers[i].start
-                            && buf.length == buffers[i].length)
-                                break;
+        index = buf.index;
+        len = buf.bytesused;
+        return 1;
+}
 
-                assert(i < n_buffers);
+static void requeue_frame(int index)
+{
+        struct v4l2_buffer buf;
 
-                //process_image((void *)buf.m.userptr, buf.bytesused);
-                memcpy(frame, (void *)buf.m.userptr, buf.bytesused);
-                len = buf.bytesused;
+        CLEAR(buf);
 
-                if (-1 == xioctl(fd, VIDIOC_QBUF, &buf))
-                        errno_exit("VIDIOC_QBUF");
-                break;
-        }
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = index;
 
-        return 1;
+        if (-1 == xioctl(fd, VIDIOC_QBUF, &buf))
+                errno_exit("VIDIOC_QBUF");
 }
 
-static void capture_frame(unsigned char *frame, int& len)
+/* Returns 1 when a frame is ready, 0 on timeout */
+static int wait_frame(long timeout_usec)
 {
       for (;;) {
 	      fd_set fds;
@@ -182,9 +133,8 @@ static void capture_frame(unsigned char *frame, int& len)
 	      FD_ZERO(&fds);
 	      FD_SET(fd, &fds);
 
-	      /* Timeout. */
-          tv.tv_sec = 2;
-          tv.tv_usec = 0;
+	      tv.tv_sec = 0;
+	      tv.tv_usec = timeout_usec;
 
 	      r = select(fd + 1, &fds, NULL, NULL, &tv);
 
@@ -194,16 +144,8 @@ static void capture_frame(unsigned char *frame, int& len)
 		      errno_exit("select");
 	      }
 
-	      if (0 == r) {
-		      fprintf(stderr, "select timeout\\n");
-		      exit(EXIT_FAILURE);
-	      }
-
-	      if (read_frame(frame, len))
-              break;
-	      /* EAGAIN - continue select loop. */
+	      return r > 0;
       }
-
 }
 
 static void stop_capturing(void)
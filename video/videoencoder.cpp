@@ -19,28 +19,192 @@
 #include "video/videocapture.cpp"
 #include <jpeglib.h>
 #include <setjmp.h>
+#include <algorithm>
+#include <vector>
+
+static const unsigned int VIDEO_WIDTH = 320;
+static const unsigned int VIDEO_HEIGHT = 240;
+static const unsigned int MAX_DECODED_FRAME_SIZE = 230400;
+/// reference frames kept for VOIP senders, the least recently seen one goes first
+static const unsigned int MAX_VIDEO_SOURCES = 8;
+
+/// Rate control limits
+static const int MIN_QUALITY = 3;
+static const int MAX_QUALITY = 60;
+static const int QUALITY_SEARCH_STEPS = 4;
+
+/// Conditional replenishment: 16x16 tiles, one MCU each so tiles never bleed
+static const unsigned int TILE_SIZE = 16;
+static const unsigned int TILES_X = VIDEO_WIDTH / TILE_SIZE;
+static const unsigned int TILES_Y = VIDEO_HEIGHT / TILE_SIZE;
+static const unsigned int NUM_TILES = TILES_X * TILES_Y;
+static const unsigned int TILE_CHANGE_THRESHOLD = TILE_SIZE * TILE_SIZE * 6;
+static const unsigned int KEYFRAME_INTERVAL = 10;
+/// Tile frame: marker byte, changed tile bitmap, then a JPEG of the packed tiles
+static const unsigned char TILE_FRAME_MARKER = 0x52;
+static const unsigned int TILE_BITMAP_SIZE = (NUM_TILES + 7) / 8;
+static const unsigned int TILE_HEADER_SIZE = 1 + TILE_BITMAP_SIZE;
+
+
+struct videoencoder_error_mgr {
+  struct jpeg_error_mgr pub;    /* "public" fields */
+
+  jmp_buf setjmp_buffer;        /* for return to caller */
+};
+
+typedef struct videoencoder_error_mgr *my_error_ptr;
+
+/*
+ * Here's the routine that will replace the standard error_exit method:
+ */
+
+METHODDEF(void)
+my_error_exit (j_common_ptr cinfo)
+{
+  /* cinfo->err really points to a my_error_mgr struct, so coerce pointer */
+  my_error_ptr myerr = (my_error_ptr) cinfo->err;
+
+  /* Always display the message. */
+  /* We could postpone this until after returning, if we chose. */
+  (*cinfo->err->output_message) (cinfo);
+  /* Return control to the setjmp point */
+  longjmp(myerr->setjmp_buffer, 1);
+}
+
+/// Compressed data goes straight into the caller's radio frame,
+/// anything beyond the frame size is discarded (frame gets truncated)
+struct videoencoder_destination_mgr {
+  struct jpeg_destination_mgr pub;
+
+  unsigned char *buffer;
+  unsigned long size;
+  bool overflow;
+  unsigned char discard[4096];
+};
+
+METHODDEF(void)
+init_destination (j_compress_ptr cinfo)
+{
+  videoencoder_destination_mgr *dest = (videoencoder_destination_mgr*) cinfo->dest;
+  dest->pub.next_output_byte = dest->buffer;
+  dest->pub.free_in_buffer = dest->size;
+  dest->overflow = false;
+}
+
+METHODDEF(boolean)
+empty_output_buffer (j_compress_ptr cinfo)
+{
+  videoencoder_destination_mgr *dest = (videoencoder_destination_mgr*) cinfo->dest;
+  dest->overflow = true;
+  dest->pub.next_output_byte = dest->discard;
+  dest->pub.free_in_buffer = sizeof(dest->discard);
+  return TRUE;
+}
+
+METHODDEF(void)
+term_destination (j_compress_ptr cinfo)
+{
+  (void) cinfo;
+}
 
 
 VideoEncoder::VideoEncoder(Logger *logger)
 {
     _logger = logger;
     _init = false;
+    _capture_running = false;
+    _latest_buffer = -1;
+    _latest_length = 0;
+    _encoding_buffer = -1;
+    _downscale = false;
+    _frame_skip = false;
+    _inter_frames = false;
+    _quality = 10;
+    _tile_quality = 10;
+    _frames_since_keyframe = 0;
+
+    /// Compressor and decompressor are created once and reused for every frame
+    _compress_err = new videoencoder_error_mgr;
+    _cinfo = new jpeg_compress_struct;
+    _cinfo->err = jpeg_std_error(&_compress_err->pub);
+    jpeg_create_compress(_cinfo);
+    _dest = new videoencoder_destination_mgr;
+    _dest->pub.init_destination = init_destination;
+    _dest->pub.empty_output_buffer = empty_output_buffer;
+    _dest->pub.term_destination = term_destination;
+    _dest->buffer = nullptr;
+    _dest->size = 0;
+    _dest->overflow = false;
+    _cinfo->dest = &_dest->pub;
+
+    _cinfo->image_width = VIDEO_WIDTH;
+    _cinfo->image_height = VIDEO_HEIGHT;
+    _cinfo->input_components = 3;
+    _cinfo->in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(_cinfo);
+    /// Planar 4:2:0 input, same sampling the library used to produce for us
+    _cinfo->raw_data_in = TRUE;
+    _cinfo->comp_info[0].h_samp_factor = 2;
+    _cinfo->comp_info[0].v_samp_factor = 2;
+    _cinfo->comp_info[1].h_samp_factor = 1;
+    _cinfo->comp_info[1].v_samp_factor = 1;
+    _cinfo->comp_info[2].h_samp_factor = 1;
+    _cinfo->comp_info[2].v_samp_factor = 1;
+    _y_plane = new unsigned char[VIDEO_WIDTH * VIDEO_HEIGHT];
+    _u_plane = new unsigned char[VIDEO_WIDTH * VIDEO_HEIGHT / 4];
+    _v_plane = new unsigned char[VIDEO_WIDTH * VIDEO_HEIGHT / 4];
+    _work_y = new unsigned char[VIDEO_WIDTH * VIDEO_HEIGHT];
+    _work_u = new unsigned char[VIDEO_WIDTH * VIDEO_HEIGHT / 4];
+    _work_v = new unsigned char[VIDEO_WIDTH * VIDEO_HEIGHT / 4];
+    _reference_y = new unsigned char[VIDEO_WIDTH * VIDEO_HEIGHT];
+    memset(_reference_y, 0, VIDEO_WIDTH * VIDEO_HEIGHT);
+
+    _decompress_err = new videoencoder_error_mgr;
+    _dinfo = new jpeg_decompress_struct;
+    _dinfo->err = jpeg_std_error(&_decompress_err->pub);
+    _decompress_err->pub.error_exit = my_error_exit;
+    jpeg_create_decompress(_dinfo);
+    _decode_count = 0;
+    _tile_frame = new unsigned char[MAX_DECODED_FRAME_SIZE];
 }
 
 VideoEncoder::~VideoEncoder()
 {
     deinit();
+    jpeg_destroy_compress(_cinfo);
+    jpeg_destroy_decompress(_dinfo);
+    delete _cinfo;
+    delete _dinfo;
+    delete _compress_err;
+    delete _decompress_err;
+    delete _dest;
+    delete[] _y_plane;
+    delete[] _u_plane;
+    delete[] _v_plane;
+    delete[] _work_y;
+    delete[] _work_u;
+    delete[] _work_v;
+    delete[] _reference_y;
+    for(auto &it : _decoded_frames)
+        delete[] it.second.frame;
+    delete[] _tile_frame;
 }
 
 void VideoEncoder::init(QString device_name)
 {
     if(_init)
         return;
-    dev_name = (char*)(device_name.toStdString().c_str());
+    _device_name = device_name.toStdString();
+    dev_name = (char*)(_device_name.c_str());
     _logger->log(Logger::LogLevelInfo,"Using video device: " + device_name);
     open_device();
     init_device();
     start_capturing();
+    _latest_buffer = -1;
+    _encoding_buffer = -1;
+    _frames_since_keyframe = 0;
+    _capture_running = true;
+    _capture_thread = std::thread(&VideoEncoder::capture_loop, this);
     _init = true;
 }
 
@@ -48,225 +212,485 @@ void VideoEncoder::deinit()
 {
     if(!_init)
         return;
+    {
+        std::lock_guard<std::mutex> lock(_capture_mutex);
+        _capture_running = false;
+    }
+    _capture_thread.join();
+    {
+        /// wait for an encode in progress to give back its buffer
+        std::unique_lock<std::mutex> lock(_capture_mutex);
+        while(_encoding_buffer >= 0)
+            _capture_cond.wait(lock);
+        _init = false;
+        _latest_buffer = -1;
+    }
     stop_capturing();
     uninit_device();
     close_device();
-    _init = false;
 }
 
-void VideoEncoder::encode_jpeg(unsigned char *videobuffer, unsigned long &encoded_size, unsigned long max_video_frame_size)
+void VideoEncoder::set_options(bool downscale, bool frame_skip, bool inter_frames)
 {
-    int len;
-    unsigned char *frame = new unsigned char[230400];
-    QDateTime dateTime1 = QDateTime::currentDateTime();
-    capture_frame(frame, len);
-    QDateTime dateTime2 = QDateTime::currentDateTime();
-    qint64 milliseconds = dateTime1.msecsTo(dateTime2);
-    Q_UNUSED(milliseconds);
-    //std::cout << "video capture " << milliseconds << " / " << len << std::endl;
-
-    unsigned char *input = frame;
-    struct jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-    JSAMPROW row_ptr[1];
-    int row_stride;
-    Q_UNUSED(row_ptr);
-    Q_UNUSED(row_stride);
-
-    encoded_size = 0;
+    std::lock_guard<std::mutex> lock(_capture_mutex);
+    _downscale = downscale;
+    _frame_skip = frame_skip;
+    _inter_frames = inter_frames;
+    _frames_since_keyframe = 0;
+}
 
-    unsigned char *outbuf = nullptr;
-
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_compress(&cinfo);
-    jpeg_mem_dest(&cinfo, &outbuf, &encoded_size);
-
-        // jrow is a libjpeg row of samples array of 1 row pointer
-    cinfo.image_width = 320 & -1;
-    cinfo.image_height = 240 & -1;
-    cinfo.input_components = 3;
-    cinfo.in_color_space = JCS_YCbCr; //libJPEG expects YUV 3bytes, 24bit
-
-    jpeg_set_defaults(&cinfo);
-    jpeg_set_quality(&cinfo, 10, TRUE);
-    jpeg_start_compress(&cinfo, TRUE);
-
-    unsigned char tmprowbuf[320 * 3];
-
-    JSAMPROW row_pointer[1];
-    row_pointer[0] = &tmprowbuf[0];
-    while (cinfo.next_scanline < cinfo.image_height) {
-        unsigned i, j;
-        unsigned offset = cinfo.next_scanline * cinfo.image_width * 2; //offset to the correct row
-        for (i = 0, j = 0; i < cinfo.image_width * 2; i += 4, j += 6) { //input strides by 4 bytes, output strides by 6 (2 pixels)
-            tmprowbuf[j + 0] = input[offset + i + 0]; // Y (unique to this pixel)
-            tmprowbuf[j + 1] = input[offset + i + 1]; // U (shared between pixels)
-            tmprowbuf[j + 2] = input[offset + i + 3]; // V (shared between pixels)
-            tmprowbuf[j + 3] = input[offset + i + 2]; // Y (unique to this pixel)
-            tmprowbuf[j + 4] = input[offset + i + 1]; // U (shared between pixels)
-            tmprowbuf[j + 5] = input[offset + i + 3]; // V (shared between pixels)
+void VideoEncoder::capture_loop()
+{
+    while(true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_capture_mutex);
+            if(!_capture_running)
+                break;
         }
-        jpeg_write_scanlines(&cinfo, row_pointer, 1);
+        if(!wait_frame(100000))
+            continue;
+        int index, len;
+        if(!dequeue_frame(index, len))
+            continue;
+        std::lock_guard<std::mutex> lock(_capture_mutex);
+        int previous = _latest_buffer;
+        _latest_buffer = index;
+        _latest_length = len;
+        /// keep only the newest frame, the encoder returns its own buffer when done
+        if((previous >= 0) && (previous != _encoding_buffer))
+            requeue_frame(previous);
+        _capture_cond.notify_all();
     }
+}
 
-    jpeg_finish_compress(&cinfo);
-    if(encoded_size > max_video_frame_size)
+void VideoEncoder::convert_frame(const unsigned char *input)
+{
+    /// YUYV to planar 4:2:0, chroma averaged over each pair of lines
+    const unsigned int stride = VIDEO_WIDTH * 2;
+    for(unsigned int row = 0; row < VIDEO_HEIGHT; row++)
     {
-        encoded_size = max_video_frame_size;
+        const unsigned char *line = input + row * stride;
+        unsigned char *y = &_y_plane[row * VIDEO_WIDTH];
+        for(unsigned int x = 0; x < VIDEO_WIDTH; x += 2)
+        {
+            y[x] = line[2 * x];
+            y[x + 1] = line[2 * x + 2];
+        }
     }
-    memcpy(videobuffer, outbuf, encoded_size);
-    jpeg_destroy_compress(&cinfo);
-    delete[] frame;
+    for(unsigned int row = 0; row < VIDEO_HEIGHT / 2; row++)
+    {
+        const unsigned char *line0 = input + 2 * row * stride;
+        const unsigned char *line1 = line0 + stride;
+        unsigned char *u = &_u_plane[row * VIDEO_WIDTH / 2];
+        unsigned char *v = &_v_plane[row * VIDEO_WIDTH / 2];
+        for(unsigned int x = 0; x < VIDEO_WIDTH / 2; x++)
+        {
+            u[x] = (line0[4 * x + 1] + line1[4 * x + 1] + 1) >> 1;
+            v[x] = (line0[4 * x + 3] + line1[4 * x + 3] + 1) >> 1;
+        }
+    }
+}
 
+unsigned long VideoEncoder::compress_planes(const unsigned char *y, const unsigned char *u,
+                                            const unsigned char *v, unsigned int width,
+                                            unsigned int height, int quality,
+                                            unsigned char *out, unsigned long max_size)
+{
+    const unsigned int rows = 2 * DCTSIZE;
+    JSAMPROW y_rows[2 * DCTSIZE];
+    JSAMPROW u_rows[DCTSIZE];
+    JSAMPROW v_rows[DCTSIZE];
+    JSAMPARRAY planes[3] = {y_rows, u_rows, v_rows};
+
+    _dest->buffer = out;
+    _dest->size = max_size;
+    _cinfo->image_width = width;
+    _cinfo->image_height = height;
+    jpeg_set_quality(_cinfo, quality, TRUE);
+    jpeg_start_compress(_cinfo, TRUE);
+    for(unsigned int row = 0; row < height; row += rows)
+    {
+        /// rows past the bottom edge repeat the last line
+        for(unsigned int i = 0; i < rows; i++)
+        {
+            y_rows[i] = (JSAMPROW)&y[std::min(row + i, height - 1) * width];
+        }
+        for(unsigned int i = 0; i < DCTSIZE; i++)
+        {
+            unsigned int chroma_row = std::min(row / 2 + i, height / 2 - 1);
+            u_rows[i] = (JSAMPROW)&u[chroma_row * width / 2];
+            v_rows[i] = (JSAMPROW)&v[chroma_row * width / 2];
+        }
+        jpeg_write_raw_data(_cinfo, planes, rows);
+    }
+    jpeg_finish_compress(_cinfo);
+    if(_dest->overflow)
+        return 0;
+    return max_size - _dest->pub.free_in_buffer;
 }
 
+unsigned long VideoEncoder::compress_to_fit(const unsigned char *y, const unsigned char *u,
+                                            const unsigned char *v, unsigned int width,
+                                            unsigned int height, int &quality,
+                                            unsigned char *out, unsigned long max_size)
+{
+    /// Start from the quality that fit the last frame, scenes change slowly
+    unsigned long size = compress_planes(y, u, v, width, height, quality, out, max_size);
+    if(size > 0)
+    {
+        if((size < max_size * 3 / 4) && (quality < MAX_QUALITY))
+            quality += 2;
+        return size;
+    }
+    /// Too large, binary search downwards
+    int low = MIN_QUALITY;
+    int high = quality - 1;
+    int best = -1;
+    int last_tried = quality;
+    for(int i = 0; (i < QUALITY_SEARCH_STEPS) && (low <= high); i++)
+    {
+        int mid = (low + high) / 2;
+        last_tried = mid;
+        if(compress_planes(y, u, v, width, height, mid, out, max_size) > 0)
+        {
+            best = mid;
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    if(best < 0 && last_tried != MIN_QUALITY)
+    {
+        last_tried = MIN_QUALITY;
+        if(compress_planes(y, u, v, width, height, MIN_QUALITY, out, max_size) > 0)
+            best = MIN_QUALITY;
+    }
+    if(best < 0)
+    {
+        quality = MIN_QUALITY;
+        return 0;
+    }
+    quality = best;
+    if(last_tried != best)
+        return compress_planes(y, u, v, width, height, best, out, max_size);
+    return max_size - _dest->pub.free_in_buffer;
+}
 
-struct my_error_mgr {
-  struct jpeg_error_mgr pub;    /* "public" fields */
+unsigned long VideoEncoder::encode_keyframe(unsigned char *out, unsigned long max_size)
+{
+    unsigned long size = compress_to_fit(_y_plane, _u_plane, _v_plane, VIDEO_WIDTH, VIDEO_HEIGHT,
+                                         _quality, out, max_size);
+    if((size == 0) && _downscale)
+    {
+        /// Half resolution, 2x2 box filter
+        const unsigned int w = VIDEO_WIDTH / 2;
+        const unsigned int h = VIDEO_HEIGHT / 2;
+        for(unsigned int row = 0; row < h; row++)
+        {
+            const unsigned char *l0 = &_y_plane[2 * row * VIDEO_WIDTH];
+            const unsigned char *l1 = l0 + VIDEO_WIDTH;
+            for(unsigned int x = 0; x < w; x++)
+                _work_y[row * w + x] = (l0[2*x] + l0[2*x+1] + l1[2*x] + l1[2*x+1] + 2) >> 2;
+        }
+        for(unsigned int row = 0; row < h / 2; row++)
+        {
+            const unsigned char *u0 = &_u_plane[2 * row * w];
+            const unsigned char *u1 = u0 + w;
+            const unsigned char *v0 = &_v_plane[2 * row * w];
+            const unsigned char *v1 = v0 + w;
+            for(unsigned int x = 0; x < w / 2; x++)
+            {
+                _work_u[row * w / 2 + x] = (u0[2*x] + u0[2*x+1] + u1[2*x] + u1[2*x+1] + 2) >> 2;
+                _work_v[row * w / 2 + x] = (v0[2*x] + v0[2*x+1] + v1[2*x] + v1[2*x+1] + 2) >> 2;
+            }
+        }
+        int quality = MAX_QUALITY;
+        size = compress_to_fit(_work_y, _work_u, _work_v, w, h, quality, out, max_size);
+    }
+    if((size == 0) && !_frame_skip)
+    {
+        /// Old behaviour: send it truncated and let the decoder cope
+        compress_planes(_y_plane, _u_plane, _v_plane, VIDEO_WIDTH, VIDEO_HEIGHT,
+                        MIN_QUALITY, out, max_size);
+        size = max_size;
+    }
+    if(size > 0)
+    {
+        memcpy(_reference_y, _y_plane, VIDEO_WIDTH * VIDEO_HEIGHT);
+        _frames_since_keyframe = 0;
+    }
+    return size;
+}
 
-  jmp_buf setjmp_buffer;        /* for return to caller */
-};
+bool VideoEncoder::encode_tiles(unsigned char *out, unsigned long max_size, unsigned long &encoded_size)
+{
+    encoded_size = 0;
+    std::vector<std::pair<unsigned int, unsigned int>> changed; // SAD, tile index
+    for(unsigned int t = 0; t < NUM_TILES; t++)
+    {
+        unsigned int x0 = (t % TILES_X) * TILE_SIZE;
+        unsigned int y0 = (t / TILES_X) * TILE_SIZE;
+        unsigned int sad = 0;
+        for(unsigned int r = 0; r < TILE_SIZE; r++)
+        {
+            const unsigned char *cur = &_y_plane[(y0 + r) * VIDEO_WIDTH + x0];
+            const unsigned char *ref = &_reference_y[(y0 + r) * VIDEO_WIDTH + x0];
+            for(unsigned int c = 0; c < TILE_SIZE; c++)
+                sad += std::abs((int)cur[c] - (int)ref[c]);
+        }
+        if(sad > TILE_CHANGE_THRESHOLD)
+            changed.push_back(std::make_pair(sad, t));
+    }
+    /// Past this point a full frame compresses better
+    if(changed.size() > NUM_TILES * 6 / 10)
+        return false;
 
-typedef struct my_error_mgr *my_error_ptr;
+    unsigned char *bitmap = &out[1];
+    out[0] = TILE_FRAME_MARKER;
+    if(changed.size() == 0)
+    {
+        memset(bitmap, 0, TILE_BITMAP_SIZE);
+        encoded_size = _frame_skip ? 0 : TILE_HEADER_SIZE;
+        return true;
+    }
+    /// Most changed first, drop the least changed tiles if over budget
+    std::sort(changed.begin(), changed.end(),
+              [](const std::pair<unsigned int, unsigned int> &a,
+                 const std::pair<unsigned int, unsigned int> &b) { return a.first > b.first; });
+    unsigned int count = changed.size();
+    unsigned long size = 0;
+    std::vector<unsigned int> tiles;
+    while(count > 0)
+    {
+        tiles.clear();
+        for(unsigned int i = 0; i < count; i++)
+            tiles.push_back(changed.at(i).second);
+        std::sort(tiles.begin(), tiles.end());
+
+        unsigned int tile_rows = (count + TILES_X - 1) / TILES_X;
+        unsigned int height = tile_rows * TILE_SIZE;
+        memset(_work_y, 0, VIDEO_WIDTH * height);
+        memset(_work_u, 128, VIDEO_WIDTH * height / 4);
+        memset(_work_v, 128, VIDEO_WIDTH * height / 4);
+        for(unsigned int slot = 0; slot < count; slot++)
+        {
+            unsigned int t = tiles.at(slot);
+            unsigned int sx = (t % TILES_X) * TILE_SIZE;
+            unsigned int sy = (t / TILES_X) * TILE_SIZE;
+            unsigned int dx = (slot % TILES_X) * TILE_SIZE;
+            unsigned int dy = (slot / TILES_X) * TILE_SIZE;
+            for(unsigned int r = 0; r < TILE_SIZE; r++)
+                memcpy(&_work_y[(dy + r) * VIDEO_WIDTH + dx],
+                        &_y_plane[(sy + r) * VIDEO_WIDTH + sx], TILE_SIZE);
+            for(unsigned int r = 0; r < TILE_SIZE / 2; r++)
+            {
+                memcpy(&_work_u[(dy / 2 + r) * VIDEO_WIDTH / 2 + dx / 2],
+                        &_u_plane[(sy / 2 + r) * VIDEO_WIDTH / 2 + sx / 2], TILE_SIZE / 2);
+                memcpy(&_work_v[(dy / 2 + r) * VIDEO_WIDTH / 2 + dx / 2],
+                        &_v_plane[(sy / 2 + r) * VIDEO_WIDTH / 2 + sx / 2], TILE_SIZE / 2);
+            }
+        }
+        size = compress_to_fit(_work_y, _work_u, _work_v, VIDEO_WIDTH, height, _tile_quality,
+                               &out[TILE_HEADER_SIZE], max_size - TILE_HEADER_SIZE);
+        if(size > 0)
+            break;
+        count /= 2;
+    }
+    if(size == 0)
+        return false;
 
-/*
- * Here's the routine that will replace the standard error_exit method:
- */
+    memset(bitmap, 0, TILE_BITMAP_SIZE);
+    for(unsigned int i = 0; i < tiles.size(); i++)
+    {
+        unsigned int t = tiles.at(i);
+        bitmap[t / 8] |= (1 << (t % 8));
+        unsigned int x0 = (t % TILES_X) * TILE_SIZE;
+        unsigned int y0 = (t / TILES_X) * TILE_SIZE;
+        for(unsigned int r = 0; r < TILE_SIZE; r++)
+            memcpy(&_reference_y[(y0 + r) * VIDEO_WIDTH + x0],
+                    &_y_plane[(y0 + r) * VIDEO_WIDTH + x0], TILE_SIZE);
+    }
+    encoded_size = TILE_HEADER_SIZE + size;
+    return true;
+}
 
-METHODDEF(void)
-my_error_exit (j_common_ptr cinfo)
+void VideoEncoder::encode_jpeg(unsigned char *videobuffer, unsigned long &encoded_size, unsigned long max_video_frame_size)
 {
-  /* cinfo->err really points to a my_error_mgr struct, so coerce pointer */
-  my_error_ptr myerr = (my_error_ptr) cinfo->err;
+    encoded_size = 0;
+    int index;
+    {
+        std::unique_lock<std::mutex> lock(_capture_mutex);
+        if(!_init)
+            return;
+        /// Only the very first frame after init may need waiting for
+        if(_latest_buffer < 0)
+        {
+            _capture_cond.wait_for(lock, std::chrono::milliseconds(200));
+        }
+        if((_latest_buffer < 0) ||
+                ((unsigned int)_latest_length < VIDEO_WIDTH * VIDEO_HEIGHT * 2))
+        {
+            return;
+        }
+        index = _latest_buffer;
+        _encoding_buffer = index;
+    }
 
-  /* Always display the message. */
-  /* We could postpone this until after returning, if we chose. */
-  (*cinfo->err->output_message) (cinfo);
-  /* Return control to the setjmp point */
-  longjmp(myerr->setjmp_buffer, 1);
+    convert_frame((const unsigned char*)buffers[index].start);
+
+    {
+        /// Done with the mmap'd buffer, the rest works on our planar copy
+        std::lock_guard<std::mutex> lock(_capture_mutex);
+        if(_encoding_buffer != _latest_buffer)
+            requeue_frame(_encoding_buffer);
+        _encoding_buffer = -1;
+        _capture_cond.notify_all();
+    }
+
+    bool keyframe = !_inter_frames || (_frames_since_keyframe >= (int)KEYFRAME_INTERVAL - 1);
+    if(!keyframe)
+    {
+        keyframe = !encode_tiles(videobuffer, max_video_frame_size, encoded_size);
+        _frames_since_keyframe++;
+    }
+    if(keyframe)
+    {
+        encoded_size = encode_keyframe(videobuffer, max_video_frame_size);
+    }
 }
 
-unsigned char* VideoEncoder::decode_jpeg(unsigned char *videobuffer, int data_length)
+
+bool VideoEncoder::decompress(const unsigned char *data, int data_length, unsigned char *out,
+                              unsigned int &width, unsigned int &height)
 {
-    int max_frame_size = 230400;
-    struct my_error_mgr jerr;
-    unsigned char *out_decompress = new unsigned char[max_frame_size];
-    /* This struct contains the JPEG decompression parameters and pointers to
-    * working space (which is allocated as needed by the JPEG library).
-    */
-    struct jpeg_decompress_struct cinfo;
-    /* We use our private extension JPEG error handler.
-    * Note that this struct must live as long as the main JPEG parameter
-    * struct, to avoid dangling-pointer problems.
-    */
-    /* More stuff */
-    JSAMPARRAY buffer;            /* Output row buffer */
-    int row_stride;               /* physical row width in output buffer */
-
-    /* In this example we want to open the input file before doing anything else,
-    * so that the setjmp() error recovery below can assume the file is open.
-    * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-    * requires it in order to read binary files.
-    */
-
-    /* Step 1: allocate and initialize JPEG decompression object */
-
-    /* We set up the normal JPEG error routines, then override error_exit. */
-    cinfo.err = jpeg_std_error(&jerr.pub);
-    jerr.pub.error_exit = my_error_exit;
-    /* Establish the setjmp return context for my_error_exit to use. */
-    if (setjmp(jerr.setjmp_buffer)) {
+    if (setjmp(_decompress_err->setjmp_buffer)) {
         /* If we get here, the JPEG code has signaled an error.
-         * We need to clean up the JPEG object, close the input file, and return.
+         * Abort leaves the decompressor usable for the next frame.
          */
-        jpeg_destroy_decompress(&cinfo);
-        delete[] out_decompress;
-        std::cerr << cinfo.err->output_message << std::endl;
-        return nullptr;
-    }
-    /* Now we can initialize the JPEG decompression object. */
-    jpeg_create_decompress(&cinfo);
-
-    /* Step 2: specify data source (eg, a file) */
-
-    jpeg_mem_src(&cinfo, videobuffer, data_length);
-
-    /* Step 3: read file parameters with jpeg_read_header() */
-
-    (void) jpeg_read_header(&cinfo, FALSE);
-    /* We can ignore the return value from jpeg_read_header since
-    *   (a) suspension is not possible with the stdio data source, and
-    *   (b) we passed TRUE to reject a tables-only JPEG file as an error.
-    * See libjpeg.txt for more info.
-    */
-
-    /* Step 4: set parameters for decompression */
-
-    /* In this example, we don't need to change any of the defaults set by
-    * jpeg_read_header(), so we do nothing here.
-    */
-
-    /* Step 5: Start decompressor */
-
-    (void) jpeg_start_decompress(&cinfo);
-    /* We can ignore the return value since suspension is not possible
-    * with the stdio data source.
-    */
-
-    /* We may need to do some setup of our own at this point before reading
-    * the data.  After jpeg_start_decompress() we have the correct scaled
-    * output image dimensions available, as well as the output colormap
-    * if we asked for color quantization.
-    * In this example, we need to make an output work buffer of the right size.
-    */
-    /* JSAMPLEs per row in output buffer */
-    row_stride = cinfo.output_width * cinfo.output_components;
-
-    /* Make a one-row-high sample array that will go away when done with image */
-    buffer = (*cinfo.mem->alloc_sarray)
-                ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
-
-    /* Step 6: while (scan lines remain to be read) */
-    /*           jpeg_read_scanlines(...); */
-
-    /* Here we use the library's state variable cinfo.output_scanline as the
-    * loop counter, so that we don't have to keep track ourselves.
-    */
-    int offset = 0;
-    while (cinfo.output_scanline < cinfo.output_height) {
-        /* jpeg_read_scanlines expects an array of pointers to scanlines.
-         * Here the array is only one element long, but you could ask for
-         * more than one scanline at a time if that's more convenient.
-         */
-        (void) jpeg_read_scanlines(&cinfo, buffer, 1);
-        /* Assume put_scanline_someplace wants a pointer and sample count. */
-        memcpy(&out_decompress[offset], buffer[0], row_stride);
-        offset += row_stride;
+        jpeg_abort_decompress(_dinfo);
+        return false;
     }
 
-    int raw_size = cinfo.output_components * cinfo.output_width * cinfo.output_height;
-
-    /* Step 7: Finish decompression */
+    jpeg_mem_src(_dinfo, (unsigned char*)data, data_length);
+    (void) jpeg_read_header(_dinfo, FALSE);
+    (void) jpeg_start_decompress(_dinfo);
 
-    (void) jpeg_finish_decompress(&cinfo);
-    /* We can ignore the return value since suspension is not possible
-    * with the stdio data source.
-    */
+    width = _dinfo->output_width;
+    height = _dinfo->output_height;
+    unsigned int row_stride = _dinfo->output_width * _dinfo->output_components;
+    if((_dinfo->output_components != 3) || (row_stride * height > MAX_DECODED_FRAME_SIZE))
+    {
+        jpeg_abort_decompress(_dinfo);
+        return false;
+    }
 
-    /* Step 8: Release JPEG decompression object */
+    /// Scanlines are decoded in place, no intermediate row buffer
+    while (_dinfo->output_scanline < _dinfo->output_height) {
+        JSAMPROW row = &out[_dinfo->output_scanline * row_stride];
+        (void) jpeg_read_scanlines(_dinfo, &row, 1);
+    }
 
-    /* This is an important step since it will release a good deal of memory. */
-    jpeg_destroy_decompress(&cinfo);
+    (void) jpeg_finish_decompress(_dinfo);
+    return true;
+}
 
-    /* At this point you may want to check to see whether any corrupt-data
-    * warnings occurred (test whether jerr.pub.num_warnings is nonzero).
-    */
+VideoEncoder::decoded_reference &VideoEncoder::reference_for(quint64 source)
+{
+    auto found = _decoded_frames.find(source);
+    if(found == _decoded_frames.end())
+    {
+        if(_decoded_frames.size() >= MAX_VIDEO_SOURCES)
+        {
+            auto oldest = _decoded_frames.end();
+            for(auto it = _decoded_frames.begin(); it != _decoded_frames.end(); ++it)
+            {
+                if((it->first != RADIO_VIDEO_SOURCE) && ((oldest == _decoded_frames.end()) ||
+                        (it->second.last_used < oldest->second.last_used)))
+                    oldest = it;
+            }
+            if(oldest != _decoded_frames.end())
+            {
+                delete[] oldest->second.frame;
+                _decoded_frames.erase(oldest);
+            }
+        }
+        decoded_reference reference;
+        reference.frame = new unsigned char[MAX_DECODED_FRAME_SIZE];
+        reference.valid = false;
+        found = _decoded_frames.insert(std::make_pair(source, reference)).first;
+    }
+    found->second.last_used = ++_decode_count;
+    return found->second;
+}
 
-    /* And we're done! */
-    unsigned char *raw_image = new unsigned char[raw_size];
-    memcpy(raw_image, out_decompress, raw_size);
-    delete[] out_decompress;
+unsigned char* VideoEncoder::decode_jpeg(unsigned char *videobuffer, int data_length,
+                                         quint64 source)
+{
+    std::lock_guard<std::mutex> lock(_decode_mutex);
+    unsigned int width, height;
+    const unsigned int stride = VIDEO_WIDTH * 3;
+    if(data_length < 2)
+        return nullptr;
+    decoded_reference &reference = reference_for(source);
+    unsigned char *decoded_frame = reference.frame;
 
-    return raw_image;
+    if(videobuffer[0] == TILE_FRAME_MARKER)
+    {
+        /// Replenishment tiles are pasted over the last decoded frame
+        if(!reference.valid || (data_length < (int)TILE_HEADER_SIZE))
+            return nullptr;
+        const unsigned char *bitmap = &videobuffer[1];
+        unsigned int count = 0;
+        for(unsigned int t = 0; t < NUM_TILES; t++)
+            if(bitmap[t / 8] & (1 << (t % 8)))
+                count++;
+        if(count == 0)
+            return decoded_frame;
+        if(!decompress(&videobuffer[TILE_HEADER_SIZE], data_length - TILE_HEADER_SIZE,
+                       _tile_frame, width, height))
+            return nullptr;
+        if((width != VIDEO_WIDTH) || (height < ((count + TILES_X - 1) / TILES_X) * TILE_SIZE))
+            return nullptr;
+        for(unsigned int t = 0, slot = 0; t < NUM_TILES; t++)
+        {
+            if(!(bitmap[t / 8] & (1 << (t % 8))))
+                continue;
+            unsigned int sx = (slot % TILES_X) * TILE_SIZE;
+            unsigned int sy = (slot / TILES_X) * TILE_SIZE;
+            unsigned int dx = (t % TILES_X) * TILE_SIZE;
+            unsigned int dy = (t / TILES_X) * TILE_SIZE;
+            for(unsigned int r = 0; r < TILE_SIZE; r++)
+                memcpy(&decoded_frame[(dy + r) * stride + dx * 3],
+                        &_tile_frame[(sy + r) * stride + sx * 3], TILE_SIZE * 3);
+            slot++;
+        }
+        return decoded_frame;
+    }
 
+    reference.valid = false;
+    if(!decompress(videobuffer, data_length, decoded_frame, width, height))
+        return nullptr;
+    if((width != VIDEO_WIDTH) || (height != VIDEO_HEIGHT))
+    {
+        /// Downscaled keyframe, nearest neighbour upscale in place from the end
+        unsigned int factor = VIDEO_WIDTH / width;
+        if((factor < 1) || (width * factor != VIDEO_WIDTH) || (height * factor != VIDEO_HEIGHT))
+            return nullptr;
+        for(int y = VIDEO_HEIGHT - 1; y >= 0; y--)
+        {
+            for(int x = VIDEO_WIDTH - 1; x >= 0; x--)
+            {
+                const unsigned char *src = &decoded_frame[((y / factor) * width + x / factor) * 3];
+                unsigned char *dst = &decoded_frame[(y * VIDEO_WIDTH + x) * 3];
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+            }
+        }
+    }
+    reference.valid = true;
+    return decoded_frame;
 }
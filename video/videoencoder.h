@@ -21,8 +21,18 @@
 #include <QDebug>
 #include <QDateTime>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
 #include "src/logger.h"
 
+struct jpeg_compress_struct;
+struct jpeg_decompress_struct;
+struct videoencoder_error_mgr;
+struct videoencoder_destination_mgr;
+
 class VideoEncoder
 {
 public:
@@ -30,12 +40,80 @@ public:
     ~VideoEncoder();
     void init(QString device_name);
     void deinit();
+    void set_options(bool downscale, bool frame_skip, bool inter_frames);
+    /// encoded_size is 0 when the frame was skipped
     void encode_jpeg(unsigned char *videobuffer, unsigned long &encoded_size, unsigned long max_video_frame_size);
-    unsigned char *decode_jpeg(unsigned char *videobuffer, int data_length);
+    /// Tiles are pasted over the last frame of the same source. Returned 320x240 RGB
+    /// buffer is owned by the encoder and valid until the next call for that source
+    unsigned char *decode_jpeg(unsigned char *videobuffer, int data_length,
+                               quint64 source=RADIO_VIDEO_SOURCE);
+    /// Source key of frames received over the radio, VOIP uses the session id
+    static const quint64 RADIO_VIDEO_SOURCE = ~(quint64)0;
 
 private:
+    void capture_loop();
+    void convert_frame(const unsigned char *input);
+    unsigned long compress_planes(const unsigned char *y, const unsigned char *u,
+                                  const unsigned char *v, unsigned int width, unsigned int height,
+                                  int quality, unsigned char *out, unsigned long max_size);
+    unsigned long compress_to_fit(const unsigned char *y, const unsigned char *u,
+                                  const unsigned char *v, unsigned int width, unsigned int height,
+                                  int &quality, unsigned char *out, unsigned long max_size);
+    unsigned long encode_keyframe(unsigned char *out, unsigned long max_size);
+    bool encode_tiles(unsigned char *out, unsigned long max_size, unsigned long &encoded_size);
+    bool decompress(const unsigned char *data, int data_length, unsigned char *out,
+                    unsigned int &width, unsigned int &height);
+
+    struct decoded_reference
+    {
+        unsigned char *frame;
+        bool valid;
+        quint64 last_used;
+    };
+    decoded_reference &reference_for(quint64 source);
+
     Logger *_logger;
     bool _init;
+    std::string _device_name;
+
+    /// V4L2 buffers are handed from the capture thread to the encoder
+    /// by index, the encoder reads the mmap'd memory directly
+    std::thread _capture_thread;
+    std::mutex _capture_mutex;
+    std::condition_variable _capture_cond;
+    bool _capture_running;
+    int _latest_buffer;
+    int _latest_length;
+    int _encoding_buffer;
+
+    /// Rate control
+    bool _downscale;
+    bool _frame_skip;
+    bool _inter_frames;
+    int _quality;
+    int _tile_quality;
+    int _frames_since_keyframe;
+
+    struct jpeg_compress_struct *_cinfo;
+    struct jpeg_decompress_struct *_dinfo;
+    struct videoencoder_error_mgr *_compress_err;
+    struct videoencoder_error_mgr *_decompress_err;
+    struct videoencoder_destination_mgr *_dest;
+    /// planar 4:2:0 copy of the current frame
+    unsigned char *_y_plane;
+    unsigned char *_u_plane;
+    unsigned char *_v_plane;
+    /// downscaled frame or packed replenishment tiles
+    unsigned char *_work_y;
+    unsigned char *_work_u;
+    unsigned char *_work_v;
+    /// luma the receiver is assumed to be showing
+    unsigned char *_reference_y;
+    /// last decoded frame of each source
+    std::map<quint64, decoded_reference> _decoded_frames;
+    quint64 _decode_count;
+    unsigned char *_tile_frame;
+    std::mutex _decode_mutex;
 
 };
 